@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "mem_pool.h"
+#include "palette.h"
+#include "spotify_client.h"
+#include "player_store.h"
+
+/**
+*
+* @brief Shows the album art of the current track and prefetches the next one.
+*
+* Two decoded images are kept: the one on screen and a standby one. While the network
+* is idle the next track is predicted from the queue and its cover is downloaded and
+* decoded into the standby image, which is swapped in as soon as the store reports
+* the new track.
+*
+* Each image carries a palette, extracted from the decoded pixels as the decoder produces
+* them, so themes switch together with the image without another pass over it.
+*
+*/
+class AlbumArt {
+public:
+    static constexpr int max_size = 160;  ///< Largest decoded width and height in pixels.
+
+    struct Stats {
+        uint32_t changes;                 ///< Track changes handled.
+        uint32_t prefetch_hits;           ///< Changes served from the standby image.
+        int64_t last_repaint_us;          ///< Track change to repaint for the last change.
+        int64_t avg_prefetched_us;        ///< Average track change to repaint with a prefetched image.
+        int64_t avg_fetched_us;           ///< Average track change to repaint without one.
+        int64_t last_palette_us;          ///< Time to pick the last palette from the extracted colors.
+    };
+
+    /**
+     * @brief Constructor for AlbumArt class. Must be called with the LVGL lock held.
+     *
+     * @param[in]  parent  The parent object.
+     * @param[in]  client  Client used to read the queue.
+     * @param[in]  store   Store reporting the track changes.
+     */
+    AlbumArt(lv_obj_t* parent, spotify::Client& client, PlayerStore& store);
+
+    /**
+     * @brief Destructor for AlbumArt class.
+     *
+     */
+    ~AlbumArt();
+
+    /**
+     * @brief  Gets the image object, e.g. to align it. Must be called with the LVGL lock held.
+     *
+     * @return The image object.
+     */
+    lv_obj_t* getObj();
+
+    /**
+     * @brief      Sets the function called with the palette of every image shown. It is called
+     *             with the LVGL lock held. Must be called with the LVGL lock held.
+     *
+     * @param[in]  listener  The function.
+     */
+    void setPaletteListener(std::function<void(const Palette&)> listener);
+
+    /**
+     * @brief  Gets the repaint statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats();
+
+    static void art_task_dummy(void *arg);
+    void art_task();
+
+private:
+
+    struct Buffer {
+        std::string url;                  ///< The URL the image was decoded from, empty if none.
+        uint16_t* pixels;                 ///< RGB565 pixels, max_size * max_size.
+        lv_image_dsc_t dsc;               ///< LVGL descriptor of the pixels.
+        Palette palette;                  ///< Colors of the image.
+    };
+
+    static void refr_event_cb(lv_event_t* e);
+
+    bool load(const std::string& url, Buffer& buffer);
+    bool decode(const mem::Buffer& jpg, Buffer& buffer);
+    bool predict_next(const spotify::Track& current, std::string& url);
+    void show(int index, int64_t changed_us, bool prefetched);
+
+    spotify::Client& client;
+    lv_obj_t* image;                      ///< The image object.
+    Buffer buffers[2];
+    int active;                           ///< Index of the buffer on screen.
+    HttpClient http_client;               ///< HttpClient for the cover downloads.
+    std::unique_ptr<uint8_t[]> work;      ///< Work area of the JPEG decoder.
+    PaletteExtractor palette_extractor;   ///< Fed by the decoder.
+    std::function<void(const Palette&)> palette_listener;  ///< Called when an image is shown.
+
+    spotify::Track pending;               ///< Track reported by the last change.
+    int64_t pending_changed_us;           ///< Time of the last change.
+    SemaphoreHandle_t mtx;                ///< Mutex for pending and the statistics.
+
+    int64_t repaint_changed_us;           ///< Change time of the repaint being measured, 0 if none.
+    bool repaint_prefetched;              ///< True if the repaint being measured uses a prefetched image.
+    int64_t prefetched_total_us;          ///< Sum of the repaint times with a prefetched image.
+    int64_t fetched_total_us;             ///< Sum of the repaint times without one.
+    Stats stats;                          ///< The repaint statistics.
+
+    TaskHandle_t task_handle;             ///< Task loading the images.
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Boot benchmarks of the API client's hot paths, reported through bench::Case.
+*
+* The "http" suite times the receive path of HttpClient fetching the queue and a playlist
+* page from the server at CONFIG_BENCH_SERVER_URL, normally tools/mock_api.py on the LAN.
+* "currently_playing" decodes the responses recorded in tools/payloads, next to parsing them
+* with cJSON, "track" copies tracks and builds them from the track cache, and "token" builds
+* the Authorization header from the access token and sets it on a client.
+*
+*/
+namespace api_bench {
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Runs the suites. The http suite needs the network up and is skipped without a server URL.
+     *
+     */
+    void run();
+#else
+    inline void run() {}
+#endif
+
+}
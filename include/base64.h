@@ -1,9 +1,37 @@
+#pragma once
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <span>
 #include <string_view>
+#include <type_traits>
 
+#if defined(__x86_64__) || defined(__i386__)
+#define BASE64_SSSE3 1
+#include <immintrin.h>
+#endif
+
+/**
+*
+* @brief Base64 (RFC 4648) encoding of string literals at compile time and of buffers at runtime.
+*
+* The runtime codec works on whole 24-bit groups with table lookups and no per-byte branches.
+* It only uses byte loads because the Xtensa cores fault on unaligned word loads. On x86 hosts
+* whose CPU has SSSE3, 12 bytes are encoded and 16 characters decoded per step in vector
+* registers, and the scalar kernel finishes the rest. Decoding is strict: characters outside
+* the alphabet, misplaced or missing padding and non-zero trailing bits are rejected, so every
+* byte sequence has exactly one accepted encoding. Both directions are constexpr, which lets
+* the static_asserts at the end check the scalar kernel against the literal encoder.
+*
+*/
 namespace base64 {
 
+    enum class Alphabet {
+        Standard,   ///< '+' and '/' with '=' padding.
+        Url         ///< '-' and '_' without padding, as in JWTs.
+    };
+
     constexpr std::array<char, 64> encode_table = {
         'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
         'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd',
@@ -28,17 +56,17 @@ namespace base64 {
         uint32_t octets = 0;
         uint32_t output_index = 0;
    
-        for (int i = 0; i < N - 1; i++) {
+        for (size_t i = 0; i < N - 1; i++) {
             if (i % 3 == 0) {
-                octets |= (str[i] << 16);
+                octets |= (static_cast<uint8_t>(str[i]) << 16);
             }
    
             else if (i % 3 == 1) {
-                octets |= (str[i] << 8);
+                octets |= (static_cast<uint8_t>(str[i]) << 8);
             }
    
             else if (i % 3 == 2) {
-                octets |= str[i];
+                octets |= static_cast<uint8_t>(str[i]);
                 char seg_1 = extract_bits(octets, 24 - 6, 6);
                 char seg_2 = extract_bits(octets, 24 - 12, 6);
                 char seg_3 = extract_bits(octets, 24 - 18, 6);
@@ -55,7 +83,7 @@ namespace base64 {
             }
         }
    
-        int remaining = (N - 1) % 3;
+        size_t remaining = (N - 1) % 3;
    
         if (remaining == 1) {
             char seg_1 = extract_bits(octets, 24 - 6, 6);
@@ -81,4 +109,350 @@ namespace base64 {
         return out;
     }
 
-}
\ No newline at end of file
+    constexpr std::array<char, 64> url_encode_table = [] {
+        std::array<char, 64> table = encode_table;
+        table[62] = '-';
+        table[63] = '_';
+        return table;
+    }();
+
+    //Entries of characters outside the alphabet have the high bit set.
+    constexpr std::array<uint8_t, 256> make_decode_table(const std::array<char, 64>& alphabet) {
+        std::array<uint8_t, 256> table{};
+
+        for(auto& entry : table) {
+            entry = 0x80;
+        }
+
+        for(size_t i = 0; i < alphabet.size(); i++) {
+            table[static_cast<uint8_t>(alphabet[i])] = static_cast<uint8_t>(i);
+        }
+
+        return table;
+    }
+
+    constexpr std::array<uint8_t, 256> decode_table = make_decode_table(encode_table);
+    constexpr std::array<uint8_t, 256> url_decode_table = make_decode_table(url_encode_table);
+
+#if BASE64_SSSE3
+    namespace simd {
+
+        //Offsets from the 6-bit values to the characters, per range of the alphabet.
+        static constexpr int8_t upper_offset = 'A';
+        static constexpr int8_t lower_offset = 'a' - 26;
+        static constexpr int8_t digit_offset = '0' - 52;
+
+        inline bool available() {
+            static const bool ssse3 = __builtin_cpu_supports("ssse3");
+            return ssse3;
+        }
+
+        //Lanes of a that lie in [low, high], bytes above 0x7F are negative and never do.
+        __attribute__((target("ssse3"))) inline __m128i in_range(__m128i a, char low, char high) {
+            return _mm_and_si128(_mm_cmpgt_epi8(a, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(a, _mm_set1_epi8(high + 1)));
+        }
+
+        /**
+         * @brief      Encodes whole blocks of 12 bytes while 16 can be loaded.
+         *
+         * @return The number of bytes encoded, 4 characters were written per 3 of them.
+         */
+        __attribute__((target("ssse3"))) inline size_t encode(const uint8_t* in, size_t len, char* out, char c62, char c63) {
+            const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+            size_t i = 0;
+
+            for(; len - i >= 16; i += 12, out += 16) {
+                __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), spread);
+
+                //Each 32-bit lane holds one group, the multiplies move its four 6-bit values to separate bytes.
+                __m128i ac = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+                __m128i bd = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+                __m128i values = _mm_or_si128(ac, bd);
+
+                __m128i offset = _mm_set1_epi8(upper_offset);
+                offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(25)), _mm_set1_epi8(lower_offset - upper_offset)));
+                offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(values, _mm_set1_epi8(51)), _mm_set1_epi8(digit_offset - lower_offset)));
+                offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(values, _mm_set1_epi8(62)), _mm_set1_epi8(c62 - 62 - digit_offset)));
+                offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpeq_epi8(values, _mm_set1_epi8(63)), _mm_set1_epi8(c63 - 63 - digit_offset)));
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi8(values, offset));
+            }
+
+            return i;
+        }
+
+        /**
+         * @brief      Decodes whole blocks of 16 characters.
+         *
+         * @param[out]  invalid  Gets the high bit set if a character is outside the alphabet.
+         *
+         * @return The number of characters decoded, 3 bytes were written per 4 of them.
+         */
+        __attribute__((target("ssse3"))) inline size_t decode(const char* in, size_t len, uint8_t* out, char c62, char c63, uint8_t& invalid) {
+            const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            __m128i bad = _mm_setzero_si128();
+            size_t i = 0;
+
+            for(; len - i >= 16; i += 16, out += 12) {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                __m128i upper = in_range(chars, 'A', 'Z');
+                __m128i lower = in_range(chars, 'a', 'z');
+                __m128i digit = in_range(chars, '0', '9');
+                __m128i is62 = _mm_cmpeq_epi8(chars, _mm_set1_epi8(c62));
+                __m128i is63 = _mm_cmpeq_epi8(chars, _mm_set1_epi8(c63));
+
+                __m128i offset = _mm_and_si128(upper, _mm_set1_epi8(-upper_offset));
+                offset = _mm_or_si128(offset, _mm_and_si128(lower, _mm_set1_epi8(-lower_offset)));
+                offset = _mm_or_si128(offset, _mm_and_si128(digit, _mm_set1_epi8(-digit_offset)));
+                offset = _mm_or_si128(offset, _mm_and_si128(is62, _mm_set1_epi8(62 - c62)));
+                offset = _mm_or_si128(offset, _mm_and_si128(is63, _mm_set1_epi8(63 - c63)));
+
+                __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(is62, is63)));
+                bad = _mm_or_si128(bad, _mm_andnot_si128(valid, _mm_set1_epi8(-1)));
+
+                //Joins the four 6-bit values of each group into 24 bits, then drops the fourth byte of each lane.
+                __m128i values = _mm_add_epi8(chars, offset);
+                __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+                __m128i groups = _mm_shuffle_epi8(_mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000)), pack);
+
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out), groups);
+                uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(groups, 8)));
+                std::memcpy(out + 8, &last, 4);
+            }
+
+            invalid |= _mm_movemask_epi8(bad) != 0 ? 0x80 : 0;
+            return i;
+        }
+
+    }
+#endif
+
+    /**
+     * @brief      Gets the length of the encoding of a buffer.
+     *
+     * @param[in]  len       The number of bytes to encode.
+     * @param[in]  alphabet  The alphabet, which decides the padding.
+     *
+     * @return The number of characters.
+     */
+    constexpr size_t encodedLength(size_t len, Alphabet alphabet = Alphabet::Standard) {
+        return alphabet == Alphabet::Standard ? 4 * ((len + 2) / 3) : (4 * len + 2) / 3;
+    }
+
+    /**
+     * @brief      Gets an upper bound of the decoded length of an encoding.
+     *
+     * @param[in]  len   The number of characters to decode.
+     *
+     * @return The maximum number of bytes.
+     */
+    constexpr size_t decodedMaxLength(size_t len) {
+        return len / 4 * 3 + len % 4 * 3 / 4;
+    }
+
+    /**
+     * @brief      Encodes a buffer. No NUL is appended.
+     *
+     * @param[in]   in        The bytes to encode.
+     * @param[out]  out       Receives the characters, at least encodedLength(in.size()) long.
+     * @param[out]  written   The number of characters written.
+     * @param[in]   alphabet  The alphabet.
+     *
+     * @return
+     *  - True if successful
+     *  - False if out is too small
+     */
+    constexpr bool encode(std::span<const uint8_t> in, std::span<char> out, size_t& written, Alphabet alphabet = Alphabet::Standard) {
+        const auto& table = alphabet == Alphabet::Standard ? encode_table : url_encode_table;
+
+        if(out.size() < encodedLength(in.size(), alphabet)) {
+            return false;
+        }
+
+        size_t i = 0;
+        size_t o = 0;
+
+#if BASE64_SSSE3
+        if(!std::is_constant_evaluated() && simd::available()) {
+            i = simd::encode(in.data(), in.size(), out.data(), table[62], table[63]);
+            o = i / 3 * 4;
+        }
+#endif
+
+        for(; in.size() - i >= 3; i += 3, o += 4) {
+            uint32_t word = in[i] << 16 | in[i + 1] << 8 | in[i + 2];
+
+            out[o] = table[word >> 18];
+            out[o + 1] = table[(word >> 12) & 0x3F];
+            out[o + 2] = table[(word >> 6) & 0x3F];
+            out[o + 3] = table[word & 0x3F];
+        }
+
+        size_t remaining = in.size() - i;
+
+        if(remaining > 0) {
+            uint32_t word = in[i] << 16 | (remaining == 2 ? in[i + 1] << 8 : 0);
+
+            out[o++] = table[word >> 18];
+            out[o++] = table[(word >> 12) & 0x3F];
+
+            if(remaining == 2) {
+                out[o++] = table[(word >> 6) & 0x3F];
+            }
+
+            if(alphabet == Alphabet::Standard) {
+                while(o % 4 != 0) {
+                    out[o++] = '=';
+                }
+            }
+        }
+
+        written = o;
+        return true;
+    }
+
+    /**
+     * @brief      Decodes and validates an encoding.
+     *
+     * @param[in]   in        The characters, without whitespace.
+     * @param[out]  out       Receives the bytes, at least decodedMaxLength(in.size()) long.
+     *                        Its contents are unspecified if decoding fails.
+     * @param[out]  written   The number of bytes written.
+     * @param[in]   alphabet  The alphabet. Standard requires padding, Url forbids it.
+     *
+     * @return
+     *  - True if successful
+     *  - False if the encoding is invalid or out is too small
+     */
+    constexpr bool decode(std::span<const char> in, std::span<uint8_t> out, size_t& written, Alphabet alphabet = Alphabet::Standard) {
+        const auto& table = alphabet == Alphabet::Standard ? decode_table : url_decode_table;
+        size_t len = in.size();
+
+        if(alphabet == Alphabet::Standard) {
+            if(len % 4 != 0) {
+                return false;
+            }
+
+            //Padding is not part of the alphabet, so any other '=' fails the lookup below.
+            if(len > 0 && in[len - 1] == '=') {
+                len -= in[len - 2] == '=' ? 2 : 1;
+            }
+        }
+
+        size_t full = len / 4 * 4;
+        size_t tail = len - full;
+
+        if(tail == 1 || out.size() < full / 4 * 3 + (tail > 0 ? tail - 1 : 0)) {
+            return false;
+        }
+
+        uint8_t invalid = 0;
+        size_t i = 0;
+        size_t o = 0;
+
+#if BASE64_SSSE3
+        if(!std::is_constant_evaluated() && simd::available()) {
+            const auto& chars = alphabet == Alphabet::Standard ? encode_table : url_encode_table;
+            i = simd::decode(in.data(), full, out.data(), chars[62], chars[63], invalid);
+            o = i / 4 * 3;
+        }
+#endif
+
+        //Validity is accumulated and checked once instead of per character.
+        for(; i < full; i += 4, o += 3) {
+            uint8_t a = table[static_cast<uint8_t>(in[i])];
+            uint8_t b = table[static_cast<uint8_t>(in[i + 1])];
+            uint8_t c = table[static_cast<uint8_t>(in[i + 2])];
+            uint8_t d = table[static_cast<uint8_t>(in[i + 3])];
+            uint32_t word = a << 18 | b << 12 | c << 6 | d;
+
+            invalid |= a | b | c | d;
+            out[o] = static_cast<uint8_t>(word >> 16);
+            out[o + 1] = static_cast<uint8_t>(word >> 8);
+            out[o + 2] = static_cast<uint8_t>(word);
+        }
+
+        if(tail > 0) {
+            uint8_t a = table[static_cast<uint8_t>(in[full])];
+            uint8_t b = table[static_cast<uint8_t>(in[full + 1])];
+            uint8_t c = tail == 3 ? table[static_cast<uint8_t>(in[full + 2])] : 0;
+            uint32_t word = a << 18 | b << 12 | c << 6;
+
+            invalid |= a | b | c;
+            out[o++] = static_cast<uint8_t>(word >> 16);
+
+            if(tail == 3) {
+                out[o++] = static_cast<uint8_t>(word >> 8);
+            }
+
+            //The bits past the last byte must be zero for the encoding to be canonical.
+            if((word & (tail == 3 ? 0xFF : 0xFFFF)) != 0) {
+                invalid |= 0x80;
+            }
+        }
+
+        if(invalid & 0x80) {
+            return false;
+        }
+
+        written = o;
+        return true;
+    }
+
+    //Runs the runtime codec on a literal and compares it with the literal encoder and a round trip.
+    template<std::size_t N>
+    constexpr bool conforms(const char(&str)[N], Alphabet alphabet = Alphabet::Standard) {
+        std::array<uint8_t, N> bytes{};
+        std::array<char, encodedLength(N - 1) + 1> chars{};
+        std::array<uint8_t, N> decoded{};
+        size_t encoded_len = 0;
+        size_t decoded_len = 0;
+
+        for(size_t i = 0; i < N - 1; i++) {
+            bytes[i] = static_cast<uint8_t>(str[i]);
+        }
+
+        if(!encode(std::span<const uint8_t>(bytes.data(), N - 1), chars, encoded_len, alphabet) ||
+           encoded_len != encodedLength(N - 1, alphabet)) {
+            return false;
+        }
+
+        if(alphabet == Alphabet::Standard) {
+            auto expected = encode(str);
+
+            for(size_t i = 0; i < encoded_len; i++) {
+                if(chars[i] != expected[i]) {
+                    return false;
+                }
+            }
+        }
+
+        if(!decode(std::span<const char>(chars.data(), encoded_len), decoded, decoded_len, alphabet) || decoded_len != N - 1) {
+            return false;
+        }
+
+        for(size_t i = 0; i < N - 1; i++) {
+            if(decoded[i] != bytes[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    constexpr bool rejects(std::string_view str, Alphabet alphabet = Alphabet::Standard) {
+        std::array<uint8_t, 16> out{};
+        size_t written = 0;
+        return !decode(str, out, written, alphabet);
+    }
+
+    static_assert(conforms("") && conforms("f") && conforms("fo") && conforms("foo"), "Runtime encoder differs from the literal encoder");
+    static_assert(conforms("foob") && conforms("fooba") && conforms("foobar"), "Runtime encoder differs from the literal encoder");
+    static_assert(conforms("\xff\xfe\xfd\x80\x00\x7f") && conforms("\xfb\xff", Alphabet::Url), "Runtime codec fails on high bytes");
+    static_assert(conforms("foobar", Alphabet::Url) && conforms("fo", Alphabet::Url), "Runtime codec fails on the URL alphabet");
+    static_assert(rejects("Zg=") && rejects("Zh==") && rejects("Zm9=v") && rejects("Zm 9v") && rejects("Zm9v=A==") && rejects("===="),
+                  "Decoder accepts invalid standard encodings");
+    static_assert(rejects("Zg==", Alphabet::Url) && rejects("Z", Alphabet::Url) && rejects("Zm+v", Alphabet::Url),
+                  "Decoder accepts invalid URL encodings");
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Boot benchmark of the runtime base64 codec in base64.h, reported as the "base64"
+*        suite. Kept out of base64.h so the codec builds without the IDF.
+*
+*/
+namespace base64 {
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Logs the throughput of the runtime codec against mbedTLS.
+     *
+     */
+    void benchmark();
+#else
+    inline void benchmark() {}
+#endif
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Runner of the boot benchmarks. A case times trials of an operation, after warming it
+*        up, and reports the median, 99th percentile and fastest time per operation, the heap
+*        allocations the task made per operation and the peak heap use above the start. Each
+*        case prints its result as a line "@B {...}" of JSON to the console, outside of the
+*        log so the log level doesn't hide it, which tools/bench_compare.py collects and
+*        compares against a recorded baseline.
+*
+* Allocations are counted by the heap hooks, which BOOT_BENCHMARKS enables. The peak counts
+* the allocations of every task, so it is only exact while nothing else runs.
+*
+*/
+namespace bench {
+
+    static constexpr uint32_t default_trials = 200;
+    static constexpr size_t max_metrics = 4;
+
+    struct Result {
+        uint32_t trials;            ///< Trials recorded.
+        uint32_t batch;             ///< Operations per trial.
+        float median_us;            ///< Median time of an operation.
+        float p99_us;               ///< 99th percentile time of an operation.
+        float min_us;               ///< Fastest time of an operation.
+        float allocations;          ///< Heap allocations per operation made by the task.
+        float allocated_bytes;      ///< Bytes of those allocations per operation.
+        uint32_t peak_bytes;        ///< Most heap in use during the trials above the start.
+    };
+
+    /**
+    *
+    * @brief Trials of one operation, started and stopped by the caller. Not thread safe, one
+    *        case is measured at a time.
+    *
+    */
+    class Case {
+    public:
+
+        /**
+         * @brief Constructor for Case class.
+         *
+         * @param[in]  suite   The suite, e.g. "base64".
+         * @param[in]  name    The case within the suite, e.g. "encode_3k".
+         * @param[in]  trials  The most trials recorded, further ones are ignored.
+         * @param[in]  batch   Operations per trial, to time operations shorter than a few microseconds.
+         */
+        Case(const char* suite, const char* name, uint32_t trials = default_trials, uint32_t batch = 1);
+
+        ~Case();
+
+        Case(const Case&) = delete;
+        Case& operator=(const Case&) = delete;
+
+        /**
+         * @brief Starts a trial.
+         *
+         */
+        void start();
+
+        /**
+         * @brief Ends the trial and records it.
+         *
+         */
+        void stop();
+
+        /**
+         * @brief Ends the trial without recording it, e.g. when a refresh drew nothing.
+         *
+         */
+        void cancel();
+
+        /**
+         * @brief      Adds a figure of the case to the report, such as its throughput.
+         *
+         * @param[in]  key    The JSON key, a literal.
+         * @param[in]  value  The value.
+         */
+        void metric(const char* key, double value);
+
+        /**
+         * @brief  Prints the report.
+         *
+         * @return The result.
+         */
+        Result report();
+
+    private:
+
+        struct Metric {
+            const char* key;
+            double value;
+        };
+
+        void end(bool record);
+
+        const char* suite;                          ///< The suite.
+        const char* name;                           ///< The case.
+        uint32_t batch;                             ///< Operations per trial.
+        std::vector<uint32_t> samples;              ///< CPU cycles of the trials recorded.
+        uint32_t start_cycles;                      ///< Cycle count at the start of the trial.
+        size_t start_free;                          ///< Free heap before the first trial.
+        uint32_t allocations;                       ///< Allocations of the recorded trials.
+        uint64_t allocated_bytes;                   ///< Bytes of those.
+        std::array<Metric, max_metrics> metrics;    ///< Figures added.
+        size_t metric_count;                        ///< Figures used.
+    };
+
+    /**
+     * @brief      Warms an operation up with a tenth as many runs, times it and prints the report.
+     *
+     * @param[in]  suite      The suite.
+     * @param[in]  name       The case within the suite.
+     * @param[in]  operation  The operation.
+     * @param[in]  trials     The trials.
+     * @param[in]  batch      Operations per trial.
+     *
+     * @return The result.
+     */
+    template<typename F>
+    Result run(const char* suite, const char* name, F&& operation, uint32_t trials = default_trials, uint32_t batch = 1) {
+        for(uint32_t i = 0; i < (trials * batch + 9) / 10; i++) {
+            operation();
+        }
+
+        Case measured(suite, name, trials, batch);
+
+        for(uint32_t trial = 0; trial < trials; trial++) {
+            measured.start();
+
+            for(uint32_t i = 0; i < batch; i++) {
+                operation();
+            }
+
+            measured.stop();
+        }
+
+        return measured.report();
+    }
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+*
+* @brief Latest-wins request channel for a continuous control.
+*
+* Sliders emit far more values than the API should see. Values submitted while
+* a request is in flight overwrite each other, so at most one request is outstanding
+* and the next one always carries the newest value. Sends are spaced by a minimum
+* interval, except for the value submitted on release which is sent as soon as the
+* channel is free.
+*
+*/
+class ControlChannel {
+public:
+    using Sender = std::function<bool(int)>;
+
+    struct Stats {
+        uint32_t drags;             ///< Number of completed drags.
+        uint32_t events;            ///< Values submitted during the last drag.
+        uint32_t requests;          ///< Requests sent during the last drag.
+        int64_t final_latency_us;   ///< Release to completion of the final request for the last drag.
+    };
+
+    /**
+     * @brief Constructor for ControlChannel class.
+     *
+     * @param[in]  name            The channel name, used for the task and log output.
+     * @param[in]  sender          Blocking function sending a single value.
+     * @param[in]  min_interval_ms Minimum time between two intermediate requests.
+     */
+    ControlChannel(const char* name, Sender sender, uint32_t min_interval_ms);
+
+    /**
+     * @brief Destructor for ControlChannel class.
+     *
+     */
+    ~ControlChannel();
+
+    /**
+     * @brief      Submits a value without blocking. Replaces any value not yet sent.
+     *
+     * @param[in]  value     The new value.
+     * @param[in]  released  True if this is the final value of the drag.
+     */
+    void submit(int value, bool released);
+
+    /**
+     * @brief  Gets the statistics of the last completed drag.
+     *
+     * @return The drag statistics.
+     */
+    Stats getStats();
+
+    static void channel_task_dummy(void *arg);
+    void channel_task();
+
+private:
+
+    const char* name;            ///< The channel name.
+    Sender sender;               ///< Sends a single value.
+    uint32_t min_interval_ms;    ///< Minimum time between intermediate requests.
+
+    portMUX_TYPE lock;           ///< Protects the pending value and the statistics.
+    int pending_value;           ///< The latest value not yet sent.
+    bool has_pending;            ///< True if pending_value has not been sent.
+    bool pending_released;       ///< True if pending_value is the final value of a drag.
+    bool dragging;               ///< True between the first value of a drag and its release.
+    int64_t release_time_us;     ///< Time the final value was submitted.
+    int64_t last_send_us;        ///< Time the last request was started.
+
+    uint32_t drag_events;        ///< Values submitted in the current drag.
+    uint32_t drag_requests;      ///< Requests sent in the current drag.
+    Stats stats;                 ///< Statistics of the last completed drag.
+
+    TaskHandle_t task_handle;    ///< Task sending the requests.
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Deferred logging for the network and UI hot paths.
+*
+* A log call stores its format string pointer and its arguments in binary form in a ring
+* buffer and returns; a low priority task formats and prints the records later. A full
+* buffer drops the record instead of waiting, so logging never blocks the caller.
+*
+* Each file sets its level by defining DLOG_LOCAL_LEVEL before including this header,
+* usually to the module level from the Logging menu. Calls above that level are removed at
+* compile time. Formats must be string literals, string arguments are copied (up to
+* dlog::max_string bytes) and '*' widths are not supported.
+*
+*/
+
+#ifndef DLOG_LOCAL_LEVEL
+#define DLOG_LOCAL_LEVEL CONFIG_DEFERRED_LOG_DEFAULT_LEVEL
+#endif
+
+namespace dlog {
+
+    //Same values as esp_log_level_t.
+    enum Level : uint8_t {
+        None,
+        Error,
+        Warn,
+        Info,
+        Debug,
+        Verbose
+    };
+
+    static constexpr size_t max_payload = 64;  ///< Bytes of arguments per record.
+    static constexpr size_t max_string = 31;   ///< Bytes kept of a string argument.
+
+    struct Header {
+        const char* tag;            ///< The log tag.
+        const char* format;         ///< The format string, which must outlive the record.
+        uint32_t time_ms;           ///< Time since boot.
+        uint8_t level;              ///< The Level.
+        uint8_t size;               ///< Bytes of payload used.
+    };
+
+    struct Record {
+        Header header;              ///< The header.
+        uint8_t payload[max_payload];  ///< The encoded arguments.
+    };
+
+    /**
+     * @brief Starts the task formatting the records.
+     *
+     */
+    void init();
+
+    /**
+     * @brief      Stamps and queues a record without blocking. Use the DLOG macros instead.
+     *
+     * @param[in]  record  The record, of which only header.size payload bytes are queued.
+     */
+    void submit(Record& record);
+
+    /**
+     * @brief  Gets the number of records dropped because the buffer was full.
+     *
+     * @return The number of dropped records.
+     */
+    uint32_t getDropped();
+
+    //Arguments are encoded in the sizes the format's length modifiers imply, see the formatter.
+    template<typename T>
+    void encode(Record& record, const T& value) {
+        using U = std::decay_t<T>;
+        uint8_t* dst = record.payload + record.header.size;
+        size_t room = max_payload - record.header.size;
+
+        if constexpr (std::is_same_v<U, const char*> || std::is_same_v<U, char*>) {
+            const char* str = value != nullptr ? value : "(null)";
+            size_t len = strnlen(str, max_string);
+
+            if(room < len + 1) {
+                record.header.size = max_payload;
+                return;
+            }
+
+            dst[0] = static_cast<uint8_t>(len);
+            std::memcpy(dst + 1, str, len);
+            record.header.size += len + 1;
+        }
+
+        else {
+            static_assert(std::is_arithmetic_v<U> || std::is_enum_v<U> || std::is_pointer_v<U>,
+                          "Deferred log arguments must be numbers, pointers or C strings");
+
+            //Mirrors the default argument promotions of printf.
+            using Stored = std::conditional_t<std::is_floating_point_v<U>, double,
+                           std::conditional_t<std::is_pointer_v<U>, uintptr_t,
+                           std::conditional_t<(sizeof(U) < sizeof(int)), int, U>>>;
+
+            Stored stored;
+
+            if constexpr (std::is_pointer_v<U>) {
+                stored = reinterpret_cast<uintptr_t>(value);
+            }
+
+            else {
+                stored = static_cast<Stored>(value);
+            }
+
+            if(room < sizeof(stored)) {
+                record.header.size = max_payload;
+                return;
+            }
+
+            std::memcpy(dst, &stored, sizeof(stored));
+            record.header.size += sizeof(stored);
+        }
+    }
+
+    //Never called, only lets the compiler check the arguments against the format.
+    [[maybe_unused]] static void check_format(const char* format, ...) __attribute__((format(printf, 1, 2)));
+    [[maybe_unused]] static inline void check_format(const char* format, ...) {}
+
+    template<typename... Args>
+    void write(Level level, const char* tag, const char* format, const Args&... args) {
+        Record record;
+        record.header = {tag, format, 0, level, 0};
+        (encode(record, args), ...);
+        submit(record);
+    }
+
+}
+
+#define DLOG_LEVEL(level, tag, format, ...) do {                              \
+        if constexpr ((level) <= DLOG_LOCAL_LEVEL) {                           \
+            if(false) {                                                        \
+                dlog::check_format(format, ##__VA_ARGS__);                     \
+            }                                                                  \
+            dlog::write(level, tag, format, ##__VA_ARGS__);                    \
+        }                                                                      \
+    } while(0)
+
+#define DLOGE(tag, format, ...) DLOG_LEVEL(dlog::Error, tag, format, ##__VA_ARGS__)
+#define DLOGW(tag, format, ...) DLOG_LEVEL(dlog::Warn, tag, format, ##__VA_ARGS__)
+#define DLOGI(tag, format, ...) DLOG_LEVEL(dlog::Info, tag, format, ##__VA_ARGS__)
+#define DLOGD(tag, format, ...) DLOG_LEVEL(dlog::Debug, tag, format, ##__VA_ARGS__)
+#define DLOGV(tag, format, ...) DLOG_LEVEL(dlog::Verbose, tag, format, ##__VA_ARGS__)
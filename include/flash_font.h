@@ -0,0 +1,65 @@
+#pragma once
+#include "esp_partition.h"
+#include "glyph_cache.h"
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+/**
+*
+* @brief LVGL font whose glyphs live in the "glyphs" data partition.
+*
+* Track, artist and album names come in any script, and a font covering them is far
+* larger than the app partition can spare. The glyph file built by tools/build_glyphs.py
+* is flashed to its own partition; only its range table is kept in RAM and glyphs are
+* read into a GlyphCache the first time they are drawn. Codepoints the file does not
+* cover fall back to the default font.
+*
+* The font is only used by the LVGL task, which serializes all access to the cache.
+*
+*/
+class FlashFont {
+public:
+    static constexpr const char* partition_label = "glyphs";
+
+    /**
+     * @brief Constructor for FlashFont class. Opens the glyph partition.
+     *
+     */
+    FlashFont();
+
+    /**
+     * @brief  Gets the font, or the default font if the glyph partition is missing or invalid.
+     *
+     * @return The font.
+     */
+    const lv_font_t* get() const;
+
+    /**
+     * @brief  Gets the cache statistics.
+     *
+     * @return The statistics.
+     */
+    GlyphCache::Stats getStats() const;
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Logs the cold and warm glyph lookup times of sample titles per script, and the hit rate
+     *        over a sequence of titles. Must be called before the font is used by LVGL.
+     *
+     */
+    void benchmark();
+#else
+    void benchmark() {}
+#endif
+
+    static bool get_glyph_dsc_dummy(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* get_glyph_bitmap_dummy(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    bool get_glyph_dsc(lv_font_glyph_dsc_t* dsc, uint32_t letter);
+    const void* get_glyph_bitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+
+private:
+
+    const esp_partition_t* partition;   ///< The glyph partition, nullptr if not found.
+    GlyphCache cache;                   ///< The glyphs read so far.
+    lv_font_t font;                     ///< The LVGL font reading from the cache.
+};
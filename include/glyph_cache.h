@@ -0,0 +1,157 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+*
+* @brief Glyph set stored outside the app image, paged into a small RAM LRU cache on use.
+*
+* The glyph file (built by tools/build_glyphs.py) starts with a header and a table of
+* codepoint ranges, which are kept in RAM. Glyph descriptors and 4 bpp bitmaps stay in
+* storage and are read through the reader on the first use of a glyph into one of a fixed
+* number of cache slots. The least recently used slot is reused when all are taken.
+*
+* File layout, little-endian:
+*
+*     header       u8[4] "GLPH", u16 version, u8 bpp, u8 reserved, u16 line height,
+*                  i16 base line, u32 range count, u32 glyph count, u32 descriptor offset,
+*                  u32 max bitmap size, u32 file size
+*     ranges       per range: u32 first codepoint, u32 count, u32 first glyph, sorted
+*     descriptors  per glyph: u32 bitmap offset, u16 bitmap size, u16 advance,
+*                  u8 box width, u8 box height, i8 x offset, i8 y offset
+*     bitmaps      rows of (box width + 1) / 2 bytes, high nibble first
+*
+* tools/glyph_cache_bench.cpp reports hit rates and lookup times from a glyph file.
+* Not thread safe.
+*
+*/
+class GlyphCache {
+public:
+    static constexpr uint16_t version = 1;
+    static constexpr size_t header_size = 32;
+    static constexpr size_t range_size = 12;
+    static constexpr size_t descriptor_size = 12;
+    static constexpr size_t slot_count = 128;              ///< Glyphs kept in RAM.
+    static constexpr size_t max_glyph_bytes = 1024;        ///< Larger bitmaps are rejected when opening.
+    static constexpr size_t max_ranges = 4096;             ///< Bounds the RAM taken by the range table.
+
+    /**
+     * @brief Reads len bytes at offset of the glyph file into dst.
+     */
+    using Reader = std::function<bool(uint32_t offset, void* dst, size_t len)>;
+
+    struct Glyph {
+        uint16_t adv_w;             ///< Advance in pixels.
+        uint8_t box_w;              ///< Bitmap width.
+        uint8_t box_h;              ///< Bitmap height.
+        int8_t ofs_x;               ///< Left of the bitmap relative to the pen.
+        int8_t ofs_y;               ///< Bottom of the bitmap relative to the base line, up is positive.
+        const uint8_t* bitmap;      ///< 4 bpp rows, valid until the next lookup.
+    };
+
+    struct Stats {
+        uint32_t hits;              ///< Lookups answered from RAM.
+        uint32_t misses;            ///< Lookups read from storage.
+        uint32_t not_found;         ///< Lookups of codepoints not in the file.
+        uint32_t evictions;         ///< Slots reused for another glyph.
+        uint32_t bytes_read;        ///< Bytes read from storage after opening.
+    };
+
+    /**
+     * @brief Constructor for GlyphCache class.
+     *
+     */
+    GlyphCache();
+
+    /**
+     * @brief      Reads the header and the range table. Clears the cache.
+     *
+     * @param[in]  reader  Reads the glyph file, kept for the lookups.
+     *
+     * @return
+     *  - True if the file is a valid glyph file
+     *  - False otherwise
+     */
+    bool open(Reader reader);
+
+    /**
+     * @brief      Looks a glyph up, reading it from storage on a miss.
+     *
+     * @param[in]   codepoint  The Unicode codepoint.
+     * @param[out]  glyph      The glyph.
+     *
+     * @return
+     *  - True if the glyph is in the file
+     *  - False otherwise, or if reading failed
+     */
+    bool lookup(uint32_t codepoint, Glyph& glyph);
+
+    /**
+     * @brief      Checks whether a codepoint is in the file without reading its glyph.
+     *
+     * @param[in]  codepoint  The Unicode codepoint.
+     *
+     * @return
+     *  - True if the codepoint is in the file
+     *  - False otherwise
+     */
+    bool contains(uint32_t codepoint) const;
+
+    /**
+     * @brief Drops every cached glyph, e.g. to measure cold lookups. The statistics are kept.
+     *
+     */
+    void clear();
+
+    bool isOpen() const;
+    int getLineHeight() const;
+    int getBaseLine() const;
+    uint32_t getSlotBytes() const;
+    Stats getStats() const;
+
+private:
+
+    static constexpr uint16_t no_slot = 0xFFFF;
+    static constexpr size_t bucket_count = 2 * slot_count;
+
+    struct Range {
+        uint32_t first;             ///< First codepoint.
+        uint32_t count;             ///< Number of consecutive codepoints.
+        uint32_t first_glyph;       ///< Glyph index of the first codepoint.
+    };
+
+    struct Slot {
+        uint32_t codepoint;         ///< The cached codepoint.
+        Glyph glyph;                ///< Its metrics, bitmap points into bitmaps.
+        uint16_t prev;              ///< Previous slot in LRU order, towards the most recent.
+        uint16_t next;              ///< Next slot in LRU order, towards the least recent.
+        uint16_t chain;             ///< Next slot in the same bucket.
+        bool used;                  ///< True if the slot holds a glyph and is in its bucket.
+    };
+
+    bool find_glyph(uint32_t codepoint, uint32_t& index) const;
+    uint16_t find_slot(uint32_t codepoint) const;
+    void unlink(uint16_t slot);
+    void push_front(uint16_t slot);
+    void push_back(uint16_t slot);
+    void remove_from_bucket(uint16_t slot);
+
+    Reader reader;                                  ///< Reads the glyph file.
+    std::vector<Range> ranges;                      ///< Codepoint ranges, sorted.
+    uint32_t glyph_count;                           ///< Number of glyphs in the file.
+    uint32_t descriptor_offset;                     ///< Offset of the descriptor table.
+    uint32_t slot_bytes;                            ///< Bitmap bytes per slot.
+    int line_height;                                ///< Line height in pixels.
+    int base_line;                                  ///< Base line from the bottom of the line.
+    std::unique_ptr<uint8_t[]> bitmaps;             ///< slot_count bitmaps of slot_bytes.
+    std::array<Slot, slot_count> slots;             ///< Cached glyphs.
+    std::array<uint16_t, bucket_count> buckets;     ///< First slot of each hash bucket.
+    uint16_t head;                                  ///< Most recently used slot.
+    uint16_t tail;                                  ///< Least recently used slot.
+    uint16_t used_slots;                            ///< Slots holding a glyph.
+    Stats stats;                                    ///< The statistics.
+};
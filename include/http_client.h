@@ -1,10 +1,95 @@
 #pragma once
 #include "esp_http_client.h"
-#include "freertos/ringbuf.h"
+#include "mem_pool.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <string_view>
 #include <string>
 #include <vector>
 
+/**
+*
+* @brief Lets any task abandon the requests it was given to.
+*
+*/
+class CancelToken {
+public:
+    /**
+     * @brief Abandons the requests using the token, including the one in progress.
+     *
+     */
+    void cancel();
+
+    /**
+     * @brief Makes the token usable for new requests.
+     *
+     */
+    void reset();
+
+    bool isCancelled() const;
+
+private:
+    std::atomic<bool> cancelled{false};  ///< True once cancel was called.
+};
+
+/**
+*
+* @brief The time a request must be done by and the token abandoning it.
+*
+* A request past its deadline or cancelled is not started, or is aborted between two socket
+* operations. Socket operations are bounded by the time left, and by cancel_poll_ms when
+* there is a token, so a cancellation takes effect within that time. Connecting is the
+* exception: it is bounded by the deadline only. Whatever the deadline, a response that makes
+* no progress for default_timeout_ms is abandoned.
+*
+*/
+struct Deadline {
+    static constexpr uint32_t cancel_poll_ms = 100;   ///< Longest socket wait with a token.
+    static constexpr uint32_t default_timeout_ms = 5000;  ///< Socket timeout without a deadline, and longest wait for a response to progress.
+
+    int64_t at_us;                  ///< esp_timer time the request must be done by, 0 for none.
+    const CancelToken* token;       ///< Abandons the request, or nullptr.
+
+    /**
+     * @brief  Gets a deadline that never passes. Socket operations and stalled responses are
+     *         still bounded by default_timeout_ms.
+     *
+     * @return The deadline.
+     */
+    static Deadline none();
+
+    /**
+     * @brief      Gets a deadline some time from now.
+     *
+     * @param[in]  timeout_ms  The time from now.
+     * @param[in]  token       Abandons the request, or nullptr.
+     *
+     * @return The deadline.
+     */
+    static Deadline in(uint32_t timeout_ms, const CancelToken* token = nullptr);
+
+    bool isCancelled() const;
+
+    /**
+     * @brief  Checks whether the request must be abandoned.
+     *
+     * @return
+     *  - True if the deadline passed or the token was cancelled
+     *  - False otherwise
+     */
+    bool expired() const;
+
+    /**
+     * @brief      Gets the timeout for the next socket operation.
+     *
+     * @param[in]  sliced  False if the operation can't be resumed after a timeout, e.g. connecting.
+     *
+     * @return The timeout, at least 1 ms.
+     */
+    int timeoutMs(bool sliced) const;
+};
+
 /**
 * 
 * @brief Provides the ability to send HTTP requests and receive responses
@@ -15,6 +100,11 @@
 */
 class HttpClient {
 public:
+    /**
+     * @brief Receives a response body as it arrives. The data is only valid during the call.
+     */
+    using BodySink = std::function<void(const char* data, size_t size)>;
+
     /**
      * @brief Constructor for HttpClient class. 
      *             
@@ -38,7 +128,7 @@ public:
      *  - ESP_OK
      *  - ESP_FAIL
      */
-    esp_err_t setHeader(std::string_view key, std::string_view value);
+    esp_err_t setHeader(const char* key, const char* value);
 
     /**
      * @brief      Deletes a HTTP header 
@@ -51,15 +141,65 @@ public:
      *  - ESP_OK
      *  - ESP_FAIL
      */
-    esp_err_t deleteHeader(std::string_view key);
+    esp_err_t deleteHeader(const char* key);
 
-    std::string getHeader(std::string_view key);
+    std::string getHeader(const char* key);
 
-    bool get(std::string_view url, std::vector<char>& dst);
+    bool get(const char* url, mem::Buffer& dst, const Deadline& deadline = Deadline::none());
     
-    bool post(std::string_view url, std::string_view data, std::vector<char>& dst);
+    bool post(const char* url, std::string_view data, mem::Buffer& dst, const Deadline& deadline = Deadline::none());
+
+    bool put(const char* url, mem::Buffer& dst, const Deadline& deadline = Deadline::none());
 
-    bool put(std::string_view url, std::vector<char>& dst);
+    /**
+     * @brief      Sends a GET request and hands the body to sink as it arrives instead of storing it,
+     *             so it can be parsed while the rest is still on the way. Bodies of responses other
+     *             than 200 are not handed out.
+     *
+     * @param[in]   url       The NUL-terminated URL.
+     * @param[in]   sink      Receives the body, in pieces of at most read_chunk bytes.
+     * @param[in]   deadline  Abandons the request, sink may have received part of the body by then.
+     *
+     * @return
+     *  - True if the request completed with status 200
+     *  - False otherwise
+     */
+    bool stream(const char* url, const BodySink& sink, const Deadline& deadline = Deadline::none());
+
+    /**
+     * @brief      Sends a request and checks its status.
+     *
+     * @param[in]   method           The request method.
+     * @param[in]   url              The NUL-terminated URL.
+     * @param[in]   data             The body, ignored for GET.
+     * @param[in]   expected_status  The status of a successful request, e.g. 204 for player commands.
+     * @param[out]  dst              Receives the response body, NUL-terminated. Placed in PSRAM once large.
+     * @param[in]   deadline         Abandons the request. The connection is closed if it is
+     *                               abandoned while in progress, and opened again by the next request.
+     *
+     * @return
+     *  - True if the request completed with the expected status
+     *  - False otherwise
+     */
+    bool request(esp_http_client_method_t method, const char* url, std::string_view data, int expected_status, mem::Buffer& dst,
+                 const Deadline& deadline = Deadline::none());
+
+    /**
+     * @brief      Sends a request whose response body is not needed. The body is received into
+     *             a buffer kept by the client, so repeated requests don't allocate.
+     *
+     * @param[in]   method           The request method.
+     * @param[in]   url              The NUL-terminated URL.
+     * @param[in]   data             The body, ignored for GET.
+     * @param[in]   expected_status  The status of a successful request.
+     * @param[in]   deadline         Abandons the request.
+     *
+     * @return
+     *  - True if the request completed with the expected status
+     *  - False otherwise
+     */
+    bool request(esp_http_client_method_t method, const char* url, std::string_view data, int expected_status,
+                 const Deadline& deadline = Deadline::none());
 
     static esp_err_t event_handler_dummy(esp_http_client_event_t *evt);
 
@@ -67,10 +207,19 @@ public:
 
 private:
 
-    std::vector<char> get_content();
+    static constexpr int read_chunk = 1024;  ///< Bytes read per socket operation.
+
+    esp_err_t send(esp_http_client_method_t method, std::string_view data, const Deadline& deadline);
+
+    esp_err_t receive(mem::Buffer& dst, const BodySink* sink, int expected_status, const Deadline& deadline);
+
+    bool execute(esp_http_client_method_t method, const char* url, std::string_view data, int expected_status, mem::Buffer& dst,
+                 const BodySink* sink, const Deadline& deadline);
 
     esp_http_client_handle_t client;  ///< ESP client handle.
 
-    RingbufHandle_t xRingbuffer;      ///< Ringbuffer to receive HTTP response data.
+    size_t received;                  ///< Body bytes received by the request in progress.
+
+    mem::Buffer scratch;              ///< Receives the bodies of requests that discard them.
 
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+*
+* @brief Finds the entries of paged lists in a JSON response while it is being received.
+*
+* Spotify returns lists as {"<section>": {"items": [ ... ], ...}, ...}, e.g. /v1/search
+* with one section per type. The scanner is fed the body as it arrives and hands out each
+* object of an items array as soon as its closing brace is seen, so callers parse and show
+* it without waiting for the rest of the page. Only the entry being received is buffered.
+* A top-level items array, as returned for playlist tracks, is reported with an empty
+* section, and the total of such a list is kept. tools/json_item_scanner_check.cpp feeds it
+* responses split at every byte and compares with a full parse.
+*
+*/
+class JsonItemScanner {
+public:
+    /**
+     * @brief Receives a complete entry. The views are only valid during the call.
+     */
+    using ItemHandler = std::function<void(std::string_view section, std::string_view item)>;
+
+    static constexpr size_t max_key = 32;  ///< Longer keys are truncated, they never match.
+
+    /**
+     * @brief Constructor for JsonItemScanner class.
+     *
+     * @param[in]  handler  Receives the entries.
+     */
+    explicit JsonItemScanner(ItemHandler handler);
+
+    /**
+     * @brief Forgets the data fed so far, for a new response.
+     *
+     */
+    void reset();
+
+    /**
+     * @brief      Scans the next bytes of the response.
+     *
+     * @param[in]  data  The bytes.
+     * @param[in]  size  The number of bytes.
+     */
+    void feed(const char* data, size_t size);
+
+    /**
+     * @brief  Gets the number of entries handed out since the last reset.
+     *
+     * @return The number of entries.
+     */
+    size_t getItemCount() const;
+
+    /**
+     * @brief  Gets the top-level total, the length of a list returned a page at a time.
+     *
+     * @return The total, -1 if not received yet.
+     */
+    int64_t getTotal() const;
+
+private:
+
+    static constexpr int max_depth = 3;     ///< Containers tracked outside of entries.
+
+    ItemHandler handler;                     ///< Receives the entries.
+    int depth;                               ///< Open objects and arrays.
+    bool in_string;                          ///< True inside a string.
+    bool escaped;                            ///< True after a backslash in a string.
+    bool in_item;                            ///< True inside an entry.
+    int item_depth;                          ///< Depth at which the current entry closes.
+    int items_depth;                         ///< Depth of the items array being read, 0 if none.
+    std::string string;                      ///< The string being read outside of entries.
+    std::string keys[max_depth + 1];         ///< Last key per depth.
+    std::string item;                        ///< The entry being received.
+    size_t item_count;                       ///< Entries handed out.
+    int64_t total;                           ///< The top-level total, -1 if none.
+};
@@ -0,0 +1,473 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/**
+*
+* @brief Decoders generated from compile-time schemas, reading JSON in a single pass without
+*        building a tree.
+*
+* Schema<T>::fields lists, for a struct, where its members are in the JSON: a tuple of
+* json::field(path, &T::member, presence). Paths are keys and array indices separated by
+* dots, "*" standing for every element of an array, e.g. "album.images.1.url" or
+* "artists.*.name". The decoder reads the text once and skips the values under no path
+* without converting them. A scalar is assigned to every member whose path it is at, so
+* several structs can be decoded from the same object. Members that are structs with a schema
+* of their own are decoded in place, with their paths below the member's. Vectors of them
+* are decoded from every element of the array, null elements skipped.
+*
+* Missing and null values leave optional members as they were, so structs are decoded into
+* value-initialized ones. A required member that is missing or null fails the decode, or in
+* a vector of structs drops the element. Members of an optional struct are never required.
+*
+* Supported members: std::string, bool, integers, floating point, std::vector<std::string>
+* (every string at the path is appended), structs with a schema and vectors of them.
+* tools/decode_bench.cpp times the decoders against recorded responses.
+*
+*/
+namespace json {
+
+    static constexpr size_t max_segments = 8;       ///< Keys and indices of a path.
+    static constexpr size_t max_nesting = 4;        ///< Structs decoded in place within each other.
+    static constexpr size_t max_bindings = 32;      ///< Paths of a struct, those of the structs in it included.
+
+    enum class Presence : uint8_t {
+        Optional,       ///< Missing or null leaves the member as it was.
+        Required        ///< Missing or null fails the decode.
+    };
+
+    void path_too_long();
+
+    struct Path {
+        std::array<std::string_view, max_segments> segments;   ///< The keys and indices.
+        uint8_t count;                                          ///< Segments used.
+
+        constexpr Path(const char* text) : segments{}, count(0) {
+            size_t start = 0;
+            size_t i = 0;
+
+            for(;; i++) {
+                if(text[i] == '.' || text[i] == '\0') {
+                    //Not a constant expression, fails the build.
+                    if(count == max_segments) {
+                        path_too_long();
+                    }
+
+                    segments[count++] = std::string_view(text + start, i - start);
+                    start = i + 1;
+                }
+
+                if(text[i] == '\0') {
+                    break;
+                }
+            }
+        }
+    };
+
+    struct Scalar {
+        enum class Type : uint8_t {
+            Null,
+            Bool,
+            Number,
+            String
+        };
+
+        Type type;                  ///< What the value is.
+        bool boolean;               ///< The value of a Bool.
+        bool integral;              ///< True if a Number has no fraction or exponent.
+        int64_t integer;            ///< The value of an integral Number.
+        double number;              ///< The value of a Number.
+        std::string_view string;    ///< The unescaped value of a String, valid until the next read.
+    };
+
+    /**
+    *
+    * @brief Reads JSON tokens from a complete text.
+    *
+    */
+    class Reader {
+    public:
+        explicit Reader(std::string_view text);
+
+        /**
+         * @brief  Skips whitespace and looks at the next character.
+         *
+         * @return The character, 0 at the end.
+         */
+        char peek();
+
+        /**
+         * @brief      Skips whitespace and reads a character if it is the one expected.
+         *
+         * @param[in]  c     The character.
+         *
+         * @return True if read.
+         */
+        bool consume(char c);
+
+        /**
+         * @brief      Reads a string. Strings without escapes are not copied.
+         *
+         * @param[out] out   The unescaped string, valid until the next read.
+         *
+         * @return True if read, false on a syntax error.
+         */
+        bool readString(std::string_view& out);
+
+        /**
+         * @brief      Reads a string, number, true, false or null.
+         *
+         * @param[out] out   The value.
+         *
+         * @return True if read, false on a syntax error.
+         */
+        bool readScalar(Scalar& out);
+
+        /**
+         * @brief  Skips a value of any type, only checking the brackets and strings.
+         *
+         * @return True if skipped, false on a syntax error.
+         */
+        bool skipValue();
+
+        /**
+         * @brief  Checks that only whitespace is left.
+         *
+         * @return True if so.
+         */
+        bool finish();
+
+        /**
+         * @brief  Marks a syntax error.
+         *
+         * @return False, to return it.
+         */
+        bool fail();
+
+        bool failed() const;
+
+    private:
+        bool skip_string();
+
+        std::string_view text;      ///< The JSON.
+        size_t pos;                 ///< The next character.
+        bool error;                 ///< True after a syntax error.
+        std::string scratch;        ///< Unescaped strings.
+    };
+
+    template<typename T, typename M>
+    struct Field {
+        Path path;                  ///< Where the member is.
+        M T::* member;              ///< The member.
+        Presence presence;          ///< What a missing or null value does.
+    };
+
+    /**
+     * @brief The fields of a struct, specialized with static constexpr auto fields = std::make_tuple(json::field(...), ...).
+     */
+    template<typename T>
+    struct Schema;
+
+    template<typename T, typename = void>
+    struct has_schema : std::false_type {};
+
+    template<typename T>
+    struct has_schema<T, std::void_t<decltype(Schema<T>::fields)>> : std::true_type {};
+
+    template<typename T>
+    struct vector_element {
+        using type = void;
+    };
+
+    template<typename U>
+    struct vector_element<std::vector<U>> {
+        using type = U;
+    };
+
+    using Assign = bool (*)(const Scalar& value, void* target);
+    using DecodeArray = bool (*)(Reader& reader, void* target);
+
+    struct Binding {
+        std::array<const Path*, max_nesting + 1> parts;  ///< The path, the paths of the members it is in first.
+        uint8_t part_count;         ///< Parts used.
+        uint8_t length;             ///< Segments of all parts.
+        bool required;              ///< True if missing or null fails the decode.
+        bool seen;                  ///< True once assigned.
+        Assign assign;              ///< Assigns a scalar, nullptr for a vector of structs.
+        DecodeArray array;          ///< Decodes a vector of structs, nullptr otherwise.
+        void* target;               ///< The member.
+
+        std::string_view segment(size_t index) const {
+            for(size_t i = 0; i < part_count; i++) {
+                if(index < parts[i]->count) {
+                    return parts[i]->segments[index];
+                }
+
+                index -= parts[i]->count;
+            }
+
+            return {};
+        }
+    };
+
+    /**
+     * @brief      Decodes a value, assigning it or what it contains to the bindings whose path it is on.
+     *
+     * @param[in]  reader    The reader, at the value.
+     * @param[in]  bindings  The bindings.
+     * @param[in]  live      Bit mask of the bindings whose first depth segments are the path of the value.
+     * @param[in]  depth     Segments of the path of the value.
+     *
+     * @return True if read, false on a syntax error.
+     */
+    bool decode_value(Reader& reader, Binding* bindings, uint32_t live, size_t depth);
+
+    template<typename M>
+    bool assign(const Scalar& value, void* target) {
+        M& member = *static_cast<M*>(target);
+
+        if constexpr(std::is_same_v<M, std::string>) {
+            if(value.type != Scalar::Type::String) {
+                return false;
+            }
+
+            member.assign(value.string);
+        }
+
+        else if constexpr(std::is_same_v<M, std::vector<std::string>>) {
+            if(value.type != Scalar::Type::String) {
+                return false;
+            }
+
+            member.emplace_back(value.string);
+        }
+
+        else if constexpr(std::is_same_v<M, bool>) {
+            if(value.type != Scalar::Type::Bool) {
+                return false;
+            }
+
+            member = value.boolean;
+        }
+
+        else if constexpr(std::is_integral_v<M>) {
+            if(value.type != Scalar::Type::Number) {
+                return false;
+            }
+
+            member = static_cast<M>(value.integral ? value.integer : static_cast<int64_t>(value.number));
+        }
+
+        else {
+            static_assert(std::is_floating_point_v<M>, "Unsupported member type");
+
+            if(value.type != Scalar::Type::Number) {
+                return false;
+            }
+
+            member = static_cast<M>(value.number);
+        }
+
+        return true;
+    }
+
+    template<typename T>
+    constexpr size_t binding_count();
+
+    template<typename T>
+    constexpr size_t nesting();
+
+    template<typename T, typename M>
+    constexpr size_t field_bindings(const Field<T, M>&) {
+        if constexpr(has_schema<M>::value) {
+            return binding_count<M>();
+        }
+
+        else {
+            return 1;
+        }
+    }
+
+    template<typename T, typename M>
+    constexpr size_t field_nesting(const Field<T, M>&) {
+        if constexpr(has_schema<M>::value) {
+            return 1 + nesting<M>();
+        }
+
+        else {
+            return 0;
+        }
+    }
+
+    template<typename T>
+    constexpr size_t binding_count() {
+        return std::apply([](const auto&... fields) { return (field_bindings(fields) + ... + 0); }, Schema<T>::fields);
+    }
+
+    template<typename T>
+    constexpr size_t nesting() {
+        return std::apply([](const auto&... fields) { return std::max({field_nesting(fields)..., size_t{0}}); }, Schema<T>::fields);
+    }
+
+    template<typename T>
+    bool decode_into(Reader& reader, T& out);
+
+    template<typename U>
+    bool decode_elements(Reader& reader, void* target) {
+        auto& items = *static_cast<std::vector<U>*>(target);
+
+        if(reader.peek() != '[') {
+            return reader.skipValue();
+        }
+
+        reader.consume('[');
+
+        if(reader.consume(']')) {
+            return true;
+        }
+
+        do {
+            if(reader.peek() == 'n') {
+                if(!reader.skipValue()) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            U& item = items.emplace_back();
+
+            if(!decode_into(reader, item)) {
+                items.pop_back();
+
+                if(reader.failed()) {
+                    return false;
+                }
+            }
+        } while(reader.consume(','));
+
+        return reader.consume(']') || reader.fail();
+    }
+
+    template<typename T>
+    void bind(T& out, Binding* bindings, size_t& count, const std::array<const Path*, max_nesting + 1>& prefix,
+              size_t prefix_count, bool required);
+
+    template<typename T, typename M>
+    void bind_field(T& out, const Field<T, M>& field, Binding* bindings, size_t& count,
+                    const std::array<const Path*, max_nesting + 1>& prefix, size_t prefix_count, bool required) {
+        std::array<const Path*, max_nesting + 1> parts = prefix;
+        parts[prefix_count] = &field.path;
+        required = required && field.presence == Presence::Required;
+
+        if constexpr(has_schema<M>::value) {
+            bind(out.*field.member, bindings, count, parts, prefix_count + 1, required);
+        }
+
+        else {
+            Binding& binding = bindings[count++];
+            binding.parts = parts;
+            binding.part_count = static_cast<uint8_t>(prefix_count + 1);
+            binding.length = 0;
+
+            for(size_t i = 0; i < binding.part_count; i++) {
+                binding.length += parts[i]->count;
+            }
+
+            binding.required = required;
+            binding.seen = false;
+            binding.target = &(out.*field.member);
+
+            if constexpr(has_schema<typename vector_element<M>::type>::value) {
+                binding.assign = nullptr;
+                binding.array = decode_elements<typename vector_element<M>::type>;
+            }
+
+            else {
+                binding.assign = assign<M>;
+                binding.array = nullptr;
+            }
+        }
+    }
+
+    template<typename T>
+    void bind(T& out, Binding* bindings, size_t& count, const std::array<const Path*, max_nesting + 1>& prefix,
+              size_t prefix_count, bool required) {
+        std::apply([&](const auto&... fields) {
+            (bind_field(out, fields, bindings, count, prefix, prefix_count, required), ...);
+        }, Schema<T>::fields);
+    }
+
+    /**
+     * @brief      Decodes the value at the reader into a struct.
+     *
+     * @param[in]  reader  The reader, at the value.
+     * @param[out] out     The struct.
+     *
+     * @return
+     *  - True if decoded
+     *  - False on a syntax error, reader.failed() is set, or if a required member is missing or null
+     */
+    template<typename T>
+    bool decode_into(Reader& reader, T& out) {
+        constexpr size_t count = binding_count<T>();
+
+        static_assert(count > 0 && count <= max_bindings, "A schema has 1 to max_bindings paths");
+        static_assert(nesting<T>() <= max_nesting, "Schemas nest too deep");
+
+        std::array<Binding, count> bindings;
+        size_t bound = 0;
+
+        bind(out, bindings.data(), bound, {}, 0, true);
+
+        if(!decode_value(reader, bindings.data(), count == 32 ? 0xFFFFFFFFu : (1u << count) - 1, 0)) {
+            return false;
+        }
+
+        for(const Binding& binding : bindings) {
+            if(binding.required && !binding.seen) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief      Decodes a JSON text into a struct.
+     *
+     * @param[in]  text  The JSON.
+     * @param[out] out   The struct, value-initialized by the caller.
+     *
+     * @return
+     *  - True if decoded
+     *  - False on a syntax error or if a required member is missing or null
+     */
+    template<typename T>
+    bool decode(std::string_view text, T& out) {
+        Reader reader(text);
+        return decode_into(reader, out) && reader.finish();
+    }
+
+    /**
+     * @brief      Describes where a member is.
+     *
+     * @param[in]  path      The keys and indices leading to it, separated by dots.
+     * @param[in]  member    The member.
+     * @param[in]  presence  What a missing or null value does.
+     *
+     * @return The field.
+     */
+    template<typename T, typename M>
+    constexpr Field<T, M> field(const char* path, M T::* member, Presence presence = Presence::Optional) {
+        return Field<T, M>{Path(path), member, presence};
+    }
+
+}
@@ -0,0 +1,312 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+*
+* @brief Prefix search over the saved tracks, albums and playlists, read in place from
+*        memory-mapped flash.
+*
+* Items are stored sorted by their normalized name and artists (and playlist owners) sorted
+* by theirs, so the position of an item or artist in its list is its id and both lists of
+* names double as the search keys. Names are front-coded in blocks of block_keys, each
+* block starting with a complete name, so a search binary searches the first names of the
+* blocks and then decodes a block or two. Each artist lists the items it appears on, so a
+* query matching an artist finds its items as well. Nothing is copied into RAM when
+* opening, the file is read through the pointer given, e.g. from esp_partition_mmap.
+*
+* File layout, little-endian:
+*
+*     header        u8[4] "LIBX", u16 version, u8 block keys, u8 sample interval, u32 item count,
+*                   u32 artist count, u32 item table offset, u32 artist table offset,
+*                   u32 name block table offset, u32 artist block table offset, u32 file size,
+*                   u32 FNV-1a of the bytes after the header, per kind (track, album, playlist):
+*                   char[20] newest added_at, u32 count, u32 digest
+*     items         per item: u8 kind | artist count << 2 | packed << 6, varint artist ids,
+*                   the Spotify ID as a 128-bit big-endian number if packed, u8 size and the
+*                   ID otherwise
+*     artists       per artist: varint item count, varint item id deltas
+*     names         per block of item names, then per block of artist names: u8 size and the
+*                   first name, per further name u8 shared prefix size, u8 suffix size, suffix
+*     tables        u32 offset of every sample interval-th item, of every sample interval-th
+*                   artist, of every block of item names and of every block of artist names
+*
+* tools/library_bench.cpp builds a synthetic library and checks every search against a scan.
+* Not thread safe.
+*
+*/
+class LibraryIndex {
+public:
+    enum class Kind : uint8_t {
+        Track,
+        Album,
+        Playlist
+    };
+
+    static constexpr uint16_t version = 1;
+    static constexpr size_t header_size = 128;
+    static constexpr size_t kind_count = 3;
+    static constexpr size_t block_keys = 16;         ///< Names per front-coded block.
+    static constexpr size_t sample_interval = 16;    ///< Records per entry of the item and artist tables.
+    static constexpr size_t max_key = 32;            ///< Names are sorted and queries matched on this many normalized bytes.
+    static constexpr size_t max_name = 255;          ///< Longer names and IDs are cut.
+    static constexpr size_t max_artists = 8;         ///< Further artists of an item are dropped.
+    static constexpr size_t added_at_size = 20;      ///< "2024-01-31T12:00:00Z"
+
+    /**
+     * @brief Where the last sync of a kind of items stopped.
+     */
+    struct Cursor {
+        char newest[added_at_size];     ///< added_at of the newest item, ISO 8601, empty if unknown.
+        uint32_t count;                 ///< Items of the kind saved when synced.
+        uint32_t digest;                ///< Digest of the items, for kinds without added_at.
+    };
+
+    struct Item {
+        Kind kind;                      ///< What the item is.
+        std::string name;               ///< The name as saved.
+        std::string id;                 ///< The Spotify ID.
+        uint8_t artist_count;           ///< Entries of artists used.
+        std::array<uint32_t, max_artists> artists; ///< The artist ids, the owner of a playlist.
+    };
+
+    /**
+     * @brief Constructor for LibraryIndex class. The index starts empty.
+     *
+     */
+    LibraryIndex();
+
+    /**
+     * @brief      Checks the header and the checksum of an index file.
+     *
+     * @param[in]  data  The file, must stay valid and unchanged until close or the next open.
+     * @param[in]  size  The bytes available at data, may be more than the file.
+     *
+     * @return
+     *  - True if data holds a valid index
+     *  - False otherwise, the index is empty
+     */
+    bool open(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Forgets the file, the index is empty.
+     *
+     */
+    void close();
+
+    /**
+     * @brief  Checks if an index is open.
+     *
+     * @return True if open.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief      Finds items whose name starts with query after both are normalized, in the
+     *             order of their names, followed by the items of artists whose name does.
+     *
+     * @param[in]  query  The text typed.
+     * @param[out] items  Receives the item ids, without duplicates.
+     * @param[in]  max    The maximum number of items.
+     *
+     * @return The number of items found.
+     */
+    size_t search(std::string_view query, uint32_t* items, size_t max) const;
+
+    /**
+     * @brief      Reads an item.
+     *
+     * @param[in]  id    The item id, less than getItemCount().
+     * @param[out] item  The item.
+     */
+    void getItem(uint32_t id, Item& item) const;
+
+    /**
+     * @brief      Reads the name of an artist.
+     *
+     * @param[in]  id    The artist id, from an Item.
+     * @param[out] name  The name.
+     */
+    void getArtist(uint32_t id, std::string& name) const;
+
+    /**
+     * @brief      Gets the artists of an item, or the owner of a playlist, as one line.
+     *
+     * @param[in]  item  The item.
+     * @param[out] out   The names separated by ", ".
+     */
+    void getDetail(const Item& item, std::string& out) const;
+
+    /**
+     * @brief  Gets the number of items.
+     *
+     * @return The number of items, 0 if no index is open.
+     */
+    uint32_t getItemCount() const;
+
+    /**
+     * @brief  Gets the number of distinct artists and playlist owners.
+     *
+     * @return The number of artists.
+     */
+    uint32_t getArtistCount() const;
+
+    /**
+     * @brief  Gets the size of the index file.
+     *
+     * @return The size in bytes.
+     */
+    uint32_t getFileSize() const;
+
+    /**
+     * @brief      Gets where the sync of a kind stopped when the file was built.
+     *
+     * @param[in]  kind  The kind of items.
+     *
+     * @return The cursor, zeroed if no index is open.
+     */
+    Cursor getCursor(Kind kind) const;
+
+    /**
+     * @brief      Normalizes a name or a query: lower case, Latin-1 accents removed, apostrophes
+     *             dropped, other ASCII punctuation and whitespace as single spaces, trimmed.
+     *             Other UTF-8 text is kept as it is. Cut to size bytes on a character boundary.
+     *
+     * @param[in]  text  The text.
+     * @param[out] out   The normalized text.
+     * @param[in]  size  The maximum number of bytes written.
+     *
+     * @return The number of bytes written.
+     */
+    static size_t normalize(std::string_view text, char* out, size_t size);
+
+private:
+
+    template<typename F>
+    bool scan(const uint8_t* blocks, uint32_t count, std::string_view prefix, F found) const;
+
+    const uint8_t* item_record(uint32_t id) const;
+    const uint8_t* artist_record(uint32_t id) const;
+    void read_name(const uint8_t* blocks, uint32_t id, std::string& name) const;
+
+    const uint8_t* data;            ///< The file, nullptr if none is open.
+    uint32_t item_count;            ///< Items in the file.
+    uint32_t artist_count;          ///< Artists in the file.
+    uint32_t file_size;             ///< Size of the file.
+    const uint8_t* item_table;      ///< Offsets of every sample_interval-th item.
+    const uint8_t* artist_table;    ///< Offsets of every sample_interval-th artist.
+    const uint8_t* name_blocks;     ///< Offsets of the blocks of item names.
+    const uint8_t* artist_blocks;   ///< Offsets of the blocks of artist names.
+};
+
+/**
+*
+* @brief Writes LibraryIndex files.
+*
+* Items are added in any order, e.g. as the pages of the saved items arrive. Items already
+* added with the same kind and Spotify ID are skipped, so pages overlapping an older index
+* can be merged with it. Artists are shared by normalized name. Keeps about 80 bytes per
+* item until built.
+*
+*/
+class LibraryIndexBuilder {
+public:
+
+    /**
+     * @brief Constructor for LibraryIndexBuilder class.
+     *
+     */
+    LibraryIndexBuilder();
+
+    /**
+     * @brief      Adds an item.
+     *
+     * @param[in]  kind     What the item is.
+     * @param[in]  name     Its name.
+     * @param[in]  artists  Its artists, or the owner of a playlist.
+     * @param[in]  id       Its Spotify ID.
+     *
+     * @return
+     *  - True if added
+     *  - False if an item of the kind with the id was added before
+     */
+    bool add(LibraryIndex::Kind kind, std::string_view name, const std::vector<std::string_view>& artists, std::string_view id);
+
+    /**
+     * @brief      Adds the items of a kind of an existing index.
+     *
+     * @param[in]  index  The index.
+     * @param[in]  kind   The kind of items to add.
+     *
+     * @return The number of items added.
+     */
+    size_t merge(const LibraryIndex& index, LibraryIndex::Kind kind);
+
+    /**
+     * @brief      Gets the number of items of a kind added.
+     *
+     * @param[in]  kind  The kind of items.
+     *
+     * @return The number of items.
+     */
+    uint32_t getCount(LibraryIndex::Kind kind) const;
+
+    /**
+     * @brief      Sets the cursor stored for a kind.
+     *
+     * @param[in]  kind    The kind of items.
+     * @param[in]  cursor  The cursor.
+     */
+    void setCursor(LibraryIndex::Kind kind, const LibraryIndex::Cursor& cursor);
+
+    /**
+     * @brief      Writes the index file.
+     *
+     * @param[out] out  The file.
+     */
+    void build(std::vector<uint8_t>& out);
+
+private:
+
+    struct Text {
+        uint32_t offset;                ///< Start in text.
+        uint8_t size;                   ///< Bytes of the text.
+    };
+
+    struct Entry {
+        Text name;                      ///< The name as added.
+        Text key;                       ///< The normalized name, cut to max_key.
+        Text id;                        ///< The Spotify ID.
+        uint32_t artists;               ///< First artist id in artist_refs.
+        uint8_t artist_count;           ///< Artist ids in artist_refs.
+        LibraryIndex::Kind kind;        ///< What the item is.
+    };
+
+    struct Artist {
+        Text name;                      ///< The name as first added.
+        Text key;                       ///< The normalized name, cut to max_key.
+    };
+
+    Text store(std::string_view value);
+    Text store_key(std::string_view name);
+    std::string_view view(const Text& value) const;
+    bool less(const Text& key_a, const Text& name_a, const Text& key_b, const Text& name_b) const;
+    bool insert_seen(uint64_t hash);
+    uint32_t artist_id(std::string_view name);
+    void put_names(std::vector<uint8_t>& out, const std::vector<Text>& names, std::vector<uint32_t>& blocks) const;
+
+    std::vector<char> text;                             ///< Names, keys and IDs.
+    std::vector<Entry> entries;                         ///< The items in the order added.
+    std::vector<uint32_t> artist_refs;                  ///< Artist ids of the items.
+    std::vector<Artist> artists;                        ///< The artists in the order added.
+    std::unordered_map<std::string, uint32_t> artist_ids; ///< Artist ids by normalized name.
+    std::vector<uint64_t> seen;                         ///< Open addressing set of the kinds and IDs added.
+    size_t seen_count;                                  ///< Used slots of seen.
+    std::array<uint32_t, LibraryIndex::kind_count> counts;
+    std::array<LibraryIndex::Cursor, LibraryIndex::kind_count> cursors;
+};
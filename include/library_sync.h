@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "library_index.h"
+#include "sdkconfig.h"
+#include "spotify_client.h"
+
+/**
+*
+* @brief Keeps a LibraryIndex of the saved tracks, albums and playlists in the "library"
+*        data partition, so they can be searched without a request.
+*
+* A background task pulls the saved items a page at a time once, then every
+* CONFIG_LIBRARY_SYNC_INTERVAL_MIN minutes only the pages saved since the newest item
+* indexed, which it merges with the index. Playlists have no saved time and are pulled in
+* full. Removed items show in the totals, and cause a full sync. The new index is built in
+* PSRAM, searched from there while it is written to the partition, then from the partition
+* through a memory mapping. The index is only rewritten when the library changed.
+*
+* search may be called from any task, the index is swapped under a mutex.
+*
+*/
+class LibrarySync {
+public:
+    static constexpr const char* partition_label = "library";
+    static constexpr size_t max_results = 16;                   ///< Most results of a search.
+
+    struct Stats {
+        uint32_t items;         ///< Items in the index.
+        uint32_t bytes;         ///< Size of the index file.
+        uint32_t syncs;         ///< Syncs that changed the index.
+        uint32_t requests;      ///< Pages requested by the last sync.
+        int64_t sync_us;        ///< Duration of the last sync, requests included.
+        int64_t build_us;       ///< Time the last index took to build.
+        int64_t write_us;       ///< Time the last index took to write to flash.
+        int64_t search_us;      ///< Duration of the last search.
+    };
+
+    /**
+     * @brief Constructor for LibrarySync class. Opens the index in the partition and starts syncing.
+     *
+     * @param[in]  client  The client pulling the saved items.
+     */
+    explicit LibrarySync(spotify::Client& client);
+
+    /**
+     * @brief Destructor for LibrarySync class.
+     *
+     */
+    ~LibrarySync();
+
+    /**
+     * @brief      Finds saved items whose name, or the name of one of whose artists, starts with query.
+     *
+     * @param[in]  query    The text typed.
+     * @param[in]  max      The maximum number of results, at most max_results.
+     * @param[out] results  The results are appended.
+     *
+     * @return The number of results appended, 0 before the first sync.
+     */
+    size_t search(std::string_view query, size_t max, std::vector<spotify::SearchResult>& results);
+
+    /**
+     * @brief  Gets the sync statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats();
+
+    static void sync_task_dummy(void *arg);
+    void sync_task();
+
+private:
+
+    static constexpr uint32_t first_sync_delay_ms = 30000;     ///< Leaves the start to the player and the UI.
+    static constexpr uint32_t retry_delay_ms = 60000;          ///< Wait after a failed sync.
+    static constexpr uint32_t page_timeout_ms = 10000;         ///< Time a page may take.
+
+    bool sync(bool full);
+    bool fetch(spotify::SearchType type, const LibraryIndex::Cursor* since, LibraryIndexBuilder& builder,
+               LibraryIndex::Cursor& cursor, int& fresh, uint32_t& requests);
+    void store(std::vector<uint8_t>& file);
+    bool map();
+
+    spotify::Client& client;                ///< The client pulling the saved items.
+    const esp_partition_t* partition;       ///< The library partition, nullptr if missing.
+    esp_partition_mmap_handle_t mmap_handle; ///< Mapping of the partition.
+    const uint8_t* mapped;                  ///< The mapped partition, nullptr if not mapped.
+    std::vector<uint8_t> pending;           ///< An index searched while it is written to flash.
+    LibraryIndex index;                     ///< The index searched.
+    SemaphoreHandle_t mtx;                  ///< Mutex for index, pending and stats.
+    Stats stats;                            ///< The statistics.
+    TaskHandle_t task_handle;               ///< Task syncing the library.
+};
@@ -0,0 +1,333 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Placement policy for heap memory, and pools for the allocations made most often.
+*
+* Small objects used often and DMA buffers stay in internal RAM, bulk data such as response
+* bodies and images goes to PSRAM. LVGL allocates from a pool of fixed-size blocks in
+* internal RAM, sorted into size classes. cJSON allocates from an arena bound to the task
+* by a JsonScope, which frees a whole document at once when the scope ends, and from the
+* same pool as LVGL outside of one. The pools count their use, the slack of their blocks and
+* the CPU cycles spent allocating, and the heap regions their fragmentation.
+*
+*/
+namespace mem {
+
+    enum class Region : uint8_t {
+        Internal,       ///< Internal RAM, for small objects used often. Any RAM if it is full.
+        Dma,            ///< Internal RAM the SPI DMA can read, for display buffers.
+        Psram,          ///< PSRAM, for bulk data. Internal RAM without PSRAM.
+    };
+
+    static constexpr size_t region_count = 3;
+    static constexpr size_t bulk_threshold = 4096;  ///< Smallest BulkAllocator allocation placed in PSRAM.
+
+    /**
+     * @brief      Allocates heap memory in a region.
+     *
+     * @param[in]  size    The size in bytes.
+     * @param[in]  region  Where to place it.
+     *
+     * @return The memory, nullptr if the region is full.
+     */
+    void* allocate(size_t size, Region region);
+
+    /**
+     * @brief      Frees memory from allocate.
+     *
+     * @param[in]  ptr  The memory, may be nullptr.
+     */
+    void deallocate(void* ptr);
+
+    /**
+     * @brief Places containers of bulk data in PSRAM once they outgrow bulk_threshold.
+     */
+    template<typename T>
+    struct BulkAllocator {
+        using value_type = T;
+
+        BulkAllocator() = default;
+
+        template<typename U>
+        BulkAllocator(const BulkAllocator<U>&) {}
+
+        T* allocate(size_t n) {
+            size_t size = n * sizeof(T);
+            void* ptr = mem::allocate(size, size >= bulk_threshold ? Region::Psram : Region::Internal);
+
+            //Like operator new without exceptions.
+            if(ptr == nullptr) {
+                abort();
+            }
+
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, size_t) {
+            mem::deallocate(ptr);
+        }
+
+        template<typename U>
+        bool operator==(const BulkAllocator<U>&) const {
+            return true;
+        }
+    };
+
+    /**
+     * @brief A response body or another buffer of bulk data.
+     */
+    using Buffer = std::vector<char, BulkAllocator<char>>;
+
+    struct Stats {
+        size_t capacity;        ///< Bytes of the pool.
+        size_t used;            ///< Bytes of the pool in use.
+        size_t peak;            ///< Most bytes of the pool in use so far.
+        uint32_t allocations;   ///< Allocations made.
+        uint32_t overflows;     ///< Allocations that did not fit the pool and went to the heap.
+        uint64_t requested;     ///< Bytes asked for by the allocations from the pool.
+        uint64_t granted;       ///< Bytes handed out for them, blocks are rounded up to their class.
+        uint64_t cycles;        ///< CPU cycles spent in the allocations.
+        uint32_t max_cycles;    ///< Longest allocation in CPU cycles.
+    };
+
+    /**
+    *
+    * @brief Fixed-size blocks in size classes, carved from one allocation. A request takes a
+    *        block of the smallest class it fits, of the next class if that one is used up,
+    *        and goes to the heap if none is left. Thread safe.
+    *
+    */
+    class Pool {
+    public:
+        static constexpr size_t max_classes = 8;
+
+        struct Class {
+            uint16_t block_size;    ///< Bytes of a block, a multiple of 8.
+            uint16_t blocks;        ///< Number of blocks.
+        };
+
+        /**
+         * @brief Constructor for Pool class.
+         *
+         * @param[in]  name     The name reported.
+         * @param[in]  region   Where to place the blocks.
+         * @param[in]  classes  The size classes, smallest first.
+         */
+        Pool(const char* name, Region region, std::initializer_list<Class> classes);
+
+        /**
+         * @brief Destructor for Pool class. Everything allocated must be freed.
+         *
+         */
+        ~Pool();
+
+        /**
+         * @brief      Allocates memory, aligned like heap memory.
+         *
+         * @param[in]  size  The size in bytes.
+         *
+         * @return The memory, nullptr if the heap is full.
+         */
+        void* alloc(size_t size);
+
+        /**
+         * @brief      Changes the size of memory from alloc, moving it if needed.
+         *
+         * @param[in]  ptr   The memory, nullptr to allocate.
+         * @param[in]  size  The new size in bytes.
+         *
+         * @return The memory, nullptr if the heap is full. ptr is still valid then.
+         */
+        void* realloc(void* ptr, size_t size);
+
+        /**
+         * @brief      Frees memory from alloc or realloc.
+         *
+         * @param[in]  ptr  The memory, may be nullptr.
+         */
+        void free(void* ptr);
+
+        /**
+         * @brief      Checks if memory is a block of the pool rather than from the heap.
+         *
+         * @param[in]  ptr  The memory.
+         *
+         * @return True if a block.
+         */
+        bool owns(const void* ptr) const;
+
+        /**
+         * @brief  Gets the statistics.
+         *
+         * @return The statistics.
+         */
+        Stats getStats();
+
+        const char* getName() const;
+
+    private:
+
+        struct Free {
+            Free* next;
+        };
+
+        struct Slab {
+            uint8_t* begin;             ///< First block.
+            uint8_t* end;               ///< End of the last block.
+            uint16_t block_size;        ///< Bytes of a block.
+            Free* free;                 ///< First free block.
+        };
+
+        Slab* find(const void* ptr);
+
+        const char* name;                           ///< The name reported.
+        uint8_t* storage;                           ///< The blocks of all classes.
+        std::array<Slab, max_classes> slabs;        ///< The classes.
+        size_t slab_count;                          ///< Classes used.
+        portMUX_TYPE lock;                          ///< Protects the free lists and the statistics.
+        Stats stats;                                ///< The statistics.
+    };
+
+    /**
+    *
+    * @brief Hands out memory in order from a chunk and frees all of it at once. A chunk
+    *        is kept for the arena's lifetime, further chunks are taken from PSRAM when it is
+    *        full and freed by reset. Not thread safe.
+    *
+    */
+    class Arena {
+    public:
+
+        /**
+         * @brief Constructor for Arena class.
+         *
+         * @param[in]  name        The name reported.
+         * @param[in]  chunk_size  Bytes of the chunk kept, and the least of a further chunk.
+         * @param[in]  region      Where to place the chunk kept.
+         */
+        Arena(const char* name, size_t chunk_size, Region region);
+
+        /**
+         * @brief Destructor for Arena class.
+         *
+         */
+        ~Arena();
+
+        /**
+         * @brief      Allocates memory, aligned like heap memory.
+         *
+         * @param[in]  size  The size in bytes.
+         *
+         * @return The memory, nullptr if the heap is full.
+         */
+        void* alloc(size_t size);
+
+        /**
+         * @brief      Checks if memory is from the arena.
+         *
+         * @param[in]  ptr  The memory.
+         *
+         * @return True if from the arena.
+         */
+        bool owns(const void* ptr) const;
+
+        /**
+         * @brief Frees everything allocated.
+         *
+         */
+        void reset();
+
+        /**
+         * @brief  Gets the statistics. overflows counts the further chunks taken.
+         *
+         * @return The statistics.
+         */
+        Stats getStats() const;
+
+        const char* getName() const;
+
+    private:
+
+        struct Chunk {
+            Chunk* next;                ///< The chunk taken before.
+            size_t size;                ///< Bytes after the header.
+        };
+
+        static uint8_t* data(Chunk* chunk);
+
+        const char* name;               ///< The name reported.
+        size_t chunk_size;              ///< Least bytes of a chunk.
+        Chunk* first;                   ///< The chunk kept, nullptr if it could not be allocated.
+        Chunk* current;                 ///< The chunk allocated from.
+        size_t offset;                  ///< Bytes of current in use.
+        size_t used;                    ///< Bytes allocated since the last reset.
+        Stats stats;                    ///< The statistics.
+    };
+
+    /**
+    *
+    * @brief Routes the cJSON allocations of the task to an arena while it exists, so
+    *        the nodes and strings of a document come from one chunk and are freed with the
+    *        scope rather than one by one. Documents parsed in the scope must be deleted
+    *        before it ends. Scopes may be nested, the outermost one binds the arena. Without
+    *        a free arena, or with CONFIG_MEM_POOLS off, cJSON allocates as before.
+    *
+    */
+    class JsonScope {
+    public:
+        JsonScope();
+        ~JsonScope();
+
+        JsonScope(const JsonScope&) = delete;
+        JsonScope& operator=(const JsonScope&) = delete;
+
+    private:
+        Arena* arena;                   ///< The arena bound by this scope, nullptr if none.
+    };
+
+    /**
+     * @brief Creates the pools and the JSON arenas, and routes cJSON to them. Call before
+     *        anything allocates from them, i.e. before cJSON is used and before lv_init.
+     *
+     */
+    void init();
+
+    /**
+     * @brief      Gets the pool of small objects, used by LVGL and by cJSON outside of a JsonScope.
+     *
+     * @return The pool, nullptr before init or with CONFIG_MEM_POOLS off.
+     */
+    Pool* small();
+
+#if CONFIG_METRICS
+    /**
+     * @brief      Appends the pool statistics and the free memory and fragmentation of the
+     *             heap regions to a Prometheus text exposition.
+     *
+     * @param[out] out  The exposition.
+     */
+    void render(std::string& out);
+#endif
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Logs the allocation latency of the pool and the arena against the heap, and the
+     *        time to parse and delete a search page with cJSON in and out of a JsonScope.
+     *
+     */
+    void benchmark();
+#else
+    inline void benchmark() {}
+#endif
+
+}
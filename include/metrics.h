@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Registry of the operational metrics, rendered in the Prometheus text format.
+*
+* The registry and the renderer only use the standard library so they can be built and
+* scraped on the host as well. MetricsServer serves them on the device, together with
+* the heap and task gauges it samples per scrape. Without CONFIG_METRICS every observe
+* call compiles to nothing.
+*
+*/
+namespace metrics {
+
+#if CONFIG_METRICS
+    /**
+     * @brief      Records a finished HTTP request.
+     *
+     * @param[in]  method      The request method, e.g. "GET".
+     * @param[in]  url         The request URL. IDs in the path are folded so endpoints stay few.
+     * @param[in]  status      The HTTP status code, or -1 if the request failed before a response.
+     * @param[in]  latency_us  Time from sending the request to the complete response.
+     */
+    void observeRequest(const char* method, std::string_view url, int status, int64_t latency_us);
+
+    /**
+     * @brief      Counts an access token refresh.
+     *
+     * @param[in]  success  True if a new token was received.
+     */
+    void countTokenRefresh(bool success);
+
+    /**
+     * @brief      Records the time between two player state polls.
+     *
+     * @param[in]  interval_us  The interval.
+     */
+    void observePollInterval(int64_t interval_us);
+
+    /**
+     * @brief      Records a finished LVGL refresh.
+     *
+     * @param[in]  render_us  Time from the start of the refresh to its end.
+     */
+    void observeFrame(int64_t render_us);
+
+    /**
+     * @brief      Records a display flush.
+     *
+     * @param[in]  flush_us  Time spent in the flush callback.
+     * @param[in]  pixels    Pixels in the flushed area, their rate gives the display throughput.
+     */
+    void observeFlush(int64_t flush_us, uint32_t pixels);
+
+    /**
+     * @brief      Records the latency of a touch.
+     *
+     * @param[in]  latency_us  Time from the pen touching the panel to LVGL reading it as pressed.
+     */
+    void observeTouchLatency(int64_t latency_us);
+
+    /**
+     * @brief      Records the display entering a power state, the time in each is counted from there.
+     *
+     * @param[in]  state  The state, e.g. "blank".
+     */
+    void observePowerState(std::string_view state);
+
+    /**
+     * @brief      Records the latency of a wake from blank.
+     *
+     * @param[in]  latency_us  Time from the touch or player change to the first frame drawn.
+     */
+    void observeWakeLatency(int64_t latency_us);
+
+    /**
+     * @brief      Appends the registry to a Prometheus text exposition.
+     *
+     * @param[out] out   The exposition.
+     */
+    void render(std::string& out);
+
+    /**
+     * @brief      Appends a gauge with one optional label to a Prometheus text exposition.
+     *
+     * @param[out] out    The exposition.
+     * @param[in]  name   The metric name.
+     * @param[in]  help   The help text, only written if not empty.
+     * @param[in]  label  The label as key="value", or empty.
+     * @param[in]  value  The value.
+     */
+    void renderGauge(std::string& out, std::string_view name, std::string_view help, std::string_view label, double value);
+#else
+    inline void observeRequest(const char* method, std::string_view url, int status, int64_t latency_us) {}
+
+    inline void countTokenRefresh(bool success) {}
+
+    inline void observePollInterval(int64_t interval_us) {}
+
+    inline void observeFrame(int64_t render_us) {}
+
+    inline void observeFlush(int64_t flush_us, uint32_t pixels) {}
+
+    inline void observeTouchLatency(int64_t latency_us) {}
+
+    inline void observePowerState(std::string_view state) {}
+
+    inline void observeWakeLatency(int64_t latency_us) {}
+#endif
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include "esp_http_server.h"
+
+/**
+*
+* @brief Serves the metrics in the Prometheus text format at /metrics.
+*
+* Besides the registry in metrics.h, every scrape samples the free heap, the largest free
+* block and the stack high-water mark of every task. Requires a network connection.
+*
+*/
+class MetricsServer {
+public:
+    /**
+     * @brief Constructor for MetricsServer class. Starts the server.
+     *
+     * @param[in]  port  The TCP port.
+     */
+    MetricsServer(uint16_t port);
+
+    /**
+     * @brief Destructor for MetricsServer class. Stops the server.
+     *
+     */
+    ~MetricsServer();
+
+    static esp_err_t metrics_handler(httpd_req_t *req);
+
+private:
+
+    httpd_handle_t server;  ///< The HTTP server, nullptr if it couldn't be started.
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+*
+* @brief Colors picked from an image to theme the UI, as 0xRRGGBB.
+*
+* The background and the text colors have a contrast ratio of at least 4.5:1 and the accent
+* of at least 3:1 against the background, as defined by WCAG 2.
+*
+*/
+struct Palette {
+    static constexpr size_t max_dominant = 4;
+
+    std::array<uint32_t, max_dominant> dominant;  ///< Most common colors, most common first.
+    uint8_t dominant_count;                        ///< Valid entries in dominant, 0 if no pixels were added.
+    uint32_t background;                           ///< The most common color, darkened or lightened for the text.
+    uint32_t text;                                 ///< White or black, whichever suits the background.
+    uint32_t secondary;                            ///< Text color for less important text.
+    uint32_t accent;                               ///< The most vivid common color, e.g. for sliders.
+};
+
+/**
+*
+* @brief Extracts a Palette from RGB565 pixels as they are decoded, in fixed memory.
+*
+* Pixels go into an octree over the top 5 bits of each channel, whose nodes come from a
+* fixed pool. Whenever the pool runs low or there are more than max_leaves colors, the
+* deepest branch is merged into one color, so memory and time per pixel are bounded no
+* matter the image. Runs of the same pixel skip the tree. tools/palette_bench.cpp times
+* the extraction per image.
+*
+*/
+class PaletteExtractor {
+public:
+    static constexpr size_t max_nodes = 384;       ///< Size of the node pool, 36 bytes each.
+    static constexpr size_t max_leaves = 32;       ///< Colors kept in the tree.
+    static constexpr int levels = 5;               ///< Bits of each channel used.
+
+    struct Stats {
+        uint32_t pixels;            ///< Pixels added since the last reset.
+        uint32_t reductions;        ///< Branches merged since the last reset.
+    };
+
+    /**
+     * @brief Constructor for PaletteExtractor class.
+     *
+     */
+    PaletteExtractor();
+
+    /**
+     * @brief Forgets the pixels added so far.
+     *
+     */
+    void reset();
+
+    /**
+     * @brief      Adds a pixel.
+     *
+     * @param[in]  pixel  The RGB565 pixel.
+     */
+    void add(uint16_t pixel);
+
+    /**
+     * @brief      Adds every step-th pixel of a row.
+     *
+     * @param[in]  pixels  The RGB565 pixels.
+     * @param[in]  count   The number of pixels in the row.
+     * @param[in]  step    The distance between two added pixels.
+     */
+    void addRow(const uint16_t* pixels, size_t count, size_t step = 1);
+
+    /**
+     * @brief  Picks the palette from the pixels added so far.
+     *
+     * @return The palette, with a neutral theme if no pixels were added.
+     */
+    Palette finish() const;
+
+    /**
+     * @brief  Gets the extraction statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats() const;
+
+    /**
+     * @brief      Gets the WCAG 2 contrast ratio of two colors.
+     *
+     * @param[in]  a     A color as 0xRRGGBB.
+     * @param[in]  b     Another color as 0xRRGGBB.
+     *
+     * @return The ratio, from 1 to 21.
+     */
+    static float contrast(uint32_t a, uint32_t b);
+
+private:
+
+    static constexpr uint16_t no_node = 0xFFFF;
+
+    struct Node {
+        uint32_t red;               ///< Sum of the 8-bit red values.
+        uint32_t green;             ///< Sum of the 8-bit green values.
+        uint32_t blue;              ///< Sum of the 8-bit blue values.
+        uint32_t count;             ///< Pixels in the node, only set on leaves.
+        uint16_t children[8];       ///< Child nodes, no_node if none.
+        uint16_t next;              ///< Next reducible node on the same level, or next free node.
+        uint8_t level;              ///< Depth, 0 for the root.
+        bool leaf;                  ///< True if the pixels are summed here.
+    };
+
+    uint16_t allocate(uint8_t level);
+    bool reduce();
+
+    std::array<Node, max_nodes> nodes;             ///< The pool.
+    uint16_t free_list;                            ///< First free node.
+    size_t free_count;                             ///< Nodes in the free list.
+    std::array<uint16_t, levels> reducible;        ///< Inner nodes per level, newest first.
+    size_t leaf_count;                             ///< Leaves in the tree.
+    uint16_t last_pixel;                           ///< Pixel added last.
+    uint16_t last_leaf;                            ///< Leaf it went into, no_node if unknown.
+    Stats stats;                                   ///< The statistics.
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "LovyanGFX.hpp"
+#include "sdkconfig.h"
 
 class LGFX : public lgfx::LGFX_Device
 {
@@ -44,7 +45,11 @@ public:
       cfg.dummy_read_bits  =     1;  // ピクセル以外のデータ読出し前のダミーリードのビット数
       cfg.readable         =  true;  // データ読出しが可能な場合 trueに設定
       cfg.invert           = false;  // パネルの明暗が反転してしまう場合 trueに設定
+#if CONFIG_DISPLAY_FLUSH_RGB888
+      cfg.rgb_order        =  true;  // LVGL's RGB888 is stored blue first, sent as is
+#else
       cfg.rgb_order        = false;  // パネルの赤と青が入れ替わってしまう場合 trueに設定
+#endif
       cfg.dlen_16bit       = false;  // データ長を16bit単位で送信するパネルの場合 trueに設定
       cfg.bus_shared       =  true;  // SDカードとバスを共有している場合 trueに設定(drawJpgFile等でバス制御を行います)
 
@@ -69,7 +74,7 @@ public:
       cfg.x_max      = 319;  // タッチスクリーンから得られる最大のX値(生の値)
       cfg.y_min      = 0;    // タッチスクリーンから得られる最小のY値(生の値)
       cfg.y_max      = 479;  // タッチスクリーンから得られる最大のY値(生の値)
-      cfg.pin_int    = -1;   // INTが接続されているピン番号
+      cfg.pin_int    = CONFIG_TOUCH_IRQ_PIN;   // INTが接続されているピン番号
       cfg.bus_shared = true; // 画面と共通のバスを使用している場合 trueを設定
       cfg.offset_rotation = 0;// 表示とタッチの向きのが一致しない場合の調整 0~7の値で設定
       cfg.spi_host = SPI2_HOST;// 使用するSPIを選択 (HSPI_HOST or VSPI_HOST)
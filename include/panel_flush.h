@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "lvgl.h"
+#include "sdkconfig.h"
+
+class LGFX;
+
+/**
+*
+* @brief Sends LVGL's rendered areas to the ILI9488 panel, which takes 3 bytes per pixel over SPI.
+*
+* Three paths are available:
+*
+* - Lgfx: LVGL renders RGB565 and LovyanGFX converts and sends it, waiting for the transfer.
+* - Rgb666: LVGL renders RGB565, which is expanded chunk by chunk into two DMA-capable
+*   staging buffers. Each chunk is sent by DMA while the next one is expanded, and the
+*   area is handed back to LVGL as soon as the last chunk is expanded, so the last transfer
+*   overlaps with rendering the next area.
+* - Rgb888: LVGL renders RGB888 and its buffer is sent as is by DMA, with the panel set to
+*   BGR order to match LVGL's byte order. Nothing is converted, but LVGL blends 3 bytes per
+*   pixel and its buffers are half as large again. The buffer is handed back by wait().
+*
+* The SPI transaction stays open while transfers are in flight, holding the bus and its PM
+* lock; wait() finishes them and must be called before anything else uses the bus, and at the
+* end of every frame so no transaction outlives it. Must only be used from the LVGL task.
+*
+*/
+class PanelFlush {
+public:
+    static constexpr size_t chunk_pixels = 2048;   ///< Pixels per staging buffer, 6 KB each.
+
+    enum class Mode {
+        Lgfx,
+        Rgb666,
+        Rgb888
+    };
+
+    struct Stats {
+        uint32_t flushes;           ///< Areas sent.
+        uint64_t pixels;            ///< Pixels sent.
+        int64_t busy_us;            ///< Time spent in flush, i.e. not available for rendering.
+        int64_t wait_us;            ///< Time spent waiting for transfers in wait.
+    };
+
+    /**
+     * @brief Constructor for PanelFlush class. Falls back to Lgfx if the staging buffers can't be allocated.
+     *
+     * @param[in]  tft   The panel, already initialized.
+     * @param[in]  mode  The path to use.
+     */
+    PanelFlush(LGFX& tft, Mode mode);
+
+    /**
+     * @brief Destructor for PanelFlush class. Waits for the transfers in flight.
+     *
+     */
+    ~PanelFlush();
+
+    /**
+     * @brief  Gets the mode configured with DISPLAY_FLUSH.
+     *
+     * @return The mode.
+     */
+    static Mode configuredMode();
+
+    /**
+     * @brief  Gets the color format LVGL must render in.
+     *
+     * @return The color format.
+     */
+    lv_color_format_t getColorFormat() const;
+
+    /**
+     * @brief  Checks whether the area is still read after flush returns.
+     *
+     * @return
+     *  - True if the area must not be handed back to LVGL before wait returns
+     *  - False if it can be handed back when flush returns
+     */
+    bool isDeferred() const;
+
+    /**
+     * @brief      Starts sending an area.
+     *
+     * @param[in]  area  The area on the panel.
+     * @param[in]  data  The rendered pixels in the color format of getColorFormat.
+     */
+    void flush(const lv_area_t* area, const uint8_t* data);
+
+    /**
+     * @brief Waits for the transfers in flight and releases the bus.
+     *
+     */
+    void wait();
+
+    /**
+     * @brief  Gets the flush statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats() const;
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Logs the time to send a full screen in 1/10 screen areas in every mode, and the time
+     *        of those spent in flush. Draws over the whole panel.
+     *
+     * @param[in]  tft   The panel, already initialized.
+     */
+    static void benchmark(LGFX& tft);
+#else
+    static void benchmark(LGFX& tft) {}
+#endif
+
+private:
+
+    LGFX& tft;                      ///< The panel.
+    Mode mode;                      ///< The path in use.
+    uint8_t* staging[2];            ///< DMA-capable RGB666 chunks, nullptr unless Rgb666.
+    int next_staging;               ///< Staging buffer the next chunk is expanded into.
+    bool in_flight;                 ///< True while the transaction is open.
+    Stats stats;                    ///< The statistics.
+};
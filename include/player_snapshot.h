@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "sdkconfig.h"
+#include "spotify_schema.h"
+
+/**
+*
+* @brief Compact binary encoding of the player state, for NVS and for sending between devices.
+*
+* All integers are little-endian, strings are a u16 length followed by the bytes:
+*
+*     0  u8[2] magic "SP"        6  u8  volume percent      16 u64 timestamp ms
+*     2  u8    version           7  u8  artist count        24 uri, name, album name,
+*     3  u8    flags             8  u32 duration ms            album image URL, context URI,
+*     4  u16   total length      12 u32 progress ms            then one string per artist
+*
+* Flags are bit 0 playing, bit 1 shuffle and bits 2-3 repeat (off, track, context). The
+* timestamp is the time the progress refers to, in whatever clock the writer chose.
+*
+* New versions only append fields. A decoder reads the fields it knows and skips to the
+* total length, so older firmware can read newer snapshots. Decoding returns views into
+* the encoded bytes and never allocates.
+*
+*/
+namespace snapshot {
+
+    static constexpr uint8_t version = 1;
+    static constexpr size_t header_size = 24;      ///< Bytes before the first string.
+    static constexpr size_t max_artists = 8;       ///< Further artists are not encoded.
+    static constexpr size_t max_string = 1024;     ///< Longer strings are truncated.
+
+    struct View {
+        uint8_t version;                                    ///< Version of the encoded snapshot.
+        std::string_view uri;                               ///< The track URI.
+        std::string_view name;                              ///< The track name.
+        std::string_view album_name;                        ///< The album name.
+        std::string_view album_pic_url;                     ///< The album image URL.
+        std::string_view context_uri;                       ///< The playlist or album being played.
+        std::array<std::string_view, max_artists> artists;  ///< The artists, artist_count used.
+        uint8_t artist_count;                               ///< Number of artists.
+        uint32_t duration_ms;                               ///< The duration of the track.
+        uint32_t progress_ms;                               ///< The progress at timestamp_ms.
+        int64_t timestamp_ms;                               ///< The time the progress refers to.
+        spotify::PlayState play_state;                      ///< The play state.
+        spotify::ShuffleState shuffle_state;                ///< The shuffle state.
+        spotify::RepeatState repeat_state;                  ///< The repeat state.
+        uint8_t volume_percent;                             ///< The volume in percent.
+    };
+
+    /**
+     * @brief      Gets the number of bytes encode needs for a state.
+     *
+     * @param[in]  state  The player state.
+     *
+     * @return The encoded size.
+     */
+    size_t encodedSize(const spotify::PlayerState& state);
+
+    /**
+     * @brief      Encodes a player state.
+     *
+     * @param[in]   state         The player state. Its progress_time_us is not encoded.
+     * @param[in]   timestamp_ms  The time the progress refers to.
+     * @param[out]  out           The buffer to encode into.
+     * @param[in]   capacity      The size of out.
+     *
+     * @return
+     *  - The number of bytes written
+     *  - 0 if out is too small
+     */
+    size_t encode(const spotify::PlayerState& state, int64_t timestamp_ms, uint8_t* out, size_t capacity);
+
+    /**
+     * @brief      Decodes a snapshot in place.
+     *
+     * @param[in]   data  The encoded snapshot, which must outlive the view.
+     * @param[in]   len   The number of bytes available, may be more than the snapshot.
+     * @param[out]  view  The decoded snapshot.
+     *
+     * @return
+     *  - The number of bytes the snapshot takes
+     *  - 0 if the data is not a valid snapshot
+     */
+    size_t decode(const uint8_t* data, size_t len, View& view);
+
+    /**
+     * @brief      Copies a decoded snapshot into a player state.
+     *
+     * @param[in]   view   The decoded snapshot.
+     * @param[out]  state  The player state. progress_time_us is left to the caller.
+     */
+    void copy(const View& view, spotify::PlayerState& state);
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Logs the size and encode/decode times of a snapshot against the API's JSON.
+     *
+     */
+    void benchmark();
+#else
+    inline void benchmark() {}
+#endif
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "spotify_client.h"
+
+/**
+*
+* @brief Holds the latest known player state and reports track changes.
+*
+* Whatever learns about the player (polling, pushes) updates the store, and the
+* UI and prefetchers subscribe to it instead of asking the API themselves.
+*
+*/
+class PlayerStore {
+public:
+    /**
+     * @brief Called from the updating task when the track changes. Must not block.
+     */
+    using Listener = std::function<void(const spotify::Track& track, int64_t changed_us)>;
+
+    /**
+     * @brief Constructor for PlayerStore class.
+     *
+     */
+    PlayerStore();
+
+    /**
+     * @brief Destructor for PlayerStore class.
+     *
+     */
+    ~PlayerStore();
+
+    /**
+     * @brief      Replaces the current track. Listeners are called if its URI changed.
+     *
+     * @param[in]  track  The track now playing.
+     */
+    void update(const spotify::Track& track);
+
+    /**
+     * @brief  Gets a copy of the current track.
+     *
+     * @return The current track.
+     */
+    spotify::Track getTrack();
+
+    /**
+     * @brief      Adds a listener for track changes. Listeners cannot be removed.
+     *
+     * @param[in]  listener  The listener.
+     */
+    void subscribe(Listener listener);
+
+private:
+
+    spotify::Track track;             ///< The current track.
+    std::vector<Listener> listeners;  ///< Called on track changes.
+    SemaphoreHandle_t mtx;            ///< Mutex for the track and the listeners.
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_pm.h"
+#include "lvgl.h"
+
+class LGFX;
+class PanelFlush;
+class TouchSampler;
+
+/**
+*
+* @brief Dims and then blanks the backlight while the music is paused and nobody touches the
+*        screen, and lets the chip slow down and sleep meanwhile:
+*
+* - Active: full brightness, the CPU at its top frequency and no light sleep.
+* - Dim: after POWER_DIM_S without a touch. The CPU frequency drops to 80 MHz when idle, light
+*   sleep stays off so the backlight PWM and the touch sampling keep running.
+* - Blank: after POWER_BLANK_S. The backlight is off, LVGL stops, and the chip goes to automatic
+*   light sleep between the Wi-Fi beacons, keeping the association.
+*
+* The panel's SPI transaction, whose bus PM lock would keep the chip awake, is closed before
+* dimming or blanking. Playing music keeps the screen active. A touch or a change of the player
+* state pushed or polled wakes it. While blank the pen IRQ is a level wakeup source of light
+* sleep; without the IRQ the pen is checked every blank_poll_ms. A touch waking the screen is
+* swallowed until the pen lifts, and the
+* backlight comes back once the first frame since is drawn, whose latency is recorded with the
+* time spent in each state.
+*
+* All methods except setPlaying, wake and the interrupt handler must be called from the LVGL task.
+*
+*/
+class PowerGovernor {
+public:
+    enum class State : uint8_t {
+        Active,
+        Dim,
+        Blank
+    };
+
+    static constexpr size_t state_count = 3;
+    static constexpr uint32_t evaluate_period_ms = 250;   ///< Period of the inactivity checks.
+    static constexpr uint8_t active_brightness = 255;     ///< Backlight while active.
+    static constexpr uint32_t min_cpu_freq_mhz = 80;      ///< Keeps the APB, and with it the panel SPI clock, at 80 MHz.
+    static constexpr uint32_t blank_poll_ms = 50;         ///< Pen check period while blank without the pen IRQ.
+
+    struct Stats {
+        std::array<int64_t, state_count> state_us;   ///< Time spent in each state.
+        uint32_t touch_wakes;                        ///< Wakes from blank by a touch.
+        uint32_t state_wakes;                        ///< Wakes from blank by a player state change.
+        int64_t last_wake_us;                        ///< Time from the last wake to its first frame.
+        int64_t avg_wake_us;                         ///< Average of those times.
+        int64_t max_wake_us;                         ///< Longest of those times.
+    };
+
+    /**
+     * @brief Constructor for PowerGovernor class. Configures power management and starts active.
+     *
+     * @param[in]  tft    The panel, whose backlight is managed.
+     * @param[in]  flush  The flush sending to the panel, whose transaction is closed before sleeping.
+     * @param[in]  disp   The display, whose inactivity is followed.
+     * @param[in]  indev  The pointer input device.
+     * @param[in]  touch  The touch sampler, which reports pen IRQs to the governor.
+     */
+    PowerGovernor(LGFX& tft, PanelFlush& flush, lv_display_t* disp, lv_indev_t* indev, TouchSampler& touch);
+
+    /**
+     * @brief Destructor for PowerGovernor class.
+     *
+     */
+    ~PowerGovernor();
+
+    /**
+     * @brief      Sets whether music is playing, which keeps the screen active. A change wakes it.
+     *
+     * @param[in]  playing  True if playing.
+     */
+    void setPlaying(bool playing);
+
+    /**
+     * @brief Wakes the screen for a change of the player state, and restarts the inactivity timeouts.
+     *
+     */
+    void wake();
+
+    /**
+     * @brief      Waits for the next LVGL timer, or while blank until something wakes the screen.
+     *             Replaces the delay of the LVGL task.
+     *
+     * @param[in]  time_till_next_ms  The time until the next LVGL timer, from lv_timer_handler.
+     */
+    void wait(uint32_t time_till_next_ms);
+
+    /**
+     * @brief  Checks if the screen is blank, e.g. to poll the player less often.
+     *
+     * @return True if blank.
+     */
+    bool isBlank() const;
+
+    /**
+     * @brief  Gets the statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats() const;
+
+    static void timer_cb_dummy(lv_timer_t* timer);
+    void timer_cb();
+    static void refr_event_cb_dummy(lv_event_t* e);
+    void refr_event_cb();
+    static void pen_listener_dummy(void* arg);
+
+private:
+
+    bool handle_wakes();
+    void set_state(State next);
+    void hold(esp_pm_lock_handle_t lock, bool before, bool after);
+
+    LGFX& tft;                              ///< The panel with the backlight.
+    PanelFlush& flush;                      ///< Finished before dimming or blanking.
+    lv_display_t* disp;                     ///< The display.
+    lv_indev_t* indev;                      ///< The pointer input device.
+    TouchSampler& touch;                    ///< Wakes the chip, or checks the pen, while blank.
+    lv_timer_t* timer;                      ///< Checks the inactivity.
+    SemaphoreHandle_t wake_signal;          ///< Given to end the wait of the LVGL task.
+    esp_pm_lock_handle_t cpu_lock;          ///< Keeps the top CPU frequency while active, nullptr without power management.
+    esp_pm_lock_handle_t sleep_lock;        ///< Prevents light sleep unless blank, nullptr without power management.
+    std::atomic<State> state;               ///< The state, read by the interrupt handler.
+    std::atomic<bool> playing;              ///< Music is playing.
+    std::atomic<bool> touch_wake;           ///< Set by a touch while not active.
+    int64_t touch_wake_us;                  ///< Time of the touch, valid while touch_wake is set.
+    std::atomic<bool> state_wake;           ///< Set by a change of the player state.
+    int64_t state_wake_us;                  ///< Time of the change, valid while state_wake is set.
+    int64_t state_since_us;                 ///< Time the state was entered.
+    int64_t waking_since_us;                ///< Time of the wake whose first frame is pending, 0 if none.
+    bool waking_by_touch;                   ///< The pending wake came from a touch.
+    int64_t wake_total_us;                  ///< Sum of the wake latencies.
+    Stats stats;                            ///< The statistics.
+};
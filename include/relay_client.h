@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_event.h"
+#include "esp_websocket_client.h"
+#include "spotify_client.h"
+
+/**
+*
+* @brief Receives the player state pushed by a LAN relay (tools/relay.py) over a WebSocket.
+*
+* The relay polls the API once for all controllers and sends binary state messages:
+*
+*     u8 version | u8 type (0 snapshot, 1 delta) | u32 sequence | u16 field mask | fields
+*
+* Fields follow in bit order, strings are length-prefixed, integers little-endian:
+* 0 uri, 1 name, 2 album name, 3 album image URL (u16 length), 4 artists (u8 count),
+* 5 context URI, 6 duration ms (u32), 7 progress ms (u32), 8 playing (u8), 9 shuffle (u8),
+* 10 repeat (u8: off, track, context), 11 volume percent (u8). Progress is only sent
+* when it jumps; in between it is extrapolated locally. After a gap in the sequence
+* the client asks for a snapshot by sending the text "snapshot".
+*
+*/
+class RelayClient {
+public:
+    static constexpr uint8_t protocol_version = 1;
+
+    using State = spotify::PlayerState;
+
+    /**
+     * @brief Constructor for RelayClient class. Connects in the background and reconnects as needed.
+     *
+     * @param[in]  uri  The relay URI, e.g. ws://192.168.1.10:8765/.
+     */
+    RelayClient(const char* uri);
+
+    /**
+     * @brief Destructor for RelayClient class.
+     *
+     */
+    ~RelayClient();
+
+    /**
+     * @brief      Gets the current state with the progress extrapolated to now.
+     *
+     * @param[out] state  The state.
+     *
+     * @return
+     *  - True if connected and a snapshot has been received
+     *  - False otherwise, the caller should poll the API itself
+     */
+    bool getState(State& state);
+
+    /**
+     * @brief      Blocks until the relay reports a change.
+     *
+     * @param[in]  timeout  The maximum time to wait.
+     *
+     * @return
+     *  - True if the state changed
+     *  - False on timeout
+     */
+    bool waitForUpdate(TickType_t timeout);
+
+    static void event_handler_dummy(void *arg, esp_event_base_t base, int32_t event_id, void *event_data);
+    void event_handler(int32_t event_id, esp_websocket_event_data_t *data);
+
+private:
+
+    bool apply(const uint8_t *data, size_t len);
+
+    esp_websocket_client_handle_t client;   ///< The WebSocket client.
+    std::vector<uint8_t> message;           ///< Fragments of the message being received.
+    State state;                            ///< The last state received.
+    bool connected;                         ///< True while the WebSocket is open.
+    bool have_snapshot;                     ///< True once a snapshot was applied on this connection.
+    uint32_t sequence;                      ///< Sequence number of the last message applied.
+    SemaphoreHandle_t mtx;                  ///< Mutex for state and the flags.
+    SemaphoreHandle_t changed;              ///< Given on every applied message.
+};
@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+*
+* @brief Expansion of RGB565 pixels to the 3 bytes per pixel an ILI9488 takes over SPI.
+*
+* In SPI mode the ILI9488 only accepts 18-bit pixels, sent as red, green and blue bytes of
+* which the top 6 bits are used. The kernel reads pixels as integers, so the byte order of
+* the source does not matter, and builds three output words from four pixels with shifts
+* and masks on two pixels at a time. It uses no tables, 16-bit loads and aligned 32-bit
+* stores only, since the Xtensa cores fault on unaligned word accesses. The low bits of
+* each channel repeat its high bits, so full intensity stays full intensity.
+*
+*/
+namespace rgb666 {
+
+    static constexpr size_t bytes_per_pixel = 3;
+
+    /**
+     * @brief      Expands one pixel, the reference for expand().
+     *
+     * @param[in]  pixel  The RGB565 pixel.
+     *
+     * @return The red, green and blue bytes.
+     */
+    constexpr std::array<uint8_t, 3> expandPixel(uint16_t pixel) {
+        uint8_t r = (pixel >> 11) & 0x1F;
+        uint8_t g = (pixel >> 5) & 0x3F;
+        uint8_t b = pixel & 0x1F;
+
+        return {static_cast<uint8_t>(r << 3 | r >> 2), static_cast<uint8_t>(g << 2 | g >> 4),
+                static_cast<uint8_t>(b << 3 | b >> 2)};
+    }
+
+    //Each takes two pixels in the low and high half of a word and returns their channel in
+    //bytes 0 and 2, with the top bits repeated into the low ones.
+    constexpr uint32_t red_pair(uint32_t pair) {
+        uint32_t x = (pair >> 8) & 0x00F800F8;
+        return x | ((x >> 5) & 0x00070007);
+    }
+
+    constexpr uint32_t green_pair(uint32_t pair) {
+        uint32_t x = (pair >> 3) & 0x00FC00FC;
+        return x | ((x >> 6) & 0x00030003);
+    }
+
+    constexpr uint32_t blue_pair(uint32_t pair) {
+        uint32_t x = (pair << 3) & 0x00F800F8;
+        return x | ((x >> 5) & 0x00070007);
+    }
+
+    /**
+     * @brief      Expands RGB565 pixels to red, green and blue bytes.
+     *
+     * @param[in]   src    The pixels, 2-byte aligned.
+     * @param[in]   count  The number of pixels.
+     * @param[out]  dst    The output, 4-byte aligned, with room for count * bytes_per_pixel bytes.
+     */
+    inline void expand(const uint16_t* src, size_t count, uint8_t* dst) {
+        auto out = reinterpret_cast<uint32_t*>(dst);
+        size_t groups = count / 4;
+
+        for(size_t i = 0; i < groups; i++) {
+            uint32_t a = src[0] | static_cast<uint32_t>(src[1]) << 16;
+            uint32_t b = src[2] | static_cast<uint32_t>(src[3]) << 16;
+            uint32_t ra = red_pair(a), ga = green_pair(a), ba = blue_pair(a);
+            uint32_t rb = red_pair(b), gb = green_pair(b), bb = blue_pair(b);
+
+            //Bytes r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3, little-endian words.
+            out[0] = (ra & 0xFF) | (ga & 0xFF) << 8 | (ba & 0xFF) << 16 | (ra & 0xFF0000) << 8;
+            out[1] = (ga >> 16 & 0xFF) | (ba >> 16 & 0xFF) << 8 | (rb & 0xFF) << 16 | (gb & 0xFF) << 24;
+            out[2] = (bb & 0xFF) | (rb >> 16 & 0xFF) << 8 | (gb >> 16 & 0xFF) << 16 | (bb & 0xFF0000) << 8;
+
+            src += 4;
+            out += 3;
+        }
+
+        dst = reinterpret_cast<uint8_t*>(out);
+
+        for(size_t i = 0; i < count % 4; i++) {
+            auto rgb = expandPixel(src[i]);
+            dst[0] = rgb[0];
+            dst[1] = rgb[1];
+            dst[2] = rgb[2];
+            dst += 3;
+        }
+    }
+
+    static_assert(expandPixel(0xFFFF) == std::array<uint8_t, 3>{0xFF, 0xFF, 0xFF});
+    static_assert(expandPixel(0xF800) == std::array<uint8_t, 3>{0xFF, 0x00, 0x00});
+    static_assert(expandPixel(0x07E0) == std::array<uint8_t, 3>{0x00, 0xFF, 0x00});
+    static_assert(expandPixel(0x001F) == std::array<uint8_t, 3>{0x00, 0x00, 0xFF});
+    static_assert(red_pair(0xF8000800) == 0x00FF0008 && blue_pair(0x0001001F) == 0x000800FF);
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "spotify_client.h"
+
+class LibrarySync;
+
+/**
+*
+* @brief On-screen search of tracks, albums and playlists, with a keyboard and a results list.
+*
+* Keystrokes don't send requests: a background task waits until the query has not changed
+* for CONFIG_UI_SEARCH_DEBOUNCE_MS and then searches for the latest one. A new keystroke
+* cancels the search in flight, and results of older queries are dropped. Results are
+* added to the list as they are parsed, and the results of the last cache_entries queries
+* are kept, so going back to an earlier query, e.g. with backspace, shows them at once.
+* While a query waits for its results, those of its longest cached prefix that still
+* match are shown. With a LibrarySync, saved items matching the query are listed first,
+* right away, and the search results are added after them.
+*
+* All methods must be called with the LVGL lock held.
+*
+*/
+class SearchView {
+public:
+    struct Stats {
+        uint32_t keystrokes;          ///< Changes of the query.
+        uint32_t queries;             ///< Queries whose results were shown in full.
+        uint32_t requests;            ///< Search requests started.
+        uint32_t cancelled;           ///< Requests abandoned for a newer query.
+        uint32_t cache_hits;          ///< Queries answered from the cache.
+        uint32_t library_hits;        ///< Queries with saved items matching.
+        int64_t first_result_us;      ///< Last keystroke to first result of the last query.
+        int64_t avg_first_result_us;  ///< Average of first_result_us over the queries.
+    };
+
+    /**
+     * @brief Constructor for SearchView class. The view starts hidden.
+     *
+     * @param[in]  parent   The parent object, e.g. lv_layer_top() to cover the screen.
+     * @param[in]  client   The client searching.
+     * @param[in]  library  The saved items searched before the network, nullptr if none.
+     */
+    SearchView(lv_obj_t* parent, spotify::Client& client, LibrarySync* library = nullptr);
+
+    /**
+     * @brief Destructor for SearchView class.
+     *
+     */
+    ~SearchView();
+
+    /**
+     * @brief Shows the view with the keyboard focused on the query.
+     *
+     */
+    void show();
+
+    /**
+     * @brief Hides the view and cancels the search in flight.
+     *
+     */
+    void hide();
+
+    /**
+     * @brief  Gets the view object, e.g. to align it.
+     *
+     * @return The view object.
+     */
+    lv_obj_t* getObj();
+
+    /**
+     * @brief  Gets the search statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats();
+
+    static void search_task_dummy(void *arg);
+    void search_task();
+
+private:
+
+    static constexpr size_t cache_entries = 8;                            ///< Queries whose results are kept.
+    static constexpr size_t max_results = 3 * spotify::Client::search_limit; ///< Rows of the results list.
+    static constexpr int32_t row_height = 36;                             ///< Height of one row in pixels.
+    static constexpr uint32_t search_timeout_ms = 5000;                   ///< Time a search may take.
+
+    struct CacheEntry {
+        std::string query;                          ///< The normalized query, empty if unused.
+        std::vector<spotify::SearchResult> results; ///< Its results, in the order received.
+        uint32_t last_used;                         ///< cache_clock when last shown.
+    };
+
+    struct Row {
+        lv_obj_t* obj;              ///< The row container.
+        lv_obj_t* name;             ///< The result name label.
+        lv_obj_t* detail;           ///< The type and artists or owner label.
+        std::string uri;            ///< The URI of the result shown.
+    };
+
+    static void textarea_event_cb(lv_event_t* e);
+    static void close_event_cb(lv_event_t* e);
+
+    void query_changed();
+    void clear_results();
+    void add_result(const spotify::SearchResult& result);
+    void show_results(const std::vector<spotify::SearchResult>& results, std::string_view filter);
+    void first_result();
+    CacheEntry* find_cached(std::string_view query, bool prefix);
+    void store(const std::string& query, std::vector<spotify::SearchResult>& results);
+
+    spotify::Client& client;        ///< The client searching.
+    LibrarySync* library;           ///< The saved items, nullptr if not searched.
+    std::vector<spotify::SearchResult> saved; ///< Saved items matching the query.
+
+    lv_obj_t* panel;                ///< The view.
+    lv_obj_t* textarea;             ///< The query input.
+    lv_obj_t* list;                 ///< The scrollable results container.
+    lv_obj_t* keyboard;             ///< The on-screen keyboard.
+    std::array<Row, max_results> rows;
+    size_t row_count;               ///< Rows showing a result.
+    bool provisional;               ///< True while the rows show the results of a cached prefix.
+
+    std::string query;              ///< The normalized query being answered.
+    uint32_t generation;            ///< Incremented by every change of the query.
+    bool answered;                  ///< True once the query needs no request.
+    int64_t keystroke_us;           ///< Time of the last change of the query.
+    bool first_shown;               ///< True once a result of the query was shown.
+    int64_t first_result_total_us;  ///< Sum of the first result latencies.
+
+    std::array<CacheEntry, cache_entries> cache;
+    uint32_t cache_clock;           ///< Incremented whenever an entry is used.
+
+    CancelToken cancel;             ///< Abandons the search of a superseded query.
+    Stats stats;                    ///< The statistics.
+    TaskHandle_t task_handle;       ///< Task sending the searches.
+};
@@ -1,15 +1,26 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "http_client.h"
+#include "control_channel.h"
+#include "spotify_schema.h"
 
 #define API_BODY "grant_type=refresh_token&refresh_token=" CONFIG_REFRESH_TOKEN
 #define API_AUTH CONFIG_CLIENT_ID ":" CONFIG_CLIENT_SECRET
+#define API_URL CONFIG_SPOTIFY_API_URL
 #define AUTH_ENC_LEN 89 // 4 * ceil(N/3) + 1
 #define AUTH_FULL_BODY AUTH_ENC_LEN + 5
 
+class TrackCache;
+class RelayClient;
+
 namespace spotify {
 
     //See the following link for explanations of each code: https://developer.spotify.com/documentation/web-api/concepts/api-calls
@@ -30,43 +41,31 @@ namespace spotify {
         GatewayTimeout =      504
     };
 
-    enum class PlayState {
-        Playing,
-        Paused
-    };
-
-    enum class ShuffleState {
-        On,
-        Off
+    struct TrackPage {
+        std::vector<Track> items;         ///< The tracks in the page.
+        int offset;                       ///< The index of the first track in the page.
+        int total;                        ///< The total number of tracks in the list.
     };
 
-    enum class RepeatState {
-        Off,
+    enum class SearchType : uint8_t {
         Track,
-        Context
+        Album,
+        Playlist
     };
 
-    enum class Command {
-        Play,
-        Pause,
-        SkipNext,
-        SkipPrev,
-        ShuffleOn,
-        ShuffleOff,
-        RepeatContext,
-        RepeatTrack,
-        RepeatOff
+    struct SearchResult {
+        SearchType type;                  ///< What the result is.
+        std::string name;                 ///< The track, album or playlist name.
+        std::string detail;               ///< The artists, or the owner of a playlist.
+        std::string uri;                  ///< The Spotify URI.
     };
 
-    struct Track {
-        std::string name;                 ///< The track name.
-        std::string album_name;           ///< The name of the track's album.
-        std::string album_pic_url;        ///< A URL to a JPG of the track's album.
-        std::vector<std::string> artists; ///< A list of artists on the track.
-        int duration_ms;                  ///< The duration of the track.
-        int progress_ms;                  ///< The current progress into the track.
-        std::string uri;                  ///< The track's url.
-        int response_code;                ///< The HTTP response code.
+    struct SavedItem {
+        SearchType type;                  ///< What the item is.
+        std::string name;                 ///< The track, album or playlist name.
+        std::vector<std::string> artists; ///< The artists, or the owner of a playlist.
+        std::string id;                   ///< The Spotify ID.
+        std::string added_at;             ///< When it was saved, ISO 8601. Empty for playlists.
     };
 
     class Client {
@@ -74,19 +73,202 @@ namespace spotify {
         Client();
         ~Client();
 
-        Track getCurrentlyPlaying();
+        static constexpr uint32_t command_timeout_ms = 3000; ///< Time a player command may take before it's dropped.
+        static constexpr size_t poll_token_count = 4;        ///< Poll tokens reused in turn, more than polls ever overlap.
+
+        /**
+         * @brief            Gets the track being played and updates the player's state.
+         *
+         * @param[in]   deadline  Abandons the request, e.g. one from pollDeadline.
+         *
+         * @return The track, with an empty uri if the request failed or was abandoned.
+         */
+        Track getCurrentlyPlaying(const Deadline& deadline = Deadline::none());
+
+        /**
+         * @brief            Gets a deadline for polling getCurrentlyPlaying, which is cancelled as soon as
+         *                   a player command or control is sent, as the poll's result would undo it on screen.
+         *                   Each poll gets its own token, so starting one never revives another.
+         *
+         * @param[in]   timeout_ms  The time from now.
+         *
+         * @return The deadline.
+         */
+        Deadline pollDeadline(uint32_t timeout_ms);
+
+        /**
+         * @brief            Waits for the relay to push a player change. Returns after the
+         *                   timeout without a relay, so it can pace polling as well.
+         *
+         * @param[in]   timeout  The maximum time to wait.
+         *
+         * @return
+         *  - True if the relay reported a change
+         *  - False on timeout
+         */
+        bool waitForRelayUpdate(TickType_t timeout);
+
+        /**
+         * @brief            Gets the tracks queued after the current one.
+         *
+         * @param[out]  page  The queued tracks. The page always starts at offset 0.
+         *
+         * @return
+         *  - True if successful
+         *  - False otherwise
+         */
+        bool getQueue(TrackPage& page);
+
+        /**
+         * @brief            Gets the devices the user can play on.
+         *
+         * @param[out]  devices  The devices, replaced.
+         *
+         * @return
+         *  - True if successful
+         *  - False otherwise
+         */
+        bool getDevices(std::vector<Device>& devices);
+
+        /**
+         * @brief            Gets a page of the tracks of a playlist.
+         *
+         * @param[in]   playlist_id  The Spotify ID of the playlist.
+         * @param[in]   offset       The index of the first track to get.
+         * @param[in]   limit        The maximum number of tracks to get (at most 50).
+         * @param[out]  page         The tracks.
+         *
+         * @return
+         *  - True if successful
+         *  - False otherwise
+         */
+        bool getPlaylistTracks(std::string_view playlist_id, int offset, int limit, TrackPage& page);
+
+        /**
+         * @brief Receives a search result as soon as it is parsed. Called from the searching task.
+         */
+        using SearchSink = std::function<void(SearchResult&& result)>;
+
+        static constexpr int search_limit = 5; ///< Results requested per type.
+
+        /**
+         * @brief            Searches tracks, albums and playlists. Each result is handed to sink as
+         *                   soon as its part of the response arrives, tracks first.
+         *
+         * @param[in]   query     The search terms.
+         * @param[in]   sink      Receives the results.
+         * @param[in]   deadline  Abandons the search, e.g. once the query changed.
+         *
+         * @return
+         *  - True if the whole response was received
+         *  - False otherwise, sink may have received some results
+         */
+        bool search(std::string_view query, const SearchSink& sink, const Deadline& deadline);
+
+        /**
+         * @brief Receives a saved item as soon as it is parsed. Called from the requesting task.
+         */
+        using SavedSink = std::function<void(SavedItem&& item)>;
+
+        static constexpr int saved_page_limit = 50; ///< Saved items per page, the most the API returns.
+
+        /**
+         * @brief            Gets a page of the saved tracks or albums, newest first, or of the playlists
+         *                   followed or owned, in the order of the user's list.
+         *
+         * @param[in]   type      The kind of items.
+         * @param[in]   offset    The index of the first item to get.
+         * @param[in]   sink      Receives the items of the page.
+         * @param[out]  total     The number of items saved.
+         * @param[in]   deadline  Abandons the request.
+         *
+         * @return
+         *  - True if the whole page was received
+         *  - False otherwise, sink may have received some items
+         */
+        bool getSavedItems(SearchType type, int offset, const SavedSink& sink, int& total, const Deadline& deadline);
+
+        /**
+         * @brief            Gets several tracks in a single request, bypassing the track cache.
+         *
+         * @param[in]   uris    Up to 50 track URIs. URIs other than spotify:track: ones are skipped.
+         * @param[out]  tracks  The tracks found are appended, in no particular order.
+         *
+         * @return
+         *  - True if successful
+         *  - False otherwise
+         */
+        bool getTracks(const std::vector<std::string>& uris, std::vector<Track>& tracks);
+
+        /**
+         * @brief            Gets the metadata of a list of tracks through the track cache.
+         *
+         *                   Tracks not cached are fetched in batches of up to 50.
+         *
+         * @param[in]   uris    The track URIs.
+         * @param[out]  tracks  The tracks, in the order of uris.
+         *
+         * @return
+         *  - True if every track was resolved
+         *  - False otherwise
+         */
+        bool resolveTracks(const std::vector<std::string>& uris, std::vector<Track>& tracks);
+
+        /**
+         * @brief  Gets the track cache, e.g. for its statistics.
+         *
+         * @return The track cache.
+         */
+        TrackCache& getTrackCache();
 
         /**
          * @brief           Sends a command to the player.
          *                  
          * 
-         * @param[in]  cmd  The command to send. 
+         * @param[in]  cmd       The command to send. 
+         * @param[in]  deadline  Drops the command instead of applying it late.
+         *
+         * @return
+         *  - True if successful
+         *  - False otherwise
+         */
+        bool sendPlayerCommand(Command cmd, const Deadline& deadline = Deadline::in(command_timeout_ms));
+
+        /**
+         * @brief           Sends a single value of a continuous control to the player. Blocks until done.
+         *                  
+         * 
+         * @param[in]  ctrl      The control to set. 
+         * @param[in]  value     The volume in percent or the seek position in ms.
+         * @param[in]  deadline  Drops the value instead of applying it late.
          *
          * @return
          *  - True if successful
          *  - False otherwise
          */
-        bool sendPlayerCommand(Command cmd);
+        bool sendPlayerControl(Control ctrl, int value, const Deadline& deadline = Deadline::in(command_timeout_ms));
+
+        /**
+         * @brief Sets the volume without blocking. Meant to be called for every slider event.
+         *
+         *        The local volume is updated immediately. Intermediate values are collapsed
+         *        and the value given on release is always sent.
+         *
+         * @param[in]  volume_percent  The volume in percent.
+         * @param[in]  released        True if this is the final value of the drag.
+         */
+        void setVolume(int volume_percent, bool released);
+
+        /**
+         * @brief Seeks within the current track without blocking. Meant to be called for every slider event.
+         *
+         *        The local progress is updated immediately. Intermediate values are collapsed
+         *        and the value given on release is always sent.
+         *
+         * @param[in]  position_ms  The position in ms.
+         * @param[in]  released     True if this is the final value of the drag.
+         */
+        void seek(int position_ms, bool released);
 
 
         /**
@@ -166,18 +348,82 @@ namespace spotify {
          */ 
         ShuffleState getShuffleState();
 
+        /**
+         * @brief Gets the current volume, including values not yet sent.
+         *          
+         * @return The volume in percent.
+         */ 
+        int getVolume();
+
+        /**
+         * @brief Gets the progress into the current track, including seeks not yet sent.
+         *          
+         * @return The progress in ms.
+         */ 
+        int getProgress();
+
+        /**
+         * @brief Gets the duration of the current track.
+         *          
+         * @return The duration in ms.
+         */ 
+        int getDuration();
+
+        /**
+         * @brief Gets the statistics of the last completed drag of a control.
+         *          
+         * @param[in]  ctrl  The control.
+         *
+         * @return The drag statistics.
+         */ 
+        ControlChannel::Stats getControlStats(Control ctrl);
+
         static void get_access_token_task_dummy(void *arg);
         void get_access_token_task();
 
     private:
+
+        /**
+         * @brief      Sets the Authorization header from the current access token without allocating.
+         *
+         * @param[in]  http_client  The client to authorize.
+         *
+         * @return
+         *  - True if the header was set
+         *  - False if the token doesn't fit the header, the request must not be sent
+         */
+        bool set_authorization(HttpClient& http_client);
+
+        /**
+         * @brief Cancels every poll in progress, as a command just made their result stale.
+         *
+         */
+        void cancel_polls();
         
+        std::unique_ptr<TrackCache> track_cache; ///< Metadata of the tracks seen recently.
+        std::unique_ptr<RelayClient> relay;      ///< Source of pushed player state, nullptr to poll the API.
         PlayState play_state;         ///< The player's state.
         RepeatState repeat_state;     ///< The repeat state.
         ShuffleState shuffle_state;   ///< The shuffle state.
+        int volume_percent;           ///< The volume in percent.
+        int progress_ms;              ///< The progress into the current track.
+        int duration_ms;              ///< The duration of the current track.
         std::string access_token;     ///< The access token,
         HttpClient token_http_client; ///< HttpClient for access token.
-        HttpClient api_http_client;
+        HttpClient api_http_client;   ///< HttpClient for browsing the queue and playlists.
+        HttpClient player_http_client; ///< HttpClient for the currently playing state.
         SemaphoreHandle_t mtx_token;  ///< Mutex for the access token.
+        SemaphoreHandle_t mtx_api;    ///< Mutex for api_http_client.
+        SemaphoreHandle_t mtx_player; ///< Mutex for player_http_client, polled by the main loop and the playlist browser.
+        HttpClient command_http_client; ///< HttpClient for player commands.
+        SemaphoreHandle_t mtx_command; ///< Mutex for command_http_client, used by the UI and the control channel.
+        HttpClient volume_http_client; ///< HttpClient for volume requests.
+        HttpClient seek_http_client;   ///< HttpClient for seek requests.
+        HttpClient search_http_client; ///< HttpClient for searches, used by one task at a time.
+        std::array<CancelToken, poll_token_count> poll_tokens; ///< Abandon the polls in progress once a command makes them stale.
+        std::atomic<uint32_t> next_poll_token; ///< Counts the polls, picks the token of the next one.
+        ControlChannel volume_channel; ///< Latest-wins channel for volume requests.
+        ControlChannel seek_channel;   ///< Latest-wins channel for seek requests.
     };
 
 }
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include "esp_http_client.h"
+#include "spotify_schema.h"
+
+/**
+*
+* @brief Compile-time descriptions of the player endpoints.
+*
+* Each command and control maps to its method, its path below API_URL (with any fixed query)
+* and the status the API answers on success. Controls add their value as the query parameter
+* named by param. The tables are indexed by the enums, which the static_asserts below check.
+*
+*/
+namespace spotify {
+
+    struct Endpoint {
+        esp_http_client_method_t method;    ///< The request method.
+        const char* path;                   ///< The path, with any fixed query.
+        const char* param;                  ///< Name of the value's query parameter, nullptr for commands.
+        int expected_status;                ///< The status of a successful request.
+    };
+
+    template<typename Key>
+    struct EndpointEntry {
+        Key key;                            ///< The command or control.
+        Endpoint endpoint;                  ///< Its endpoint.
+    };
+
+    inline constexpr EndpointEntry<Command> command_endpoints[] = {
+        {Command::Play,          {HTTP_METHOD_PUT,  "/v1/me/player/play",                  nullptr, 204}},
+        {Command::Pause,         {HTTP_METHOD_PUT,  "/v1/me/player/pause",                 nullptr, 204}},
+        {Command::SkipNext,      {HTTP_METHOD_POST, "/v1/me/player/next",                  nullptr, 204}},
+        {Command::SkipPrev,      {HTTP_METHOD_POST, "/v1/me/player/previous",              nullptr, 204}},
+        {Command::ShuffleOn,     {HTTP_METHOD_PUT,  "/v1/me/player/shuffle?state=true",    nullptr, 204}},
+        {Command::ShuffleOff,    {HTTP_METHOD_PUT,  "/v1/me/player/shuffle?state=false",   nullptr, 204}},
+        {Command::RepeatContext, {HTTP_METHOD_PUT,  "/v1/me/player/repeat?state=context",  nullptr, 204}},
+        {Command::RepeatTrack,   {HTTP_METHOD_PUT,  "/v1/me/player/repeat?state=track",    nullptr, 204}},
+        {Command::RepeatOff,     {HTTP_METHOD_PUT,  "/v1/me/player/repeat?state=off",      nullptr, 204}}
+    };
+
+    inline constexpr EndpointEntry<Control> control_endpoints[] = {
+        {Control::Volume,        {HTTP_METHOD_PUT,  "/v1/me/player/volume",  "volume_percent", 204}},
+        {Control::Seek,          {HTTP_METHOD_PUT,  "/v1/me/player/seek",    "position_ms",    204}}
+    };
+
+    template<typename Key, size_t N>
+    constexpr bool endpoints_indexed(const EndpointEntry<Key> (&table)[N]) {
+        for(size_t i = 0; i < N; i++) {
+            if(static_cast<size_t>(table[i].key) != i || table[i].endpoint.path[0] != '/') {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static_assert(endpoints_indexed(command_endpoints) && std::size(command_endpoints) == static_cast<size_t>(Command::RepeatOff) + 1,
+                  "command_endpoints must list every Command in enum order");
+    static_assert(endpoints_indexed(control_endpoints) && std::size(control_endpoints) == static_cast<size_t>(Control::Seek) + 1,
+                  "control_endpoints must list every Control in enum order");
+
+    constexpr const Endpoint& endpoint(Command cmd) {
+        return command_endpoints[static_cast<size_t>(cmd)].endpoint;
+    }
+
+    constexpr const Endpoint& endpoint(Control ctrl) {
+        return control_endpoints[static_cast<size_t>(ctrl)].endpoint;
+    }
+
+}
@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "json_schema.h"
+
+/**
+*
+* @brief The objects of the Spotify Web API the client reads, the player state it keeps and
+*        the commands it sends, and the schemas the responses are decoded with. See
+*        https://developer.spotify.com/documentation/web-api/reference for the responses. Only
+*        uses the standard library, tools/decode_bench.cpp decodes recorded responses with them
+*        on the host.
+*
+*/
+namespace spotify {
+
+    struct Track {
+        std::string name;                 ///< The track name.
+        std::string album_name;           ///< The name of the track's album.
+        std::string album_pic_url;        ///< A URL to a JPG of the track's album.
+        std::vector<std::string> artists; ///< A list of artists on the track.
+        int duration_ms;                  ///< The duration of the track.
+        int progress_ms;                  ///< The current progress into the track.
+        std::string uri;                  ///< The track's url.
+        std::string context_uri;          ///< The URI of the playlist or album being played, if any.
+        int response_code;                ///< The HTTP response code.
+    };
+
+    struct Episode {
+        std::string name;                 ///< The episode name.
+        std::string show_name;            ///< The name of the episode's show.
+        std::string publisher;            ///< The publisher of the show.
+        std::string image_url;            ///< A URL to a JPG of the episode.
+        int duration_ms;                  ///< The duration of the episode.
+        std::string uri;                  ///< The episode's URI.
+    };
+
+    struct Device {
+        std::string id;                   ///< The device ID, empty for some restricted devices.
+        std::string name;                 ///< The name shown to the user.
+        std::string type;                 ///< "Computer", "Smartphone", "Speaker" and so on.
+        bool is_active;                   ///< True if it is the device playing.
+        int volume_percent;               ///< The volume in percent, 0 if it has none.
+    };
+
+    enum class PlayState {
+        Playing,
+        Paused
+    };
+
+    enum class ShuffleState {
+        On,
+        Off
+    };
+
+    enum class RepeatState {
+        Off,
+        Track,
+        Context
+    };
+
+    enum class Command {
+        Play,
+        Pause,
+        SkipNext,
+        SkipPrev,
+        ShuffleOn,
+        ShuffleOff,
+        RepeatContext,
+        RepeatTrack,
+        RepeatOff
+    };
+
+    enum class Control {
+        Volume,
+        Seek
+    };
+
+    struct PlayerState {
+        Track track;                  ///< The current track, progress as of progress_time_us.
+        PlayState play_state;         ///< The play state.
+        ShuffleState shuffle_state;   ///< The shuffle state.
+        RepeatState repeat_state;     ///< The repeat state.
+        int volume_percent;           ///< The volume in percent.
+        int64_t progress_time_us;     ///< esp_timer time the progress was reported at.
+    };
+
+    namespace api {
+
+        //GET /v1/me/player/currently-playing?additional_types=episode
+        struct CurrentlyPlaying {
+            bool is_playing;                    ///< True if playing.
+            int progress_ms;                    ///< The progress into the item.
+            std::string type;                   ///< "track", "episode", "ad" or "unknown".
+            std::string context_uri;            ///< The URI of the playlist, album or show being played, if any.
+            Track track;                        ///< The item if type is "track".
+            Episode episode;                    ///< The item if type is "episode".
+        };
+
+        //GET /v1/me/player/queue
+        struct Queue {
+            std::vector<Track> queue;           ///< The items after the current one, episodes have no album.
+        };
+
+        struct PlaylistItem {
+            std::string uri;                    ///< The track's URI, empty for local files removed from Spotify.
+        };
+
+        //GET /v1/playlists/{id}/tracks?fields=total,items(track(uri))
+        struct PlaylistPage {
+            std::vector<PlaylistItem> items;    ///< The items of the page.
+            int total;                          ///< Items of the playlist.
+        };
+
+        //GET /v1/tracks?ids=...
+        struct Tracks {
+            std::vector<Track> tracks;          ///< The tracks found, unknown IDs are dropped.
+        };
+
+        //GET /v1/me/player/devices
+        struct Devices {
+            std::vector<Device> devices;        ///< The devices available.
+        };
+
+        //POST /api/token
+        struct Token {
+            std::string access_token;           ///< The access token.
+        };
+
+    }
+
+}
+
+namespace json {
+
+    template<>
+    struct Schema<spotify::Track> {
+        static constexpr auto fields = std::make_tuple(
+            field("name", &spotify::Track::name),
+            field("album.name", &spotify::Track::album_name),
+            field("album.images.1.url", &spotify::Track::album_pic_url),
+            field("artists.*.name", &spotify::Track::artists),
+            field("duration_ms", &spotify::Track::duration_ms),
+            field("uri", &spotify::Track::uri, Presence::Required));
+    };
+
+    template<>
+    struct Schema<spotify::Episode> {
+        static constexpr auto fields = std::make_tuple(
+            field("name", &spotify::Episode::name),
+            field("show.name", &spotify::Episode::show_name),
+            field("show.publisher", &spotify::Episode::publisher),
+            field("images.1.url", &spotify::Episode::image_url),
+            field("duration_ms", &spotify::Episode::duration_ms),
+            field("uri", &spotify::Episode::uri, Presence::Required));
+    };
+
+    template<>
+    struct Schema<spotify::Device> {
+        static constexpr auto fields = std::make_tuple(
+            field("id", &spotify::Device::id),
+            field("name", &spotify::Device::name, Presence::Required),
+            field("type", &spotify::Device::type),
+            field("is_active", &spotify::Device::is_active),
+            field("volume_percent", &spotify::Device::volume_percent));
+    };
+
+    //The item is a track or an episode, both are decoded from it and type tells which one is valid.
+    template<>
+    struct Schema<spotify::api::CurrentlyPlaying> {
+        static constexpr auto fields = std::make_tuple(
+            field("is_playing", &spotify::api::CurrentlyPlaying::is_playing),
+            field("progress_ms", &spotify::api::CurrentlyPlaying::progress_ms),
+            field("currently_playing_type", &spotify::api::CurrentlyPlaying::type),
+            field("context.uri", &spotify::api::CurrentlyPlaying::context_uri),
+            field("item", &spotify::api::CurrentlyPlaying::track),
+            field("item", &spotify::api::CurrentlyPlaying::episode));
+    };
+
+    template<>
+    struct Schema<spotify::api::Queue> {
+        static constexpr auto fields = std::make_tuple(
+            field("queue", &spotify::api::Queue::queue));
+    };
+
+    template<>
+    struct Schema<spotify::api::PlaylistItem> {
+        static constexpr auto fields = std::make_tuple(
+            field("track.uri", &spotify::api::PlaylistItem::uri));
+    };
+
+    template<>
+    struct Schema<spotify::api::PlaylistPage> {
+        static constexpr auto fields = std::make_tuple(
+            field("items", &spotify::api::PlaylistPage::items),
+            field("total", &spotify::api::PlaylistPage::total, Presence::Required));
+    };
+
+    template<>
+    struct Schema<spotify::api::Tracks> {
+        static constexpr auto fields = std::make_tuple(
+            field("tracks", &spotify::api::Tracks::tracks));
+    };
+
+    template<>
+    struct Schema<spotify::api::Devices> {
+        static constexpr auto fields = std::make_tuple(
+            field("devices", &spotify::api::Devices::devices, Presence::Required));
+    };
+
+    template<>
+    struct Schema<spotify::api::Token> {
+        static constexpr auto fields = std::make_tuple(
+            field("access_token", &spotify::api::Token::access_token, Presence::Required));
+    };
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include "lvgl.h"
+
+/**
+*
+* @brief Static part of a screen rendered once into a cached full-screen layer.
+*
+* In partial render mode every invalidated area is drawn from the bottom up, so a
+* progress bar moving over the album art also redraws the background, the gradient and
+* the cover beneath it. Objects created on the layer's content instead live on an
+* off-screen screen and are rendered into an RGB565 buffer in PSRAM whenever they change.
+* The active screen shows that buffer as one opaque image at the bottom, so the dynamic
+* widgets on top are drawn over a row copy of it, and only in their own dirty areas.
+*
+* Changes on the content are not seen by LVGL's invalidation, which skips inactive screens.
+* Objects that change after being composed send LV_EVENT_REFRESH with
+* LV_OBJ_FLAG_EVENT_BUBBLE set, or the owner calls invalidate(). Without PSRAM the content
+* is the parent itself and everything is drawn directly, as before.
+*
+* All methods must be called with the LVGL lock held.
+*
+*/
+class StaticLayer {
+public:
+    static constexpr uint32_t compose_delay_ms = 20;  ///< Changes within this time are composed together.
+
+    struct Stats {
+        uint32_t composes;          ///< Times the content was rendered into the layer.
+        int64_t last_compose_us;    ///< Time the last render took.
+        uint32_t layer_bytes;       ///< Size of the layer, 0 if drawing directly.
+    };
+
+    /**
+     * @brief Constructor for StaticLayer class.
+     *
+     * @param[in]  parent  The screen showing the layer.
+     */
+    StaticLayer(lv_obj_t* parent);
+
+    /**
+     * @brief Destructor for StaticLayer class. Deletes the content and the objects on it.
+     *
+     */
+    ~StaticLayer();
+
+    /**
+     * @brief  Gets the parent for static objects. It has the size of the display, so positions
+     *         on it are screen positions.
+     *
+     * @return The content object.
+     */
+    lv_obj_t* getContent();
+
+    /**
+     * @brief Renders all of the content again on the next composition.
+     *
+     */
+    void invalidate();
+
+    /**
+     * @brief  Gets the composition statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats();
+
+    static void refresh_event_cb(lv_event_t* e);
+    static void timer_cb_dummy(lv_timer_t* timer);
+    void timer_cb();
+
+private:
+
+    void add_dirty(const lv_area_t& area);
+
+    lv_obj_t* content;              ///< Off-screen parent of the static objects, or the parent.
+    lv_obj_t* canvas;               ///< Shows the layer, nullptr if drawing directly.
+    lv_timer_t* timer;              ///< Composes pending changes, paused while there are none.
+    void* pixels;                   ///< RGB565 pixels of the layer.
+    lv_draw_buf_t layer;            ///< Draw buffer over pixels.
+    lv_area_t dirty_area;           ///< Screen area changed since the last composition.
+    bool dirty;                     ///< True if dirty_area is set.
+    Stats stats;                    ///< The statistics.
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+*
+* @brief Fixed-size pool of reference counted, interned strings.
+*
+* Equal strings share one copy and are referred to by a 16-bit id. The bytes of
+* released strings are reclaimed by compacting the pool when it runs out of space.
+* Not thread safe.
+*
+*/
+class StringPool {
+public:
+    using Id = uint16_t;
+
+    static constexpr Id invalid_id = 0xFFFF;       ///< Returned when the pool is full.
+    static constexpr size_t max_strings = 1024;    ///< Maximum number of distinct strings.
+    static constexpr size_t pool_bytes = 24576;    ///< Bytes available for string data.
+
+    /**
+     * @brief Constructor for StringPool class.
+     *
+     */
+    StringPool();
+
+    /**
+     * @brief      Interns a string, adding a reference to it.
+     *
+     * @param[in]  str  The string.
+     *
+     * @return
+     *  - The string id
+     *  - invalid_id if the string is empty or the pool is full
+     */
+    Id intern(std::string_view str);
+
+    /**
+     * @brief      Removes a reference to a string. The string is freed with its last reference.
+     *
+     * @param[in]  id  The string id. invalid_id is ignored.
+     */
+    void release(Id id);
+
+    /**
+     * @brief      Gets an interned string. Valid until the next call to intern.
+     *
+     * @param[in]  id  The string id.
+     *
+     * @return The string, empty for invalid_id.
+     */
+    std::string_view get(Id id) const;
+
+    /**
+     * @brief  Gets the number of bytes used by live strings.
+     *
+     * @return The number of bytes.
+     */
+    size_t getUsedBytes() const;
+
+    /**
+     * @brief      Hashes a string with the hash used for interning.
+     *
+     * @param[in]  str  The string.
+     *
+     * @return The 32-bit FNV-1a hash.
+     */
+    static uint32_t hash(std::string_view str);
+
+private:
+
+    static constexpr size_t bucket_count = 512;
+
+    struct Entry {
+        uint32_t hash;          ///< Hash of the string.
+        uint16_t length;        ///< Length of the string.
+        uint16_t offset;        ///< Offset of the string in data.
+        uint16_t refs;          ///< Number of references, 0 if the entry is free.
+    };
+
+    void compact();
+
+    std::array<char, pool_bytes> data;              ///< String bytes.
+    std::array<Entry, max_strings> entries;         ///< String descriptors, indexed by id.
+    std::array<Id, max_strings> chain;              ///< Next entry in the same bucket, or the next free entry.
+    std::array<Id, bucket_count> buckets;           ///< First entry of each hash bucket.
+    Id free_head;                                   ///< First free entry.
+    size_t data_end;                                ///< End of the allocated bytes in data.
+    size_t live_bytes;                              ///< Bytes used by live strings.
+};
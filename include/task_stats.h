@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+/**
+*
+* @brief Samples the FreeRTOS runtime counters and reports the CPU share per task and per core.
+*
+* Every interval the run time of each task is compared with the previous sample, so the
+* report covers only the last window. Requires CONFIG_TASK_STATS, which enables the
+* FreeRTOS run time statistics.
+*
+*/
+class TaskStats {
+public:
+    static constexpr int no_core = -1;  ///< Core of tasks that are not pinned.
+
+    struct TaskLoad {
+        std::string name;               ///< The task name.
+        int core;                       ///< The core the task is pinned to, or no_core.
+        uint32_t cpu_permille;          ///< Share of one core's time in the last window.
+        uint32_t stack_free;            ///< Stack high-water mark in bytes, i.e. the least free stack so far.
+    };
+
+    /**
+     * @brief Constructor for TaskStats class.
+     *
+     * @param[in]  interval_ms  Length of the sampling window.
+     */
+    TaskStats(uint32_t interval_ms);
+
+    /**
+     * @brief Destructor for TaskStats class.
+     *
+     */
+    ~TaskStats();
+
+    /**
+     * @brief  Gets the task loads of the last window, busiest first.
+     *
+     * @return The task loads.
+     */
+    std::vector<TaskLoad> getTasks();
+
+    /**
+     * @brief      Gets the busy share of a core in the last window.
+     *
+     * @param[in]  core  The core.
+     *
+     * @return     Share of the time not spent in the idle task, in permille.
+     */
+    uint32_t getCoreLoad(int core);
+
+    static void sampler_task_dummy(void *arg);
+    void sampler_task();
+
+private:
+
+    struct Sample {
+        TaskHandle_t handle;            ///< The task.
+        uint32_t run_time;              ///< Its runtime counter.
+    };
+
+    void sample();
+    void log();
+
+    uint32_t interval_ms;                       ///< Length of the sampling window.
+    std::vector<Sample> previous;               ///< Counters of the previous sample.
+    uint32_t previous_total;                    ///< Total runtime of the previous sample.
+    std::vector<TaskLoad> tasks;                ///< Task loads of the last window.
+    uint32_t core_load[portNUM_PROCESSORS];     ///< Core loads of the last window.
+    SemaphoreHandle_t mtx;                      ///< Mutex for tasks and core_load.
+    TaskHandle_t task_handle;                   ///< The sampling task.
+};
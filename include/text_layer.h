@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lvgl.h"
+
+/**
+*
+* @brief Single line of text rasterized once into an A8 strip and scrolled as a marquee.
+*
+* LVGL's scrolling labels shape and rasterize every glyph on every frame. A text layer
+* renders its string into an alpha-only strip when the text changes and shows it through
+* a tiled image, so scrolling only moves the image offset and blits the visible window.
+* Text that fits stays still. The marquee advances on its own timer, which bounds how
+* often the layer is redrawn and flushed independently of the display refresh rate.
+*
+*/
+class TextLayer {
+public:
+    static constexpr int32_t max_strip_width = 2048;  ///< Longer text is cut off.
+    static constexpr int32_t gap = 40;                ///< Pixels between the end of the text and its repetition.
+
+    struct Stats {
+        uint32_t renders;           ///< Strips rasterized.
+        uint32_t steps;             ///< Marquee steps, each of which redraws the layer.
+        uint32_t strip_bytes;       ///< Size of the current strip.
+    };
+
+    /**
+     * @brief Constructor for TextLayer class. Must be called with the LVGL lock held.
+     *
+     * @param[in]  parent      The parent object.
+     * @param[in]  width       The visible width in pixels.
+     * @param[in]  font        The font.
+     * @param[in]  color       The text color.
+     * @param[in]  speed       The scrolling speed in pixels per second.
+     * @param[in]  period_ms   The time between two marquee steps.
+     */
+    TextLayer(lv_obj_t* parent, int32_t width, const lv_font_t* font, lv_color_t color,
+              int32_t speed = 30, uint32_t period_ms = 40);
+
+    /**
+     * @brief Destructor for TextLayer class. Must be called with the LVGL lock held.
+     *
+     */
+    ~TextLayer();
+
+    /**
+     * @brief  Gets the object, e.g. to align it. Must be called with the LVGL lock held.
+     *
+     * @return The object.
+     */
+    lv_obj_t* getObj();
+
+    /**
+     * @brief      Sets the text. May be called from any task; the strip is rendered by the LVGL
+     *             task on the next marquee step, and not at all if the text did not change.
+     *
+     * @param[in]  text  The text.
+     */
+    void setText(std::string_view text);
+
+    /**
+     * @brief      Sets the text color. The strip only holds coverage, so nothing is rendered again.
+     *             Must be called with the LVGL lock held.
+     *
+     * @param[in]  color  The text color.
+     */
+    void setColor(lv_color_t color);
+
+    /**
+     * @brief  Gets the rendering statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats();
+
+    static void timer_cb_dummy(lv_timer_t* timer);
+    void timer_cb();
+
+private:
+
+    void render();
+
+    lv_obj_t* canvas;               ///< Shows the strip, tiled while scrolling.
+    lv_draw_buf_t* strip;           ///< The rasterized text, nullptr before the first render.
+    lv_timer_t* timer;              ///< Advances the marquee and picks up new text.
+    const lv_font_t* font;          ///< The font.
+    int32_t width;                  ///< The visible width.
+    int32_t strip_width;            ///< Width of the strip, including the gap if scrolling.
+    bool scrolling;                 ///< True if the text is wider than the layer.
+    int32_t speed;                  ///< Pixels per second.
+    uint32_t period_ms;             ///< Time between two steps.
+    int32_t offset_milli;           ///< Scroll position in thousandths of a pixel.
+    uint32_t hold_ms;               ///< Time left to hold at the start of a pass.
+
+    std::string text;               ///< The rendered text.
+    std::string pending;            ///< Text set since the last render.
+    bool dirty;                     ///< True if pending differs from text.
+    Stats stats;                    ///< The statistics.
+    SemaphoreHandle_t mtx;          ///< Mutex for pending, dirty and the statistics.
+};
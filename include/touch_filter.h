@@ -0,0 +1,98 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+*
+* @brief Filtering and buffering of touch samples between the sampler and LVGL's read callback.
+*
+* A batch of raw readings is reduced to one sample by taking the median of each coordinate,
+* which drops the single outliers resistive panels produce when the pen lands or lifts. Samples
+* are queued in a small ring that the read callback drains; when it is full the oldest sample
+* is overwritten, so LVGL always ends up at the latest position. tools/touch_filter_check.cpp
+* runs both on a drag or a capture of readings.
+*
+*/
+namespace touch {
+
+    struct Sample {
+        int16_t x;                  ///< Calibrated x.
+        int16_t y;                  ///< Calibrated y.
+        bool pressed;               ///< True while the pen is down.
+        int64_t time_us;            ///< Time the batch was read.
+    };
+
+    /**
+     * @brief      Gets the median of a batch of readings. Reorders the readings.
+     *
+     * @param[in]  values  The readings, not empty.
+     *
+     * @return The median, the upper one for an even count.
+     */
+    constexpr int16_t median(std::span<int16_t> values) {
+        auto mid = values.begin() + values.size() / 2;
+        std::nth_element(values.begin(), mid, values.end());
+        return *mid;
+    }
+
+    template<size_t N>
+    class Ring {
+    public:
+        static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+        /**
+         * @brief      Adds a sample, overwriting the oldest one if the ring is full.
+         *
+         * @param[in]  sample  The sample.
+         */
+        void push(const Sample& sample) {
+            if(tail - head == N) {
+                head++;
+                dropped++;
+            }
+
+            samples[tail++ % N] = sample;
+        }
+
+        /**
+         * @brief      Takes the oldest sample.
+         *
+         * @param[out]  sample  The sample.
+         *
+         * @return
+         *  - True if there was a sample
+         *  - False if the ring is empty
+         */
+        bool pop(Sample& sample) {
+            if(head == tail) {
+                return false;
+            }
+
+            sample = samples[head++ % N];
+            return true;
+        }
+
+        bool empty() const {
+            return head == tail;
+        }
+
+        uint32_t getDropped() const {
+            return dropped;
+        }
+
+    private:
+        std::array<Sample, N> samples{};  ///< The samples, indexed modulo N.
+        uint32_t head = 0;                ///< Index of the oldest sample.
+        uint32_t tail = 0;                ///< Index after the newest sample.
+        uint32_t dropped = 0;             ///< Samples overwritten before being read.
+    };
+
+    static_assert([] {
+        std::array<int16_t, 5> values = {9, 1, 300, 4, 5};
+        return median(values) == 5;
+    }());
+
+}
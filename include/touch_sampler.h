@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "lvgl.h"
+#include "touch_filter.h"
+
+class LGFX;
+class PanelFlush;
+
+/**
+*
+* @brief Samples the XPT2046 touch controller in the gaps between panel transfers.
+*
+* The touch controller shares SPI2_HOST with the panel, and each reading at 1 MHz holds the bus
+* for several hundred microseconds. Instead of reading it on every LVGL input read, a timer
+* on the LVGL task samples it between refreshes. Each frame releases the bus when its last
+* transfer is done (see PanelFlush), the sampler doesn't close transactions for it:
+*
+* - With the pen IRQ wired (TOUCH_IRQ_PIN), the bus is only used after the pin fell and while
+*   the pen stays down. A released pen costs a pin read per period.
+* - Without it, the controller is polled every poll_period_ms with a single reading.
+*
+* While the pen is down a batch is read every pressed_period_ms.
+*
+* Each sample is the median of a batch of readings, queued in a ring. The input device is
+* switched to event mode and read right after a sample is queued; its read callback only
+* drains the ring. All methods except the interrupt handler must be called from the LVGL task.
+*
+*/
+class TouchSampler {
+public:
+    static constexpr uint32_t irq_period_ms = 10;      ///< Period of the pen IRQ checks, which don't use the bus.
+    static constexpr uint32_t pressed_period_ms = 20;  ///< Sampling period while the pen is down.
+    static constexpr uint32_t poll_period_ms = 30;     ///< Polling period without the pen IRQ.
+    static constexpr size_t batch_size = 3;            ///< Readings per sample.
+    static constexpr size_t ring_size = 8;             ///< Samples queued for the read callback.
+
+    using PenListener = void (*)(void* arg);    ///< Called from the interrupt handler, must be in IRAM.
+
+    struct Stats {
+        uint32_t wakeups;           ///< Pen IRQs, or polls without the IRQ.
+        uint32_t batches;           ///< Batches read from the controller.
+        uint32_t readings;          ///< Readings taken, each holding the bus.
+        uint32_t presses;           ///< Touches reported to LVGL.
+        uint32_t dropped;           ///< Samples overwritten before LVGL read them.
+        int64_t bus_us;             ///< Time spent reading the controller.
+        int64_t avg_latency_us;     ///< Average time from a touch to LVGL reading it as pressed.
+        int64_t max_latency_us;     ///< Longest such time.
+    };
+
+    /**
+     * @brief Constructor for TouchSampler class. Takes over the input device's read callback.
+     *
+     * @param[in]  tft      The panel, already initialized with the touch calibration.
+     * @param[in]  flush    The flush sending to the panel.
+     * @param[in]  indev    The pointer input device.
+     * @param[in]  irq_pin  The GPIO of the pen IRQ, or -1 if not connected.
+     */
+    TouchSampler(LGFX& tft, PanelFlush& flush, lv_indev_t* indev, int irq_pin);
+
+    /**
+     * @brief Destructor for TouchSampler class.
+     *
+     */
+    ~TouchSampler();
+
+    /**
+     * @brief  Gets the sampling statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats() const;
+
+    /**
+     * @brief      Sets a listener told about the first pen IRQ of a touch, e.g. to wake the screen.
+     *             Only called with the pen IRQ wired.
+     *
+     * @param[in]  listener  The listener, or nullptr to remove it.
+     * @param[in]  arg       The argument passed to it.
+     */
+    void setPenListener(PenListener listener, void* arg);
+
+    /**
+     * @brief  Checks for the pen outside of the sampling, e.g. while LVGL is stopped. With the pen
+     *         IRQ this reads the pin, without it a reading holds the bus.
+     *
+     * @return True if the pen is down.
+     */
+    bool isPenDown();
+
+    /**
+     * @brief  Checks whether the pen IRQ is wired and attached.
+     *
+     * @return True if the pen is reported by the interrupt, false if it's polled.
+     */
+    bool hasPenIrq() const;
+
+    /**
+     * @brief      Lets the pen IRQ wake the chip from light sleep, e.g. while the screen is blank.
+     *             Light sleep needs a level wakeup, so the pin is switched to a low level while
+     *             enabled and back to the falling edge when disabled. The interrupt handler
+     *             switches it back as well, as the level would fire until the pen lifts. Does
+     *             nothing without the pen IRQ.
+     *
+     * @param[in]  enable  True to wake on the pen, false to stop.
+     */
+    void setSleepWakeup(bool enable);
+
+    static void read_cb_dummy(lv_indev_t* indev, lv_indev_data_t* data);
+    void read_cb(lv_indev_data_t* data);
+    static void timer_cb_dummy(lv_timer_t* timer);
+    void timer_cb();
+    static void pen_isr_dummy(void* arg);
+
+private:
+
+    bool pen_maybe_down();
+    bool read_batch(touch::Sample& sample);
+    void queue(const touch::Sample& sample);
+
+    LGFX& tft;                      ///< The panel owning the touch controller.
+    PanelFlush& flush;              ///< Finished before the bus is used.
+    lv_indev_t* indev;              ///< The input device fed from the ring.
+    lv_timer_t* timer;              ///< Samples the controller.
+    int irq_pin;                    ///< The pen IRQ GPIO, or -1.
+    std::atomic<bool> pen_irq;      ///< Set by the interrupt when the pin falls.
+    std::atomic<bool> sleep_wakeup; ///< The pin is set to the low level to wake from light sleep.
+    std::atomic<PenListener> pen_listener;  ///< Told about the pen IRQs, or nullptr.
+    void* pen_listener_arg;         ///< The argument of the listener.
+    int64_t pen_irq_us;             ///< Time of the interrupt, valid while pen_irq is set.
+    int64_t touch_start_us;         ///< Time the current touch began, 0 if not yet reported.
+    touch::Sample queued;           ///< Last sample queued.
+    touch::Sample last;             ///< Last sample read by LVGL.
+    touch::Ring<ring_size> ring;    ///< Samples waiting for the read callback.
+    int64_t latency_total_us;       ///< Sum of the reported latencies.
+    Stats stats;                    ///< The statistics.
+};
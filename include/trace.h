@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Binary event trace recorder.
+*
+* Events are written with their cycle count into a ring per core without taking a lock.
+* A background task drains the rings over the console as text lines, which tools/trace_export.py
+* turns into Chrome trace JSON (chrome://tracing, ui.perfetto.dev). Without CONFIG_TRACE every
+* call compiles to nothing.
+*
+*/
+namespace trace {
+
+    enum class Id : uint8_t {
+        HttpRequest,            ///< HttpClient::request, from connecting to the last byte.
+        HttpConnected,          ///< Connection established.
+        HttpHeaderSent,         ///< Request headers sent.
+        HttpFinish,             ///< Response complete.
+        HttpBytes,              ///< Response bytes received so far.
+        LvglRender,             ///< LVGL refresh, from REFR_START to REFR_READY.
+        LvglFlush,              ///< Display flush callback.
+        TouchRead,              ///< Touch controller read.
+        JsonParse,              ///< cJSON parsing of a response.
+        Count
+    };
+
+    enum class Type : uint8_t {
+        Begin,
+        End,
+        Instant,
+        Counter,
+        Sync                    ///< Pairs the cycle count with esp_timer time, written by the drain task.
+    };
+
+#if CONFIG_TRACE
+    /**
+     * @brief      Records an event on the calling core. Safe from tasks and ISRs.
+     *
+     * @param[in]  type   The event type.
+     * @param[in]  id     The event id.
+     * @param[in]  value  The counter value, 0 for other types.
+     */
+    void record(Type type, Id id, int32_t value);
+
+    /**
+     * @brief Starts the task draining the rings.
+     *
+     */
+    void init();
+#else
+    inline void record(Type type, Id id, int32_t value) {}
+
+    inline void init() {}
+#endif
+
+    inline void begin(Id id) {
+        record(Type::Begin, id, 0);
+    }
+
+    inline void end(Id id) {
+        record(Type::End, id, 0);
+    }
+
+    inline void instant(Id id) {
+        record(Type::Instant, id, 0);
+    }
+
+    inline void counter(Id id, int32_t value) {
+        record(Type::Counter, id, value);
+    }
+
+    /**
+    *
+    * @brief Records a begin event on construction and the matching end event on destruction.
+    *
+    */
+    class Scope {
+    public:
+        explicit Scope(Id id) : id(id) {
+            begin(id);
+        }
+
+        ~Scope() {
+            end(id);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Id id;  ///< The event id.
+    };
+
+}
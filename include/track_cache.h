@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "string_pool.h"
+#include "spotify_client.h"
+
+/**
+*
+* @brief Bounded LRU cache of track metadata keyed by track URI.
+*
+* Entries are kept as a struct of arrays, with every string interned in a shared
+* StringPool so tracks of the same album or artist share their strings. Lookups
+* that miss are gathered and fetched in batches instead of one request per track.
+*
+*/
+class TrackCache {
+public:
+    static constexpr size_t capacity = 256;    ///< Maximum number of cached tracks.
+    static constexpr size_t max_batch = 50;    ///< Maximum number of tracks per batch request.
+
+    /**
+     * @brief Fetches up to max_batch tracks by URI in a single request. Tracks may be returned in any order.
+     */
+    using BatchFetcher = std::function<bool(const std::vector<std::string>& uris, std::vector<spotify::Track>& tracks)>;
+
+    struct Stats {
+        uint32_t hits;              ///< Lookups answered from the cache.
+        uint32_t misses;            ///< Lookups that had to be fetched.
+        uint32_t pages;             ///< Pages resolved, each fetched with one request before the cache.
+        uint32_t batch_requests;    ///< Batch requests sent for the misses.
+        uint32_t requests;          ///< Requests sent for the resolved pages, the page of URIs and its batches.
+        int32_t requests_saved;     ///< Requests saved compared to one request per page, negative while cold.
+        uint32_t entries;           ///< Tracks currently cached.
+        size_t string_bytes;        ///< Bytes used in the string pool.
+    };
+
+    /**
+     * @brief Constructor for TrackCache class.
+     *
+     * @param[in]  fetcher  Fetches the tracks that miss.
+     */
+    TrackCache(BatchFetcher fetcher);
+
+    /**
+     * @brief Destructor for TrackCache class.
+     *
+     */
+    ~TrackCache();
+
+    /**
+     * @brief      Adds or refreshes a track. Tracks without a URI are ignored.
+     *
+     * @param[in]  track  The track.
+     */
+    void insert(const spotify::Track& track);
+
+    /**
+     * @brief      Looks a track up without fetching it.
+     *
+     * @param[in]   uri    The track URI.
+     * @param[out]  track  The cached metadata. Progress and response code are left untouched.
+     *
+     * @return
+     *  - True if the track is cached
+     *  - False otherwise
+     */
+    bool lookup(std::string_view uri, spotify::Track& track);
+
+    /**
+     * @brief      Gets the metadata of a list of tracks, fetching the misses in batches.
+     *
+     *             Tracks that could not be fetched only have their URI set. Each call counts
+     *             as one page, whose URIs were fetched with one request.
+     *
+     * @param[in]   uris    The track URIs.
+     * @param[out]  tracks  The tracks, in the order of uris.
+     *
+     * @return
+     *  - True if every track was resolved
+     *  - False otherwise
+     */
+    bool resolve(const std::vector<std::string>& uris, std::vector<spotify::Track>& tracks);
+
+    /**
+     * @brief  Gets the cache statistics.
+     *
+     * @return The statistics.
+     */
+    Stats getStats();
+
+private:
+
+    using Slot = uint16_t;
+
+    static constexpr Slot no_slot = 0xFFFF;
+    static constexpr size_t bucket_count = 128;
+
+    Slot find(std::string_view uri, uint32_t hash);
+    Slot allocate();
+    void unlink(Slot slot);
+    void push_front(Slot slot);
+    void read(Slot slot, spotify::Track& track);
+
+    //Struct of arrays, indexed by slot.
+    std::array<uint32_t, capacity> uri_hashes;
+    std::array<StringPool::Id, capacity> uris;
+    std::array<StringPool::Id, capacity> names;
+    std::array<StringPool::Id, capacity> album_names;
+    std::array<StringPool::Id, capacity> album_pic_urls;
+    std::array<StringPool::Id, capacity> artists;   ///< Artist names joined by '\n'.
+    std::array<int32_t, capacity> durations_ms;
+    std::array<Slot, capacity> lru_prev;
+    std::array<Slot, capacity> lru_next;            ///< Next in LRU order, or the next free slot.
+    std::array<Slot, capacity> bucket_next;
+
+    std::array<Slot, bucket_count> buckets;         ///< First slot of each URI hash bucket.
+    Slot lru_head;                                  ///< Most recently used slot.
+    Slot lru_tail;                                  ///< Least recently used slot.
+    Slot free_head;                                 ///< First unused slot.
+    uint32_t count;                                 ///< Number of used slots.
+
+    StringPool strings;                             ///< Storage for every string of the cache.
+    BatchFetcher fetcher;                           ///< Fetches the misses.
+    Stats stats;                                    ///< The cache statistics.
+    SemaphoreHandle_t mtx;                          ///< Mutex for the cache.
+};
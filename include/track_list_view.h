@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "lvgl.h"
+#include "spotify_client.h"
+
+/**
+*
+* @brief Scrollable list of tracks that only materializes the visible rows.
+*
+* A fixed set of row widgets is recycled as the list scrolls, and at most a fixed
+* number of pages of tracks are held in memory. Pages are fetched by a background
+* task, ahead of the scroll direction, so memory stays bounded however long the list is.
+*
+* All methods must be called with the LVGL lock held.
+*
+*/
+class TrackListView {
+public:
+    /**
+     * @brief Fetches a page of tracks. Called from the fetch task, without the LVGL lock held.
+     */
+    using PageFetcher = std::function<bool(int offset, int limit, spotify::TrackPage& page)>;
+
+    struct Stats {
+        uint32_t frames;            ///< Frames rendered during the last scroll.
+        int64_t avg_frame_us;       ///< Average render and flush time of those frames.
+        int64_t max_frame_us;       ///< Longest render and flush time of those frames.
+        uint32_t pages_fetched;     ///< Pages fetched since the source was set.
+        size_t min_free_heap;       ///< Lowest free heap seen since boot.
+    };
+
+    /**
+     * @brief Constructor for TrackListView class.
+     *
+     * @param[in]  parent  The parent object.
+     * @param[in]  width   The list width.
+     * @param[in]  height  The list height.
+     */
+    TrackListView(lv_obj_t* parent, int32_t width, int32_t height);
+
+    /**
+     * @brief Destructor for TrackListView class.
+     *
+     */
+    ~TrackListView();
+
+    /**
+     * @brief      Replaces the tracks shown and scrolls back to the top.
+     *
+     * @param[in]  fetcher  Fetches the pages of the new list.
+     */
+    void setSource(PageFetcher fetcher);
+
+    /**
+     * @brief  Gets the list object, e.g. to align it.
+     *
+     * @return The list object.
+     */
+    lv_obj_t* getObj();
+
+    /**
+     * @brief  Gets the statistics of the last scroll.
+     *
+     * @return The scroll statistics.
+     */
+    Stats getStats();
+
+    static void fetch_task_dummy(void *arg);
+    void fetch_task();
+
+private:
+
+    static constexpr int32_t row_height = 44;  ///< Height of one row in pixels.
+    static constexpr int row_count = 10;       ///< Materialized rows, the viewport plus a margin.
+    static constexpr int page_size = 20;       ///< Tracks per fetched page.
+    static constexpr int page_slots = 4;       ///< Pages held in memory.
+
+    enum class PageState {
+        Empty,
+        Loading,
+        Ready
+    };
+
+    struct PageSlot {
+        int page;                   ///< The page index held by the slot.
+        PageState state;            ///< The slot state.
+        spotify::TrackPage data;    ///< The tracks, once ready.
+    };
+
+    struct Row {
+        lv_obj_t* obj;              ///< The row container.
+        lv_obj_t* title;            ///< The track name label.
+        lv_obj_t* artist;           ///< The artists label.
+        int index;                  ///< The index of the track bound to the row, -1 if none.
+    };
+
+    struct FetchRequest {
+        int page;                   ///< The page to fetch.
+        uint32_t generation;        ///< The source generation the request belongs to.
+    };
+
+    static void scroll_event_cb(lv_event_t* e);
+    static void refr_event_cb(lv_event_t* e);
+
+    void bind_rows(bool force);
+    void bind_row(Row& row, int index);
+    PageSlot* find_page(int page);
+    void request_page(int page);
+    void set_total(int new_total);
+
+    lv_obj_t* list;                 ///< The scrollable container.
+    lv_obj_t* spacer;               ///< Gives the container the height of the whole list.
+    std::array<Row, row_count> rows;
+    std::array<PageSlot, page_slots> pages;
+
+    PageFetcher fetcher;            ///< Fetches the pages of the current source.
+    uint32_t generation;            ///< Incremented by setSource so stale pages are dropped.
+    int total;                      ///< The number of tracks in the list, -1 until known.
+    int first_index;                ///< The index of the first materialized row.
+    int32_t last_scroll_y;          ///< Scroll position at the previous scroll event.
+    int direction;                  ///< 1 when scrolling down, -1 when scrolling up.
+
+    bool scrolling;                 ///< True between scroll begin and end.
+    int64_t frame_start_us;         ///< Start of the frame being rendered.
+    int64_t frame_total_us;         ///< Sum of the frame times of the current scroll.
+    Stats stats;                    ///< Statistics of the last scroll.
+
+    QueueHandle_t fetch_queue;      ///< Pages waiting to be fetched.
+    TaskHandle_t task_handle;       ///< Task fetching the pages.
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include "sdkconfig.h"
+
+/**
+*
+* @brief Headless render benchmark of UI scenes.
+*
+* Each scene is built on an off-screen display whose flush only counts bytes, and LVGL is
+* stepped with a simulated clock. CPU time per frame and the bytes a real flush would send
+* per second are reported as the "ui" suite of the boot benchmarks, so rendering alternatives
+* can be compared on the device without the panel's SPI time in the numbers.
+*
+*/
+namespace ui_bench {
+
+#if CONFIG_BOOT_BENCHMARKS
+    /**
+     * @brief Runs the scenes. Must be called after lv_init and before the real display is created.
+     *
+     */
+    void run();
+#else
+    inline void run() {}
+#endif
+
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+/**
+*
+* @brief NUL-terminated string in a fixed-size buffer, for building request lines without the heap.
+*
+* Appending past the capacity truncates and marks the string, so callers build first and
+* check ok() once before using the result.
+*
+*/
+template<size_t N>
+class FixedString {
+public:
+    static_assert(N > 1, "FixedString needs room for at least one character");
+
+    FixedString() : len(0), truncated(false) {
+        buf[0] = 0;
+    }
+
+    /**
+     * @brief      Appends a string.
+     *
+     * @param[in]  str   The string.
+     *
+     * @return This string, to chain calls.
+     */
+    FixedString& append(std::string_view str) {
+        size_t count = str.size();
+
+        if(count > N - 1 - len) {
+            count = N - 1 - len;
+            truncated = true;
+        }
+
+        std::memcpy(buf.data() + len, str.data(), count);
+        len += count;
+        buf[len] = 0;
+        return *this;
+    }
+
+    /**
+     * @brief      Appends a character.
+     *
+     * @param[in]  c     The character.
+     *
+     * @return This string, to chain calls.
+     */
+    FixedString& append(char c) {
+        return append(std::string_view(&c, 1));
+    }
+
+    /**
+     * @brief      Appends an integer in decimal.
+     *
+     * @param[in]  value  The integer.
+     *
+     * @return This string, to chain calls.
+     */
+    FixedString& append(long long value) {
+        char digits[24];
+        int count = snprintf(digits, sizeof(digits), "%lld", value);
+        return append(std::string_view(digits, count));
+    }
+
+    FixedString& append(int value) {
+        return append(static_cast<long long>(value));
+    }
+
+    /**
+     * @brief  Checks that nothing was truncated.
+     *
+     * @return
+     *  - True if every append fit
+     *  - False otherwise
+     */
+    bool ok() const {
+        return !truncated;
+    }
+
+    const char* c_str() const {
+        return buf.data();
+    }
+
+    std::string_view view() const {
+        return std::string_view(buf.data(), len);
+    }
+
+    size_t size() const {
+        return len;
+    }
+
+    static constexpr size_t capacity() {
+        return N - 1;
+    }
+
+protected:
+
+    std::array<char, N> buf;    ///< The characters and the terminating NUL.
+    size_t len;                 ///< Number of characters, without the NUL.
+    bool truncated;             ///< True once an append did not fit.
+};
+
+/**
+*
+* @brief FixedString that adds percent-encoded query parameters.
+*
+*/
+template<size_t N>
+class UrlBuilder : public FixedString<N> {
+public:
+    /**
+     * @brief      Appends a query parameter, starting the query if the URL has none yet.
+     *
+     * @param[in]  key    The parameter name, appended as is.
+     * @param[in]  value  The value, percent-encoded.
+     *
+     * @return This builder, to chain calls.
+     */
+    UrlBuilder& query(std::string_view key, std::string_view value) {
+        this->append(this->view().find('?') == std::string_view::npos ? '?' : '&');
+        this->append(key);
+        this->append('=');
+
+        static constexpr char hex[] = "0123456789ABCDEF";
+
+        for(char c : value) {
+            auto byte = static_cast<unsigned char>(c);
+
+            //RFC 3986 unreserved characters, everything else is escaped.
+            if((byte >= 'A' && byte <= 'Z') || (byte >= 'a' && byte <= 'z') || (byte >= '0' && byte <= '9') ||
+               byte == '-' || byte == '.' || byte == '_' || byte == '~') {
+                this->append(c);
+            }
+
+            else {
+                const char escaped[3] = {'%', hex[byte >> 4], hex[byte & 0xF]};
+                this->append(std::string_view(escaped, sizeof(escaped)));
+            }
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief      Appends an integer query parameter, starting the query if the URL has none yet.
+     *
+     * @param[in]  key    The parameter name.
+     * @param[in]  value  The value.
+     *
+     * @return This builder, to chain calls.
+     */
+    UrlBuilder& query(std::string_view key, long long value) {
+        char digits[24];
+        int count = snprintf(digits, sizeof(digits), "%lld", value);
+        return query(key, std::string_view(digits, count));
+    }
+
+    UrlBuilder& query(std::string_view key, int value) {
+        return query(key, static_cast<long long>(value));
+    }
+};
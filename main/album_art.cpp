@@ -0,0 +1,348 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "album_art.h"
+#include "freertos/semphr.h"
+#include "deferred_log.h"
+#include "esp_timer.h"
+#include "mem_pool.h"
+#include "esp32s3/rom/tjpgd.h"
+#include <algorithm>
+#include <cstring>
+
+static const char* TAG = "AlbumArt";
+
+//Recommended work area size of TJpgDec.
+static constexpr size_t jpeg_work_size = 3100;
+
+//Wait after a track change before prefetching, so the change itself gets the network first.
+static constexpr uint32_t prefetch_delay_ms = 2000;
+
+//The queue can change without a track change, so the prediction is refreshed periodically.
+static constexpr uint32_t prefetch_refresh_ms = 30000;
+
+//Every palette_step-th pixel of every palette_step-th row goes into the palette.
+static constexpr int palette_step = 2;
+
+struct JpegSource {
+    const uint8_t* data;    ///< The JPEG file.
+    size_t size;            ///< The size of the JPEG file.
+    size_t pos;             ///< Read position.
+    uint16_t* pixels;       ///< The RGB565 output.
+    uint16_t width;         ///< The output width.
+    PaletteExtractor* palette;  ///< Gets the output rows.
+};
+
+static uint32_t jpeg_input(JDEC* jd, uint8_t* buf, uint32_t len) {
+    auto src = static_cast<JpegSource*>(jd->device);
+    len = std::min<uint32_t>(len, src->size - src->pos);
+
+    //A null buffer means the data is skipped.
+    if(buf != nullptr) {
+        std::memcpy(buf, src->data + src->pos, len);
+    }
+
+    src->pos += len;
+    return len;
+}
+
+static uint32_t jpeg_output(JDEC* jd, void* bitmap, JRECT* rect) {
+    auto src = static_cast<JpegSource*>(jd->device);
+    auto rgb = static_cast<const uint8_t*>(bitmap);
+
+    for(int y = rect->top; y <= rect->bottom; y++) {
+        uint16_t* row = src->pixels + y * src->width;
+
+        for(int x = rect->left; x <= rect->right; x++) {
+            row[x] = ((rgb[0] & 0xF8) << 8) | ((rgb[1] & 0xFC) << 3) | (rgb[2] >> 3);
+            rgb += 3;
+        }
+
+        //Blocks start at multiples of 8, so the sampled pixels form a regular grid.
+        if(y % palette_step == 0) {
+            src->palette->addRow(row + rect->left, rect->right - rect->left + 1, palette_step);
+        }
+    }
+
+    return 1;
+}
+
+AlbumArt::AlbumArt(lv_obj_t* parent, spotify::Client& client, PlayerStore& store)
+    : client(client),
+      active(0),
+      work(std::make_unique<uint8_t[]>(jpeg_work_size)),
+      pending_changed_us(0),
+      repaint_changed_us(0),
+      repaint_prefetched(false),
+      prefetched_total_us(0),
+      fetched_total_us(0),
+      stats{},
+      task_handle(nullptr) {
+
+    for(auto& buffer : buffers) {
+        //Prefer PSRAM for the images and leave internal RAM to the network stack.
+        buffer.pixels = static_cast<uint16_t*>(mem::allocate(max_size * max_size * sizeof(uint16_t), mem::Region::Psram));
+        buffer.dsc = lv_image_dsc_t{};
+        buffer.palette = {};
+    }
+
+    mtx = xSemaphoreCreateMutex();
+
+    image = lv_image_create(parent);
+    lv_obj_set_size(image, max_size, max_size);
+    lv_obj_add_flag(image, LV_OBJ_FLAG_EVENT_BUBBLE);
+
+    lv_display_add_event_cb(lv_display_get_default(), refr_event_cb, LV_EVENT_REFR_READY, this);
+
+    xTaskCreatePinnedToCore(art_task_dummy,
+                            "Album Art",
+                            6144,
+                            this,
+                            1,
+                            &task_handle,
+                            CONFIG_DECODE_TASK_CORE);
+
+    store.subscribe([this](const spotify::Track& track, int64_t changed_us) {
+        xSemaphoreTake(mtx, portMAX_DELAY);
+        pending = track;
+        pending_changed_us = changed_us;
+        xSemaphoreGive(mtx);
+
+        xTaskNotifyGive(task_handle);
+    });
+}
+
+AlbumArt::~AlbumArt() {
+    vTaskDelete(task_handle);
+    lv_display_remove_event_cb_with_user_data(lv_display_get_default(), refr_event_cb, this);
+    lv_obj_delete(image);
+    vSemaphoreDelete(mtx);
+
+    for(auto& buffer : buffers) {
+        mem::deallocate(buffer.pixels);
+    }
+}
+
+lv_obj_t* AlbumArt::getObj() {
+    return image;
+}
+
+void AlbumArt::setPaletteListener(std::function<void(const Palette&)> listener) {
+    palette_listener = std::move(listener);
+}
+
+AlbumArt::Stats AlbumArt::getStats() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    Stats out = stats;
+    xSemaphoreGive(mtx);
+
+    return out;
+}
+
+void AlbumArt::refr_event_cb(lv_event_t* e) {
+    auto art = static_cast<AlbumArt*>(lv_event_get_user_data(e));
+
+    if(art->repaint_changed_us == 0) {
+        return;
+    }
+
+    int64_t repaint_us = esp_timer_get_time() - art->repaint_changed_us;
+    bool prefetched = art->repaint_prefetched;
+    art->repaint_changed_us = 0;
+
+    xSemaphoreTake(art->mtx, portMAX_DELAY);
+    Stats& stats = art->stats;
+    stats.changes++;
+    stats.last_repaint_us = repaint_us;
+
+    if(prefetched) {
+        stats.prefetch_hits++;
+        art->prefetched_total_us += repaint_us;
+        stats.avg_prefetched_us = art->prefetched_total_us / stats.prefetch_hits;
+    }
+
+    else {
+        art->fetched_total_us += repaint_us;
+        stats.avg_fetched_us = art->fetched_total_us / (stats.changes - stats.prefetch_hits);
+    }
+    xSemaphoreGive(art->mtx);
+
+    DLOGI(TAG, "Track change to repaint: %lld us (%s)", repaint_us, prefetched ? "prefetched" : "not prefetched");
+}
+
+bool AlbumArt::decode(const mem::Buffer& jpg, Buffer& buffer) {
+    JpegSource src = {
+        .data = reinterpret_cast<const uint8_t*>(jpg.data()),
+        .size = jpg.size(),
+        .pos = 0,
+        .pixels = buffer.pixels,
+        .width = 0,
+        .palette = &palette_extractor
+    };
+    JDEC jd;
+
+    if(jd_prepare(&jd, jpeg_input, work.get(), jpeg_work_size, &src) != JDR_OK) {
+        DLOGE(TAG, "Not a supported JPEG");
+        return false;
+    }
+
+    //Use the smallest downscaling (1/1 to 1/8) that fits the buffer.
+    uint8_t scale = 0;
+
+    while(scale < 3 && ((jd.width >> scale) > max_size || (jd.height >> scale) > max_size)) {
+        scale++;
+    }
+
+    uint16_t width = jd.width >> scale;
+    uint16_t height = jd.height >> scale;
+
+    if(width > max_size || height > max_size) {
+        DLOGE(TAG, "JPEG too large: %dx%d", jd.width, jd.height);
+        return false;
+    }
+
+    src.width = width;
+    palette_extractor.reset();
+
+    if(jd_decomp(&jd, jpeg_output, scale) != JDR_OK) {
+        DLOGE(TAG, "JPEG decoding failed");
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    buffer.palette = palette_extractor.finish();
+    int64_t palette_us = esp_timer_get_time() - start_us;
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    stats.last_palette_us = palette_us;
+    xSemaphoreGive(mtx);
+
+    DLOGD(TAG, "Palette: background %06lx, accent %06lx from %lu pixels in %lld us", buffer.palette.background,
+          buffer.palette.accent, palette_extractor.getStats().pixels, palette_us);
+
+    buffer.dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    buffer.dsc.header.cf = LV_COLOR_FORMAT_RGB565;
+    buffer.dsc.header.w = width;
+    buffer.dsc.header.h = height;
+    buffer.dsc.header.stride = width * sizeof(uint16_t);
+    buffer.dsc.data_size = width * height * sizeof(uint16_t);
+    buffer.dsc.data = reinterpret_cast<const uint8_t*>(buffer.pixels);
+
+    return true;
+}
+
+bool AlbumArt::load(const std::string& url, Buffer& buffer) {
+    mem::Buffer jpg;
+
+    //The standby buffer is not on screen, only LVGL's cached view of it needs dropping.
+    lv_lock();
+    lv_image_cache_drop(&buffer.dsc);
+    lv_unlock();
+
+    buffer.url.clear();
+
+    if(buffer.pixels == nullptr || url.empty() || !http_client.get(url.c_str(), jpg)) {
+        DLOGE(TAG, "Couldn't download album art");
+        return false;
+    }
+
+    if(!decode(jpg, buffer)) {
+        return false;
+    }
+
+    buffer.url = url;
+    return true;
+}
+
+bool AlbumArt::predict_next(const spotify::Track& current, std::string& url) {
+    //Repeating the track plays the same cover again.
+    if(client.getRepeatState() == spotify::RepeatState::Track) {
+        url = current.album_pic_url;
+        return true;
+    }
+
+    //The queue already follows the shuffled order when shuffle is on.
+    spotify::TrackPage queue;
+
+    if(!client.getQueue(queue) || queue.items.empty()) {
+        return false;
+    }
+
+    url = queue.items.front().album_pic_url;
+    return true;
+}
+
+void AlbumArt::show(int index, int64_t changed_us, bool prefetched) {
+    lv_lock();
+    active = index;
+    lv_image_set_src(image, &buffers[index].dsc);
+    //Lets a StaticLayer holding the image compose it again.
+    lv_obj_send_event(image, LV_EVENT_REFRESH, nullptr);
+
+    if(palette_listener) {
+        palette_listener(buffers[index].palette);
+    }
+
+    repaint_changed_us = changed_us;
+    repaint_prefetched = prefetched;
+    lv_unlock();
+}
+
+void AlbumArt::art_task_dummy(void *arg) {
+    auto obj = static_cast<AlbumArt*>(arg);
+    obj->art_task();
+}
+
+void AlbumArt::art_task() {
+    bool prefetch_due = false;
+
+    while(1) {
+        uint32_t wait_ms = prefetch_due ? prefetch_delay_ms : prefetch_refresh_ms;
+
+        if(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms)) > 0) {
+            xSemaphoreTake(mtx, portMAX_DELAY);
+            std::string url = pending.album_pic_url;
+            int64_t changed_us = pending_changed_us;
+            xSemaphoreGive(mtx);
+
+            int standby = 1 - active;
+
+            if(url == buffers[active].url) {
+                //Same album, nothing to repaint.
+            }
+
+            else if(url == buffers[standby].url) {
+                show(standby, changed_us, true);
+            }
+
+            else if(load(url, buffers[standby])) {
+                show(standby, changed_us, false);
+            }
+
+            prefetch_due = true;
+            continue;
+        }
+
+        prefetch_due = false;
+
+        xSemaphoreTake(mtx, portMAX_DELAY);
+        spotify::Track current = pending;
+        xSemaphoreGive(mtx);
+
+        std::string next_url;
+
+        if(current.uri.empty() || !predict_next(current, next_url)) {
+            continue;
+        }
+
+        Buffer& standby = buffers[1 - active];
+
+        if(next_url.empty() || next_url == buffers[active].url || next_url == standby.url) {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+
+        if(load(next_url, standby)) {
+            DLOGI(TAG, "Prefetched next album art in %lld us", esp_timer_get_time() - start_us);
+        }
+    }
+}
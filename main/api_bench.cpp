@@ -0,0 +1,156 @@
+#include "api_bench.h"
+#include "bench.h"
+#include "cJSON.h"
+#include "esp_log.h"
+#include "http_client.h"
+#include "spotify_schema.h"
+#include "track_cache.h"
+#include "url_builder.h"
+#include "freertos/semphr.h"
+#include <string>
+#include <string_view>
+
+#if CONFIG_BOOT_BENCHMARKS
+
+//Recorded responses, embedded by main/CMakeLists.txt with a NUL at the end.
+extern const char currently_playing_track_start[] asm("_binary_currently_playing_track_json_start");
+extern const char currently_playing_track_end[] asm("_binary_currently_playing_track_json_end");
+extern const char currently_playing_episode_start[] asm("_binary_currently_playing_episode_json_start");
+extern const char currently_playing_episode_end[] asm("_binary_currently_playing_episode_json_end");
+
+namespace api_bench {
+
+    static const char* TAG = "ApiBench";
+
+    static constexpr uint32_t http_trials = 30;
+
+    static std::string_view payload(const char* start, const char* end) {
+        return std::string_view(start, end - start - 1);
+    }
+
+    static void run_http() {
+        std::string_view server = CONFIG_BENCH_SERVER_URL;
+
+        if(server.empty()) {
+            ESP_LOGI(TAG, "No benchmark server, skipping the http suite");
+            return;
+        }
+
+        HttpClient http_client;
+        mem::Buffer buff;
+        std::string queue_url = std::string(server) + "/v1/me/player/queue";
+        std::string page_url = std::string(server) + "/v1/playlists/mock/tracks?offset=0&limit=100";
+        size_t streamed = 0;
+
+        //Warming up also opens the connection, which is kept alive for the trials.
+        if(!http_client.get(queue_url.c_str(), buff)) {
+            ESP_LOGE(TAG, "The benchmark server at %s does not answer", CONFIG_BENCH_SERVER_URL);
+            return;
+        }
+
+        bench::Case queue("http", "get_queue", http_trials);
+
+        for(uint32_t i = 0; i < http_trials; i++) {
+            queue.start();
+            http_client.get(queue_url.c_str(), buff);
+            queue.stop();
+        }
+
+        queue.metric("body_bytes", buff.size());
+        queue.report();
+
+        bench::run("http", "get_playlist_page", [&] {
+            http_client.get(page_url.c_str(), buff);
+        }, http_trials);
+
+        bench::run("http", "stream_playlist_page", [&] {
+            streamed = 0;
+            http_client.stream(page_url.c_str(), [&streamed](const char*, size_t size) {
+                streamed += size;
+            });
+        }, http_trials);
+
+        ESP_LOGI(TAG, "Playlist page of %u bytes, %u streamed", static_cast<unsigned>(buff.size()), static_cast<unsigned>(streamed));
+    }
+
+    static void run_currently_playing() {
+        std::string_view track = payload(currently_playing_track_start, currently_playing_track_end);
+        std::string_view episode = payload(currently_playing_episode_start, currently_playing_episode_end);
+
+        bench::Result result = bench::run("currently_playing", "decode_track", [track] {
+            spotify::api::CurrentlyPlaying playing{};
+            json::decode(track, playing);
+        });
+
+        ESP_LOGI(TAG, "Decoded %u bytes at %.2f MB/s", static_cast<unsigned>(track.size()), track.size() / result.median_us);
+
+        bench::run("currently_playing", "decode_episode", [episode] {
+            spotify::api::CurrentlyPlaying playing{};
+            json::decode(episode, playing);
+        });
+
+        //The tree the client used to build, for reference.
+        bench::run("currently_playing", "cjson_parse_track", [track] {
+            cJSON_Delete(cJSON_ParseWithLength(track.data(), track.size()));
+        });
+    }
+
+    static void run_track() {
+        std::string_view text = payload(currently_playing_track_start, currently_playing_track_end);
+        spotify::api::CurrentlyPlaying playing{};
+        TrackCache track_cache([](const std::vector<std::string>&, std::vector<spotify::Track>&) { return false; });
+
+        json::decode(text, playing);
+        track_cache.insert(playing.track);
+
+        bench::run("track", "copy", [&playing] {
+            spotify::Track track = playing.track;
+        }, bench::default_trials, 10);
+
+        bench::run("track", "cache_lookup", [&track_cache, &playing] {
+            spotify::Track track;
+            track_cache.lookup(playing.track.uri, track);
+        }, bench::default_trials, 10);
+    }
+
+    static void run_token() {
+        //The length of the tokens Spotify hands out.
+        std::string access_token(260, 'x');
+        SemaphoreHandle_t mtx_token = xSemaphoreCreateMutex();
+        HttpClient http_client;
+        FixedString<512> bearer;
+
+        //What the requests reading a body do before setting the header.
+        bench::run("token", "bearer_string", [&] {
+            xSemaphoreTake(mtx_token, portMAX_DELAY);
+            std::string header = "Bearer " + access_token;
+            xSemaphoreGive(mtx_token);
+        }, bench::default_trials, 10);
+
+        //What Client::set_authorization does before setting the header.
+        bench::run("token", "bearer_fixed", [&] {
+            FixedString<512> header;
+            xSemaphoreTake(mtx_token, portMAX_DELAY);
+            header.append("Bearer ").append(access_token);
+            xSemaphoreGive(mtx_token);
+        }, bench::default_trials, 10);
+
+        bearer.append("Bearer ").append(access_token);
+
+        bench::run("token", "set_header", [&] {
+            http_client.setHeader("Authorization", bearer.c_str());
+        }, bench::default_trials, 10);
+
+        vSemaphoreDelete(mtx_token);
+    }
+
+    void run() {
+        run_currently_playing();
+        run_track();
+        run_token();
+        run_http();
+    }
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "base64_bench.h"
+#include "base64.h"
+#include "bench.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "mbedtls/base64.h"
+#include <algorithm>
+#include <vector>
+
+#if CONFIG_BOOT_BENCHMARKS
+
+namespace base64 {
+
+    static const char* TAG = "Base64Bench";
+
+    static constexpr size_t input_size = 3072;
+    static constexpr int iterations = 200;
+
+    static double megabytes_per_second(size_t bytes, const bench::Result& result) {
+        return result.median_us > 0 ? bytes / result.median_us : 0;
+    }
+
+    void benchmark() {
+        std::vector<uint8_t> input(input_size);
+        std::vector<char> encoded(encodedLength(input_size) + 1);
+        std::vector<uint8_t> decoded(decodedMaxLength(encoded.size()));
+        size_t written = 0;
+
+        esp_fill_random(input.data(), input.size());
+
+        bench::Result encode_result = bench::run("base64", "encode_3k", [&] {
+            encode(input, encoded, written);
+        }, iterations);
+
+        size_t encoded_len = written;
+
+        bench::Result decode_result = bench::run("base64", "decode_3k", [&] {
+            decode(std::span<const char>(encoded.data(), encoded_len), decoded, written);
+        }, iterations);
+
+        bool round_trip = written == input_size && std::equal(input.begin(), input.end(), decoded.begin());
+        auto encoded_bytes = reinterpret_cast<unsigned char*>(encoded.data());
+
+        bench::Result mbedtls_encode_result = bench::run("base64", "mbedtls_encode_3k", [&] {
+            mbedtls_base64_encode(encoded_bytes, encoded.size(), &written, input.data(), input.size());
+        }, iterations);
+
+        bench::Result mbedtls_decode_result = bench::run("base64", "mbedtls_decode_3k", [&] {
+            mbedtls_base64_decode(decoded.data(), decoded.size(), &written, encoded_bytes, encoded_len);
+        }, iterations);
+
+        ESP_LOGI(TAG, "%u bytes, round trip %s", static_cast<unsigned>(input_size), round_trip ? "ok" : "FAILED");
+        ESP_LOGI(TAG, "Encode %.2f MB/s, decode %.2f MB/s", megabytes_per_second(input_size, encode_result),
+                 megabytes_per_second(input_size, decode_result));
+        ESP_LOGI(TAG, "mbedTLS encode %.2f MB/s, decode %.2f MB/s", megabytes_per_second(input_size, mbedtls_encode_result),
+                 megabytes_per_second(input_size, mbedtls_decode_result));
+    }
+
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "bench.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_sys.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+#if CONFIG_HEAP_USE_HOOKS
+//The task whose allocations are counted, nullptr outside of a trial.
+static std::atomic<TaskHandle_t> measured_task = nullptr;
+static std::atomic<uint32_t> hook_allocations = 0;
+static std::atomic<uint32_t> hook_bytes = 0;
+
+//Called by the heap on every allocation, from any task.
+extern "C" void IRAM_ATTR esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {
+    TaskHandle_t task = measured_task.load(std::memory_order_relaxed);
+
+    if(task != nullptr && ptr != nullptr && xTaskGetCurrentTaskHandle() == task) {
+        hook_allocations.fetch_add(1, std::memory_order_relaxed);
+        hook_bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+extern "C" void IRAM_ATTR esp_heap_trace_free_hook(void* ptr) {
+}
+#endif
+
+#if CONFIG_BOOT_BENCHMARKS
+
+namespace bench {
+
+    Case::Case(const char* suite, const char* name, uint32_t trials, uint32_t batch)
+        : suite(suite),
+          name(name),
+          batch(std::max<uint32_t>(batch, 1)),
+          start_cycles(0),
+          allocations(0),
+          allocated_bytes(0),
+          metrics{},
+          metric_count(0) {
+
+        //Reserved up front, so recording doesn't allocate.
+        samples.reserve(trials);
+        start_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        heap_caps_monitor_local_minimum_free_size_start();
+    }
+
+    Case::~Case() {
+        heap_caps_monitor_local_minimum_free_size_stop();
+    }
+
+    void Case::start() {
+#if CONFIG_HEAP_USE_HOOKS
+        hook_allocations = 0;
+        hook_bytes = 0;
+        measured_task = xTaskGetCurrentTaskHandle();
+#endif
+        start_cycles = esp_cpu_get_cycle_count();
+    }
+
+    void Case::stop() {
+        end(true);
+    }
+
+    void Case::cancel() {
+        end(false);
+    }
+
+    void Case::end(bool record) {
+        uint32_t cycles = esp_cpu_get_cycle_count() - start_cycles;
+
+#if CONFIG_HEAP_USE_HOOKS
+        measured_task = nullptr;
+#endif
+
+        if(!record || samples.size() == samples.capacity()) {
+            return;
+        }
+
+        samples.push_back(cycles);
+
+#if CONFIG_HEAP_USE_HOOKS
+        allocations += hook_allocations;
+        allocated_bytes += hook_bytes;
+#endif
+    }
+
+    void Case::metric(const char* key, double value) {
+        if(metric_count < metrics.size()) {
+            metrics[metric_count++] = {key, value};
+        }
+    }
+
+    Result Case::report() {
+        Result result = {};
+        size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+        float cycles_per_op = static_cast<float>(esp_rom_get_cpu_ticks_per_us()) * batch;
+        uint32_t operations = samples.size() * batch;
+
+        result.trials = samples.size();
+        result.batch = batch;
+        result.peak_bytes = start_free > min_free ? start_free - min_free : 0;
+
+        if(!samples.empty()) {
+            std::sort(samples.begin(), samples.end());
+            result.median_us = samples[samples.size() / 2] / cycles_per_op;
+            result.p99_us = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] / cycles_per_op;
+            result.min_us = samples.front() / cycles_per_op;
+            result.allocations = static_cast<float>(allocations) / operations;
+            result.allocated_bytes = static_cast<float>(allocated_bytes) / operations;
+        }
+
+        //Printed at once, so the logs of other tasks don't split the line.
+        char line[512];
+        int length = snprintf(line, sizeof(line), "@B {\"suite\":\"%s\",\"case\":\"%s\",\"trials\":%lu,\"batch\":%lu,"
+                              "\"median_us\":%.3f,\"p99_us\":%.3f,\"min_us\":%.3f,",
+                              suite, name, static_cast<unsigned long>(result.trials), static_cast<unsigned long>(result.batch),
+                              result.median_us, result.p99_us, result.min_us);
+
+#if CONFIG_HEAP_USE_HOOKS
+        length += snprintf(line + length, sizeof(line) - length, "\"allocs\":%.2f,\"alloc_bytes\":%.1f,",
+                           result.allocations, result.allocated_bytes);
+#endif
+
+        length += snprintf(line + length, sizeof(line) - length, "\"peak_bytes\":%lu", static_cast<unsigned long>(result.peak_bytes));
+
+        for(size_t i = 0; i < metric_count; i++) {
+            length += snprintf(line + length, sizeof(line) - length, ",\"%s\":%.3f", metrics[i].key, metrics[i].value);
+        }
+
+        printf("%s}\n", line);
+
+        return result;
+    }
+
+}
+
+#endif
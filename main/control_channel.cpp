@@ -0,0 +1,141 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "control_channel.h"
+#include "deferred_log.h"
+#include "esp_timer.h"
+
+static const char* TAG = "ControlChannel";
+
+ControlChannel::ControlChannel(const char* name, Sender sender, uint32_t min_interval_ms)
+    : name(name),
+      sender(std::move(sender)),
+      min_interval_ms(min_interval_ms),
+      lock(portMUX_INITIALIZER_UNLOCKED),
+      pending_value(0),
+      has_pending(false),
+      pending_released(false),
+      dragging(false),
+      release_time_us(0),
+      last_send_us(0),
+      drag_events(0),
+      drag_requests(0),
+      stats{},
+      task_handle(nullptr) {
+
+    xTaskCreatePinnedToCore(channel_task_dummy,
+                            name,
+                            4096,
+                            this,
+                            2,
+                            &task_handle,
+                            CONFIG_NETWORK_TASK_CORE);
+}
+
+ControlChannel::~ControlChannel() {
+    if(task_handle != nullptr) {
+        vTaskDelete(task_handle);
+    }
+}
+
+void ControlChannel::submit(int value, bool released) {
+    portENTER_CRITICAL(&lock);
+
+    if(!dragging) {
+        dragging = true;
+        drag_events = 0;
+        drag_requests = 0;
+    }
+
+    pending_value = value;
+    has_pending = true;
+    drag_events++;
+
+    if(released) {
+        pending_released = true;
+        release_time_us = esp_timer_get_time();
+    }
+
+    portEXIT_CRITICAL(&lock);
+
+    xTaskNotifyGive(task_handle);
+}
+
+ControlChannel::Stats ControlChannel::getStats() {
+    portENTER_CRITICAL(&lock);
+    Stats out = stats;
+    portEXIT_CRITICAL(&lock);
+
+    return out;
+}
+
+void ControlChannel::channel_task_dummy(void *arg) {
+    auto obj = static_cast<ControlChannel*>(arg);
+    obj->channel_task();
+}
+
+void ControlChannel::channel_task() {
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while(1) {
+            portENTER_CRITICAL(&lock);
+            bool pending = has_pending;
+            bool released = pending_released;
+            portEXIT_CRITICAL(&lock);
+
+            if(!pending) {
+                break;
+            }
+
+            //Intermediate values wait out the interval, letting newer values replace them.
+            //A release wakes the task early through the notification.
+            if(!released) {
+                int64_t wait_us = last_send_us + static_cast<int64_t>(min_interval_ms) * 1000 - esp_timer_get_time();
+
+                if(wait_us > 0) {
+                    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000 + 1));
+                    continue;
+                }
+            }
+
+            portENTER_CRITICAL(&lock);
+            int value = pending_value;
+            released = pending_released;
+            has_pending = false;
+            pending_released = false;
+            drag_requests++;
+
+            //The drag ends when its release is taken, a drag starting during the send counts anew.
+            uint32_t events = drag_events;
+            uint32_t requests = drag_requests;
+            int64_t released_us = release_time_us;
+
+            if(released) {
+                dragging = false;
+            }
+
+            portEXIT_CRITICAL(&lock);
+
+            last_send_us = esp_timer_get_time();
+
+            if(!sender(value)) {
+                DLOGE(TAG, "%s: request for value %d failed", name, value);
+            }
+
+            if(released) {
+                portENTER_CRITICAL(&lock);
+                stats.drags++;
+                stats.events = events;
+                stats.requests = requests;
+                stats.final_latency_us = esp_timer_get_time() - released_us;
+                Stats out = stats;
+                portEXIT_CRITICAL(&lock);
+
+                DLOGI(TAG, "%s: %lu values, %lu requests, final value latency %lld us",
+                         name,
+                         static_cast<unsigned long>(out.events),
+                         static_cast<unsigned long>(out.requests),
+                         out.final_latency_us);
+            }
+        }
+    }
+}
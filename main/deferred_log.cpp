@@ -0,0 +1,202 @@
+#include "deferred_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+namespace dlog {
+
+    static const char* TAG = "DeferredLog";
+
+    static RingbufHandle_t ring = nullptr;
+    static std::atomic<uint32_t> dropped{0};
+
+    //Reads an argument of the given size, or returns false if the payload is exhausted.
+    template<typename T>
+    static bool read(const Record& record, size_t& pos, T& value) {
+        if(pos + sizeof(T) > record.header.size) {
+            return false;
+        }
+
+        std::memcpy(&value, record.payload + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    //Formats one conversion, spec holds everything from '%' to the conversion character.
+    static bool format_arg(const Record& record, size_t& pos, const std::string& spec, std::string& out) {
+        char conversion = spec.back();
+        char buf[64];
+        int len = 0;
+
+        if(conversion == 's') {
+            if(pos >= record.header.size) {
+                return false;
+            }
+
+            uint8_t str_len = record.payload[pos];
+            std::string str(reinterpret_cast<const char*>(record.payload + pos + 1), str_len);
+            pos += str_len + 1;
+            len = snprintf(buf, sizeof(buf), spec.c_str(), str.c_str());
+        }
+
+        else if(conversion == 'f' || conversion == 'F' || conversion == 'e' || conversion == 'E' ||
+                conversion == 'g' || conversion == 'G' || conversion == 'a' || conversion == 'A') {
+            double value;
+
+            if(!read(record, pos, value)) {
+                return false;
+            }
+
+            len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+        }
+
+        else if(conversion == 'p') {
+            uintptr_t value;
+
+            if(!read(record, pos, value)) {
+                return false;
+            }
+
+            len = snprintf(buf, sizeof(buf), spec.c_str(), reinterpret_cast<void*>(value));
+        }
+
+        else if(spec.find("ll") != std::string::npos || spec.find('j') != std::string::npos) {
+            long long value;
+
+            if(!read(record, pos, value)) {
+                return false;
+            }
+
+            len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+        }
+
+        else if(spec.find('l') != std::string::npos) {
+            long value;
+
+            if(!read(record, pos, value)) {
+                return false;
+            }
+
+            len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+        }
+
+        else if(spec.find('z') != std::string::npos) {
+            size_t value;
+
+            if(!read(record, pos, value)) {
+                return false;
+            }
+
+            len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+        }
+
+        else {
+            int value;
+
+            if(!read(record, pos, value)) {
+                return false;
+            }
+
+            len = snprintf(buf, sizeof(buf), spec.c_str(), value);
+        }
+
+        out.append(buf, std::min<int>(std::max(len, 0), sizeof(buf) - 1));
+        return true;
+    }
+
+    static std::string format(const Record& record) {
+        std::string out;
+        size_t pos = 0;
+
+        for(const char* c = record.header.format; *c != 0; c++) {
+            if(*c != '%') {
+                out += *c;
+                continue;
+            }
+
+            if(c[1] == '%') {
+                out += '%';
+                c++;
+                continue;
+            }
+
+            //Flags, width, precision and length modifiers up to the conversion character.
+            std::string spec = "%";
+
+            while(c[1] != 0 && std::strchr("diouxXcsfFeEgGaAp", c[1]) == nullptr) {
+                spec += *++c;
+            }
+
+            if(c[1] == 0) {
+                break;
+            }
+
+            spec += *++c;
+
+            if(!format_arg(record, pos, spec, out)) {
+                out += "...";
+                break;
+            }
+        }
+
+        return out;
+    }
+
+    static void print_task(void* arg) {
+        static constexpr char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+        uint32_t reported = 0;
+
+        while(1) {
+            size_t size = 0;
+            auto record = static_cast<Record*>(xRingbufferReceive(ring, &size, portMAX_DELAY));
+
+            if(record == nullptr) {
+                continue;
+            }
+
+            std::string text = format(*record);
+            char letter = letters[record->header.level < sizeof(letters) ? record->header.level : 0];
+
+            printf("%c (%lu) %s: %s\n", letter, record->header.time_ms, record->header.tag, text.c_str());
+            vRingbufferReturnItem(ring, record);
+
+            uint32_t total = dropped.load();
+
+            if(total != reported) {
+                ESP_LOGW(TAG, "%lu records dropped", total - reported);
+                reported = total;
+            }
+        }
+    }
+
+    void init() {
+        ring = xRingbufferCreate(CONFIG_DEFERRED_LOG_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+
+        xTaskCreatePinnedToCore(print_task,
+                                "Deferred Log",
+                                4096,
+                                nullptr,
+                                1,
+                                nullptr,
+                                CONFIG_NETWORK_TASK_CORE);
+    }
+
+    void submit(Record& record) {
+        record.header.time_ms = esp_log_timestamp();
+
+        //Records logged before init are dropped, and so are records that don't fit.
+        if(ring == nullptr || xRingbufferSend(ring, &record, sizeof(Header) + record.header.size, 0) != pdTRUE) {
+            dropped++;
+        }
+    }
+
+    uint32_t getDropped() {
+        return dropped.load();
+    }
+
+}
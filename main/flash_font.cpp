@@ -0,0 +1,167 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "flash_font.h"
+#include "deferred_log.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char* TAG = "FlashFont";
+
+FlashFont::FlashFont()
+    : partition(nullptr),
+      font{} {
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+
+    if(partition == nullptr) {
+        DLOGW(TAG, "No %s partition, using the default font", partition_label);
+        return;
+    }
+
+    bool opened = cache.open([this](uint32_t offset, void* dst, size_t len) {
+        return esp_partition_read(partition, offset, dst, len) == ESP_OK;
+    });
+
+    if(!opened) {
+        DLOGW(TAG, "No glyph file in the %s partition, using the default font", partition_label);
+        return;
+    }
+
+    font.get_glyph_dsc = get_glyph_dsc_dummy;
+    font.get_glyph_bitmap = get_glyph_bitmap_dummy;
+    font.line_height = cache.getLineHeight();
+    font.base_line = cache.getBaseLine();
+    font.underline_position = -1;
+    font.underline_thickness = 1;
+    font.fallback = LV_FONT_DEFAULT;
+    font.user_data = this;
+}
+
+const lv_font_t* FlashFont::get() const {
+    return cache.isOpen() ? &font : LV_FONT_DEFAULT;
+}
+
+GlyphCache::Stats FlashFont::getStats() const {
+    return cache.getStats();
+}
+
+bool FlashFont::get_glyph_dsc_dummy(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto obj = static_cast<FlashFont*>(font->user_data);
+    return obj->get_glyph_dsc(dsc, letter);
+}
+
+const void* FlashFont::get_glyph_bitmap_dummy(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    auto obj = static_cast<FlashFont*>(dsc->resolved_font->user_data);
+    return obj->get_glyph_bitmap(dsc, draw_buf);
+}
+
+bool FlashFont::get_glyph_dsc(lv_font_glyph_dsc_t* dsc, uint32_t letter) {
+    GlyphCache::Glyph glyph;
+
+    //Not found lets LVGL try the fallback font.
+    if(!cache.lookup(letter, glyph)) {
+        return false;
+    }
+
+    dsc->adv_w = glyph.adv_w;
+    dsc->box_w = glyph.box_w;
+    dsc->box_h = glyph.box_h;
+    dsc->ofs_x = glyph.ofs_x;
+    dsc->ofs_y = glyph.ofs_y;
+    dsc->format = LV_FONT_GLYPH_FORMAT_A4;
+    dsc->is_placeholder = 0;
+    dsc->gid.index = letter;
+
+    return true;
+}
+
+const void* FlashFont::get_glyph_bitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    GlyphCache::Glyph glyph;
+
+    //Usually a hit, the descriptor was looked up just before.
+    if(draw_buf == nullptr || !cache.lookup(dsc->gid.index, glyph)) {
+        return nullptr;
+    }
+
+    //LVGL draws A8 from the buffer it passes in, so the 4 bpp rows are expanded into it.
+    uint32_t src_stride = (glyph.box_w + 1) / 2;
+    uint32_t dst_stride = draw_buf->header.stride;
+
+    for(uint32_t y = 0; y < glyph.box_h; y++) {
+        const uint8_t* src = glyph.bitmap + y * src_stride;
+        uint8_t* dst = draw_buf->data + y * dst_stride;
+
+        for(uint32_t x = 0; x < glyph.box_w; x++) {
+            uint8_t nibble = x & 1 ? src[x / 2] & 0x0F : src[x / 2] >> 4;
+            dst[x] = nibble * 17;
+        }
+    }
+
+    return draw_buf;
+}
+
+#if CONFIG_BOOT_BENCHMARKS
+
+struct Sample {
+    const char* script;
+    const char* text;
+};
+
+static constexpr Sample samples[] = {
+    {"Latin", "Bohemian Rhapsody - Remastered 2011"},
+    {"Latin-1", "Sigur Rós - Hoppípolla, Björk - Jóga"},
+    {"Cyrillic", "Кино - Группа крови"},
+    {"Greek", "Μάνος Χατζιδάκις - Τα παιδιά του Πειραιά"},
+    {"Japanese", "坂本龍一 - 戦場のメリークリスマス"},
+    {"Chinese", "周杰伦 - 晴天 (叶惠美)"},
+    {"Hangul", "방탄소년단 - 봄날 (Spring Day)"},
+};
+
+static constexpr int rounds = 4;
+
+//Measuring a text looks every glyph up, which is what a first render costs on top of drawing.
+static int64_t measure_us(const lv_font_t* font, const char* text) {
+    lv_point_t size;
+    int64_t start_us = esp_timer_get_time();
+    lv_text_get_size(&size, text, font, 0, 0, LV_COORD_MAX, LV_TEXT_FLAG_NONE);
+    return esp_timer_get_time() - start_us;
+}
+
+void FlashFont::benchmark() {
+    if(!cache.isOpen()) {
+        ESP_LOGI(TAG, "No glyph file, nothing to measure");
+        return;
+    }
+
+    for(const Sample& sample : samples) {
+        cache.clear();
+        GlyphCache::Stats before = cache.getStats();
+        int64_t cold_us = measure_us(&font, sample.text);
+        GlyphCache::Stats after = cache.getStats();
+        int64_t warm_us = measure_us(&font, sample.text);
+
+        ESP_LOGI(TAG, "%-8s first render %lld us, cached %lld us, %lu glyphs read, %lu bytes, %lu not in file",
+                 sample.script, cold_us, warm_us, after.misses - before.misses, after.bytes_read - before.bytes_read,
+                 after.not_found - before.not_found);
+    }
+
+    //Cycles through the titles the way a queue does; each render measures and draws the text.
+    cache.clear();
+    GlyphCache::Stats before = cache.getStats();
+
+    for(int round = 0; round < rounds; round++) {
+        for(const Sample& sample : samples) {
+            measure_us(&font, sample.text);
+            measure_us(&font, sample.text);
+        }
+    }
+
+    GlyphCache::Stats after = cache.getStats();
+    uint32_t hits = after.hits - before.hits;
+    uint32_t lookups = hits + after.misses - before.misses;
+
+    ESP_LOGI(TAG, "%d rounds: hit rate %.1f%%, %lu evictions, %u slots of %lu bytes",
+             rounds, lookups > 0 ? 100.0 * hits / lookups : 0.0, after.evictions - before.evictions,
+             static_cast<unsigned>(GlyphCache::slot_count), cache.getSlotBytes());
+}
+
+#endif
@@ -0,0 +1,317 @@
+#include "glyph_cache.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint8_t magic[4] = {'G', 'L', 'P', 'H'};
+
+static uint32_t get(const uint8_t* data, size_t bytes) {
+    uint32_t value = 0;
+
+    for(size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+static size_t hash(uint32_t codepoint) {
+    //Knuth's multiplicative hash, neighbouring codepoints land in different buckets.
+    return (codepoint * 2654435761u) >> 24;
+}
+
+GlyphCache::GlyphCache()
+    : glyph_count(0),
+      descriptor_offset(0),
+      slot_bytes(0),
+      line_height(0),
+      base_line(0),
+      head(no_slot),
+      tail(no_slot),
+      used_slots(0),
+      stats{} {
+
+    static_assert(bucket_count == 256, "hash() yields 8 bits");
+    clear();
+}
+
+bool GlyphCache::open(Reader new_reader) {
+    uint8_t header[header_size];
+
+    reader = nullptr;
+    ranges.clear();
+    bitmaps.reset();
+    clear();
+
+    if(!new_reader(0, header, sizeof(header)) || std::memcmp(header, magic, sizeof(magic)) != 0 ||
+       get(header + 4, 2) != version || header[6] != 4) {
+        return false;
+    }
+
+    uint32_t range_count = get(header + 12, 4);
+    uint32_t max_bitmap_size = get(header + 24, 4);
+    uint32_t file_size = get(header + 28, 4);
+
+    glyph_count = get(header + 16, 4);
+    descriptor_offset = get(header + 20, 4);
+
+    if(range_count == 0 || range_count > max_ranges || max_bitmap_size > max_glyph_bytes ||
+       descriptor_offset < header_size + static_cast<uint64_t>(range_count) * range_size ||
+       descriptor_offset + static_cast<uint64_t>(glyph_count) * descriptor_size > file_size) {
+        return false;
+    }
+
+    std::vector<uint8_t> table(range_count * range_size);
+
+    if(!new_reader(header_size, table.data(), table.size())) {
+        return false;
+    }
+
+    ranges.resize(range_count);
+    uint32_t next_codepoint = 0;
+
+    for(uint32_t i = 0; i < range_count; i++) {
+        const uint8_t* entry = &table[i * range_size];
+        Range& range = ranges[i];
+
+        range.first = get(entry, 4);
+        range.count = get(entry + 4, 4);
+        range.first_glyph = get(entry + 8, 4);
+
+        //Sorted, disjoint and inside the descriptor table, so lookups need no further checks.
+        if(range.first < next_codepoint || range.count == 0 || range.first_glyph > glyph_count ||
+           range.count > glyph_count - range.first_glyph) {
+            ranges.clear();
+            return false;
+        }
+
+        next_codepoint = range.first + range.count;
+    }
+
+    line_height = get(header + 8, 2);
+    base_line = static_cast<int16_t>(get(header + 10, 2));
+    slot_bytes = std::max<uint32_t>(max_bitmap_size, 1);
+    bitmaps.reset(new uint8_t[slot_count * slot_bytes]);
+    reader = std::move(new_reader);
+
+    return true;
+}
+
+bool GlyphCache::find_glyph(uint32_t codepoint, uint32_t& index) const {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), codepoint,
+                               [](uint32_t cp, const Range& range) { return cp < range.first; });
+
+    if(it == ranges.begin()) {
+        return false;
+    }
+
+    --it;
+
+    if(codepoint - it->first >= it->count) {
+        return false;
+    }
+
+    index = it->first_glyph + (codepoint - it->first);
+    return true;
+}
+
+bool GlyphCache::contains(uint32_t codepoint) const {
+    uint32_t index;
+    return find_glyph(codepoint, index);
+}
+
+uint16_t GlyphCache::find_slot(uint32_t codepoint) const {
+    for(uint16_t slot = buckets[hash(codepoint)]; slot != no_slot; slot = slots[slot].chain) {
+        if(slots[slot].codepoint == codepoint) {
+            return slot;
+        }
+    }
+
+    return no_slot;
+}
+
+void GlyphCache::unlink(uint16_t slot) {
+    Slot& s = slots[slot];
+
+    if(s.prev != no_slot) {
+        slots[s.prev].next = s.next;
+    }
+
+    else {
+        head = s.next;
+    }
+
+    if(s.next != no_slot) {
+        slots[s.next].prev = s.prev;
+    }
+
+    else {
+        tail = s.prev;
+    }
+
+    s.prev = no_slot;
+    s.next = no_slot;
+}
+
+void GlyphCache::push_front(uint16_t slot) {
+    slots[slot].prev = no_slot;
+    slots[slot].next = head;
+
+    if(head != no_slot) {
+        slots[head].prev = slot;
+    }
+
+    head = slot;
+
+    if(tail == no_slot) {
+        tail = slot;
+    }
+}
+
+void GlyphCache::push_back(uint16_t slot) {
+    slots[slot].prev = tail;
+    slots[slot].next = no_slot;
+
+    if(tail != no_slot) {
+        slots[tail].next = slot;
+    }
+
+    tail = slot;
+
+    if(head == no_slot) {
+        head = slot;
+    }
+}
+
+void GlyphCache::remove_from_bucket(uint16_t slot) {
+    uint16_t* link = &buckets[hash(slots[slot].codepoint)];
+
+    while(*link != slot) {
+        link = &slots[*link].chain;
+    }
+
+    *link = slots[slot].chain;
+    slots[slot].chain = no_slot;
+}
+
+bool GlyphCache::lookup(uint32_t codepoint, Glyph& glyph) {
+    if(!reader) {
+        return false;
+    }
+
+    uint16_t slot = find_slot(codepoint);
+
+    if(slot != no_slot) {
+        if(slot != head) {
+            unlink(slot);
+            push_front(slot);
+        }
+
+        stats.hits++;
+        glyph = slots[slot].glyph;
+        return true;
+    }
+
+    uint32_t index;
+
+    if(!find_glyph(codepoint, index)) {
+        stats.not_found++;
+        return false;
+    }
+
+    uint8_t descriptor[descriptor_size];
+
+    if(!reader(descriptor_offset + index * descriptor_size, descriptor, sizeof(descriptor))) {
+        return false;
+    }
+
+    uint32_t bitmap_offset = get(descriptor, 4);
+    uint32_t bitmap_size = get(descriptor + 4, 2);
+    uint8_t box_w = descriptor[8];
+    uint8_t box_h = descriptor[9];
+    uint32_t expected_size = (box_w + 1U) / 2 * box_h;
+
+    if(bitmap_size > slot_bytes || bitmap_size < expected_size) {
+        return false;
+    }
+
+    //Take a free slot while there are any, then the least recently used one.
+    if(used_slots < slot_count) {
+        slot = used_slots++;
+    }
+
+    else {
+        slot = tail;
+        unlink(slot);
+
+        if(slots[slot].used) {
+            remove_from_bucket(slot);
+            slots[slot].used = false;
+            stats.evictions++;
+        }
+    }
+
+    uint8_t* bitmap = &bitmaps[slot * slot_bytes];
+
+    if(bitmap_size > 0 && !reader(bitmap_offset, bitmap, bitmap_size)) {
+        //Left empty at the end of the list, where the next miss takes it.
+        push_back(slot);
+        return false;
+    }
+
+    Slot& s = slots[slot];
+    s.codepoint = codepoint;
+    s.used = true;
+    s.glyph = Glyph{
+        .adv_w = static_cast<uint16_t>(get(descriptor + 6, 2)),
+        .box_w = box_w,
+        .box_h = box_h,
+        .ofs_x = static_cast<int8_t>(descriptor[10]),
+        .ofs_y = static_cast<int8_t>(descriptor[11]),
+        .bitmap = bitmap
+    };
+
+    s.chain = buckets[hash(codepoint)];
+    buckets[hash(codepoint)] = slot;
+    push_front(slot);
+
+    stats.misses++;
+    stats.bytes_read += sizeof(descriptor) + bitmap_size;
+    glyph = s.glyph;
+
+    return true;
+}
+
+void GlyphCache::clear() {
+    buckets.fill(no_slot);
+
+    for(Slot& slot : slots) {
+        slot = Slot{};
+        slot.prev = no_slot;
+        slot.next = no_slot;
+        slot.chain = no_slot;
+    }
+
+    head = no_slot;
+    tail = no_slot;
+    used_slots = 0;
+}
+
+bool GlyphCache::isOpen() const {
+    return static_cast<bool>(reader);
+}
+
+int GlyphCache::getLineHeight() const {
+    return line_height;
+}
+
+int GlyphCache::getBaseLine() const {
+    return base_line;
+}
+
+uint32_t GlyphCache::getSlotBytes() const {
+    return slot_bytes;
+}
+
+GlyphCache::Stats GlyphCache::getStats() const {
+    return stats;
+}
@@ -1,34 +1,54 @@
+#define DLOG_LOCAL_LEVEL CONFIG_HTTP_LOG_LEVEL
 #include "http_client.h"
-#include "esp_log.h"
+#include "trace.h"
+#include "metrics.h"
+#include "esp_timer.h"
+#include "deferred_log.h"
 #include "freertos/FreeRTOS.h"
+#include <algorithm>
 
 static const char* TAG = "HttpClient";
 
-std::vector<char> HttpClient::get_content() {
-    int bufferSize = esp_http_client_get_content_length(client);
-    std::vector<char> response_data(bufferSize+1);
+void CancelToken::cancel() {
+    cancelled.store(true, std::memory_order_relaxed);
+}
 
-    size_t item_size;
-    int index = 0;
+void CancelToken::reset() {
+    cancelled.store(false, std::memory_order_relaxed);
+}
 
-    ESP_LOGI(TAG,"Receiving item of size %d", bufferSize);
+bool CancelToken::isCancelled() const {
+    return cancelled.load(std::memory_order_relaxed);
+}
 
-    while(1) {
-        char *item = (char*)xRingbufferReceive(xRingbuffer,&item_size,pdMS_TO_TICKS(1000));
-        if(item != nullptr) {
-            for(int i = 0 ; i< item_size; i++) {
-                response_data[index] = item[i];
-                index++;
-                response_data[index] = 0;
-            }
-            vRingbufferReturnItem(xRingbuffer,static_cast<void*>(item));
-        }
+Deadline Deadline::none() {
+    return {0, nullptr};
+}
 
-        else {
-            ESP_LOGI(TAG,"End of receive item");
-            return response_data;
-        }
+Deadline Deadline::in(uint32_t timeout_ms, const CancelToken* token) {
+    return {esp_timer_get_time() + static_cast<int64_t>(timeout_ms) * 1000, token};
+}
+
+bool Deadline::isCancelled() const {
+    return token != nullptr && token->isCancelled();
+}
+
+bool Deadline::expired() const {
+    return isCancelled() || (at_us != 0 && esp_timer_get_time() >= at_us);
+}
+
+int Deadline::timeoutMs(bool sliced) const {
+    int64_t timeout_ms = default_timeout_ms;
+
+    if(at_us != 0) {
+        timeout_ms = (at_us - esp_timer_get_time() + 999) / 1000;
+    }
+
+    if(sliced && token != nullptr) {
+        timeout_ms = std::min<int64_t>(timeout_ms, cancel_poll_ms);
     }
+
+    return std::max<int64_t>(timeout_ms, 1);
 }
 
 esp_err_t HttpClient::event_handler_dummy(esp_http_client_event_t *evt) {
@@ -40,39 +60,27 @@ esp_err_t HttpClient::event_handler(esp_http_client_event_t *evt)
 {
     switch (evt->event_id)
     {
+    //Per-event output is debug level, synchronous UART writes here distort every request timing.
     case HTTP_EVENT_ERROR:
-        ESP_LOGI(TAG, "HTTP_EVENT_ERROR");
+        DLOGD(TAG, "HTTP_EVENT_ERROR");
         break;
     case HTTP_EVENT_ON_CONNECTED:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
+        DLOGD(TAG, "HTTP_EVENT_ON_CONNECTED");
+        trace::instant(trace::Id::HttpConnected);
         break;
     case HTTP_EVENT_HEADER_SENT:
-        ESP_LOGI(TAG, "HTTP_EVENT_HEADER_SENT");
+        DLOGD(TAG, "HTTP_EVENT_HEADER_SENT");
+        trace::instant(trace::Id::HttpHeaderSent);
         break;
     case HTTP_EVENT_ON_HEADER:
-        ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+        DLOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
         break;
     case HTTP_EVENT_ON_DATA:
-        ESP_LOGI(TAG,"HTTP_EVENT_ON_DATA");
-
-        if(!esp_http_client_is_chunked_response(evt->client)) {
-            ESP_LOGI(TAG,"Length of event data: %d",evt->data_len);
-
-            char *buffer = static_cast<char*>(malloc(evt->data_len+1));
-
-            memcpy(buffer,evt->data,evt->data_len);
-            buffer[evt->data_len] = 0;
-
-            UBaseType_t res = xRingbufferSend(xRingbuffer,buffer,evt->data_len,pdMS_TO_TICKS(1000));
-
-            if(res != pdTRUE) {
-                ESP_LOGE(TAG,"xRingbufferSendFromISR res=%d",res);
-            }
-            free(buffer);
-        }
+        //The data is also what esp_http_client_read returns, receive() stores it.
+        DLOGD(TAG,"HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
         break;
     case HTTP_EVENT_ON_FINISH:
-        ESP_LOGI(TAG,"HTTP_EVENT_ON_FINISH");
+        DLOGD(TAG,"HTTP_EVENT_ON_FINISH");
         break;
     default:
         break;
@@ -80,13 +88,7 @@ esp_err_t HttpClient::event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
-HttpClient::HttpClient() {
-
-    xRingbuffer = xRingbufferCreate(8192,RINGBUF_TYPE_NOSPLIT);
-    
-    if(xRingbuffer == NULL) {
-        ESP_LOGE(TAG, "Couldn't create ring buffer");
-    }
+HttpClient::HttpClient() : received(0) {
 
     //Create with some dummy data.
     esp_http_client_config_t config = {
@@ -98,25 +100,27 @@ HttpClient::HttpClient() {
     };
 
     client = esp_http_client_init(&config);
+
+    //Room for the NUL of an empty response, so bodiless requests never allocate.
+    scratch.reserve(64);
 }
 
 HttpClient::~HttpClient() {
     esp_http_client_cleanup(client);
-    vRingbufferDelete(xRingbuffer);
 }
 
-esp_err_t HttpClient::setHeader(std::string_view key, std::string_view value) {
-    return esp_http_client_set_header(client,key.data(),value.data());
+esp_err_t HttpClient::setHeader(const char* key, const char* value) {
+    return esp_http_client_set_header(client,key,value);
 }
 
-esp_err_t HttpClient::deleteHeader(std::string_view key) {
-    return esp_http_client_delete_header(client,key.data());
+esp_err_t HttpClient::deleteHeader(const char* key) {
+    return esp_http_client_delete_header(client,key);
 }
 
-std::string HttpClient::getHeader(std::string_view key) {
+std::string HttpClient::getHeader(const char* key) {
     char* value = nullptr;
 
-    ESP_ERROR_CHECK(esp_http_client_get_header(client,key.data(),&value));
+    ESP_ERROR_CHECK(esp_http_client_get_header(client,key,&value));
 
     if(value == nullptr) {
         return "";
@@ -127,78 +131,225 @@ std::string HttpClient::getHeader(std::string_view key) {
     }
 }
 
-bool HttpClient::get(std::string_view url, std::vector<char>& dst) {
+static const char* method_name(esp_http_client_method_t method) {
+    switch(method) {
+    case HTTP_METHOD_GET:
+        return "GET";
+    case HTTP_METHOD_POST:
+        return "POST";
+    case HTTP_METHOD_PUT:
+        return "PUT";
+    default:
+        return "OTHER";
+    }
+}
 
-    esp_http_client_set_url(client,url.data());
-    esp_http_client_set_method(client,HTTP_METHOD_GET);
+bool HttpClient::get(const char* url, mem::Buffer& dst, const Deadline& deadline) {
+    return request(HTTP_METHOD_GET, url, "", HttpStatus_Ok, dst, deadline);
+}
 
-    esp_err_t err = esp_http_client_perform(client);
+bool HttpClient::post(const char* url, std::string_view data, mem::Buffer& dst, const Deadline& deadline) {
+    return request(HTTP_METHOD_POST, url, data, HttpStatus_Ok, dst, deadline);
+}
 
-    int status_code = esp_http_client_get_status_code(client);
+bool HttpClient::put(const char* url, mem::Buffer& dst, const Deadline& deadline) {
+    return request(HTTP_METHOD_PUT, url, "", HttpStatus_Ok, dst, deadline);
+}
+
+bool HttpClient::stream(const char* url, const BodySink& sink, const Deadline& deadline) {
+    return execute(HTTP_METHOD_GET, url, "", HttpStatus_Ok, scratch, &sink, deadline);
+}
+
+bool HttpClient::request(esp_http_client_method_t method, const char* url, std::string_view data, int expected_status,
+                         const Deadline& deadline) {
+    return execute(method, url, data, expected_status, scratch, nullptr, deadline);
+}
+
+bool HttpClient::request(esp_http_client_method_t method, const char* url, std::string_view data, int expected_status, mem::Buffer& dst,
+                         const Deadline& deadline) {
+    return execute(method, url, data, expected_status, dst, nullptr, deadline);
+}
+
+esp_err_t HttpClient::send(esp_http_client_method_t method, std::string_view data, const Deadline& deadline) {
+    //Connecting and the TLS handshake can't be resumed after a timeout, so they get all the time left.
+    esp_http_client_set_timeout_ms(client, deadline.timeoutMs(false));
+    esp_err_t err = esp_http_client_open(client, method == HTTP_METHOD_GET ? 0 : data.size());
 
     if(err != ESP_OK) {
-        ESP_LOGE(TAG,"HTTP GET request failed: %s", esp_err_to_name(err));
-        return false;
+        return err;
     }
 
-    else if(status_code != HttpStatus_Ok) {
-        ESP_LOGE(TAG,"HTTP status error, code: %d", status_code);
-        return false;
-    }
+    for(size_t written = 0; written < data.size();) {
+        if(deadline.expired()) {
+            return ESP_ERR_TIMEOUT;
+        }
 
-    else {
-        dst = get_content();
-        return true;
+        esp_http_client_set_timeout_ms(client, deadline.timeoutMs(true));
+        int length = esp_http_client_write(client, data.data() + written, data.size() - written);
+
+        if(length < 0) {
+            return ESP_FAIL;
+        }
+
+        written += length;
     }
 
+    return ESP_OK;
+}
+
+//True once a response made no progress for default_timeout_ms, which bounds it even without a deadline.
+static bool stalled(int64_t progress_us) {
+    return esp_timer_get_time() - progress_us >= static_cast<int64_t>(Deadline::default_timeout_ms) * 1000;
 }
 
-bool HttpClient::post(std::string_view url, std::string_view data, std::vector<char>& dst) {
-    esp_http_client_set_url(client,url.data());
-    esp_http_client_set_method(client,HTTP_METHOD_POST);
-    esp_http_client_set_post_field(client, data.data(), data.size());
+esp_err_t HttpClient::receive(mem::Buffer& dst, const BodySink* sink, int expected_status, const Deadline& deadline) {
+    int64_t content_length;
+    int64_t progress_us = esp_timer_get_time();
 
-    esp_err_t err = esp_http_client_perform(client);
+    do {
+        if(deadline.expired() || stalled(progress_us)) {
+            return ESP_ERR_TIMEOUT;
+        }
 
-    int status_code = esp_http_client_get_status_code(client);
+        esp_http_client_set_timeout_ms(client, deadline.timeoutMs(true));
+        content_length = esp_http_client_fetch_headers(client);
+    } while(content_length == -ESP_ERR_HTTP_EAGAIN);
 
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG,"HTTP POST request failed: %s", esp_err_to_name(err));
-        return false;
+    bool chunked = esp_http_client_is_chunked_response(client);
+
+    //Chunked responses have no length, which fetch_headers reports as -1 like a failure.
+    if(content_length < 0 && !(content_length == -1 && chunked)) {
+        return ESP_FAIL;
     }
 
-    else if(status_code != HttpStatus_Ok) {
-        ESP_LOGE(TAG,"HTTP status error, code: %d", status_code);
+    //Streamed bodies only keep one chunk at a time.
+    if(sink != nullptr && esp_http_client_get_status_code(client) != expected_status) {
+        sink = nullptr;
+    }
+
+    if(content_length > 0 && sink == nullptr) {
+        dst.reserve(content_length + 1);
+    }
+
+    //Without a length or chunks, the body ends when the server closes the connection, which
+    //the transport reports as an error. A slice that timed out reads nothing and is retried.
+    bool delimited = content_length >= 0 || chunked;
+
+    progress_us = esp_timer_get_time();
+
+    while(!esp_http_client_is_complete_data_received(client)) {
+        if(deadline.expired() || stalled(progress_us)) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        size_t size = dst.size();
+        dst.resize(size + read_chunk);
+        esp_http_client_set_timeout_ms(client, deadline.timeoutMs(true));
+        int length = esp_http_client_read(client, dst.data() + size, read_chunk);
+        dst.resize(size + std::max(length, 0));
+
+        //A read that timed out returns what arrived so far, possibly nothing.
+        if(length == -ESP_ERR_HTTP_EAGAIN || length == 0) {
+            continue;
+        }
+
+        else if(length < 0 && !delimited) {
+            break;
+        }
+
+        else if(length < 0) {
+            return ESP_FAIL;
+        }
+
+        progress_us = esp_timer_get_time();
+
+        received += length;
+        trace::counter(trace::Id::HttpBytes, received);
+
+        if(sink != nullptr) {
+            (*sink)(dst.data(), dst.size());
+            dst.clear();
+        }
+    }
+
+    return ESP_OK;
+}
+
+bool HttpClient::execute(esp_http_client_method_t method, const char* url, std::string_view data, int expected_status, mem::Buffer& dst,
+                         const BodySink* sink, const Deadline& deadline) {
+    dst.clear();
+    received = 0;
+
+    //Work superseded before it started is dropped without touching the connection.
+    if(deadline.expired()) {
+        DLOGW(TAG,"HTTP %s request dropped: %s", method_name(method), deadline.isCancelled() ? "cancelled" : "deadline passed");
+        dst.push_back(0);
         return false;
     }
 
+    esp_http_client_set_url(client,url);
+    esp_http_client_set_method(client,method);
+
+    int64_t start_us = esp_timer_get_time();
+    trace::begin(trace::Id::HttpRequest);
+    esp_err_t err = send(method, data, deadline);
+
+    //A kept-alive connection the server closed only fails once it's used, it's opened again once.
+    //GETs are also retried if the headers never came, other requests may have been applied already.
+    if(err != ESP_OK && err != ESP_ERR_HTTP_CONNECT && !deadline.expired()) {
+        DLOGD(TAG,"Reconnecting");
+        esp_http_client_close(client);
+        err = send(method, data, deadline);
+    }
+
+    if(err == ESP_OK) {
+        err = receive(dst, sink, expected_status, deadline);
+
+        if(err == ESP_FAIL && received == 0 && method == HTTP_METHOD_GET && !deadline.expired()) {
+            DLOGD(TAG,"Reconnecting");
+            esp_http_client_close(client);
+            err = send(method, data, deadline);
+
+            if(err == ESP_OK) {
+                err = receive(dst, sink, expected_status, deadline);
+            }
+        }
+    }
+
+    //An abandoned response can't be skipped, the connection is closed so the next request opens a clean one.
+    if(err != ESP_OK) {
+        esp_http_client_close(client);
+    }
+
     else {
-        dst = get_content();
-        return true;
+        trace::instant(trace::Id::HttpFinish);
     }
-}
 
-bool HttpClient::put(std::string_view url, std::vector<char>& dst) {
-    esp_http_client_set_url(client,url.data());
-    esp_http_client_set_method(client,HTTP_METHOD_PUT);
+    trace::end(trace::Id::HttpRequest);
 
-    esp_err_t err = esp_http_client_perform(client);
+    //Responses are handed out NUL-terminated so they can be parsed as strings.
+    dst.push_back(0);
 
     int status_code = esp_http_client_get_status_code(client);
+    metrics::observeRequest(method_name(method), url, err == ESP_OK ? status_code : -1, esp_timer_get_time() - start_us);
 
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG,"HTTP PUT request failed: %s", esp_err_to_name(err));
+    if(err == ESP_ERR_TIMEOUT) {
+        DLOGW(TAG,"HTTP %s request abandoned: %s", method_name(method), deadline.isCancelled() ? "cancelled" : "deadline passed");
+        return false;
+    }
+
+    else if(err != ESP_OK) {
+        DLOGE(TAG,"HTTP %s request failed: %s", method_name(method), esp_err_to_name(err));
         return false;
     }
 
-    else if(status_code != HttpStatus_Ok) {
-        ESP_LOGE(TAG,"HTTP status error, code: %d", status_code);
+    else if(status_code != expected_status) {
+        DLOGE(TAG,"HTTP status error, code: %d", status_code);
         return false;
     }
 
     else {
-        dst = get_content();
         return true;
     }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,120 @@
+#include "json_item_scanner.h"
+
+JsonItemScanner::JsonItemScanner(ItemHandler handler) : handler(std::move(handler)) {
+    reset();
+}
+
+void JsonItemScanner::reset() {
+    depth = 0;
+    in_string = false;
+    escaped = false;
+    in_item = false;
+    item_depth = 0;
+    items_depth = 0;
+    string.clear();
+    item.clear();
+    item_count = 0;
+    total = -1;
+
+    for(auto& key : keys) {
+        key.clear();
+    }
+}
+
+size_t JsonItemScanner::getItemCount() const {
+    return item_count;
+}
+
+int64_t JsonItemScanner::getTotal() const {
+    return total;
+}
+
+void JsonItemScanner::feed(const char* data, size_t size) {
+    for(size_t i = 0; i < size; i++) {
+        char c = data[i];
+
+        if(in_item) {
+            item.push_back(c);
+        }
+
+        if(in_string) {
+            if(escaped) {
+                escaped = false;
+            }
+
+            else if(c == '\\') {
+                escaped = true;
+            }
+
+            else if(c == '"') {
+                in_string = false;
+            }
+
+            else if(!in_item && string.size() < max_key) {
+                string.push_back(c);
+            }
+
+            continue;
+        }
+
+        switch(c) {
+        case '"':
+            in_string = true;
+            escaped = false;
+
+            //Strings become keys when a colon follows.
+            if(!in_item) {
+                string.clear();
+            }
+            break;
+        case ':':
+            if(!in_item && depth <= max_depth) {
+                keys[depth] = string;
+            }
+            break;
+        case '{':
+        case '[':
+            depth++;
+
+            //An entry is an object directly inside an items array.
+            if(!in_item && c == '{' && items_depth != 0 && depth == items_depth + 1) {
+                in_item = true;
+                item_depth = depth;
+                item.assign(1, c);
+            }
+
+            //Arrays named items, at the top level or in a section object.
+            else if(!in_item && c == '[' && (depth == 2 || depth == 3) && keys[depth - 1] == "items") {
+                items_depth = depth;
+            }
+            break;
+        case '}':
+        case ']':
+            if(in_item && depth == item_depth) {
+                in_item = false;
+                item_count++;
+                handler(item_depth == 4 ? std::string_view(keys[1]) : std::string_view(), item);
+                item.clear();
+            }
+
+            else if(!in_item) {
+                if(depth == items_depth) {
+                    items_depth = 0;
+                }
+
+                if(depth >= 0 && depth <= max_depth) {
+                    keys[depth].clear();
+                }
+            }
+
+            depth--;
+            break;
+        default:
+            //The digits of "total": in the top-level object.
+            if(!in_item && depth == 1 && c >= '0' && c <= '9' && keys[1] == "total") {
+                total = (total < 0 ? 0 : total * 10) + (c - '0');
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,441 @@
+#include "json_schema.h"
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+namespace json {
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    static int hex_value(char c) {
+        if(c >= '0' && c <= '9') {
+            return c - '0';
+        }
+
+        if(c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+
+        if(c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+
+        return -1;
+    }
+
+    static void append_utf8(std::string& out, uint32_t code) {
+        if(code < 0x80) {
+            out += static_cast<char>(code);
+        }
+
+        else if(code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+
+        else if(code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+
+        else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    //-1 if the segment is not an array index.
+    static int segment_index(std::string_view segment) {
+        int index = 0;
+
+        if(segment.empty()) {
+            return -1;
+        }
+
+        for(char c : segment) {
+            if(c < '0' || c > '9') {
+                return -1;
+            }
+
+            index = index * 10 + (c - '0');
+        }
+
+        return index;
+    }
+
+    Reader::Reader(std::string_view text)
+        : text(text),
+          pos(0),
+          error(false) {
+    }
+
+    char Reader::peek() {
+        while(pos < text.size() && is_space(text[pos])) {
+            pos++;
+        }
+
+        return pos < text.size() ? text[pos] : '\0';
+    }
+
+    bool Reader::consume(char c) {
+        if(peek() != c || c == '\0') {
+            return false;
+        }
+
+        pos++;
+        return true;
+    }
+
+    bool Reader::readString(std::string_view& out) {
+        if(!consume('"')) {
+            return fail();
+        }
+
+        size_t start = pos;
+
+        //Fast path, no escapes to undo.
+        while(pos < text.size() && text[pos] != '"' && text[pos] != '\\') {
+            pos++;
+        }
+
+        if(pos == text.size()) {
+            return fail();
+        }
+
+        if(text[pos] == '"') {
+            out = text.substr(start, pos - start);
+            pos++;
+            return true;
+        }
+
+        scratch.assign(text.substr(start, pos - start));
+
+        while(pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+
+            if(c != '\\') {
+                scratch += c;
+                continue;
+            }
+
+            if(pos == text.size()) {
+                return fail();
+            }
+
+            switch(text[pos++]) {
+                case '"':  scratch += '"';  break;
+                case '\\': scratch += '\\'; break;
+                case '/':  scratch += '/';  break;
+                case 'b':  scratch += '\b'; break;
+                case 'f':  scratch += '\f'; break;
+                case 'n':  scratch += '\n'; break;
+                case 'r':  scratch += '\r'; break;
+                case 't':  scratch += '\t'; break;
+                case 'u': {
+                    uint32_t code = 0;
+
+                    for(int units = 0; units < 2; units++) {
+                        uint32_t unit = 0;
+
+                        if(pos + 4 > text.size()) {
+                            return fail();
+                        }
+
+                        for(int i = 0; i < 4; i++) {
+                            int digit = hex_value(text[pos++]);
+
+                            if(digit < 0) {
+                                return fail();
+                            }
+
+                            unit = (unit << 4) | static_cast<uint32_t>(digit);
+                        }
+
+                        //A high surrogate is followed by the low one.
+                        if(units == 0 && unit >= 0xD800 && unit < 0xDC00 &&
+                           text.substr(pos, 2) == "\\u") {
+                            code = unit;
+                            pos += 2;
+                            continue;
+                        }
+
+                        if(units == 1) {
+                            if(unit < 0xDC00 || unit >= 0xE000) {
+                                return fail();
+                            }
+
+                            code = 0x10000 + ((code - 0xD800) << 10) + (unit - 0xDC00);
+                        }
+
+                        else {
+                            code = unit;
+                        }
+
+                        break;
+                    }
+
+                    append_utf8(scratch, code);
+                    break;
+                }
+                default:
+                    return fail();
+            }
+        }
+
+        if(pos == text.size()) {
+            return fail();
+        }
+
+        pos++;
+        out = scratch;
+        return true;
+    }
+
+    bool Reader::readScalar(Scalar& out) {
+        char c = peek();
+
+        if(c == '"') {
+            out.type = Scalar::Type::String;
+            return readString(out.string);
+        }
+
+        for(std::string_view word : {"true", "false", "null"}) {
+            if(text.substr(pos, word.size()) == word) {
+                pos += word.size();
+                out.type = word[0] == 'n' ? Scalar::Type::Null : Scalar::Type::Bool;
+                out.boolean = word[0] == 't';
+                return true;
+            }
+        }
+
+        if(c != '-' && (c < '0' || c > '9')) {
+            return fail();
+        }
+
+        size_t start = pos;
+        bool integral = true;
+
+        while(pos < text.size()) {
+            c = text[pos];
+
+            if(c == '.' || c == 'e' || c == 'E') {
+                integral = false;
+            }
+
+            else if(c != '-' && c != '+' && (c < '0' || c > '9')) {
+                break;
+            }
+
+            pos++;
+        }
+
+        const char* first = text.data() + start;
+        const char* last = text.data() + pos;
+
+        out.type = Scalar::Type::Number;
+        out.integral = integral;
+
+        if(integral) {
+            auto result = std::from_chars(first, last, out.integer);
+
+            if(result.ptr == last) {
+                out.number = static_cast<double>(out.integer);
+                return true;
+            }
+
+            //Too large for an integer.
+            out.integral = false;
+        }
+
+        auto result = std::from_chars(first, last, out.number);
+        return result.ptr == last || fail();
+    }
+
+    bool Reader::skip_string() {
+        pos++;
+
+        while(pos < text.size()) {
+            const char* quote = static_cast<const char*>(std::memchr(text.data() + pos, '"', text.size() - pos));
+
+            if(quote == nullptr) {
+                break;
+            }
+
+            //The quote is escaped if an odd number of backslashes is before it.
+            size_t end = quote - text.data();
+            size_t backslashes = 0;
+
+            while(end - backslashes > pos && text[end - backslashes - 1] == '\\') {
+                backslashes++;
+            }
+
+            pos = end + 1;
+
+            if(backslashes % 2 == 0) {
+                return true;
+            }
+        }
+
+        return fail();
+    }
+
+    bool Reader::skipValue() {
+        char c = peek();
+
+        if(c != '{' && c != '[') {
+            if(c == '"') {
+                return skip_string();
+            }
+
+            Scalar value;
+            return readScalar(value);
+        }
+
+        //Only the brackets are counted, the values in them are not checked.
+        size_t depth = 0;
+
+        while(pos < text.size()) {
+            c = text[pos];
+
+            if(c == '"') {
+                if(!skip_string()) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            pos++;
+
+            if(c == '{' || c == '[') {
+                depth++;
+            }
+
+            else if(c == '}' || c == ']') {
+                if(--depth == 0) {
+                    return true;
+                }
+            }
+        }
+
+        return fail();
+    }
+
+    bool Reader::finish() {
+        return peek() == '\0' && pos == text.size();
+    }
+
+    bool Reader::fail() {
+        error = true;
+        return false;
+    }
+
+    bool Reader::failed() const {
+        return error;
+    }
+
+    bool decode_value(Reader& reader, Binding* bindings, uint32_t live, size_t depth) {
+        if(live == 0) {
+            return reader.skipValue();
+        }
+
+        char c = reader.peek();
+        uint32_t exact = 0;
+
+        for(uint32_t bits = live; bits != 0; bits &= bits - 1) {
+            Binding& binding = bindings[std::countr_zero(bits)];
+
+            if(binding.length == depth) {
+                exact |= bits & -bits;
+            }
+        }
+
+        if(c == '{' || c == '[') {
+            for(uint32_t bits = exact; bits != 0; bits &= bits - 1) {
+                Binding& binding = bindings[std::countr_zero(bits)];
+
+                if(binding.array != nullptr && c == '[') {
+                    binding.seen = true;
+                    return binding.array(reader, binding.target);
+                }
+            }
+
+            uint32_t deeper = live & ~exact;
+
+            if(deeper == 0) {
+                return reader.skipValue();
+            }
+
+            reader.consume(c);
+
+            if(reader.consume(c == '{' ? '}' : ']')) {
+                return true;
+            }
+
+            int index = 0;
+
+            do {
+                uint32_t next = 0;
+
+                if(c == '{') {
+                    std::string_view key;
+
+                    if(!reader.readString(key) || !reader.consume(':')) {
+                        return reader.fail();
+                    }
+
+                    for(uint32_t bits = deeper; bits != 0; bits &= bits - 1) {
+                        if(bindings[std::countr_zero(bits)].segment(depth) == key) {
+                            next |= bits & -bits;
+                        }
+                    }
+                }
+
+                else {
+                    for(uint32_t bits = deeper; bits != 0; bits &= bits - 1) {
+                        std::string_view segment = bindings[std::countr_zero(bits)].segment(depth);
+
+                        if(segment == "*" || segment_index(segment) == index) {
+                            next |= bits & -bits;
+                        }
+                    }
+
+                    index++;
+                }
+
+                if(!decode_value(reader, bindings, next, depth + 1)) {
+                    return false;
+                }
+            } while(reader.consume(','));
+
+            return reader.consume(c == '{' ? '}' : ']') || reader.fail();
+        }
+
+        Scalar value;
+
+        if(!reader.readScalar(value)) {
+            return false;
+        }
+
+        if(value.type == Scalar::Type::Null) {
+            return true;
+        }
+
+        //Assigned to every member at the path, values of another type are ignored.
+        for(uint32_t bits = exact; bits != 0; bits &= bits - 1) {
+            Binding& binding = bindings[std::countr_zero(bits)];
+
+            if(binding.assign != nullptr && binding.assign(value, binding.target)) {
+                binding.seen = true;
+            }
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,799 @@
+#include "library_index.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+static constexpr uint8_t magic[4] = {'L', 'I', 'B', 'X'};
+static constexpr size_t cursor_offset = 40;
+static constexpr size_t cursor_size = LibraryIndex::added_at_size + 8;
+static constexpr size_t id_size = 22;           ///< Base 62 digits of a Spotify ID.
+static constexpr size_t packed_id_size = 16;
+static constexpr uint8_t packed_flag = 0x40;
+
+//Base letters of U+00C0 to U+00FF, a space for the multiplication and division signs.
+static constexpr char latin1[] = "aaaaaaaceeeeiiiidnooooo ouuuuyts"
+                                 "aaaaaaaceeeeiiiidnooooo ouuuuyty";
+
+static constexpr char base62[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+static uint32_t get(const uint8_t* data, size_t bytes) {
+    uint32_t value = 0;
+
+    for(size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+static void put(uint8_t* data, uint32_t value, size_t bytes) {
+    for(size_t i = 0; i < bytes; i++) {
+        data[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static void append(std::vector<uint8_t>& out, uint32_t value) {
+    out.insert(out.end(), 4, 0);
+    put(&out[out.size() - 4], value, 4);
+}
+
+static uint32_t get_varint(const uint8_t*& p) {
+    uint32_t value = 0;
+
+    for(int shift = 0; shift < 35; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+
+        if((byte & 0x80) == 0) {
+            break;
+        }
+    }
+
+    return value;
+}
+
+static void put_varint(std::vector<uint8_t>& out, uint32_t value) {
+    while(value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void skip_varint(const uint8_t*& p) {
+    while(*p++ & 0x80) {
+    }
+}
+
+static uint32_t fnv1a(const uint8_t* data, size_t size) {
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t samples(uint32_t count) {
+    return (count + LibraryIndex::sample_interval - 1) / LibraryIndex::sample_interval;
+}
+
+//Bytes of the UTF-8 sequence starting with lead, 1 for stray continuation bytes.
+static size_t sequence_size(uint8_t lead) {
+    if(lead >= 0xF0 && lead < 0xF8) {
+        return 4;
+    }
+
+    if(lead >= 0xE0) {
+        return lead < 0xF0 ? 3 : 1;
+    }
+
+    return lead >= 0xC0 ? 2 : 1;
+}
+
+//Cuts text to at most size bytes without splitting a character.
+static std::string_view cut(std::string_view text, size_t size) {
+    if(text.size() <= size) {
+        return text;
+    }
+
+    while(size > 0 && (static_cast<uint8_t>(text[size]) & 0xC0) == 0x80) {
+        size--;
+    }
+
+    return text.substr(0, size);
+}
+
+//Spotify IDs are 128-bit numbers in 22 base 62 digits, stored as 16 bytes, most significant first.
+static bool pack_id(std::string_view id, uint8_t* out) {
+    std::memset(out, 0, packed_id_size);
+
+    if(id.size() != id_size) {
+        return false;
+    }
+
+    for(char c : id) {
+        const char* digit = std::strchr(base62, c);
+
+        if(c == 0 || digit == nullptr) {
+            return false;
+        }
+
+        uint32_t carry = static_cast<uint32_t>(digit - base62);
+
+        for(size_t i = packed_id_size; i-- > 0;) {
+            uint32_t value = out[i] * 62u + carry;
+            out[i] = static_cast<uint8_t>(value);
+            carry = value >> 8;
+        }
+
+        if(carry != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void unpack_id(const uint8_t* packed, std::string& id) {
+    uint8_t number[packed_id_size];
+
+    std::memcpy(number, packed, sizeof(number));
+    id.assign(id_size, '0');
+
+    for(size_t digit = id_size; digit-- > 0;) {
+        uint32_t remainder = 0;
+
+        for(size_t i = 0; i < packed_id_size; i++) {
+            uint32_t value = remainder << 8 | number[i];
+            number[i] = static_cast<uint8_t>(value / 62);
+            remainder = value % 62;
+        }
+
+        id[digit] = base62[remainder];
+    }
+}
+
+//Reads the next name of a block into key, which holds the previous one.
+static size_t next_name(const uint8_t*& p, char* key, bool first) {
+    size_t shared = first ? 0 : *p++;
+    size_t suffix = *p++;
+
+    std::memcpy(key + shared, p, suffix);
+    p += suffix;
+    return shared + suffix;
+}
+
+LibraryIndex::LibraryIndex() {
+    close();
+}
+
+bool LibraryIndex::open(const uint8_t* new_data, size_t size) {
+    close();
+
+    if(new_data == nullptr || size < header_size || std::memcmp(new_data, magic, sizeof(magic)) != 0 ||
+       get(new_data + 4, 2) != version || new_data[6] != block_keys || new_data[7] != sample_interval) {
+        return false;
+    }
+
+    uint32_t items = get(new_data + 8, 4);
+    uint32_t artists = get(new_data + 12, 4);
+    uint64_t item_table_offset = get(new_data + 16, 4);
+    uint64_t artist_table_offset = get(new_data + 20, 4);
+    uint64_t name_blocks_offset = get(new_data + 24, 4);
+    uint64_t artist_blocks_offset = get(new_data + 28, 4);
+    uint32_t file = get(new_data + 32, 4);
+
+    //The tables follow each other at the end of the file, block_keys equals sample_interval.
+    if(file > size || item_table_offset < header_size ||
+       artist_table_offset != item_table_offset + samples(items) * 4ull ||
+       name_blocks_offset != artist_table_offset + samples(artists) * 4ull ||
+       artist_blocks_offset != name_blocks_offset + samples(items) * 4ull ||
+       artist_blocks_offset + samples(artists) * 4ull != file) {
+        return false;
+    }
+
+    //Power lost while the file was written leaves a partial file.
+    if(fnv1a(new_data + header_size, file - header_size) != get(new_data + 36, 4)) {
+        return false;
+    }
+
+    data = new_data;
+    item_count = items;
+    artist_count = artists;
+    file_size = file;
+    item_table = data + item_table_offset;
+    artist_table = data + artist_table_offset;
+    name_blocks = data + name_blocks_offset;
+    artist_blocks = data + artist_blocks_offset;
+    return true;
+}
+
+void LibraryIndex::close() {
+    data = nullptr;
+    item_count = 0;
+    artist_count = 0;
+    file_size = 0;
+    item_table = nullptr;
+    artist_table = nullptr;
+    name_blocks = nullptr;
+    artist_blocks = nullptr;
+}
+
+bool LibraryIndex::isOpen() const {
+    return data != nullptr;
+}
+
+template<typename F>
+bool LibraryIndex::scan(const uint8_t* blocks, uint32_t count, std::string_view prefix, F found) const {
+    char name[max_name];
+    char key[max_key];
+    uint32_t block_count = samples(count);
+
+    //Names of a block are only compared once normalized, as they are sorted.
+    auto first_key = [&](uint32_t block) {
+        const uint8_t* p = data + get(blocks + block * 4, 4);
+        return std::string_view(key, normalize(std::string_view(reinterpret_cast<const char*>(p + 1), p[0]), key, sizeof(key)));
+    };
+
+    //The first block starting at or after the prefix, the matches may begin in the one before.
+    uint32_t low = 0;
+    uint32_t high = block_count;
+
+    while(low < high) {
+        uint32_t mid = low + (high - low) / 2;
+
+        if(first_key(mid) < prefix) {
+            low = mid + 1;
+        }
+
+        else {
+            high = mid;
+        }
+    }
+
+    for(uint32_t block = low > 0 ? low - 1 : 0; block < block_count; block++) {
+        const uint8_t* p = data + get(blocks + block * 4, 4);
+        uint32_t first = block * block_keys;
+        uint32_t names = std::min<uint32_t>(block_keys, count - first);
+
+        for(uint32_t i = 0; i < names; i++) {
+            size_t size = next_name(p, name, i == 0);
+            std::string_view current(key, normalize(std::string_view(name, size), key, sizeof(key)));
+
+            if(current.starts_with(prefix)) {
+                if(!found(first + i)) {
+                    return false;
+                }
+            }
+
+            //Sorted, nothing further can match.
+            else if(current > prefix) {
+                return true;
+            }
+        }
+    }
+
+    return true;
+}
+
+size_t LibraryIndex::search(std::string_view query, uint32_t* items, size_t max) const {
+    char buffer[max_key];
+    size_t count = 0;
+
+    if(data == nullptr || max == 0) {
+        return 0;
+    }
+
+    std::string_view prefix(buffer, normalize(query, buffer, sizeof(buffer)));
+
+    if(prefix.empty()) {
+        return 0;
+    }
+
+    auto add = [&](uint32_t item) {
+        if(std::find(items, items + count, item) == items + count) {
+            items[count++] = item;
+        }
+
+        return count < max;
+    };
+
+    bool more = scan(name_blocks, item_count, prefix, add);
+
+    if(more) {
+        scan(artist_blocks, artist_count, prefix, [&](uint32_t artist) {
+            const uint8_t* p = artist_record(artist);
+            uint32_t total = get_varint(p);
+            uint32_t item = 0;
+
+            for(uint32_t i = 0; i < total; i++) {
+                item += get_varint(p);
+
+                if(!add(item)) {
+                    return false;
+                }
+            }
+
+            return true;
+        });
+    }
+
+    return count;
+}
+
+void LibraryIndex::getItem(uint32_t id, Item& item) const {
+    const uint8_t* p = item_record(id);
+    uint8_t flags = *p++;
+
+    item.kind = static_cast<Kind>(flags & 0x03);
+    item.artist_count = std::min<uint8_t>((flags >> 2) & 0x0F, max_artists);
+
+    for(uint8_t i = 0; i < item.artist_count; i++) {
+        item.artists[i] = get_varint(p);
+    }
+
+    if(flags & packed_flag) {
+        unpack_id(p, item.id);
+    }
+
+    else {
+        item.id.assign(reinterpret_cast<const char*>(p + 1), p[0]);
+    }
+
+    read_name(name_blocks, id, item.name);
+}
+
+void LibraryIndex::getArtist(uint32_t id, std::string& name) const {
+    read_name(artist_blocks, id, name);
+}
+
+void LibraryIndex::getDetail(const Item& item, std::string& out) const {
+    std::string name;
+
+    out.clear();
+
+    for(uint8_t i = 0; i < item.artist_count; i++) {
+        if(i > 0) {
+            out += ", ";
+        }
+
+        getArtist(item.artists[i], name);
+        out += name;
+    }
+}
+
+uint32_t LibraryIndex::getItemCount() const {
+    return item_count;
+}
+
+uint32_t LibraryIndex::getArtistCount() const {
+    return artist_count;
+}
+
+uint32_t LibraryIndex::getFileSize() const {
+    return file_size;
+}
+
+LibraryIndex::Cursor LibraryIndex::getCursor(Kind kind) const {
+    Cursor cursor{};
+
+    if(data != nullptr) {
+        const uint8_t* p = data + cursor_offset + static_cast<size_t>(kind) * cursor_size;
+
+        std::memcpy(cursor.newest, p, added_at_size);
+        cursor.count = get(p + added_at_size, 4);
+        cursor.digest = get(p + added_at_size + 4, 4);
+    }
+
+    return cursor;
+}
+
+size_t LibraryIndex::normalize(std::string_view text, char* out, size_t size) {
+    size_t count = 0;
+    bool space = false;
+
+    for(size_t i = 0; i < text.size();) {
+        uint8_t c = static_cast<uint8_t>(text[i]);
+        size_t length = std::min(sequence_size(c), text.size() - i);
+        std::string_view copied;
+        char folded = 0;
+
+        if(c < 0x80) {
+            if((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+                folded = static_cast<char>(c);
+            }
+
+            else if(c >= 'A' && c <= 'Z') {
+                folded = static_cast<char>(c - 'A' + 'a');
+            }
+
+            //"Don't" matches "dont".
+            else if(c != '\'') {
+                space = true;
+            }
+        }
+
+        else if(c == 0xC3 && length == 2 && (static_cast<uint8_t>(text[i + 1]) & 0xC0) == 0x80) {
+            folded = latin1[static_cast<uint8_t>(text[i + 1]) - 0x80];
+        }
+
+        //U+2019 is the apostrophe of most titles.
+        else if(text.substr(i, length) != "\xE2\x80\x99") {
+            copied = text.substr(i, length);
+        }
+
+        if(folded == ' ') {
+            space = true;
+            folded = 0;
+        }
+
+        if(folded != 0) {
+            copied = std::string_view(&folded, 1);
+        }
+
+        i += length;
+
+        if(copied.empty()) {
+            continue;
+        }
+
+        size_t separator = space && count > 0 ? 1 : 0;
+
+        if(count + separator + copied.size() > size) {
+            break;
+        }
+
+        if(separator != 0) {
+            out[count++] = ' ';
+        }
+
+        space = false;
+        std::memcpy(out + count, copied.data(), copied.size());
+        count += copied.size();
+    }
+
+    return count;
+}
+
+const uint8_t* LibraryIndex::item_record(uint32_t id) const {
+    const uint8_t* p = data + get(item_table + (id / sample_interval) * 4, 4);
+
+    for(uint32_t i = 0; i < id % sample_interval; i++) {
+        uint8_t flags = *p++;
+
+        for(uint8_t j = 0; j < ((flags >> 2) & 0x0F); j++) {
+            skip_varint(p);
+        }
+
+        p += flags & packed_flag ? packed_id_size : 1 + p[0];
+    }
+
+    return p;
+}
+
+const uint8_t* LibraryIndex::artist_record(uint32_t id) const {
+    const uint8_t* p = data + get(artist_table + (id / sample_interval) * 4, 4);
+
+    for(uint32_t i = 0; i < id % sample_interval; i++) {
+        uint32_t items = get_varint(p);
+
+        for(uint32_t j = 0; j < items; j++) {
+            skip_varint(p);
+        }
+    }
+
+    return p;
+}
+
+void LibraryIndex::read_name(const uint8_t* blocks, uint32_t id, std::string& name) const {
+    char buffer[max_name];
+    const uint8_t* p = data + get(blocks + (id / block_keys) * 4, 4);
+    size_t size = 0;
+
+    for(uint32_t i = 0; i <= id % block_keys; i++) {
+        size = next_name(p, buffer, i == 0);
+    }
+
+    name.assign(buffer, size);
+}
+
+LibraryIndexBuilder::LibraryIndexBuilder() : seen_count(0), counts{}, cursors{} {
+}
+
+bool LibraryIndexBuilder::add(LibraryIndex::Kind kind, std::string_view name, const std::vector<std::string_view>& item_artists, std::string_view id) {
+    //FNV-1a over the kind and the id.
+    uint64_t hash = 14695981039346656037ull ^ static_cast<uint8_t>(kind);
+
+    for(char c : id) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+
+    if(!insert_seen(hash)) {
+        return false;
+    }
+
+    Entry entry;
+    size_t artist_total = std::min(item_artists.size(), LibraryIndex::max_artists);
+
+    entry.name = store(cut(name, LibraryIndex::max_name));
+    entry.key = store_key(name);
+    entry.id = store(cut(id, LibraryIndex::max_name));
+    entry.artists = static_cast<uint32_t>(artist_refs.size());
+    entry.artist_count = static_cast<uint8_t>(artist_total);
+    entry.kind = kind;
+
+    for(size_t i = 0; i < artist_total; i++) {
+        artist_refs.push_back(artist_id(item_artists[i]));
+    }
+
+    entries.push_back(entry);
+    counts[static_cast<size_t>(kind)]++;
+    return true;
+}
+
+size_t LibraryIndexBuilder::merge(const LibraryIndex& index, LibraryIndex::Kind kind) {
+    LibraryIndex::Item item;
+    std::vector<std::string> names;
+    std::vector<std::string_view> views;
+    size_t added = 0;
+
+    for(uint32_t i = 0; i < index.getItemCount(); i++) {
+        index.getItem(i, item);
+
+        if(item.kind != kind) {
+            continue;
+        }
+
+        names.resize(item.artist_count);
+        views.clear();
+
+        for(uint8_t j = 0; j < item.artist_count; j++) {
+            index.getArtist(item.artists[j], names[j]);
+            views.push_back(names[j]);
+        }
+
+        added += add(kind, item.name, views, item.id);
+    }
+
+    return added;
+}
+
+uint32_t LibraryIndexBuilder::getCount(LibraryIndex::Kind kind) const {
+    return counts[static_cast<size_t>(kind)];
+}
+
+void LibraryIndexBuilder::setCursor(LibraryIndex::Kind kind, const LibraryIndex::Cursor& cursor) {
+    cursors[static_cast<size_t>(kind)] = cursor;
+}
+
+void LibraryIndexBuilder::build(std::vector<uint8_t>& out) {
+    //Ids are the positions in name order.
+    std::vector<uint32_t> item_order(entries.size());
+    std::vector<uint32_t> artist_order(artists.size());
+    std::vector<uint32_t> artist_position(artists.size());
+
+    std::iota(item_order.begin(), item_order.end(), 0);
+    std::iota(artist_order.begin(), artist_order.end(), 0);
+
+    std::sort(item_order.begin(), item_order.end(), [this](uint32_t a, uint32_t b) {
+        return less(entries[a].key, entries[a].name, entries[b].key, entries[b].name);
+    });
+
+    std::sort(artist_order.begin(), artist_order.end(), [this](uint32_t a, uint32_t b) {
+        return less(artists[a].key, artists[a].name, artists[b].key, artists[b].name);
+    });
+
+    for(uint32_t i = 0; i < artist_order.size(); i++) {
+        artist_position[artist_order[i]] = i;
+    }
+
+    out.assign(LibraryIndex::header_size, 0);
+
+    std::vector<uint32_t> item_offsets;
+    std::vector<std::vector<uint32_t>> artist_items(artists.size());
+    std::vector<Text> names;
+
+    for(uint32_t i = 0; i < item_order.size(); i++) {
+        const Entry& entry = entries[item_order[i]];
+        uint8_t packed[packed_id_size];
+        bool is_packed = pack_id(view(entry.id), packed);
+
+        if(i % LibraryIndex::sample_interval == 0) {
+            item_offsets.push_back(static_cast<uint32_t>(out.size()));
+        }
+
+        out.push_back(static_cast<uint8_t>(static_cast<uint8_t>(entry.kind) | entry.artist_count << 2 | (is_packed ? packed_flag : 0)));
+
+        for(uint8_t j = 0; j < entry.artist_count; j++) {
+            uint32_t artist = artist_position[artist_refs[entry.artists + j]];
+            auto& list = artist_items[artist];
+
+            put_varint(out, artist);
+
+            if(list.empty() || list.back() != i) {
+                list.push_back(i);
+            }
+        }
+
+        if(is_packed) {
+            out.insert(out.end(), packed, packed + packed_id_size);
+        }
+
+        else {
+            out.push_back(entry.id.size);
+            out.insert(out.end(), text.begin() + entry.id.offset, text.begin() + entry.id.offset + entry.id.size);
+        }
+
+        names.push_back(entry.name);
+    }
+
+    std::vector<uint32_t> artist_offsets;
+
+    for(uint32_t i = 0; i < artist_items.size(); i++) {
+        uint32_t previous = 0;
+
+        if(i % LibraryIndex::sample_interval == 0) {
+            artist_offsets.push_back(static_cast<uint32_t>(out.size()));
+        }
+
+        put_varint(out, static_cast<uint32_t>(artist_items[i].size()));
+
+        for(uint32_t item : artist_items[i]) {
+            put_varint(out, item - previous);
+            previous = item;
+        }
+    }
+
+    std::vector<uint32_t> name_blocks;
+    std::vector<uint32_t> artist_blocks;
+
+    put_names(out, names, name_blocks);
+    names.clear();
+
+    for(uint32_t artist : artist_order) {
+        names.push_back(artists[artist].name);
+    }
+
+    put_names(out, names, artist_blocks);
+
+    uint32_t item_table_offset = static_cast<uint32_t>(out.size());
+    uint32_t artist_table_offset = item_table_offset + static_cast<uint32_t>(item_offsets.size()) * 4;
+    uint32_t name_blocks_offset = artist_table_offset + static_cast<uint32_t>(artist_offsets.size()) * 4;
+    uint32_t artist_blocks_offset = name_blocks_offset + static_cast<uint32_t>(name_blocks.size()) * 4;
+
+    for(const auto* table : {&item_offsets, &artist_offsets, &name_blocks, &artist_blocks}) {
+        for(uint32_t offset : *table) {
+            append(out, offset);
+        }
+    }
+
+    uint8_t* header = out.data();
+
+    std::memcpy(header, magic, sizeof(magic));
+    put(header + 4, LibraryIndex::version, 2);
+    header[6] = LibraryIndex::block_keys;
+    header[7] = LibraryIndex::sample_interval;
+    put(header + 8, static_cast<uint32_t>(entries.size()), 4);
+    put(header + 12, static_cast<uint32_t>(artists.size()), 4);
+    put(header + 16, item_table_offset, 4);
+    put(header + 20, artist_table_offset, 4);
+    put(header + 24, name_blocks_offset, 4);
+    put(header + 28, artist_blocks_offset, 4);
+    put(header + 32, static_cast<uint32_t>(out.size()), 4);
+
+    for(size_t i = 0; i < LibraryIndex::kind_count; i++) {
+        uint8_t* cursor = header + cursor_offset + i * cursor_size;
+
+        std::memcpy(cursor, cursors[i].newest, LibraryIndex::added_at_size);
+        put(cursor + LibraryIndex::added_at_size, cursors[i].count, 4);
+        put(cursor + LibraryIndex::added_at_size + 4, cursors[i].digest, 4);
+    }
+
+    put(header + 36, fnv1a(out.data() + LibraryIndex::header_size, out.size() - LibraryIndex::header_size), 4);
+}
+
+LibraryIndexBuilder::Text LibraryIndexBuilder::store(std::string_view value) {
+    Text stored{static_cast<uint32_t>(text.size()), static_cast<uint8_t>(value.size())};
+
+    text.insert(text.end(), value.begin(), value.end());
+    return stored;
+}
+
+LibraryIndexBuilder::Text LibraryIndexBuilder::store_key(std::string_view name) {
+    char key[LibraryIndex::max_key];
+    return store(std::string_view(key, LibraryIndex::normalize(name, key, sizeof(key))));
+}
+
+std::string_view LibraryIndexBuilder::view(const Text& value) const {
+    return std::string_view(text.data() + value.offset, value.size);
+}
+
+//The order searches rely on, equal keys by name so that front coding finds longer prefixes.
+bool LibraryIndexBuilder::less(const Text& key_a, const Text& name_a, const Text& key_b, const Text& name_b) const {
+    int order = view(key_a).compare(view(key_b));
+    return order != 0 ? order < 0 : view(name_a) < view(name_b);
+}
+
+bool LibraryIndexBuilder::insert_seen(uint64_t hash) {
+    //0 marks a free slot.
+    hash = hash != 0 ? hash : 1;
+
+    if((seen_count + 1) * 2 > seen.size()) {
+        std::vector<uint64_t> old(std::max<size_t>(seen.size() * 2, 1024), 0);
+
+        old.swap(seen);
+        seen_count = 0;
+
+        for(uint64_t value : old) {
+            if(value != 0) {
+                insert_seen(value);
+            }
+        }
+    }
+
+    size_t mask = seen.size() - 1;
+
+    for(size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        if(seen[slot] == hash) {
+            return false;
+        }
+
+        if(seen[slot] == 0) {
+            seen[slot] = hash;
+            seen_count++;
+            return true;
+        }
+    }
+}
+
+uint32_t LibraryIndexBuilder::artist_id(std::string_view name) {
+    char buffer[LibraryIndex::max_name];
+    std::string normalized(buffer, LibraryIndex::normalize(name, buffer, sizeof(buffer)));
+
+    if(normalized.empty()) {
+        normalized = name;
+    }
+
+    auto found = artist_ids.find(normalized);
+
+    if(found != artist_ids.end()) {
+        return found->second;
+    }
+
+    uint32_t id = static_cast<uint32_t>(artists.size());
+
+    artist_ids.emplace(std::move(normalized), id);
+    artists.push_back({store(cut(name, LibraryIndex::max_name)), store_key(name)});
+    return id;
+}
+
+void LibraryIndexBuilder::put_names(std::vector<uint8_t>& out, const std::vector<Text>& names, std::vector<uint32_t>& blocks) const {
+    std::string_view previous;
+
+    for(size_t i = 0; i < names.size(); i++) {
+        std::string_view name = view(names[i]);
+
+        if(i % LibraryIndex::block_keys == 0) {
+            blocks.push_back(static_cast<uint32_t>(out.size()));
+            out.push_back(static_cast<uint8_t>(name.size()));
+            out.insert(out.end(), name.begin(), name.end());
+        }
+
+        else {
+            size_t shared = 0;
+
+            while(shared < name.size() && shared < previous.size() && name[shared] == previous[shared]) {
+                shared++;
+            }
+
+            out.push_back(static_cast<uint8_t>(shared));
+            out.push_back(static_cast<uint8_t>(name.size() - shared));
+            out.insert(out.end(), name.begin() + shared, name.end());
+        }
+
+        previous = name;
+    }
+}
@@ -0,0 +1,329 @@
+#define DLOG_LOCAL_LEVEL CONFIG_SPOTIFY_LOG_LEVEL
+#include "library_sync.h"
+#include "deferred_log.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+static const char* TAG = "LibrarySync";
+
+static_assert(static_cast<int>(LibraryIndex::Kind::Track) == static_cast<int>(spotify::SearchType::Track) &&
+              static_cast<int>(LibraryIndex::Kind::Album) == static_cast<int>(spotify::SearchType::Album) &&
+              static_cast<int>(LibraryIndex::Kind::Playlist) == static_cast<int>(spotify::SearchType::Playlist),
+              "Kinds are stored as search types");
+
+static constexpr spotify::SearchType types[] = {spotify::SearchType::Track, spotify::SearchType::Album, spotify::SearchType::Playlist};
+static constexpr const char* uri_prefixes[] = {"spotify:track:", "spotify:album:", "spotify:playlist:"};
+
+static std::string_view newest(const LibraryIndex::Cursor& cursor) {
+    return std::string_view(cursor.newest, strnlen(cursor.newest, sizeof(cursor.newest)));
+}
+
+LibrarySync::LibrarySync(spotify::Client& client)
+    : client(client),
+      partition(nullptr),
+      mmap_handle(0),
+      mapped(nullptr),
+      stats{},
+      task_handle(nullptr) {
+
+    mtx = xSemaphoreCreateMutex();
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+
+    if(partition == nullptr) {
+        DLOGW(TAG, "No %s partition, the library is synced into RAM after every start", partition_label);
+    }
+
+    else if(!map()) {
+        DLOGE(TAG, "Mapping the %s partition failed", partition_label);
+    }
+
+    else if(index.open(mapped, partition->size)) {
+        stats.items = index.getItemCount();
+        stats.bytes = index.getFileSize();
+        DLOGI(TAG, "%lu saved items indexed", static_cast<unsigned long>(stats.items));
+    }
+
+    xTaskCreatePinnedToCore(sync_task_dummy,
+                            "Library",
+                            6144,
+                            this,
+                            1,
+                            &task_handle,
+                            CONFIG_NETWORK_TASK_CORE);
+}
+
+LibrarySync::~LibrarySync() {
+    vTaskDelete(task_handle);
+    index.close();
+
+    if(mapped != nullptr) {
+        esp_partition_munmap(mmap_handle);
+    }
+
+    vSemaphoreDelete(mtx);
+}
+
+size_t LibrarySync::search(std::string_view query, size_t max, std::vector<spotify::SearchResult>& results) {
+    std::array<uint32_t, max_results> found;
+    LibraryIndex::Item item;
+    int64_t start = esp_timer_get_time();
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    size_t count = index.search(query, found.data(), std::min(max, found.size()));
+
+    for(size_t i = 0; i < count; i++) {
+        index.getItem(found[i], item);
+
+        spotify::SearchResult& result = results.emplace_back();
+        result.type = static_cast<spotify::SearchType>(item.kind);
+        result.name = std::move(item.name);
+        index.getDetail(item, result.detail);
+        result.uri = uri_prefixes[static_cast<size_t>(item.kind)];
+        result.uri += item.id;
+    }
+
+    stats.search_us = esp_timer_get_time() - start;
+    xSemaphoreGive(mtx);
+
+    return count;
+}
+
+LibrarySync::Stats LibrarySync::getStats() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    Stats out = stats;
+    xSemaphoreGive(mtx);
+
+    return out;
+}
+
+void LibrarySync::sync_task_dummy(void *arg) {
+    auto obj = static_cast<LibrarySync*>(arg);
+    obj->sync_task();
+}
+
+void LibrarySync::sync_task() {
+    vTaskDelay(pdMS_TO_TICKS(first_sync_delay_ms));
+
+    while(1) {
+        bool success = sync(false);
+        vTaskDelay(pdMS_TO_TICKS(success ? CONFIG_LIBRARY_SYNC_INTERVAL_MIN * 60000 : retry_delay_ms));
+    }
+}
+
+bool LibrarySync::sync(bool full) {
+    int64_t start = esp_timer_get_time();
+    LibraryIndexBuilder builder;
+    std::array<uint32_t, LibraryIndex::kind_count> counts;
+    uint32_t requests = 0;
+    bool changed = !index.isOpen();
+
+    //Only this task changes the index, it is read here without the mutex.
+    for(auto type : types) {
+        auto kind = static_cast<LibraryIndex::Kind>(type);
+        LibraryIndex::Cursor previous = index.getCursor(kind);
+        LibraryIndex::Cursor cursor;
+        bool incremental = !full && index.isOpen() && type != spotify::SearchType::Playlist && previous.newest[0] != '\0';
+        int fresh = 0;
+
+        if(!fetch(type, incremental ? &previous : nullptr, builder, cursor, fresh, requests)) {
+            return false;
+        }
+
+        if(incremental) {
+            //Unless items were removed, the new ones add up to the new total.
+            if(cursor.count != previous.count + static_cast<uint32_t>(fresh)) {
+                DLOGI(TAG, "Saved items were removed, syncing all of them");
+                builder = LibraryIndexBuilder();
+                return sync(true);
+            }
+
+            builder.merge(index, kind);
+            changed = changed || fresh > 0;
+        }
+
+        else {
+            changed = changed || cursor.count != previous.count || cursor.digest != previous.digest;
+        }
+
+        builder.setCursor(kind, cursor);
+        counts[static_cast<size_t>(kind)] = builder.getCount(kind);
+    }
+
+    if(!changed) {
+        xSemaphoreTake(mtx, portMAX_DELAY);
+        stats.requests = requests;
+        stats.sync_us = esp_timer_get_time() - start;
+        xSemaphoreGive(mtx);
+
+        DLOGD(TAG, "Library unchanged, %lu requests", static_cast<unsigned long>(requests));
+        return true;
+    }
+
+    int64_t build_start = esp_timer_get_time();
+    std::vector<uint8_t> file;
+
+    builder.build(file);
+
+    //The items added take more than the file, free them before writing it.
+    builder = LibraryIndexBuilder();
+    int64_t build_us = esp_timer_get_time() - build_start;
+
+    store(file);
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    stats.items = index.getItemCount();
+    stats.bytes = index.getFileSize();
+    stats.syncs++;
+    stats.requests = requests;
+    stats.build_us = build_us;
+    stats.sync_us = esp_timer_get_time() - start;
+    Stats out = stats;
+    xSemaphoreGive(mtx);
+
+    DLOGI(TAG, "%lu items (%lu tracks, %lu albums, %lu playlists), %lu bytes, %lu requests, synced in %lld us, built in %lld us, written in %lld us",
+               static_cast<unsigned long>(out.items),
+               static_cast<unsigned long>(counts[0]),
+               static_cast<unsigned long>(counts[1]),
+               static_cast<unsigned long>(counts[2]),
+               static_cast<unsigned long>(out.bytes),
+               static_cast<unsigned long>(out.requests),
+               out.sync_us,
+               out.build_us,
+               out.write_us);
+
+    return true;
+}
+
+bool LibrarySync::fetch(spotify::SearchType type, const LibraryIndex::Cursor* since, LibraryIndexBuilder& builder,
+                        LibraryIndex::Cursor& cursor, int& fresh, uint32_t& requests) {
+    auto kind = static_cast<LibraryIndex::Kind>(type);
+    std::vector<std::string_view> artists;
+    uint32_t digest = 2166136261u;
+    bool older = false;
+    int total = 0;
+
+    cursor = since != nullptr ? *since : LibraryIndex::Cursor{};
+    fresh = 0;
+
+    for(int offset = 0; !older && (offset == 0 || offset < total); offset += spotify::Client::saved_page_limit) {
+        int received = 0;
+
+        bool success = client.getSavedItems(type, offset, [&](spotify::SavedItem&& item) {
+            std::string_view added_at = std::string_view(item.added_at).substr(0, LibraryIndex::added_at_size);
+
+            received++;
+
+            //Saved items come newest first, the rest of the list is in the index.
+            if(older || (since != nullptr && added_at <= newest(*since))) {
+                older = true;
+                return;
+            }
+
+            if(added_at > newest(cursor)) {
+                std::memset(cursor.newest, 0, sizeof(cursor.newest));
+                std::memcpy(cursor.newest, added_at.data(), added_at.size());
+            }
+
+            //FNV-1a over the IDs and names, for lists without saved times.
+            for(const std::string* text : {&item.id, &item.name}) {
+                for(char c : *text) {
+                    digest = (digest ^ static_cast<uint8_t>(c)) * 16777619u;
+                }
+            }
+
+            artists.assign(item.artists.begin(), item.artists.end());
+            builder.add(kind, item.name, artists, item.id);
+            fresh++;
+        }, total, Deadline::in(page_timeout_ms));
+
+        requests++;
+
+        if(!success) {
+            return false;
+        }
+
+        //The list got shorter while paging.
+        if(received == 0) {
+            break;
+        }
+    }
+
+    cursor.count = static_cast<uint32_t>(total);
+
+    //The digest of an incremental sync is that of the last full one.
+    if(since == nullptr) {
+        cursor.digest = digest;
+    }
+
+    return true;
+}
+
+void LibrarySync::store(std::vector<uint8_t>& file) {
+    int64_t start = esp_timer_get_time();
+
+    //Searched from PSRAM until the partition holds the new file.
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    pending.swap(file);
+    index.open(pending.data(), pending.size());
+    xSemaphoreGive(mtx);
+
+    if(partition == nullptr || pending.size() > partition->size) {
+        DLOGW(TAG, "The index of %u bytes does not fit the %s partition, it is kept in RAM",
+                   static_cast<unsigned>(pending.size()), partition_label);
+        return;
+    }
+
+    if(mapped != nullptr) {
+        esp_partition_munmap(mmap_handle);
+        mapped = nullptr;
+    }
+
+    //The header goes last, so an index cut short by a reset is not opened.
+    size_t erase_size = (pending.size() + partition->erase_size - 1) / partition->erase_size * partition->erase_size;
+    esp_err_t err = esp_partition_erase_range(partition, 0, erase_size);
+
+    if(err == ESP_OK) {
+        err = esp_partition_write(partition, LibraryIndex::header_size, pending.data() + LibraryIndex::header_size,
+                                  pending.size() - LibraryIndex::header_size);
+    }
+
+    if(err == ESP_OK) {
+        err = esp_partition_write(partition, 0, pending.data(), LibraryIndex::header_size);
+    }
+
+    if(err != ESP_OK) {
+        DLOGE(TAG, "Writing the %s partition failed: %s", partition_label, esp_err_to_name(err));
+        return;
+    }
+
+    if(!map()) {
+        DLOGE(TAG, "Mapping the %s partition failed", partition_label);
+        return;
+    }
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    if(index.open(mapped, partition->size)) {
+        std::vector<uint8_t>().swap(pending);
+    }
+
+    else {
+        DLOGE(TAG, "The index written to the %s partition does not open", partition_label);
+        index.open(pending.data(), pending.size());
+    }
+
+    stats.write_us = esp_timer_get_time() - start;
+    xSemaphoreGive(mtx);
+}
+
+bool LibrarySync::map() {
+    const void* ptr = nullptr;
+
+    if(esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &ptr, &mmap_handle) != ESP_OK) {
+        return false;
+    }
+
+    mapped = static_cast<const uint8_t*>(ptr);
+    return true;
+}
@@ -12,65 +12,107 @@
 #include "../include/spotify_client.h"
 #include "../include/wifi.h"
 #include "../include/http_client.h"
+#include "../include/track_list_view.h"
+#include "../include/player_store.h"
+#include "../include/album_art.h"
+#include "../include/task_stats.h"
+#include "../include/trace.h"
+#include "../include/deferred_log.h"
+#include "../include/metrics.h"
+#include "../include/metrics_server.h"
+#include "../include/player_snapshot.h"
+#include "../include/base64.h"
+#include "../include/base64_bench.h"
+#include "../include/text_layer.h"
+#include "../include/ui_bench.h"
+#include "../include/api_bench.h"
+#include "../include/flash_font.h"
+#include "../include/static_layer.h"
+#include "../include/panel_flush.h"
+#include "../include/touch_sampler.h"
+#include "../include/search_view.h"
+#include "../include/library_sync.h"
+#include "../include/mem_pool.h"
+#include "../include/power_governor.h"
+#include <memory>
+#include <string>
 
 static const char *TAG = "main";
 LGFX tft;
 
 static lv_display_t *disp = nullptr;
 static lv_indev_t *indev = nullptr;
-static lv_color16_t *lv_buf_1 = nullptr;
-static lv_color16_t *lv_buf_2 = nullptr;
+static uint8_t *lv_buf_1 = nullptr;
+static uint8_t *lv_buf_2 = nullptr;
+static PanelFlush *panel_flush = nullptr;
+static TouchSampler *touch_sampler = nullptr;
 
 static TaskHandle_t player_task_handle;
-
-static void lv_tick_task(void *arg) {
-    (void) arg;
-
-    lv_tick_inc(1);
+static TrackListView *track_list = nullptr;
+static PlayerStore player_store;
+static AlbumArt *album_art = nullptr;
+static TextLayer *title_layer = nullptr;
+static TextLayer *artists_layer = nullptr;
+static TextLayer *album_layer = nullptr;
+static FlashFont *flash_font = nullptr;
+#if CONFIG_UI_STATIC_LAYER
+static StaticLayer *static_layer = nullptr;
+#endif
+#if CONFIG_UI_SEARCH
+static SearchView *search_view = nullptr;
+#endif
+#if CONFIG_LIBRARY_SYNC
+static LibrarySync *library_sync = nullptr;
+#endif
+#if CONFIG_POWER_GOVERNOR
+static PowerGovernor *power_governor = nullptr;
+#endif
+
+//Read on demand instead of counted by a 1 ms timer, whose interrupts would keep the chip awake.
+static uint32_t lv_tick_cb() {
+    return static_cast<uint32_t>(esp_timer_get_time() / 1000);
 }
 
 /* Display flushing */
 void my_disp_flush( lv_display_t *disp, const lv_area_t *area, uint8_t* data) {
-    uint32_t w = lv_area_get_width(area);
-    uint32_t h = lv_area_get_height(area);
-    // lv_draw_sw_rgb565_swap(data, w*h);
-
-    // if (tft.getStartCount() == 0)
-    // {   // Processing if not yet started
-    //      tft.startWrite();
-    // }
-
-    // tft.pushImageDMA( area->x1
-    //     , area->y1
-    //     , area->x2 - area->x1 + 1
-    //     , area->y2 - area->y1 + 1
-    //     ,(uint16_t*) data); 
-
-    tft.startWrite();
-    tft.setAddrWindow(area->x1, area->y1, w, h);
-    tft.writePixels((lgfx::rgb565_t *)data, w * h);
-    tft.endWrite();
-
-    lv_display_flush_ready(disp);
-}
+    trace::Scope scope(trace::Id::LvglFlush);
+    int64_t start_us = esp_timer_get_time();
 
-void touch_driver_read(lv_indev_t *indev, lv_indev_data_t *data) {
-    uint16_t touchX, touchY;
-    bool touched = tft.getTouch( &touchX, &touchY);
+    panel_flush->flush(area, data);
 
-    if( !touched ) {
-        data->state = LV_INDEV_STATE_REL;
+    metrics::observeFlush(esp_timer_get_time() - start_us, lv_area_get_size(area));
+
+    //Deferred areas are still being sent, LVGL gets them back through my_disp_flush_wait.
+    if(!panel_flush->isDeferred()) {
+        lv_display_flush_ready(disp);
     }
 
-    else {
-        data->state = LV_INDEV_STATE_PR;
+    //The last transfer of the frame overlaps nothing, so the bus and its PM lock are released with it.
+    if(lv_display_flush_is_last(disp)) {
+        panel_flush->wait();
+    }
+}
+
+void my_disp_flush_wait(lv_display_t *disp) {
+    panel_flush->wait();
+}
 
-        data->point.x = touchX;
-        data->point.y = touchY;
+#if CONFIG_TRACE || CONFIG_METRICS
+static void refr_event_cb(lv_event_t * e) {
+    static int64_t refr_start_us = 0;
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if(code == LV_EVENT_REFR_START) {
+        trace::begin(trace::Id::LvglRender);
+        refr_start_us = esp_timer_get_time();
     }
 
-    data->continue_reading = false;
+    else if(code == LV_EVENT_REFR_READY) {
+        trace::end(trace::Id::LvglRender);
+        metrics::observeFrame(esp_timer_get_time() - refr_start_us);
+    }
 }
+#endif
 
 static void btn_event_cb(lv_event_t * e) {
     lv_event_code_t code = lv_event_get_code(e);
@@ -79,11 +121,101 @@ static void btn_event_cb(lv_event_t * e) {
     }
 }
 
+static void volume_slider_event_cb(lv_event_t * e) {
+    lv_event_code_t code = lv_event_get_code(e);
+    auto client = static_cast<spotify::Client*>(lv_event_get_user_data(e));
+    auto slider = static_cast<lv_obj_t*>(lv_event_get_target(e));
+
+    if(code == LV_EVENT_VALUE_CHANGED || code == LV_EVENT_RELEASED) {
+        client->setVolume(lv_slider_get_value(slider), code == LV_EVENT_RELEASED);
+    }
+}
+
+static void seek_slider_event_cb(lv_event_t * e) {
+    lv_event_code_t code = lv_event_get_code(e);
+    auto client = static_cast<spotify::Client*>(lv_event_get_user_data(e));
+    auto slider = static_cast<lv_obj_t*>(lv_event_get_target(e));
+
+    if(code == LV_EVENT_VALUE_CHANGED || code == LV_EVENT_RELEASED) {
+        //The slider works in permille of the track so its range survives track changes.
+        int position_ms = static_cast<int>(static_cast<int64_t>(client->getDuration()) * lv_slider_get_value(slider) / 1000);
+        client->seek(position_ms, code == LV_EVENT_RELEASED);
+    }
+}
+
+static TrackListView::PageFetcher queue_fetcher(spotify::Client *client) {
+    return [client](int offset, int limit, spotify::TrackPage& page) {
+        spotify::TrackPage queue;
+
+        if(!client->getQueue(queue)) {
+            return false;
+        }
+
+        //The queue is short and not paginated, so pages are sliced out of it.
+        page.offset = offset;
+        page.total = queue.total;
+
+        for(int i = offset; i < queue.total && i < offset + limit; i++) {
+            page.items.push_back(std::move(queue.items[i]));
+        }
+
+        return true;
+    };
+}
+
+static TrackListView::PageFetcher playlist_fetcher(spotify::Client *client) {
+    auto playlist_id = std::make_shared<std::string>();
+
+    return [client, playlist_id](int offset, int limit, spotify::TrackPage& page) {
+        constexpr std::string_view prefix = "spotify:playlist:";
+        constexpr uint32_t playlist_lookup_timeout_ms = 3000;
+
+        //The first page is always fetched first, so the playlist being played is looked up there.
+        if(offset == 0) {
+            std::string context_uri = client->getCurrentlyPlaying(Deadline::in(playlist_lookup_timeout_ms)).context_uri;
+            *playlist_id = context_uri.starts_with(prefix) ? context_uri.substr(prefix.size()) : "";
+        }
+
+        if(playlist_id->empty()) {
+            page.offset = offset;
+            page.total = 0;
+            return true;
+        }
+
+        return client->getPlaylistTracks(*playlist_id, offset, limit, page);
+    };
+}
+
+static void list_source_btn_event_cb(lv_event_t * e) {
+    static bool showing_playlist = false;
+
+    if(lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        auto client = static_cast<spotify::Client*>(lv_event_get_user_data(e));
+        auto btn = static_cast<lv_obj_t*>(lv_event_get_target(e));
+
+        showing_playlist = !showing_playlist;
+        track_list->setSource(showing_playlist ? playlist_fetcher(client) : queue_fetcher(client));
+        lv_label_set_text(lv_obj_get_child(btn, 0), showing_playlist ? "Playlist" : "Queue");
+    }
+}
+
+#if CONFIG_UI_SEARCH
+static void search_btn_event_cb(lv_event_t * e) {
+    if(lv_event_get_code(e) == LV_EVENT_CLICKED) {
+        search_view->show();
+    }
+}
+#endif
+
 static void lvgl_timer_task(void* arg) {
     while(1) {
         uint32_t time_till_next;
         time_till_next = lv_timer_handler(); /* lv_lock/lv_unlock is called internally */
+#if CONFIG_POWER_GOVERNOR
+        power_governor->wait(time_till_next);
+#else
         vTaskDelay(pdMS_TO_TICKS(time_till_next));
+#endif
     }
 }
 
@@ -102,6 +234,13 @@ static void player_task(void* arg) {
 
 extern "C" void app_main() {
 
+    mem::init();
+    trace::init();
+    dlog::init();
+    snapshot::benchmark();
+    base64::benchmark();
+    mem::benchmark();
+
     constexpr int screen_width = 480;
     constexpr int screen_height = 320;
     constexpr int lv_buffer_size = screen_width * screen_height/10;
@@ -112,6 +251,12 @@ extern "C" void app_main() {
 
     ESP_ERROR_CHECK(wifi_sta.connect());
 
+    api_bench::run();
+
+#if CONFIG_METRICS
+    static MetricsServer metrics_server(CONFIG_METRICS_PORT);
+#endif
+
     spotify::Client client;
 
     tft.begin();
@@ -120,34 +265,48 @@ extern "C" void app_main() {
     uint16_t calData[] = {191, 3913, 207, 289, 3748, 3901, 3799, 256};
     tft.setTouchCalibrate(calData);
 
-    lv_buf_1 = (lv_color16_t *)heap_caps_malloc(lv_buffer_size * sizeof(lv_color16_t), MALLOC_CAP_DMA);
-    lv_buf_2 = (lv_color16_t *)heap_caps_malloc(lv_buffer_size * sizeof(lv_color16_t), MALLOC_CAP_DMA);
+    PanelFlush::benchmark(tft);
+    panel_flush = new PanelFlush(tft, PanelFlush::configuredMode());
+
+    uint32_t lv_buffer_bytes = lv_buffer_size * lv_color_format_get_size(panel_flush->getColorFormat());
+    lv_buf_1 = (uint8_t *)mem::allocate(lv_buffer_bytes, mem::Region::Dma);
+    lv_buf_2 = (uint8_t *)mem::allocate(lv_buffer_bytes, mem::Region::Dma);
 
     lv_init();
+    ui_bench::run();
+
+    flash_font = new FlashFont();
+    flash_font->benchmark();
+
     disp = lv_display_create(screen_width,screen_height);
     lv_display_set_flush_cb(disp, my_disp_flush);
-    lv_display_set_buffers(disp, lv_buf_1, lv_buf_2, lv_buffer_size, LV_DISPLAY_RENDER_MODE_PARTIAL );
+    lv_display_set_flush_wait_cb(disp, my_disp_flush_wait);
+    lv_display_set_color_format(disp, panel_flush->getColorFormat());
+    lv_display_set_buffers(disp, lv_buf_1, lv_buf_2, lv_buffer_bytes, LV_DISPLAY_RENDER_MODE_PARTIAL );
+#if CONFIG_TRACE || CONFIG_METRICS
+    lv_display_add_event_cb(disp, refr_event_cb, LV_EVENT_ALL, nullptr);
+#endif
 
     indev = lv_indev_create();
     lv_indev_set_type(indev,LV_INDEV_TYPE_POINTER);
-    lv_indev_set_read_cb(indev,touch_driver_read);
-
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &lv_tick_task,
-        .name = "periodic_gui"
-    };
+    touch_sampler = new TouchSampler(tft, *panel_flush, indev, CONFIG_TOUCH_IRQ_PIN);
+#if CONFIG_POWER_GOVERNOR
+    power_governor = new PowerGovernor(tft, *panel_flush, disp, indev, *touch_sampler);
+#endif
 
-    esp_timer_handle_t periodic_timer;
-    ESP_ERROR_CHECK(esp_timer_create(&periodic_timer_args, &periodic_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(periodic_timer, 1000));
+    lv_tick_set_cb(lv_tick_cb);
     
+#if CONFIG_TASK_STATS
+    static TaskStats task_stats(CONFIG_TASK_STATS_INTERVAL_MS);
+#endif
+
     xTaskCreatePinnedToCore(player_task,
                             "Player Control",
                             4096,
                             &client,
                             2,
                             &player_task_handle,
-                            0);
+                            CONFIG_NETWORK_TASK_CORE);
 
     xTaskCreatePinnedToCore(lvgl_timer_task,
         "LVGL Timer",
@@ -155,9 +314,16 @@ extern "C" void app_main() {
         nullptr,
         2,
         nullptr,
-        0);
+        CONFIG_UI_TASK_CORE);
 
     lv_lock();
+#if CONFIG_UI_STATIC_LAYER
+    static_layer = new StaticLayer(lv_screen_active());
+    lv_obj_t * static_parent = static_layer->getContent();
+#else
+    lv_obj_t * static_parent = lv_screen_active();
+#endif
+
     lv_obj_t * btn = lv_button_create(lv_screen_active());     /*Add a button the current screen*/
     lv_obj_align(btn, LV_ALIGN_CENTER,0,0);                         /*Set its position*/
     lv_obj_set_size(btn, 120, 50);                          /*Set its size*/
@@ -166,13 +332,141 @@ extern "C" void app_main() {
     lv_obj_t * label = lv_label_create(btn);          /*Add a label to the button*/
     lv_label_set_text(label, "Button");                     /*Set the labels text*/
     lv_obj_center(label);
+
+    lv_obj_t * volume_slider = lv_slider_create(lv_screen_active());
+    lv_obj_align(volume_slider, LV_ALIGN_BOTTOM_MID, 0, -60);
+    lv_obj_set_width(volume_slider, 300);
+    lv_slider_set_range(volume_slider, 0, 100);
+    lv_obj_add_event_cb(volume_slider, volume_slider_event_cb, LV_EVENT_ALL, &client);
+
+    lv_obj_t * seek_slider = lv_slider_create(lv_screen_active());
+    lv_obj_align(seek_slider, LV_ALIGN_BOTTOM_MID, 0, -20);
+    lv_obj_set_width(seek_slider, 400);
+    lv_slider_set_range(seek_slider, 0, 1000);
+    lv_obj_add_event_cb(seek_slider, seek_slider_event_cb, LV_EVENT_ALL, &client);
+
+    track_list = new TrackListView(lv_screen_active(), 180, 230);
+    lv_obj_align(track_list->getObj(), LV_ALIGN_TOP_RIGHT, 0, 0);
+    track_list->setSource(queue_fetcher(&client));
+
+    lv_obj_t * list_source_btn = lv_button_create(lv_screen_active());
+    lv_obj_align(list_source_btn, LV_ALIGN_TOP_LEFT, 10, 10);
+    lv_obj_set_size(list_source_btn, 100, 40);
+    lv_obj_add_event_cb(list_source_btn, list_source_btn_event_cb, LV_EVENT_ALL, &client);
+
+    lv_obj_t * list_source_label = lv_label_create(list_source_btn);
+    lv_label_set_text(list_source_label, "Queue");
+    lv_obj_center(list_source_label);
+
+#if CONFIG_UI_SEARCH
+    //The view covers the whole screen while it is shown.
+#if CONFIG_LIBRARY_SYNC
+    library_sync = new LibrarySync(client);
+    search_view = new SearchView(lv_layer_top(), client, library_sync);
+#else
+    search_view = new SearchView(lv_layer_top(), client);
+#endif
+
+    lv_obj_t * search_btn = lv_button_create(lv_screen_active());
+    lv_obj_align(search_btn, LV_ALIGN_TOP_LEFT, 120, 10);
+    lv_obj_set_size(search_btn, 80, 40);
+    lv_obj_add_event_cb(search_btn, search_btn_event_cb, LV_EVENT_ALL, nullptr);
+
+    lv_obj_t * search_label = lv_label_create(search_btn);
+    lv_label_set_text(search_label, "Search");
+    lv_obj_center(search_label);
+#endif
+
+    album_art = new AlbumArt(static_parent, client, player_store);
+    lv_obj_align(album_art->getObj(), LV_ALIGN_TOP_LEFT, 10, 60);
+
+    title_layer = new TextLayer(lv_screen_active(), 110, flash_font->get(), lv_color_black());
+    lv_obj_align(title_layer->getObj(), LV_ALIGN_TOP_LEFT, 180, 60);
+
+    artists_layer = new TextLayer(lv_screen_active(), 110, flash_font->get(), lv_color_hex(0x606060));
+    lv_obj_align(artists_layer->getObj(), LV_ALIGN_TOP_LEFT, 180, 85);
+
+    album_layer = new TextLayer(lv_screen_active(), 110, flash_font->get(), lv_color_hex(0x606060));
+    lv_obj_align(album_layer->getObj(), LV_ALIGN_TOP_LEFT, 180, 110);
+
+#if CONFIG_UI_ART_THEME
+    album_art->setPaletteListener([=](const Palette& palette) {
+        lv_color_t accent = lv_color_hex(palette.accent);
+
+        //The background is static content, composed again on the next refresh.
+        lv_obj_set_style_bg_color(static_parent, lv_color_hex(palette.background), 0);
+        lv_obj_send_event(static_parent, LV_EVENT_REFRESH, nullptr);
+
+        title_layer->setColor(lv_color_hex(palette.text));
+        artists_layer->setColor(lv_color_hex(palette.secondary));
+        album_layer->setColor(lv_color_hex(palette.secondary));
+
+        for(lv_obj_t * slider : {volume_slider, seek_slider}) {
+            lv_obj_set_style_bg_color(slider, accent, LV_PART_INDICATOR);
+            lv_obj_set_style_bg_color(slider, accent, LV_PART_KNOB);
+        }
+    });
+#endif
     lv_unlock();
 
-    TickType_t api_request_time;
+    //The layers render on the LVGL task, the listener only hands the strings over.
+    player_store.subscribe([](const spotify::Track& track, int64_t changed_us) {
+        std::string artists;
+
+        for(const auto& artist : track.artists) {
+            if(!artists.empty()) {
+                artists += ", ";
+            }
+
+            artists += artist;
+        }
+
+        title_layer->setText(track.name);
+        artists_layer->setText(artists);
+        album_layer->setText(track.album_name);
+
+#if CONFIG_POWER_GOVERNOR
+        power_governor->wake();
+#endif
+    });
+
+    int64_t last_poll_us = 0;
+
+    //A poll slower than this is dropped, the next one is due by then anyway.
+    constexpr uint32_t poll_timeout_ms = 2000;
 
     while(1) {
 
-        // api_request_time = xTaskGetTickCount();
+#if !CONFIG_RELAY
+        //Only paces the polling without the relay, which wakes the loop itself.
+        TickType_t api_request_time = xTaskGetTickCount();
+#endif
+
+        int64_t poll_us = esp_timer_get_time();
+
+        if(last_poll_us != 0) {
+            metrics::observePollInterval(poll_us - last_poll_us);
+        }
+
+        last_poll_us = poll_us;
+
+        spotify::Track current = client.getCurrentlyPlaying(client.pollDeadline(poll_timeout_ms));
+
+        if(!current.uri.empty()) {
+            player_store.update(current);
+        }
+
+        uint32_t poll_period_ms = 1000;
+
+#if CONFIG_POWER_GOVERNOR
+        //A failed poll leaves the last known play state.
+        power_governor->setPlaying(client.getPlayState() == spotify::PlayState::Playing);
+
+        //Nothing shows the player while blank, a change still wakes the screen on the next poll.
+        if(power_governor->isBlank()) {
+            poll_period_ms = CONFIG_POWER_IDLE_POLL_MS;
+        }
+#endif
 
         // ESP_LOGI(TAG, "Free Heap Space %u", (unsigned int)esp_get_free_heap_size());
 
@@ -190,10 +484,14 @@ extern "C" void app_main() {
         // printf("Duration %dms\n",track.duration_ms);
         // printf("Album Pic: %s\n", track.album_pic_url.c_str());
 
-        // vTaskDelayUntil(&api_request_time,pdMS_TO_TICKS(1000));
+#if CONFIG_RELAY
+        //Pushed changes wake the loop right away, the timeout keeps the fallback polling going.
+        client.waitForRelayUpdate(pdMS_TO_TICKS(poll_period_ms));
+#else
+        vTaskDelayUntil(&api_request_time,pdMS_TO_TICKS(poll_period_ms));
+#endif
         // uint32_t time_till_next;
         // time_till_next = lv_timer_handler(); /* lv_lock/lv_unlock is called internally */
         // vTaskDelay(pdMS_TO_TICKS(time_till_next));
-        vTaskDelay(pdMS_TO_TICKS(10));
     }
 }
@@ -0,0 +1,616 @@
+#include "mem_pool.h"
+#include "cJSON.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if CONFIG_METRICS
+#include "metrics.h"
+#endif
+
+#if CONFIG_BOOT_BENCHMARKS
+#include "esp_timer.h"
+#endif
+
+#if CONFIG_LV_USE_CUSTOM_MALLOC
+#include "lvgl.h"
+#endif
+
+namespace mem {
+
+    static const char* TAG = "Mem";
+
+    static constexpr size_t alignment = 8;
+    static constexpr size_t json_arena_count = 3;   ///< Tasks parsing at once: the API, search and library tasks.
+    static constexpr const char* json_arena_names[json_arena_count] = {"json0", "json1", "json2"};
+    static constexpr const char* region_names[region_count] = {"internal", "dma", "psram"};
+    static constexpr uint32_t region_caps[region_count] = {MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_DMA, MALLOC_CAP_SPIRAM};
+
+    static std::array<std::atomic<uint32_t>, region_count> placements;
+    static Pool* small_pool = nullptr;
+    static std::array<Arena*, json_arena_count> json_arenas = {};
+    static std::array<bool, json_arena_count> json_busy = {};
+    static portMUX_TYPE json_lock = portMUX_INITIALIZER_UNLOCKED;
+    static thread_local Arena* json_bound = nullptr;
+
+    static size_t align(size_t size) {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    void* allocate(size_t size, Region region) {
+        void* ptr = nullptr;
+
+        switch(region) {
+        case Region::Internal:
+            ptr = heap_caps_malloc_prefer(size, 2, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_DEFAULT);
+            break;
+        case Region::Dma:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_DMA);
+            break;
+        case Region::Psram:
+            ptr = heap_caps_malloc_prefer(size, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+            break;
+        }
+
+        placements[static_cast<size_t>(region)].fetch_add(1, std::memory_order_relaxed);
+        return ptr;
+    }
+
+    void deallocate(void* ptr) {
+        heap_caps_free(ptr);
+    }
+
+    Pool::Pool(const char* name, Region region, std::initializer_list<Class> classes)
+        : name(name),
+          storage(nullptr),
+          slabs{},
+          slab_count(0),
+          lock(portMUX_INITIALIZER_UNLOCKED),
+          stats{} {
+
+        size_t total = 0;
+
+        for(const Class& cls : classes) {
+            total += cls.block_size * cls.blocks;
+        }
+
+        storage = static_cast<uint8_t*>(allocate(total, region));
+
+        if(storage == nullptr) {
+            ESP_LOGW(TAG, "No memory for the %u bytes of the %s pool, it allocates from the heap", static_cast<unsigned>(total), name);
+            return;
+        }
+
+        uint8_t* begin = storage;
+
+        for(const Class& cls : classes) {
+            if(slab_count == max_classes) {
+                break;
+            }
+
+            Slab& slab = slabs[slab_count++];
+            slab.begin = begin;
+            slab.end = begin + cls.block_size * cls.blocks;
+            slab.block_size = cls.block_size;
+            slab.free = nullptr;
+
+            //Threaded back to front, so blocks are handed out in address order.
+            for(uint8_t* block = slab.end; block > slab.begin;) {
+                block -= cls.block_size;
+                auto free_block = reinterpret_cast<Free*>(block);
+                free_block->next = slab.free;
+                slab.free = free_block;
+            }
+
+            begin = slab.end;
+        }
+
+        stats.capacity = total;
+    }
+
+    Pool::~Pool() {
+        deallocate(storage);
+    }
+
+    void* Pool::alloc(size_t size) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        void* ptr = nullptr;
+
+        portENTER_CRITICAL(&lock);
+
+        for(size_t i = 0; i < slab_count; i++) {
+            if(slabs[i].block_size < size) {
+                continue;
+            }
+
+            //The smallest class that fits, or the next one up.
+            for(size_t j = i; j < std::min(i + 2, slab_count) && ptr == nullptr; j++) {
+                Slab& slab = slabs[j];
+
+                if(slab.free != nullptr) {
+                    ptr = slab.free;
+                    slab.free = slab.free->next;
+                    stats.used += slab.block_size;
+                    stats.peak = std::max(stats.peak, stats.used);
+                    stats.requested += size;
+                    stats.granted += slab.block_size;
+                }
+            }
+
+            break;
+        }
+
+        if(ptr != nullptr) {
+            uint32_t cycles = esp_cpu_get_cycle_count() - start;
+            stats.allocations++;
+            stats.cycles += cycles;
+            stats.max_cycles = std::max(stats.max_cycles, cycles);
+        }
+
+        portEXIT_CRITICAL(&lock);
+
+        if(ptr != nullptr) {
+            return ptr;
+        }
+
+        //Heap allocations can block, they are made outside of the critical section.
+        ptr = allocate(std::max<size_t>(size, 1), size >= bulk_threshold ? Region::Psram : Region::Internal);
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+        portENTER_CRITICAL(&lock);
+        stats.allocations++;
+        stats.overflows++;
+        stats.cycles += cycles;
+        stats.max_cycles = std::max(stats.max_cycles, cycles);
+        portEXIT_CRITICAL(&lock);
+
+        return ptr;
+    }
+
+    void* Pool::realloc(void* ptr, size_t size) {
+        if(ptr == nullptr) {
+            return alloc(size);
+        }
+
+        Slab* slab = find(ptr);
+        size_t old_size = slab != nullptr ? slab->block_size : heap_caps_get_allocated_size(ptr);
+
+        if(slab != nullptr && size <= old_size) {
+            return ptr;
+        }
+
+        void* moved = alloc(size);
+
+        if(moved != nullptr) {
+            std::memcpy(moved, ptr, std::min(old_size, size));
+            free(ptr);
+        }
+
+        return moved;
+    }
+
+    void Pool::free(void* ptr) {
+        if(ptr == nullptr) {
+            return;
+        }
+
+        Slab* slab = find(ptr);
+
+        if(slab == nullptr) {
+            deallocate(ptr);
+            return;
+        }
+
+        portENTER_CRITICAL(&lock);
+        auto block = static_cast<Free*>(ptr);
+        block->next = slab->free;
+        slab->free = block;
+        stats.used -= slab->block_size;
+        portEXIT_CRITICAL(&lock);
+    }
+
+    bool Pool::owns(const void* ptr) const {
+        return slab_count > 0 && ptr >= slabs[0].begin && ptr < slabs[slab_count - 1].end;
+    }
+
+    Stats Pool::getStats() {
+        portENTER_CRITICAL(&lock);
+        Stats out = stats;
+        portEXIT_CRITICAL(&lock);
+
+        return out;
+    }
+
+    const char* Pool::getName() const {
+        return name;
+    }
+
+    Pool::Slab* Pool::find(const void* ptr) {
+        //The bounds of the classes never change, no lock needed.
+        if(!owns(ptr)) {
+            return nullptr;
+        }
+
+        for(size_t i = 0; i < slab_count; i++) {
+            if(ptr < slabs[i].end) {
+                return &slabs[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    Arena::Arena(const char* name, size_t chunk_size, Region region)
+        : name(name),
+          chunk_size(chunk_size),
+          first(nullptr),
+          current(nullptr),
+          offset(0),
+          used(0),
+          stats{} {
+
+        first = static_cast<Chunk*>(allocate(sizeof(Chunk) + chunk_size, region));
+
+        if(first == nullptr) {
+            ESP_LOGW(TAG, "No memory for the %u byte chunk of the %s arena", static_cast<unsigned>(chunk_size), name);
+            return;
+        }
+
+        first->next = nullptr;
+        first->size = chunk_size;
+        current = first;
+        stats.capacity = chunk_size;
+    }
+
+    Arena::~Arena() {
+        reset();
+        deallocate(first);
+    }
+
+    uint8_t* Arena::data(Chunk* chunk) {
+        return reinterpret_cast<uint8_t*>(chunk) + sizeof(Chunk);
+    }
+
+    void* Arena::alloc(size_t size) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        size = align(std::max<size_t>(size, 1));
+
+        if(current == nullptr || size > current->size - offset) {
+            size_t data_size = std::max(chunk_size, size);
+            auto chunk = static_cast<Chunk*>(allocate(sizeof(Chunk) + data_size, Region::Psram));
+
+            if(chunk == nullptr) {
+                return nullptr;
+            }
+
+            chunk->next = current;
+            chunk->size = data_size;
+            current = chunk;
+            offset = 0;
+            stats.overflows++;
+        }
+
+        void* ptr = data(current) + offset;
+        offset += size;
+        used += size;
+
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        stats.used = used;
+        stats.peak = std::max(stats.peak, used);
+        stats.allocations++;
+        stats.requested += size;
+        stats.granted += size;
+        stats.cycles += cycles;
+        stats.max_cycles = std::max(stats.max_cycles, cycles);
+
+        return ptr;
+    }
+
+    bool Arena::owns(const void* ptr) const {
+        for(Chunk* chunk = current; chunk != nullptr; chunk = chunk->next) {
+            if(ptr >= data(chunk) && ptr < data(chunk) + chunk->size) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Arena::reset() {
+        while(current != first) {
+            Chunk* next = current->next;
+            deallocate(current);
+            current = next;
+        }
+
+        offset = 0;
+        used = 0;
+        stats.used = 0;
+    }
+
+    Stats Arena::getStats() const {
+        return stats;
+    }
+
+    const char* Arena::getName() const {
+        return name;
+    }
+
+    static void* json_malloc(size_t size) {
+        if(json_bound != nullptr) {
+            return json_bound->alloc(size);
+        }
+
+        return small_pool->alloc(size);
+    }
+
+    static void json_free(void* ptr) {
+        //Freed with the arena when the scope ends.
+        if(json_bound != nullptr && json_bound->owns(ptr)) {
+            return;
+        }
+
+        small_pool->free(ptr);
+    }
+
+    JsonScope::JsonScope() : arena(nullptr) {
+        if(json_bound != nullptr) {
+            return;
+        }
+
+        portENTER_CRITICAL(&json_lock);
+
+        for(size_t i = 0; i < json_arena_count; i++) {
+            if(json_arenas[i] != nullptr && !json_busy[i]) {
+                json_busy[i] = true;
+                arena = json_arenas[i];
+                break;
+            }
+        }
+
+        portEXIT_CRITICAL(&json_lock);
+
+        json_bound = arena;
+    }
+
+    JsonScope::~JsonScope() {
+        if(arena == nullptr) {
+            return;
+        }
+
+        json_bound = nullptr;
+        arena->reset();
+
+        portENTER_CRITICAL(&json_lock);
+
+        for(size_t i = 0; i < json_arena_count; i++) {
+            if(json_arenas[i] == arena) {
+                json_busy[i] = false;
+            }
+        }
+
+        portEXIT_CRITICAL(&json_lock);
+    }
+
+    void init() {
+#if CONFIG_MEM_POOLS
+        //Sized for LVGL's objects, styles and labels, and the odd cJSON document outside of a scope.
+        small_pool = new Pool("small", Region::Internal, {{16, 512}, {32, 384}, {64, 192}, {128, 64}, {256, 24}, {512, 8}});
+
+        for(size_t i = 0; i < json_arena_count; i++) {
+            json_arenas[i] = new Arena(json_arena_names[i], CONFIG_MEM_JSON_ARENA_KB * 1024, Region::Internal);
+        }
+
+        cJSON_Hooks hooks = {
+            .malloc_fn = json_malloc,
+            .free_fn = json_free
+        };
+
+        cJSON_InitHooks(&hooks);
+#endif
+    }
+
+    Pool* small() {
+        return small_pool;
+    }
+
+#if CONFIG_METRICS
+    static void render_pool(std::string& out, const char* name, const Stats& stats, bool first) {
+        std::string label = std::string("pool=\"") + name + "\"";
+        double slack = stats.granted > 0 ? 1.0 - static_cast<double>(stats.requested) / stats.granted : 0;
+        double cycles = stats.allocations > 0 ? static_cast<double>(stats.cycles) / stats.allocations : 0;
+
+        metrics::renderGauge(out, "spotify_pool_capacity_bytes", first ? "Bytes kept by the pool." : "", label, stats.capacity);
+        metrics::renderGauge(out, "spotify_pool_used_bytes", first ? "Bytes of the pool in use." : "", label, stats.used);
+        metrics::renderGauge(out, "spotify_pool_peak_bytes", first ? "Most bytes of the pool in use since boot." : "", label, stats.peak);
+        metrics::renderGauge(out, "spotify_pool_allocations", first ? "Allocations since boot." : "", label, stats.allocations);
+        metrics::renderGauge(out, "spotify_pool_overflows", first ? "Allocations that went to the heap, or further arena chunks." : "", label, stats.overflows);
+        metrics::renderGauge(out, "spotify_pool_slack_ratio", first ? "Share of the bytes handed out that were not asked for." : "", label, slack);
+        metrics::renderGauge(out, "spotify_pool_alloc_cycles_avg", first ? "Average CPU cycles per allocation." : "", label, cycles);
+        metrics::renderGauge(out, "spotify_pool_alloc_cycles_max", first ? "Longest allocation in CPU cycles." : "", label, stats.max_cycles);
+    }
+
+    void render(std::string& out) {
+        if(small_pool != nullptr) {
+            render_pool(out, small_pool->getName(), small_pool->getStats(), true);
+        }
+
+        //Read without the lock, the values of an arena in use may be a moment old.
+        for(size_t i = 0; i < json_arena_count; i++) {
+            if(json_arenas[i] != nullptr) {
+                render_pool(out, json_arenas[i]->getName(), json_arenas[i]->getStats(), small_pool == nullptr && i == 0);
+            }
+        }
+
+        for(size_t i = 0; i < region_count; i++) {
+            multi_heap_info_t info;
+            heap_caps_get_info(&info, region_caps[i]);
+
+            std::string label = std::string("region=\"") + region_names[i] + "\"";
+            double fragmentation = info.total_free_bytes > 0 ? 1.0 - static_cast<double>(info.largest_free_block) / info.total_free_bytes : 0;
+
+            metrics::renderGauge(out, "spotify_heap_region_free_bytes", i == 0 ? "Free bytes of the heap region." : "", label, info.total_free_bytes);
+            metrics::renderGauge(out, "spotify_heap_region_min_free_bytes", i == 0 ? "Lowest free bytes of the heap region since boot." : "", label, info.minimum_free_bytes);
+            metrics::renderGauge(out, "spotify_heap_region_fragmentation_ratio", i == 0 ? "Share of the free bytes outside the largest free block." : "", label, fragmentation);
+            metrics::renderGauge(out, "spotify_heap_region_placements", i == 0 ? "Allocations placed in the region by policy since boot." : "", label,
+                                 placements[i].load(std::memory_order_relaxed));
+        }
+    }
+#endif
+
+#if CONFIG_BOOT_BENCHMARKS
+    static constexpr int bench_rounds = 200;
+    static constexpr size_t bench_batch = 64;
+    static constexpr size_t bench_sizes[] = {24, 40, 40, 16, 64, 120, 40, 200};   ///< A mix of cJSON nodes, strings and LVGL objects.
+    static constexpr int bench_items = 20;
+
+    static void search_page(std::string& out) {
+        out = "{\"tracks\":{\"items\":[";
+
+        for(int i = 0; i < bench_items; i++) {
+            out += i > 0 ? "," : "";
+            out += "{\"album\":{\"name\":\"Album name " + std::to_string(i) + "\",\"images\":["
+                   "{\"url\":\"https://i.scdn.co/image/ab67616d0000b2730000000000000000000000\",\"height\":640,\"width\":640},"
+                   "{\"url\":\"https://i.scdn.co/image/ab67616d00001e020000000000000000000000\",\"height\":300,\"width\":300}]},"
+                   "\"artists\":[{\"name\":\"Artist name\",\"id\":\"0000000000000000000000\"}],"
+                   "\"duration_ms\":215000,\"id\":\"0000000000000000000000\",\"name\":\"Track name " + std::to_string(i) + "\","
+                   "\"popularity\":50,\"uri\":\"spotify:track:0000000000000000000000\"}";
+        }
+
+        out += "],\"total\":1000}}";
+    }
+
+    template<typename Alloc, typename Free>
+    static int64_t time_batches(Alloc alloc, Free free) {
+        std::array<void*, bench_batch> ptrs;
+        int64_t start = esp_timer_get_time();
+
+        for(int round = 0; round < bench_rounds; round++) {
+            for(size_t i = 0; i < bench_batch; i++) {
+                ptrs[i] = alloc(bench_sizes[i % std::size(bench_sizes)]);
+            }
+
+            free(ptrs);
+        }
+
+        return esp_timer_get_time() - start;
+    }
+
+    template<typename F>
+    static int64_t time_parses(F scope) {
+        std::string page;
+        search_page(page);
+        int64_t start = esp_timer_get_time();
+
+        for(int round = 0; round < bench_rounds / 10; round++) {
+            scope([&] {
+                cJSON_Delete(cJSON_ParseWithLength(page.data(), page.size()));
+            });
+        }
+
+        return esp_timer_get_time() - start;
+    }
+
+    void benchmark() {
+        if(small_pool == nullptr || json_arenas[0] == nullptr) {
+            ESP_LOGI(TAG, "Pools disabled");
+            return;
+        }
+
+        constexpr double allocations = bench_rounds * bench_batch;
+
+        int64_t heap_us = time_batches([](size_t size) { return heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT); },
+                                       [](auto& ptrs) { for(void* ptr : ptrs) heap_caps_free(ptr); });
+        int64_t pool_us = time_batches([](size_t size) { return small_pool->alloc(size); },
+                                       [](auto& ptrs) { for(void* ptr : ptrs) small_pool->free(ptr); });
+        int64_t arena_us = time_batches([](size_t size) { return json_arenas[0]->alloc(size); },
+                                        [](auto&) { json_arenas[0]->reset(); });
+
+        ESP_LOGI(TAG, "Allocation and free: heap %.2f us, pool %.2f us, arena %.2f us", heap_us / allocations,
+                 pool_us / allocations, arena_us / allocations);
+
+        //Nothing else parses yet, the hooks can be swapped.
+        cJSON_InitHooks(nullptr);
+        int64_t parse_heap_us = time_parses([](auto parse) { parse(); });
+
+        cJSON_Hooks hooks = {
+            .malloc_fn = json_malloc,
+            .free_fn = json_free
+        };
+
+        cJSON_InitHooks(&hooks);
+        int64_t parse_pool_us = time_parses([](auto parse) { parse(); });
+        int64_t parse_arena_us = time_parses([](auto parse) { JsonScope scope; parse(); });
+        Stats arena = json_arenas[0]->getStats();
+
+        ESP_LOGI(TAG, "Parse and delete a %d track search page: heap %lld us, pool %lld us, arena %lld us, %u bytes of arena",
+                 bench_items, parse_heap_us / (bench_rounds / 10), parse_pool_us / (bench_rounds / 10),
+                 parse_arena_us / (bench_rounds / 10), static_cast<unsigned>(arena.peak));
+    }
+#endif
+
+}
+
+#if CONFIG_LV_USE_CUSTOM_MALLOC
+//LVGL's allocator, the small pool for objects and styles, the heap for images and draw buffers.
+
+void lv_mem_init(void) {
+}
+
+void lv_mem_deinit(void) {
+}
+
+lv_mem_pool_t lv_mem_add_pool(void* mem, size_t bytes) {
+    return nullptr;
+}
+
+void lv_mem_remove_pool(lv_mem_pool_t pool) {
+}
+
+void* lv_malloc_core(size_t size) {
+    if(mem::small() == nullptr) {
+        return mem::allocate(size, size >= mem::bulk_threshold ? mem::Region::Psram : mem::Region::Internal);
+    }
+
+    return mem::small()->alloc(size);
+}
+
+void* lv_realloc_core(void* p, size_t new_size) {
+    if(mem::small() == nullptr) {
+        return heap_caps_realloc(p, new_size, MALLOC_CAP_8BIT);
+    }
+
+    return mem::small()->realloc(p, new_size);
+}
+
+void lv_free_core(void* p) {
+    if(mem::small() == nullptr) {
+        mem::deallocate(p);
+        return;
+    }
+
+    mem::small()->free(p);
+}
+
+void lv_mem_monitor_core(lv_mem_monitor_t* mon_p) {
+    std::memset(mon_p, 0, sizeof(*mon_p));
+
+    if(mem::small() == nullptr) {
+        return;
+    }
+
+    mem::Stats stats = mem::small()->getStats();
+    mon_p->total_size = stats.capacity;
+    mon_p->free_size = stats.capacity - stats.used;
+    mon_p->max_used = stats.peak;
+    mon_p->used_pct = stats.capacity > 0 ? stats.used * 100 / stats.capacity : 0;
+    mon_p->frag_pct = stats.granted > 0 ? 100 - stats.requested * 100 / stats.granted : 0;
+}
+
+lv_result_t lv_mem_test_core(void) {
+    return LV_RESULT_OK;
+}
+#endif
@@ -0,0 +1,299 @@
+#include "metrics.h"
+
+#if CONFIG_METRICS
+
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace metrics {
+
+    //Further endpoints are counted as "other", so the exposition stays small.
+    static constexpr size_t max_endpoints = 24;
+
+    template<size_t N>
+    struct Histogram {
+        const std::array<double, N>& bounds;    ///< Upper bounds of the buckets in seconds.
+        std::array<uint32_t, N> buckets{};      ///< Observations per bucket, not cumulative.
+        uint32_t count = 0;                     ///< All observations.
+        double sum = 0;                         ///< Sum of the observations in seconds.
+
+        void observe(int64_t us) {
+            double seconds = us / 1e6;
+
+            for(size_t i = 0; i < N; i++) {
+                if(seconds <= bounds[i]) {
+                    buckets[i]++;
+                    break;
+                }
+            }
+
+            count++;
+            sum += seconds;
+        }
+    };
+
+    static constexpr std::array<double, 9> request_bounds = {0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10};
+    static constexpr std::array<double, 8> interval_bounds = {0.5, 0.9, 1, 1.1, 1.5, 2, 5, 10};
+    static constexpr std::array<double, 8> frame_bounds = {0.001, 0.002, 0.005, 0.01, 0.02, 0.033, 0.05, 0.1};
+    static constexpr std::array<double, 8> wake_bounds = {0.02, 0.05, 0.075, 0.1, 0.15, 0.2, 0.3, 0.5};
+
+    struct Endpoint {
+        std::string method;                                 ///< The request method.
+        std::string path;                                   ///< The folded path.
+        uint32_t errors = 0;                                ///< Requests without a 2xx response.
+        Histogram<request_bounds.size()> latency{request_bounds};  ///< Request latency.
+    };
+
+    struct PowerState {
+        std::string name;                   ///< The state.
+        uint32_t entries = 0;               ///< Times the state was entered.
+        double seconds = 0;                 ///< Time spent in the state before it was last left.
+    };
+
+    static std::mutex mtx;
+    static std::vector<Endpoint> endpoints;
+    static uint32_t token_refreshes[2];
+    static Histogram<interval_bounds.size()> poll_interval{interval_bounds};
+    static Histogram<frame_bounds.size()> render_time{frame_bounds};
+    static Histogram<frame_bounds.size()> flush_time{frame_bounds};
+    static uint64_t flushed_pixels;
+    static Histogram<frame_bounds.size()> touch_latency{frame_bounds};
+    static std::vector<PowerState> power_states;
+    static size_t power_state = 0;
+    static std::chrono::steady_clock::time_point power_state_since;
+    static Histogram<wake_bounds.size()> wake_latency{wake_bounds};
+
+    //Keeps the path only and replaces segments that look like IDs, e.g. /v1/playlists/{id}/tracks.
+    static std::string fold_path(std::string_view url) {
+        size_t scheme = url.find("://");
+        url.remove_prefix(scheme == std::string_view::npos ? 0 : scheme + 3);
+
+        size_t path_start = url.find('/');
+        url = path_start == std::string_view::npos ? "/" : url.substr(path_start);
+        url = url.substr(0, url.find('?'));
+
+        std::string path;
+
+        while(!url.empty()) {
+            url.remove_prefix(1);
+            std::string_view segment = url.substr(0, url.find('/'));
+            url.remove_prefix(segment.size());
+
+            bool has_digit = false;
+
+            for(char c : segment) {
+                has_digit |= std::isdigit(static_cast<unsigned char>(c)) != 0;
+            }
+
+            path += '/';
+            path += (segment.size() >= 16 && has_digit) ? std::string_view("{id}") : segment;
+        }
+
+        return path.empty() ? "/" : path;
+    }
+
+    void observeRequest(const char* method, std::string_view url, int status, int64_t latency_us) {
+        std::string path = fold_path(url);
+        std::lock_guard<std::mutex> lock(mtx);
+
+        Endpoint* endpoint = nullptr;
+
+        for(auto& candidate : endpoints) {
+            if(candidate.method == method && candidate.path == path) {
+                endpoint = &candidate;
+                break;
+            }
+        }
+
+        if(endpoint == nullptr) {
+            if(endpoints.size() >= max_endpoints) {
+                path = "other";
+
+                for(auto& candidate : endpoints) {
+                    if(candidate.method == method && candidate.path == path) {
+                        endpoint = &candidate;
+                    }
+                }
+            }
+
+            if(endpoint == nullptr) {
+                endpoints.push_back(Endpoint{method, path});
+                endpoint = &endpoints.back();
+            }
+        }
+
+        endpoint->latency.observe(latency_us);
+
+        if(status < 200 || status >= 300) {
+            endpoint->errors++;
+        }
+    }
+
+    void countTokenRefresh(bool success) {
+        std::lock_guard<std::mutex> lock(mtx);
+        token_refreshes[success ? 1 : 0]++;
+    }
+
+    void observePollInterval(int64_t interval_us) {
+        std::lock_guard<std::mutex> lock(mtx);
+        poll_interval.observe(interval_us);
+    }
+
+    void observeFrame(int64_t render_us) {
+        std::lock_guard<std::mutex> lock(mtx);
+        render_time.observe(render_us);
+    }
+
+    void observeFlush(int64_t flush_us, uint32_t pixels) {
+        std::lock_guard<std::mutex> lock(mtx);
+        flush_time.observe(flush_us);
+        flushed_pixels += pixels;
+    }
+
+    void observeTouchLatency(int64_t latency_us) {
+        std::lock_guard<std::mutex> lock(mtx);
+        touch_latency.observe(latency_us);
+    }
+
+    void observePowerState(std::string_view state) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+
+        if(!power_states.empty()) {
+            power_states[power_state].seconds += std::chrono::duration<double>(now - power_state_since).count();
+        }
+
+        power_state_since = now;
+        power_state = 0;
+
+        while(power_state < power_states.size() && power_states[power_state].name != state) {
+            power_state++;
+        }
+
+        if(power_state == power_states.size()) {
+            power_states.push_back({std::string(state)});
+        }
+
+        power_states[power_state].entries++;
+    }
+
+    void observeWakeLatency(int64_t latency_us) {
+        std::lock_guard<std::mutex> lock(mtx);
+        wake_latency.observe(latency_us);
+    }
+
+    static void render_header(std::string& out, std::string_view name, std::string_view help, std::string_view type) {
+        out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    static void render_sample(std::string& out, std::string_view name, std::string_view labels, double value) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.9g", value);
+
+        out.append(name);
+
+        if(!labels.empty()) {
+            out.append("{").append(labels).append("}");
+        }
+
+        out.append(" ").append(buf).append("\n");
+    }
+
+    template<size_t N>
+    static void render_histogram(std::string& out, std::string_view name, std::string_view labels, const Histogram<N>& histogram) {
+        std::string bucket_name = std::string(name) + "_bucket";
+        std::string separator = labels.empty() ? "" : ",";
+        uint32_t cumulative = 0;
+
+        for(size_t i = 0; i < N; i++) {
+            char le[48];
+            snprintf(le, sizeof(le), "le=\"%g\"", histogram.bounds[i]);
+            cumulative += histogram.buckets[i];
+            render_sample(out, bucket_name, std::string(labels) + separator + le, cumulative);
+        }
+
+        render_sample(out, bucket_name, std::string(labels) + separator + "le=\"+Inf\"", histogram.count);
+        render_sample(out, std::string(name) + "_sum", labels, histogram.sum);
+        render_sample(out, std::string(name) + "_count", labels, histogram.count);
+    }
+
+    void renderGauge(std::string& out, std::string_view name, std::string_view help, std::string_view label, double value) {
+        if(!help.empty()) {
+            render_header(out, name, help, "gauge");
+        }
+
+        render_sample(out, name, label, value);
+    }
+
+    void render(std::string& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        render_header(out, "spotify_http_request_duration_seconds", "Latency of the API requests.", "histogram");
+
+        for(const auto& endpoint : endpoints) {
+            std::string labels = "method=\"" + endpoint.method + "\",endpoint=\"" + endpoint.path + "\"";
+            render_histogram(out, "spotify_http_request_duration_seconds", labels, endpoint.latency);
+        }
+
+        render_header(out, "spotify_http_request_errors_total", "Requests that failed or got a non-2xx status.", "counter");
+
+        for(const auto& endpoint : endpoints) {
+            std::string labels = "method=\"" + endpoint.method + "\",endpoint=\"" + endpoint.path + "\"";
+            render_sample(out, "spotify_http_request_errors_total", labels, endpoint.errors);
+        }
+
+        render_header(out, "spotify_token_refreshes_total", "Access token refreshes by outcome.", "counter");
+        render_sample(out, "spotify_token_refreshes_total", "result=\"success\"", token_refreshes[1]);
+        render_sample(out, "spotify_token_refreshes_total", "result=\"failure\"", token_refreshes[0]);
+
+        render_header(out, "spotify_poll_interval_seconds", "Time between two player state polls.", "histogram");
+        render_histogram(out, "spotify_poll_interval_seconds", "", poll_interval);
+
+        render_header(out, "spotify_lvgl_render_seconds", "Duration of the LVGL refreshes, their count gives the frame rate.", "histogram");
+        render_histogram(out, "spotify_lvgl_render_seconds", "", render_time);
+
+        render_header(out, "spotify_lvgl_flush_seconds", "Duration of the display flushes.", "histogram");
+        render_histogram(out, "spotify_lvgl_flush_seconds", "", flush_time);
+
+        render_header(out, "spotify_lvgl_flushed_pixels_total", "Pixels sent to the panel, their rate gives the display throughput.", "counter");
+        render_sample(out, "spotify_lvgl_flushed_pixels_total", "", flushed_pixels);
+
+        render_header(out, "spotify_touch_latency_seconds", "Time from a touch to LVGL reading it as pressed.", "histogram");
+        render_histogram(out, "spotify_touch_latency_seconds", "", touch_latency);
+
+        render_header(out, "spotify_wake_latency_seconds", "Time from a touch or player change to the first frame after blank.", "histogram");
+        render_histogram(out, "spotify_wake_latency_seconds", "", wake_latency);
+
+        if(!power_states.empty()) {
+            //The current state counts up to now, so its time grows while it lasts.
+            double current_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - power_state_since).count();
+
+            render_header(out, "spotify_power_state_seconds_total", "Time the display spent in each power state.", "counter");
+
+            for(size_t i = 0; i < power_states.size(); i++) {
+                render_sample(out, "spotify_power_state_seconds_total", "state=\"" + power_states[i].name + "\"",
+                              power_states[i].seconds + (i == power_state ? current_seconds : 0));
+            }
+
+            render_header(out, "spotify_power_state_entries_total", "Times the display entered each power state.", "counter");
+
+            for(const auto& state : power_states) {
+                render_sample(out, "spotify_power_state_entries_total", "state=\"" + state.name + "\"", state.entries);
+            }
+
+            render_header(out, "spotify_power_state", "The current power state of the display.", "gauge");
+
+            for(size_t i = 0; i < power_states.size(); i++) {
+                render_sample(out, "spotify_power_state", "state=\"" + power_states[i].name + "\"", i == power_state ? 1 : 0);
+            }
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "metrics_server.h"
+#include "metrics.h"
+#include "mem_pool.h"
+
+#if CONFIG_METRICS
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <string>
+#include <vector>
+
+static const char* TAG = "MetricsServer";
+
+MetricsServer::MetricsServer(uint16_t port) : server(nullptr) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    config.core_id = CONFIG_NETWORK_TASK_CORE;
+
+    if(httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Couldn't start the metrics server on port %u", port);
+        server = nullptr;
+        return;
+    }
+
+    httpd_uri_t uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_handler,
+        .user_ctx = this
+    };
+
+    httpd_register_uri_handler(server, &uri);
+    ESP_LOGI(TAG, "Serving metrics on port %u", port);
+}
+
+MetricsServer::~MetricsServer() {
+    if(server != nullptr) {
+        httpd_stop(server);
+    }
+}
+
+esp_err_t MetricsServer::metrics_handler(httpd_req_t *req) {
+    std::string out;
+    out.reserve(8192);
+
+    metrics::render(out);
+
+    metrics::renderGauge(out, "spotify_heap_free_bytes", "Free heap.", "",
+                         heap_caps_get_free_size(MALLOC_CAP_DEFAULT));
+    metrics::renderGauge(out, "spotify_heap_min_free_bytes", "Lowest free heap since boot.", "",
+                         heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+    metrics::renderGauge(out, "spotify_heap_largest_free_block_bytes", "Largest free heap block.", "",
+                         heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+
+    mem::render(out);
+
+    std::vector<TaskStatus_t> status(uxTaskGetNumberOfTasks() + 4);
+    status.resize(uxTaskGetSystemState(status.data(), status.size(), nullptr));
+
+    for(size_t i = 0; i < status.size(); i++) {
+        std::string label = std::string("task=\"") + status[i].pcTaskName + "\"";
+
+        metrics::renderGauge(out, "spotify_task_stack_free_bytes",
+                             i == 0 ? "Stack high-water mark, the least free stack so far." : "",
+                             label, status[i].usStackHighWaterMark);
+    }
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    return httpd_resp_send(req, out.data(), out.size());
+}
+
+#endif
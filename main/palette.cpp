@@ -0,0 +1,329 @@
+#include "palette.h"
+#include <algorithm>
+#include <cmath>
+
+//Colors of the theme without an image, those of LVGL's default light theme.
+static constexpr uint32_t neutral_background = 0xFFFFFF;
+static constexpr uint32_t neutral_accent = 0x2196F3;
+
+static constexpr uint32_t white = 0xFFFFFF;
+static constexpr uint32_t black = 0x000000;
+
+static constexpr float text_contrast = 4.5f;
+static constexpr float accent_contrast = 3.0f;
+
+//Leaves closer than this are one color, in weighted squared 8-bit RGB distance (about 32 per channel).
+static constexpr uint32_t merge_distance = 9216;
+
+//Colors covering less of the image than this are not considered for the accent.
+static constexpr uint32_t min_accent_share_percent = 2;
+
+struct Cluster {
+    uint32_t red;           ///< Sum of the red values.
+    uint32_t green;         ///< Sum of the green values.
+    uint32_t blue;          ///< Sum of the blue values.
+    uint32_t count;         ///< Pixels in the cluster.
+
+    uint32_t color() const {
+        return (red / count) << 16 | (green / count) << 8 | (blue / count);
+    }
+};
+
+//At most max_leaves entries, most common first.
+static void sort_by_count(Cluster* clusters, size_t count) {
+    for(size_t i = 1; i < count; i++) {
+        Cluster cluster = clusters[i];
+        size_t j = i;
+
+        for(; j > 0 && clusters[j - 1].count < cluster.count; j--) {
+            clusters[j] = clusters[j - 1];
+        }
+
+        clusters[j] = cluster;
+    }
+}
+
+static uint32_t distance(uint32_t a, uint32_t b) {
+    int32_t dr = static_cast<int32_t>(a >> 16 & 0xFF) - static_cast<int32_t>(b >> 16 & 0xFF);
+    int32_t dg = static_cast<int32_t>(a >> 8 & 0xFF) - static_cast<int32_t>(b >> 8 & 0xFF);
+    int32_t db = static_cast<int32_t>(a & 0xFF) - static_cast<int32_t>(b & 0xFF);
+
+    return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+static uint32_t chroma(uint32_t color) {
+    uint32_t r = color >> 16 & 0xFF, g = color >> 8 & 0xFF, b = color & 0xFF;
+    return std::max({r, g, b}) - std::min({r, g, b});
+}
+
+//Moves a color towards another by ratio / 256.
+static uint32_t mix(uint32_t from, uint32_t to, uint32_t ratio) {
+    uint32_t out = 0;
+
+    for(int shift = 0; shift <= 16; shift += 8) {
+        uint32_t a = from >> shift & 0xFF;
+        uint32_t b = to >> shift & 0xFF;
+        out |= ((a * (256 - ratio) + b * ratio) >> 8) << shift;
+    }
+
+    return out;
+}
+
+static float luminance(uint32_t color) {
+    float sum = 0;
+    static constexpr float weights[3] = {0.0722f, 0.7152f, 0.2126f};
+
+    for(int i = 0; i < 3; i++) {
+        float c = (color >> (8 * i) & 0xFF) / 255.0f;
+        sum += weights[i] * (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f));
+    }
+
+    return sum;
+}
+
+PaletteExtractor::PaletteExtractor() {
+    reset();
+}
+
+void PaletteExtractor::reset() {
+    //Node 0 is the root, the others are free.
+    for(size_t i = 1; i < max_nodes; i++) {
+        nodes[i].next = i + 1 < max_nodes ? i + 1 : no_node;
+        nodes[i].count = 0;
+        nodes[i].leaf = false;
+    }
+
+    free_list = 1;
+    free_count = max_nodes - 1;
+    reducible.fill(no_node);
+    leaf_count = 0;
+    last_pixel = 0;
+    last_leaf = no_node;
+    stats = {};
+
+    nodes[0] = Node{};
+    std::fill(std::begin(nodes[0].children), std::end(nodes[0].children), no_node);
+}
+
+uint16_t PaletteExtractor::allocate(uint8_t level) {
+    uint16_t index = free_list;
+    Node& node = nodes[index];
+
+    free_list = node.next;
+    free_count--;
+
+    node = Node{};
+    std::fill(std::begin(node.children), std::end(node.children), no_node);
+    node.level = level;
+    node.leaf = level == levels;
+
+    if(node.leaf) {
+        leaf_count++;
+    }
+
+    else {
+        node.next = reducible[level];
+        reducible[level] = index;
+    }
+
+    return index;
+}
+
+bool PaletteExtractor::reduce() {
+    //Nodes below the deepest inner level are all leaves.
+    for(int level = levels - 1; level > 0; level--) {
+        uint16_t index = reducible[level];
+
+        if(index == no_node) {
+            continue;
+        }
+
+        Node& node = nodes[index];
+        reducible[level] = node.next;
+
+        for(uint16_t& child_index : node.children) {
+            if(child_index == no_node) {
+                continue;
+            }
+
+            Node& child = nodes[child_index];
+            node.red += child.red;
+            node.green += child.green;
+            node.blue += child.blue;
+            node.count += child.count;
+
+            child.count = 0;
+            child.leaf = false;
+            child.next = free_list;
+            free_list = child_index;
+            free_count++;
+            leaf_count--;
+            child_index = no_node;
+        }
+
+        node.leaf = true;
+        leaf_count++;
+        last_leaf = no_node;
+        stats.reductions++;
+        return true;
+    }
+
+    return false;
+}
+
+void PaletteExtractor::add(uint16_t pixel) {
+    stats.pixels++;
+
+    uint32_t r5 = pixel >> 11;
+    uint32_t g6 = pixel >> 5 & 0x3F;
+    uint32_t b5 = pixel & 0x1F;
+    uint32_t red = r5 << 3 | r5 >> 2;
+    uint32_t green = g6 << 2 | g6 >> 4;
+    uint32_t blue = b5 << 3 | b5 >> 2;
+    uint16_t index = last_leaf;
+
+    //Covers often have large flat areas, whose pixels all go into the same leaf.
+    if(pixel != last_pixel || index == no_node) {
+        //A new path takes at most one node per level.
+        while(free_count < levels && reduce()) {
+        }
+
+        uint32_t g5 = g6 >> 1;
+        index = 0;
+
+        for(int level = 0; !nodes[index].leaf; level++) {
+            int shift = levels - 1 - level;
+            int child = ((r5 >> shift) & 1) << 2 | ((g5 >> shift) & 1) << 1 | ((b5 >> shift) & 1);
+
+            if(nodes[index].children[child] == no_node) {
+                uint16_t child_index = allocate(level + 1);
+                nodes[index].children[child] = child_index;
+            }
+
+            index = nodes[index].children[child];
+        }
+    }
+
+    Node& leaf = nodes[index];
+    leaf.red += red;
+    leaf.green += green;
+    leaf.blue += blue;
+    leaf.count++;
+
+    last_pixel = pixel;
+    last_leaf = index;
+
+    //A branch with a single leaf merges without removing a color.
+    while(leaf_count > max_leaves && reduce()) {
+    }
+}
+
+void PaletteExtractor::addRow(const uint16_t* pixels, size_t count, size_t step) {
+    for(size_t i = 0; i < count; i += step) {
+        add(pixels[i]);
+    }
+}
+
+Palette PaletteExtractor::finish() const {
+    std::array<Cluster, max_leaves + 1> leaves;
+    size_t leaf_total = 0;
+    uint32_t pixel_total = 0;
+
+    for(const Node& node : nodes) {
+        if(node.leaf && node.count > 0 && leaf_total < leaves.size()) {
+            leaves[leaf_total++] = {node.red, node.green, node.blue, node.count};
+            pixel_total += node.count;
+        }
+    }
+
+    sort_by_count(leaves.data(), leaf_total);
+
+    //Colors split across octree branches are joined again, most common first.
+    std::array<Cluster, 2 * Palette::max_dominant> clusters;
+    size_t cluster_count = 0;
+
+    for(size_t i = 0; i < leaf_total; i++) {
+        uint32_t color = leaves[i].color();
+        size_t j = 0;
+
+        while(j < cluster_count && distance(clusters[j].color(), color) >= merge_distance) {
+            j++;
+        }
+
+        if(j < cluster_count) {
+            clusters[j].red += leaves[i].red;
+            clusters[j].green += leaves[i].green;
+            clusters[j].blue += leaves[i].blue;
+            clusters[j].count += leaves[i].count;
+        }
+
+        else if(cluster_count < clusters.size()) {
+            clusters[cluster_count++] = leaves[i];
+        }
+    }
+
+    sort_by_count(clusters.data(), cluster_count);
+
+    Palette palette = {};
+    palette.dominant_count = std::min(cluster_count, Palette::max_dominant);
+
+    for(size_t i = 0; i < palette.dominant_count; i++) {
+        palette.dominant[i] = clusters[i].color();
+    }
+
+    palette.background = cluster_count > 0 ? clusters[0].color() : neutral_background;
+    palette.text = contrast(palette.background, white) >= contrast(palette.background, black) ? white : black;
+    uint32_t away = palette.text == white ? black : white;
+
+    for(int i = 0; i < 16 && contrast(palette.background, palette.text) < text_contrast; i++) {
+        palette.background = mix(palette.background, away, 32);
+    }
+
+    //The accent is the most vivid color that covers enough of the image, other than the background.
+    palette.accent = cluster_count > 0 ? palette.text : neutral_accent;
+    uint32_t best_score = 0;
+
+    for(size_t i = 1; i < cluster_count; i++) {
+        uint32_t color = clusters[i].color();
+
+        if(clusters[i].count * 100 < pixel_total * min_accent_share_percent) {
+            continue;
+        }
+
+        uint32_t score = chroma(color) * static_cast<uint32_t>(std::sqrt(static_cast<float>(clusters[i].count)));
+
+        if(score > best_score) {
+            best_score = score;
+            palette.accent = color;
+        }
+    }
+
+    for(int i = 0; i < 16 && contrast(palette.accent, palette.background) < accent_contrast; i++) {
+        palette.accent = mix(palette.accent, palette.text, 32);
+    }
+
+    //Secondary text is blended into the background as far as the contrast allows.
+    palette.secondary = palette.text;
+
+    for(uint32_t ratio = 96; ratio > 0; ratio -= 16) {
+        uint32_t color = mix(palette.text, palette.background, ratio);
+
+        if(contrast(color, palette.background) >= text_contrast) {
+            palette.secondary = color;
+            break;
+        }
+    }
+
+    return palette;
+}
+
+PaletteExtractor::Stats PaletteExtractor::getStats() const {
+    return stats;
+}
+
+float PaletteExtractor::contrast(uint32_t a, uint32_t b) {
+    float la = luminance(a);
+    float lb = luminance(b);
+
+    return (std::max(la, lb) + 0.05f) / (std::min(la, lb) + 0.05f);
+}
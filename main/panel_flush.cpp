@@ -0,0 +1,201 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#define LGFX_USE_V1
+#include "panel_flush.h"
+#include "panel.h"
+#include "rgb666.h"
+#include "deferred_log.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mem_pool.h"
+#include <algorithm>
+
+static const char* TAG = "PanelFlush";
+
+PanelFlush::PanelFlush(LGFX& tft, Mode mode)
+    : tft(tft),
+      mode(mode),
+      staging{nullptr, nullptr},
+      next_staging(0),
+      in_flight(false),
+      stats{} {
+
+    if(mode != Mode::Rgb666) {
+        return;
+    }
+
+    for(auto& buffer : staging) {
+        buffer = static_cast<uint8_t*>(mem::allocate(chunk_pixels * rgb666::bytes_per_pixel, mem::Region::Dma));
+    }
+
+    if(staging[0] == nullptr || staging[1] == nullptr) {
+        DLOGW(TAG, "No DMA memory for the staging buffers, LovyanGFX converts the pixels");
+        this->mode = Mode::Lgfx;
+    }
+}
+
+PanelFlush::~PanelFlush() {
+    wait();
+
+    for(auto buffer : staging) {
+        mem::deallocate(buffer);
+    }
+}
+
+PanelFlush::Mode PanelFlush::configuredMode() {
+#if CONFIG_DISPLAY_FLUSH_RGB888
+    return Mode::Rgb888;
+#elif CONFIG_DISPLAY_FLUSH_RGB666
+    return Mode::Rgb666;
+#else
+    return Mode::Lgfx;
+#endif
+}
+
+lv_color_format_t PanelFlush::getColorFormat() const {
+    return mode == Mode::Rgb888 ? LV_COLOR_FORMAT_RGB888 : LV_COLOR_FORMAT_RGB565;
+}
+
+bool PanelFlush::isDeferred() const {
+    return mode == Mode::Rgb888;
+}
+
+void PanelFlush::flush(const lv_area_t* area, const uint8_t* data) {
+    int64_t start_us = esp_timer_get_time();
+    uint32_t w = lv_area_get_width(area);
+    uint32_t h = lv_area_get_height(area);
+    size_t count = w * h;
+
+    if(mode == Mode::Lgfx) {
+        tft.startWrite();
+        tft.setAddrWindow(area->x1, area->y1, w, h);
+        tft.writePixels(reinterpret_cast<const lgfx::rgb565_t*>(data), count);
+        tft.endWrite();
+    }
+
+    else {
+        if(!in_flight) {
+            tft.startWrite();
+            in_flight = true;
+        }
+
+        //Waits for the previous transfer, which may still be running from the last flush.
+        tft.setAddrWindow(area->x1, area->y1, w, h);
+
+        if(mode == Mode::Rgb888) {
+            tft.writeBytes(data, count * 3, true);
+        }
+
+        else {
+            auto pixels = reinterpret_cast<const uint16_t*>(data);
+
+            //Only one transfer runs at a time, so the buffer expanded into is never the one being sent.
+            for(size_t offset = 0; offset < count; offset += chunk_pixels) {
+                size_t n = std::min(chunk_pixels, count - offset);
+                uint8_t* chunk = staging[next_staging];
+
+                rgb666::expand(pixels + offset, n, chunk);
+                tft.writeBytes(chunk, n * rgb666::bytes_per_pixel, true);
+                next_staging ^= 1;
+            }
+        }
+    }
+
+    stats.flushes++;
+    stats.pixels += count;
+    stats.busy_us += esp_timer_get_time() - start_us;
+}
+
+void PanelFlush::wait() {
+    if(!in_flight) {
+        return;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    tft.waitDMA();
+    tft.endWrite();
+    in_flight = false;
+    stats.wait_us += esp_timer_get_time() - start_us;
+}
+
+PanelFlush::Stats PanelFlush::getStats() const {
+    return stats;
+}
+
+#if CONFIG_BOOT_BENCHMARKS
+
+struct BenchMode {
+    const char* name;
+    PanelFlush::Mode mode;
+};
+
+static constexpr BenchMode bench_modes[] = {
+    {"LovyanGFX RGB565", PanelFlush::Mode::Lgfx},
+    {"RGB666 staging", PanelFlush::Mode::Rgb666},
+    {"Native RGB888", PanelFlush::Mode::Rgb888},
+};
+
+static constexpr int32_t bench_width = 480;
+static constexpr int32_t bench_height = 320;
+static constexpr int32_t bench_strip = bench_height / 10;
+static constexpr int bench_frames = 10;
+
+void PanelFlush::benchmark(LGFX& tft) {
+    //Large enough for a strip in either format, filled with a gradient so nothing compresses.
+    size_t strip_pixels = bench_width * bench_strip;
+    auto data = static_cast<uint8_t*>(heap_caps_malloc(strip_pixels * 3, MALLOC_CAP_DMA));
+
+    if(data == nullptr) {
+        ESP_LOGE(TAG, "No DMA memory for the benchmark strip");
+        return;
+    }
+
+    for(size_t i = 0; i < strip_pixels * 3; i++) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    alignas(4) static uint8_t expanded[chunk_pixels * rgb666::bytes_per_pixel];
+
+    for(int i = 0; i < bench_frames; i++) {
+        rgb666::expand(reinterpret_cast<const uint16_t*>(data), chunk_pixels, expanded);
+    }
+
+    int64_t expand_us = esp_timer_get_time() - start_us;
+    ESP_LOGI(TAG, "RGB666 expansion: %.1f Mpixel/s", expand_us > 0 ? static_cast<double>(chunk_pixels) * bench_frames / expand_us : 0);
+
+    for(const BenchMode& bench : bench_modes) {
+        PanelFlush flush(tft, bench.mode);
+
+        if(flush.mode != bench.mode) {
+            ESP_LOGI(TAG, "%s: not available", bench.name);
+            continue;
+        }
+
+        start_us = esp_timer_get_time();
+
+        for(int frame = 0; frame < bench_frames; frame++) {
+            for(int32_t y = 0; y < bench_height; y += bench_strip) {
+                lv_area_t area = {0, y, bench_width - 1, y + bench_strip - 1};
+                flush.flush(&area, data);
+
+                if(flush.isDeferred()) {
+                    flush.wait();
+                }
+            }
+        }
+
+        flush.wait();
+        int64_t total_us = esp_timer_get_time() - start_us;
+        Stats stats = flush.getStats();
+        uint64_t bytes = stats.pixels * 3;
+
+        ESP_LOGI(TAG, "%s: %lld us per full screen, %lld us of it in flush, %.2f MB/s over SPI", bench.name,
+                 total_us / bench_frames, stats.busy_us / bench_frames,
+                 total_us > 0 ? static_cast<double>(bytes) / total_us : 0);
+    }
+
+    heap_caps_free(data);
+}
+
+#endif
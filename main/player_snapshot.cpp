@@ -0,0 +1,203 @@
+#include "player_snapshot.h"
+#include <algorithm>
+#include <cstring>
+
+namespace snapshot {
+
+    static constexpr uint8_t magic[2] = {'S', 'P'};
+
+    //Bounds-checked little-endian reader, any overrun marks the snapshot as invalid.
+    struct Reader {
+        const uint8_t *data;
+        size_t len;
+        size_t pos;
+        bool ok;
+
+        uint64_t read(size_t bytes) {
+            if(!ok || len - pos < bytes) {
+                ok = false;
+                return 0;
+            }
+
+            uint64_t value = 0;
+
+            for(size_t i = 0; i < bytes; i++) {
+                value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+            }
+
+            pos += bytes;
+            return value;
+        }
+
+        std::string_view string() {
+            size_t length = read(2);
+
+            if(!ok || len - pos < length) {
+                ok = false;
+                return {};
+            }
+
+            std::string_view out(reinterpret_cast<const char*>(data + pos), length);
+            pos += length;
+            return out;
+        }
+    };
+
+    static uint8_t* put(uint8_t* out, uint64_t value, size_t bytes) {
+        for(size_t i = 0; i < bytes; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+
+        return out + bytes;
+    }
+
+    static uint8_t* put(uint8_t* out, std::string_view str) {
+        str = str.substr(0, max_string);
+        out = put(out, str.size(), 2);
+        std::memcpy(out, str.data(), str.size());
+        return out + str.size();
+    }
+
+    static size_t string_size(std::string_view str) {
+        return 2 + std::min(str.size(), max_string);
+    }
+
+    size_t encodedSize(const spotify::PlayerState& state) {
+        const spotify::Track& track = state.track;
+        size_t size = header_size;
+
+        size += string_size(track.uri) + string_size(track.name) + string_size(track.album_name);
+        size += string_size(track.album_pic_url) + string_size(track.context_uri);
+
+        for(size_t i = 0; i < std::min(track.artists.size(), max_artists); i++) {
+            size += string_size(track.artists[i]);
+        }
+
+        return size;
+    }
+
+    size_t encode(const spotify::PlayerState& state, int64_t timestamp_ms, uint8_t* out, size_t capacity) {
+        const spotify::Track& track = state.track;
+        size_t size = encodedSize(state);
+
+        if(size > capacity) {
+            return 0;
+        }
+
+        uint8_t flags = 0;
+
+        if(state.play_state == spotify::PlayState::Playing) {
+            flags |= 1 << 0;
+        }
+
+        if(state.shuffle_state == spotify::ShuffleState::On) {
+            flags |= 1 << 1;
+        }
+
+        switch(state.repeat_state) {
+        case spotify::RepeatState::Off:
+            break;
+        case spotify::RepeatState::Track:
+            flags |= 1 << 2;
+            break;
+        case spotify::RepeatState::Context:
+            flags |= 2 << 2;
+            break;
+        }
+
+        size_t artist_count = std::min(track.artists.size(), max_artists);
+
+        uint8_t* pos = out;
+        pos = put(pos, magic[0], 1);
+        pos = put(pos, magic[1], 1);
+        pos = put(pos, version, 1);
+        pos = put(pos, flags, 1);
+        pos = put(pos, size, 2);
+        pos = put(pos, std::clamp(state.volume_percent, 0, 100), 1);
+        pos = put(pos, artist_count, 1);
+        pos = put(pos, std::max(track.duration_ms, 0), 4);
+        pos = put(pos, std::max(track.progress_ms, 0), 4);
+        pos = put(pos, static_cast<uint64_t>(timestamp_ms), 8);
+
+        pos = put(pos, track.uri);
+        pos = put(pos, track.name);
+        pos = put(pos, track.album_name);
+        pos = put(pos, track.album_pic_url);
+        pos = put(pos, track.context_uri);
+
+        for(size_t i = 0; i < artist_count; i++) {
+            pos = put(pos, track.artists[i]);
+        }
+
+        return pos - out;
+    }
+
+    size_t decode(const uint8_t* data, size_t len, View& view) {
+        Reader reader = {data, len, 0, true};
+
+        uint8_t first = reader.read(1);
+        uint8_t second = reader.read(1);
+        view.version = reader.read(1);
+        uint8_t flags = reader.read(1);
+        size_t size = reader.read(2);
+
+        if(!reader.ok || first != magic[0] || second != magic[1] || view.version == 0 ||
+           size < header_size || size > len) {
+            return 0;
+        }
+
+        //Only the bytes of this snapshot, fields added by later versions are skipped below.
+        reader.len = size;
+
+        view.volume_percent = reader.read(1);
+        view.artist_count = reader.read(1);
+        view.duration_ms = reader.read(4);
+        view.progress_ms = reader.read(4);
+        view.timestamp_ms = static_cast<int64_t>(reader.read(8));
+
+        view.uri = reader.string();
+        view.name = reader.string();
+        view.album_name = reader.string();
+        view.album_pic_url = reader.string();
+        view.context_uri = reader.string();
+
+        if(view.artist_count > max_artists) {
+            return 0;
+        }
+
+        for(size_t i = 0; i < view.artist_count; i++) {
+            view.artists[i] = reader.string();
+        }
+
+        if(!reader.ok) {
+            return 0;
+        }
+
+        constexpr spotify::RepeatState repeat_states[] = {spotify::RepeatState::Off, spotify::RepeatState::Track, spotify::RepeatState::Context};
+
+        view.play_state = (flags & (1 << 0)) ? spotify::PlayState::Playing : spotify::PlayState::Paused;
+        view.shuffle_state = (flags & (1 << 1)) ? spotify::ShuffleState::On : spotify::ShuffleState::Off;
+        view.repeat_state = repeat_states[std::min((flags >> 2) & 0x3, 2)];
+
+        return size;
+    }
+
+    void copy(const View& view, spotify::PlayerState& state) {
+        spotify::Track& track = state.track;
+
+        track.uri = view.uri;
+        track.name = view.name;
+        track.album_name = view.album_name;
+        track.album_pic_url = view.album_pic_url;
+        track.context_uri = view.context_uri;
+        track.artists.assign(view.artists.begin(), view.artists.begin() + view.artist_count);
+        track.duration_ms = view.duration_ms;
+        track.progress_ms = view.progress_ms;
+
+        state.play_state = view.play_state;
+        state.shuffle_state = view.shuffle_state;
+        state.repeat_state = view.repeat_state;
+        state.volume_percent = view.volume_percent;
+    }
+
+}
@@ -0,0 +1,42 @@
+#include "player_store.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+PlayerStore::PlayerStore() {
+    mtx = xSemaphoreCreateMutex();
+}
+
+PlayerStore::~PlayerStore() {
+    vSemaphoreDelete(mtx);
+}
+
+void PlayerStore::update(const spotify::Track& track) {
+    int64_t now_us = esp_timer_get_time();
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+
+    bool changed = track.uri != this->track.uri;
+    this->track = track;
+
+    if(changed) {
+        for(const auto& listener : listeners) {
+            listener(track, now_us);
+        }
+    }
+
+    xSemaphoreGive(mtx);
+}
+
+spotify::Track PlayerStore::getTrack() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    spotify::Track out = track;
+    xSemaphoreGive(mtx);
+
+    return out;
+}
+
+void PlayerStore::subscribe(Listener listener) {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    listeners.push_back(std::move(listener));
+    xSemaphoreGive(mtx);
+}
@@ -0,0 +1,305 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#define LGFX_USE_V1
+#include "power_governor.h"
+#include "panel.h"
+#include "panel_flush.h"
+#include "touch_sampler.h"
+#include "deferred_log.h"
+#include "metrics.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include <algorithm>
+
+static const char* TAG = "PowerGovernor";
+
+static constexpr const char* state_names[PowerGovernor::state_count] = {"active", "dim", "blank"};
+
+PowerGovernor::PowerGovernor(LGFX& tft, PanelFlush& flush, lv_display_t* disp, lv_indev_t* indev, TouchSampler& touch)
+    : tft(tft),
+      flush(flush),
+      disp(disp),
+      indev(indev),
+      touch(touch),
+      timer(nullptr),
+      wake_signal(xSemaphoreCreateBinary()),
+      cpu_lock(nullptr),
+      sleep_lock(nullptr),
+      state(State::Active),
+      playing(false),
+      touch_wake(false),
+      touch_wake_us(0),
+      state_wake(false),
+      state_wake_us(0),
+      state_since_us(esp_timer_get_time()),
+      waking_since_us(0),
+      waking_by_touch(false),
+      wake_total_us(0),
+      stats{} {
+
+    esp_pm_config_t pm_config = {};
+    pm_config.max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    pm_config.min_freq_mhz = min_cpu_freq_mhz;
+    pm_config.light_sleep_enable = true;
+
+    esp_err_t err = esp_pm_configure(&pm_config);
+
+    if(err == ESP_OK) {
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "governor_cpu", &cpu_lock);
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "governor_sleep", &sleep_lock);
+        hold(cpu_lock, false, true);
+        hold(sleep_lock, false, true);
+    }
+
+    else {
+        DLOGW(TAG, "No power management (%s), only the backlight is managed", esp_err_to_name(err));
+    }
+
+    tft.setBrightness(active_brightness);
+    metrics::observePowerState(state_names[static_cast<size_t>(State::Active)]);
+
+    touch.setPenListener(pen_listener_dummy, this);
+    lv_display_add_event_cb(disp, refr_event_cb_dummy, LV_EVENT_REFR_READY, this);
+    timer = lv_timer_create(timer_cb_dummy, evaluate_period_ms, this);
+}
+
+PowerGovernor::~PowerGovernor() {
+    touch.setSleepWakeup(false);
+    touch.setPenListener(nullptr, nullptr);
+    lv_display_remove_event_cb_with_user_data(disp, refr_event_cb_dummy, this);
+    lv_timer_delete(timer);
+
+    if(cpu_lock != nullptr) {
+        hold(cpu_lock, state == State::Active, false);
+        esp_pm_lock_delete(cpu_lock);
+    }
+
+    if(sleep_lock != nullptr) {
+        hold(sleep_lock, state != State::Blank, false);
+        esp_pm_lock_delete(sleep_lock);
+    }
+
+    vSemaphoreDelete(wake_signal);
+}
+
+void PowerGovernor::setPlaying(bool playing) {
+    if(this->playing.exchange(playing, std::memory_order_relaxed) != playing) {
+        wake();
+    }
+}
+
+void PowerGovernor::wake() {
+    //Keeps the earliest change until the LVGL task takes it.
+    if(!state_wake.load(std::memory_order_relaxed)) {
+        state_wake_us = esp_timer_get_time();
+        state_wake.store(true, std::memory_order_release);
+    }
+
+    xSemaphoreGive(wake_signal);
+}
+
+bool PowerGovernor::isBlank() const {
+    return state.load(std::memory_order_relaxed) == State::Blank;
+}
+
+PowerGovernor::Stats PowerGovernor::getStats() const {
+    Stats result = stats;
+    uint32_t wakes = stats.touch_wakes + stats.state_wakes;
+
+    result.state_us[static_cast<size_t>(state.load(std::memory_order_relaxed))] += esp_timer_get_time() - state_since_us;
+    result.avg_wake_us = wakes > 0 ? wake_total_us / wakes : 0;
+    return result;
+}
+
+void IRAM_ATTR PowerGovernor::pen_listener_dummy(void* arg) {
+    auto obj = static_cast<PowerGovernor*>(arg);
+
+    //While active the sampler handles the touch on its own.
+    if(obj->state.load(std::memory_order_relaxed) == State::Active || obj->touch_wake.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    obj->touch_wake_us = esp_timer_get_time();
+    obj->touch_wake.store(true, std::memory_order_release);
+
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    xSemaphoreGiveFromISR(obj->wake_signal, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+void PowerGovernor::wait(uint32_t time_till_next_ms) {
+    if(state.load(std::memory_order_relaxed) != State::Blank) {
+        xSemaphoreTake(wake_signal, pdMS_TO_TICKS(std::min(time_till_next_ms, evaluate_period_ms)));
+        handle_wakes();
+        return;
+    }
+
+    //LVGL stays stopped, so nothing but this wait keeps the chip from light sleep.
+    while(!handle_wakes()) {
+        //The pen IRQ wakes the chip and gives the signal through the pen listener.
+        if(touch.hasPenIrq()) {
+            xSemaphoreTake(wake_signal, portMAX_DELAY);
+            continue;
+        }
+
+        if(xSemaphoreTake(wake_signal, pdMS_TO_TICKS(blank_poll_ms)) == pdTRUE) {
+            continue;
+        }
+
+        if(!touch_wake.load(std::memory_order_relaxed) && touch.isPenDown()) {
+            touch_wake_us = esp_timer_get_time();
+            touch_wake.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void PowerGovernor::timer_cb_dummy(lv_timer_t* timer) {
+    auto obj = static_cast<PowerGovernor*>(lv_timer_get_user_data(timer));
+    obj->timer_cb();
+}
+
+void PowerGovernor::timer_cb() {
+    //The wake holds the state until its first frame is drawn.
+    if(waking_since_us != 0) {
+        return;
+    }
+
+    uint32_t inactive_ms = lv_display_get_inactive_time(disp);
+    State next = State::Active;
+
+    //Playing music keeps the screen on, however long it isn't touched.
+    if(!playing.load(std::memory_order_relaxed)) {
+        if(inactive_ms >= CONFIG_POWER_BLANK_S * 1000U) {
+            next = State::Blank;
+        }
+
+        else if(inactive_ms >= CONFIG_POWER_DIM_S * 1000U) {
+            next = State::Dim;
+        }
+    }
+
+    if(next != state.load(std::memory_order_relaxed)) {
+        set_state(next);
+    }
+}
+
+void PowerGovernor::refr_event_cb_dummy(lv_event_t* e) {
+    auto obj = static_cast<PowerGovernor*>(lv_event_get_user_data(e));
+    obj->refr_event_cb();
+}
+
+void PowerGovernor::refr_event_cb() {
+    if(waking_since_us == 0) {
+        return;
+    }
+
+    //The frame is drawn while the backlight is still off, so the stale screen is never shown.
+    tft.setBrightness(active_brightness);
+
+    int64_t latency_us = esp_timer_get_time() - waking_since_us;
+    waking_since_us = 0;
+
+    if(waking_by_touch) {
+        stats.touch_wakes++;
+    }
+
+    else {
+        stats.state_wakes++;
+    }
+
+    wake_total_us += latency_us;
+    stats.last_wake_us = latency_us;
+    stats.max_wake_us = std::max(stats.max_wake_us, latency_us);
+    metrics::observeWakeLatency(latency_us);
+
+    Stats current = getStats();
+
+    DLOGI(TAG, "Woken by %s, first frame after %lld ms. Active %lld s, dim %lld s, blank %lld s",
+          waking_by_touch ? "a touch" : "the player", latency_us / 1000,
+          current.state_us[0] / 1000000, current.state_us[1] / 1000000, current.state_us[2] / 1000000);
+}
+
+bool PowerGovernor::handle_wakes() {
+    bool touched = touch_wake.load(std::memory_order_acquire);
+    bool changed = state_wake.load(std::memory_order_acquire);
+
+    if(!touched && !changed) {
+        return false;
+    }
+
+    int64_t since_us = touched && changed ? std::min(touch_wake_us, state_wake_us) : touched ? touch_wake_us : state_wake_us;
+
+    touch_wake.store(false, std::memory_order_relaxed);
+    state_wake.store(false, std::memory_order_relaxed);
+
+    lv_lock();
+    lv_display_trigger_activity(disp);
+
+    State current = state.load(std::memory_order_relaxed);
+
+    if(current == State::Blank) {
+        //The touch only wakes the screen, it doesn't reach what it landed on.
+        if(touched) {
+            lv_indev_wait_release(indev);
+        }
+
+        waking_since_us = since_us;
+        waking_by_touch = touched;
+        set_state(State::Active);
+    }
+
+    else if(current == State::Dim) {
+        set_state(State::Active);
+    }
+
+    lv_unlock();
+    return true;
+}
+
+void PowerGovernor::set_state(State next) {
+    State current = state.load(std::memory_order_relaxed);
+    int64_t now_us = esp_timer_get_time();
+
+    stats.state_us[static_cast<size_t>(current)] += now_us - state_since_us;
+    state_since_us = now_us;
+
+    //An open transaction holds the bus PM lock, which keeps the APB up and the chip awake.
+    if(next != State::Active) {
+        flush.wait();
+    }
+
+    hold(cpu_lock, current == State::Active, next == State::Active);
+    hold(sleep_lock, current != State::Blank, next != State::Blank);
+    touch.setSleepWakeup(next == State::Blank);
+
+    if(next == State::Dim) {
+        tft.setBrightness(CONFIG_POWER_DIM_BRIGHTNESS);
+    }
+
+    else if(next == State::Blank) {
+        tft.setBrightness(0);
+    }
+
+    //Waking from blank, the backlight waits for the first frame.
+    else if(waking_since_us == 0) {
+        tft.setBrightness(active_brightness);
+    }
+
+    state.store(next, std::memory_order_relaxed);
+    metrics::observePowerState(state_names[static_cast<size_t>(next)]);
+
+    DLOGD(TAG, "%s -> %s", state_names[static_cast<size_t>(current)], state_names[static_cast<size_t>(next)]);
+}
+
+void PowerGovernor::hold(esp_pm_lock_handle_t lock, bool before, bool after) {
+    if(lock == nullptr || before == after) {
+        return;
+    }
+
+    if(after) {
+        esp_pm_lock_acquire(lock);
+    }
+
+    else {
+        esp_pm_lock_release(lock);
+    }
+}
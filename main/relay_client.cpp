@@ -0,0 +1,273 @@
+#define DLOG_LOCAL_LEVEL CONFIG_SPOTIFY_LOG_LEVEL
+#include "relay_client.h"
+#include "deferred_log.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#if CONFIG_RELAY
+
+static const char* TAG = "RelayClient";
+
+enum Field : uint16_t {
+    Uri =           1 << 0,
+    Name =          1 << 1,
+    AlbumName =     1 << 2,
+    AlbumPicUrl =   1 << 3,
+    Artists =       1 << 4,
+    ContextUri =    1 << 5,
+    Duration =      1 << 6,
+    Progress =      1 << 7,
+    Playing =       1 << 8,
+    Shuffle =       1 << 9,
+    Repeat =        1 << 10,
+    Volume =        1 << 11
+};
+
+//Bounds-checked little-endian reader, any overrun marks the message as invalid.
+struct Reader {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    bool ok;
+
+    uint32_t read(size_t bytes) {
+        if(!ok || len - pos < bytes) {
+            ok = false;
+            return 0;
+        }
+
+        uint32_t value = 0;
+
+        for(size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint32_t>(data[pos + i]) << (8 * i);
+        }
+
+        pos += bytes;
+        return value;
+    }
+
+    std::string string(size_t length_bytes) {
+        size_t length = read(length_bytes);
+
+        if(!ok || len - pos < length) {
+            ok = false;
+            return "";
+        }
+
+        std::string out(reinterpret_cast<const char*>(data + pos), length);
+        pos += length;
+        return out;
+    }
+};
+
+RelayClient::RelayClient(const char* uri)
+    : state{},
+      connected(false),
+      have_snapshot(false),
+      sequence(0) {
+
+    mtx = xSemaphoreCreateMutex();
+    changed = xSemaphoreCreateBinary();
+
+    esp_websocket_client_config_t config = {};
+    config.uri = uri;
+    config.reconnect_timeout_ms = 2000;
+    config.network_timeout_ms = 5000;
+
+    client = esp_websocket_client_init(&config);
+    esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, event_handler_dummy, this);
+    esp_websocket_client_start(client);
+}
+
+RelayClient::~RelayClient() {
+    esp_websocket_client_stop(client);
+    esp_websocket_client_destroy(client);
+    vSemaphoreDelete(changed);
+    vSemaphoreDelete(mtx);
+}
+
+bool RelayClient::getState(State& out) {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+
+    bool valid = connected && have_snapshot;
+
+    if(valid) {
+        out = state;
+    }
+
+    xSemaphoreGive(mtx);
+
+    if(valid && out.play_state == spotify::PlayState::Playing) {
+        int64_t elapsed_ms = (esp_timer_get_time() - out.progress_time_us) / 1000;
+        out.track.progress_ms = std::min<int64_t>(out.track.progress_ms + elapsed_ms, out.track.duration_ms);
+    }
+
+    return valid;
+}
+
+bool RelayClient::waitForUpdate(TickType_t timeout) {
+    return xSemaphoreTake(changed, timeout) == pdTRUE;
+}
+
+bool RelayClient::apply(const uint8_t *data, size_t len) {
+    Reader reader = {data, len, 0, true};
+
+    uint8_t version = reader.read(1);
+    uint8_t type = reader.read(1);
+    uint32_t seq = reader.read(4);
+    uint16_t mask = reader.read(2);
+
+    if(!reader.ok || version != protocol_version) {
+        DLOGE(TAG, "Unsupported message, version %u", version);
+        return false;
+    }
+
+    bool snapshot = type == 0;
+
+    //A delta only applies on top of the message right before it.
+    if(!snapshot && (!have_snapshot || seq != sequence + 1)) {
+        DLOGW(TAG, "Missed an update (%lu after %lu), requesting a snapshot", seq, sequence);
+        return false;
+    }
+
+    State next = snapshot ? State{} : state;
+    spotify::Track& track = next.track;
+
+    if(mask & Uri) {
+        track.uri = reader.string(1);
+    }
+
+    if(mask & Name) {
+        track.name = reader.string(1);
+    }
+
+    if(mask & AlbumName) {
+        track.album_name = reader.string(1);
+    }
+
+    if(mask & AlbumPicUrl) {
+        track.album_pic_url = reader.string(2);
+    }
+
+    if(mask & Artists) {
+        track.artists.resize(reader.read(1));
+
+        for(auto& artist : track.artists) {
+            artist = reader.string(1);
+        }
+    }
+
+    if(mask & ContextUri) {
+        track.context_uri = reader.string(1);
+    }
+
+    if(mask & Duration) {
+        track.duration_ms = reader.read(4);
+    }
+
+    if(mask & Progress) {
+        track.progress_ms = reader.read(4);
+        next.progress_time_us = esp_timer_get_time();
+    }
+
+    //Without a new progress, the extrapolated one becomes the reference for the new play state.
+    else if((mask & Playing) && next.play_state == spotify::PlayState::Playing) {
+        int64_t now_us = esp_timer_get_time();
+        track.progress_ms = std::min<int64_t>(track.progress_ms + (now_us - next.progress_time_us) / 1000, track.duration_ms);
+        next.progress_time_us = now_us;
+    }
+
+    if(mask & Playing) {
+        next.play_state = reader.read(1) ? spotify::PlayState::Playing : spotify::PlayState::Paused;
+    }
+
+    if(mask & Shuffle) {
+        next.shuffle_state = reader.read(1) ? spotify::ShuffleState::On : spotify::ShuffleState::Off;
+    }
+
+    if(mask & Repeat) {
+        constexpr spotify::RepeatState repeat_states[] = {spotify::RepeatState::Off, spotify::RepeatState::Track, spotify::RepeatState::Context};
+        next.repeat_state = repeat_states[std::min<uint32_t>(reader.read(1), 2)];
+    }
+
+    if(mask & Volume) {
+        next.volume_percent = reader.read(1);
+    }
+
+    if(!reader.ok) {
+        DLOGE(TAG, "Truncated message");
+        return false;
+    }
+
+    state = std::move(next);
+    sequence = seq;
+    have_snapshot = true;
+
+    return true;
+}
+
+void RelayClient::event_handler_dummy(void *arg, esp_event_base_t base, int32_t event_id, void *event_data) {
+    auto obj = static_cast<RelayClient*>(arg);
+    obj->event_handler(event_id, static_cast<esp_websocket_event_data_t*>(event_data));
+}
+
+void RelayClient::event_handler(int32_t event_id, esp_websocket_event_data_t *data) {
+    switch(event_id) {
+    case WEBSOCKET_EVENT_CONNECTED:
+        DLOGI(TAG, "Connected to relay");
+        xSemaphoreTake(mtx, portMAX_DELAY);
+        connected = true;
+        have_snapshot = false;
+        xSemaphoreGive(mtx);
+        break;
+    case WEBSOCKET_EVENT_DISCONNECTED:
+    case WEBSOCKET_EVENT_CLOSED:
+        DLOGW(TAG, "Disconnected from relay, polling the API until it's back");
+        xSemaphoreTake(mtx, portMAX_DELAY);
+        connected = false;
+        xSemaphoreGive(mtx);
+        xSemaphoreGive(changed);
+        break;
+    case WEBSOCKET_EVENT_DATA: {
+        //Only binary frames carry state, possibly split over several events.
+        if(data->op_code != 0x2 && !(data->op_code == 0x0 && !message.empty())) {
+            break;
+        }
+
+        if(data->payload_offset == 0) {
+            message.clear();
+        }
+
+        message.insert(message.end(), data->data_ptr, data->data_ptr + data->data_len);
+
+        if(data->payload_offset + data->data_len < data->payload_len) {
+            break;
+        }
+
+        xSemaphoreTake(mtx, portMAX_DELAY);
+        bool applied = apply(message.data(), message.size());
+
+        if(!applied) {
+            have_snapshot = false;
+        }
+        xSemaphoreGive(mtx);
+
+        message.clear();
+
+        if(applied) {
+            xSemaphoreGive(changed);
+        }
+
+        else {
+            esp_websocket_client_send_text(client, "snapshot", 8, pdMS_TO_TICKS(1000));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+#endif
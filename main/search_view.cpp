@@ -0,0 +1,433 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "search_view.h"
+#include "deferred_log.h"
+#include "library_sync.h"
+#include "esp_timer.h"
+#include <cctype>
+#include <utility>
+
+static const char* TAG = "SearchView";
+
+//Queries differing in case or surrounding spaces are the same query.
+static std::string normalize(const char* text) {
+    std::string_view view(text);
+
+    while(!view.empty() && std::isspace(static_cast<unsigned char>(view.front()))) {
+        view.remove_prefix(1);
+    }
+
+    while(!view.empty() && std::isspace(static_cast<unsigned char>(view.back()))) {
+        view.remove_suffix(1);
+    }
+
+    std::string out(view);
+
+    for(char& c : out) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+
+    return out;
+}
+
+//Case-insensitive for ASCII, the needle is already normalized.
+static bool contains(std::string_view haystack, std::string_view needle) {
+    if(needle.size() > haystack.size()) {
+        return false;
+    }
+
+    for(size_t i = 0; i + needle.size() <= haystack.size(); i++) {
+        size_t j = 0;
+
+        while(j < needle.size() && std::tolower(static_cast<unsigned char>(haystack[i + j])) == static_cast<unsigned char>(needle[j])) {
+            j++;
+        }
+
+        if(j == needle.size()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static const char* type_name(spotify::SearchType type) {
+    switch(type) {
+    case spotify::SearchType::Track:
+        return "Track";
+    case spotify::SearchType::Album:
+        return "Album";
+    default:
+        return "Playlist";
+    }
+}
+
+SearchView::SearchView(lv_obj_t* parent, spotify::Client& client, LibrarySync* library)
+    : client(client),
+      library(library),
+      row_count(0),
+      provisional(false),
+      generation(0),
+      answered(true),
+      keystroke_us(0),
+      first_shown(false),
+      first_result_total_us(0),
+      cache_clock(0),
+      stats{},
+      task_handle(nullptr) {
+
+    panel = lv_obj_create(parent);
+    lv_obj_set_size(panel, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_style_pad_all(panel, 4, LV_PART_MAIN);
+    lv_obj_remove_flag(panel, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(panel, LV_OBJ_FLAG_HIDDEN);
+
+    textarea = lv_textarea_create(panel);
+    lv_textarea_set_one_line(textarea, true);
+    lv_textarea_set_placeholder_text(textarea, "Tracks, albums, playlists");
+    lv_obj_set_width(textarea, LV_PCT(85));
+    lv_obj_align(textarea, LV_ALIGN_TOP_LEFT, 0, 0);
+    lv_obj_add_event_cb(textarea, textarea_event_cb, LV_EVENT_VALUE_CHANGED, this);
+
+    lv_obj_t* close_btn = lv_button_create(panel);
+    lv_obj_set_size(close_btn, LV_PCT(13), 40);
+    lv_obj_align(close_btn, LV_ALIGN_TOP_RIGHT, 0, 0);
+    lv_obj_add_event_cb(close_btn, close_event_cb, LV_EVENT_CLICKED, this);
+
+    lv_obj_t* close_label = lv_label_create(close_btn);
+    lv_label_set_text(close_label, LV_SYMBOL_CLOSE);
+    lv_obj_center(close_label);
+
+    list = lv_obj_create(panel);
+    lv_obj_set_size(list, LV_PCT(100), LV_PCT(35));
+    lv_obj_align(list, LV_ALIGN_TOP_LEFT, 0, 44);
+    lv_obj_set_style_pad_all(list, 0, LV_PART_MAIN);
+    lv_obj_set_scroll_dir(list, LV_DIR_VER);
+
+    for(size_t i = 0; i < rows.size(); i++) {
+        Row& row = rows[i];
+
+        row.obj = lv_obj_create(list);
+        lv_obj_set_size(row.obj, LV_PCT(100), row_height);
+        lv_obj_set_y(row.obj, static_cast<int32_t>(i) * row_height);
+        lv_obj_set_style_radius(row.obj, 0, LV_PART_MAIN);
+        lv_obj_set_style_pad_all(row.obj, 2, LV_PART_MAIN);
+        lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+
+        row.name = lv_label_create(row.obj);
+        lv_label_set_long_mode(row.name, LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(row.name, LV_PCT(100));
+        lv_obj_align(row.name, LV_ALIGN_TOP_LEFT, 0, 0);
+
+        row.detail = lv_label_create(row.obj);
+        lv_label_set_long_mode(row.detail, LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(row.detail, LV_PCT(100));
+        lv_obj_align(row.detail, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+    }
+
+    //The keyboard's close key sends LV_EVENT_CANCEL.
+    keyboard = lv_keyboard_create(panel);
+    lv_obj_set_size(keyboard, LV_PCT(100), LV_PCT(50));
+    lv_obj_align(keyboard, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_keyboard_set_textarea(keyboard, textarea);
+    lv_obj_add_event_cb(keyboard, close_event_cb, LV_EVENT_CANCEL, this);
+
+    for(auto& entry : cache) {
+        entry.last_used = 0;
+    }
+
+    xTaskCreatePinnedToCore(search_task_dummy,
+                            "Search",
+                            6144,
+                            this,
+                            1,
+                            &task_handle,
+                            CONFIG_NETWORK_TASK_CORE);
+}
+
+SearchView::~SearchView() {
+    vTaskDelete(task_handle);
+    lv_obj_delete(panel);
+}
+
+void SearchView::show() {
+    lv_obj_remove_flag(panel, LV_OBJ_FLAG_HIDDEN);
+    query_changed();
+}
+
+void SearchView::hide() {
+    lv_obj_add_flag(panel, LV_OBJ_FLAG_HIDDEN);
+
+    //Showing the view again looks the query up anew.
+    query.clear();
+    generation++;
+    answered = true;
+    cancel.cancel();
+}
+
+lv_obj_t* SearchView::getObj() {
+    return panel;
+}
+
+SearchView::Stats SearchView::getStats() {
+    return stats;
+}
+
+void SearchView::textarea_event_cb(lv_event_t* e) {
+    auto view = static_cast<SearchView*>(lv_event_get_user_data(e));
+
+    view->stats.keystrokes++;
+    view->query_changed();
+}
+
+void SearchView::close_event_cb(lv_event_t* e) {
+    auto view = static_cast<SearchView*>(lv_event_get_user_data(e));
+    view->hide();
+}
+
+void SearchView::query_changed() {
+    std::string text = normalize(lv_textarea_get_text(textarea));
+
+    if(text == query) {
+        return;
+    }
+
+    query = std::move(text);
+    generation++;
+    keystroke_us = esp_timer_get_time();
+    first_shown = false;
+    answered = true;
+
+    //Whatever is in flight answers an older query.
+    cancel.cancel();
+
+    if(query.empty()) {
+        clear_results();
+        return;
+    }
+
+    clear_results();
+
+    //Saved items are found without a request, in a few ms, and stay above the search results.
+    if(library != nullptr) {
+        saved.clear();
+
+        if(library->search(query, rows.size(), saved) > 0) {
+            stats.library_hits++;
+            show_results(saved, "");
+            first_result();
+        }
+    }
+
+    CacheEntry* entry = find_cached(query, false);
+
+    if(entry != nullptr) {
+        entry->last_used = ++cache_clock;
+        stats.cache_hits++;
+        show_results(entry->results, "");
+        first_result();
+        return;
+    }
+
+    //Until the results arrive, those of a shorter query that still match stand in.
+    entry = find_cached(query, true);
+
+    if(entry != nullptr && row_count == 0) {
+        entry->last_used = ++cache_clock;
+        show_results(entry->results, query);
+        provisional = true;
+    }
+
+    answered = false;
+    xTaskNotifyGive(task_handle);
+}
+
+void SearchView::clear_results() {
+    for(size_t i = 0; i < row_count; i++) {
+        lv_obj_add_flag(rows[i].obj, LV_OBJ_FLAG_HIDDEN);
+    }
+
+    row_count = 0;
+    provisional = false;
+    lv_obj_scroll_to_y(list, 0, LV_ANIM_OFF);
+}
+
+void SearchView::add_result(const spotify::SearchResult& result) {
+    if(row_count == rows.size()) {
+        return;
+    }
+
+    //Saved items are found by the search as well.
+    for(size_t i = 0; i < row_count; i++) {
+        if(rows[i].uri == result.uri) {
+            return;
+        }
+    }
+
+    Row& row = rows[row_count++];
+    row.uri = result.uri;
+    std::string detail = type_name(result.type);
+
+    if(!result.detail.empty()) {
+        detail += " - ";
+        detail += result.detail;
+    }
+
+    lv_label_set_text(row.name, result.name.c_str());
+    lv_label_set_text(row.detail, detail.c_str());
+    lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+}
+
+void SearchView::show_results(const std::vector<spotify::SearchResult>& results, std::string_view filter) {
+    for(const auto& result : results) {
+        if(filter.empty() || contains(result.name, filter) || contains(result.detail, filter)) {
+            add_result(result);
+        }
+    }
+}
+
+void SearchView::first_result() {
+    if(first_shown) {
+        return;
+    }
+
+    first_shown = true;
+    stats.queries++;
+    stats.first_result_us = esp_timer_get_time() - keystroke_us;
+    first_result_total_us += stats.first_result_us;
+    stats.avg_first_result_us = first_result_total_us / stats.queries;
+}
+
+SearchView::CacheEntry* SearchView::find_cached(std::string_view query, bool prefix) {
+    CacheEntry* found = nullptr;
+
+    for(auto& entry : cache) {
+        if(entry.query.empty()) {
+            continue;
+        }
+
+        if(!prefix && entry.query == query) {
+            return &entry;
+        }
+
+        //The longest shorter query the new one starts with.
+        if(prefix && entry.query.size() < query.size() && query.starts_with(entry.query) &&
+           (found == nullptr || entry.query.size() > found->query.size())) {
+            found = &entry;
+        }
+    }
+
+    return found;
+}
+
+void SearchView::store(const std::string& query, std::vector<spotify::SearchResult>& results) {
+    CacheEntry* victim = find_cached(query, false);
+
+    //Replace the least recently shown entry, unused entries have never been shown.
+    if(victim == nullptr) {
+        victim = &cache[0];
+
+        for(auto& entry : cache) {
+            if(entry.last_used < victim->last_used) {
+                victim = &entry;
+            }
+        }
+    }
+
+    victim->query = query;
+    victim->results.swap(results);
+    victim->last_used = ++cache_clock;
+}
+
+void SearchView::search_task_dummy(void *arg) {
+    auto obj = static_cast<SearchView*>(arg);
+    obj->search_task();
+}
+
+void SearchView::search_task() {
+    std::vector<spotify::SearchResult> results;
+
+    while(1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        //Every keystroke restarts the wait, so a query is only sent once typing pauses.
+        while(ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_UI_SEARCH_DEBOUNCE_MS)) > 0) {
+        }
+
+        lv_lock();
+        std::string pending = query;
+        uint32_t pending_generation = generation;
+        bool wanted = !answered;
+
+        //Cancellations from here on are meant for this search.
+        if(wanted) {
+            cancel.reset();
+            stats.requests++;
+        }
+        lv_unlock();
+
+        if(!wanted) {
+            continue;
+        }
+
+        results.clear();
+
+        bool success = client.search(pending, [&](spotify::SearchResult&& result) {
+            lv_lock();
+            if(pending_generation == generation) {
+                //The first result replaces those of the cached prefix.
+                if(provisional) {
+                    clear_results();
+                }
+
+                add_result(result);
+                first_result();
+            }
+            lv_unlock();
+
+            results.push_back(std::move(result));
+        }, Deadline::in(search_timeout_ms, &cancel));
+
+        lv_lock();
+        bool current = pending_generation == generation;
+
+        //Complete results are worth keeping even if the query changed meanwhile.
+        if(success) {
+            store(pending, results);
+        }
+
+        if(success && current) {
+            answered = true;
+
+            //No results at all, the stand-ins don't match either.
+            if(provisional) {
+                clear_results();
+            }
+
+            first_result();
+        }
+
+        else if(!success && !current) {
+            stats.cancelled++;
+        }
+
+        Stats out = stats;
+        lv_unlock();
+
+        if(success && current) {
+            DLOGI(TAG, "\"%s\": first result after %lld us (avg %lld us), %lu requests for %lu keystrokes, %lu cancelled, %lu cache hits, %lu library hits",
+                     pending.c_str(),
+                     out.first_result_us,
+                     out.avg_first_result_us,
+                     static_cast<unsigned long>(out.requests),
+                     static_cast<unsigned long>(out.keystrokes),
+                     static_cast<unsigned long>(out.cancelled),
+                     static_cast<unsigned long>(out.cache_hits),
+                     static_cast<unsigned long>(out.library_hits));
+        }
+
+        else if(current) {
+            DLOGE(TAG, "Search for \"%s\" failed", pending.c_str());
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#include "player_snapshot.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "cJSON.h"
+#include <cstring>
+#include <vector>
+
+#if CONFIG_BOOT_BENCHMARKS
+
+namespace snapshot {
+
+    static const char* TAG = "SnapshotBench";
+
+    static constexpr int iterations = 1000;
+
+    static spotify::PlayerState sample_state() {
+        spotify::PlayerState state = {};
+        spotify::Track& track = state.track;
+
+        track.uri = "spotify:track:6rqhFgbbKwnb9MLmUQDhG6";
+        track.name = "Speak to Me - 2011 Remastered Version";
+        track.album_name = "The Dark Side of the Moon (2011 Remastered Version)";
+        track.album_pic_url = "https://i.scdn.co/image/ab67616d00001e02ea7caaff71dea1051d49b2fe";
+        track.context_uri = "spotify:playlist:37i9dQZF1DXcBWIGoYBM5M";
+        track.artists = {"Pink Floyd", "Alan Parsons"};
+        track.duration_ms = 65000;
+        track.progress_ms = 31235;
+
+        state.play_state = spotify::PlayState::Playing;
+        state.shuffle_state = spotify::ShuffleState::Off;
+        state.repeat_state = spotify::RepeatState::Context;
+        state.volume_percent = 64;
+
+        return state;
+    }
+
+    //The same fields in the shape of GET /v1/me/player.
+    static char* print_json(const spotify::PlayerState& state, int64_t timestamp_ms) {
+        const spotify::Track& track = state.track;
+        cJSON *root = cJSON_CreateObject();
+
+        cJSON *device = cJSON_AddObjectToObject(root, "device");
+        cJSON_AddNumberToObject(device, "volume_percent", state.volume_percent);
+
+        cJSON_AddBoolToObject(root, "shuffle_state", state.shuffle_state == spotify::ShuffleState::On);
+        cJSON_AddStringToObject(root, "repeat_state", state.repeat_state == spotify::RepeatState::Off ? "off" :
+                                                      state.repeat_state == spotify::RepeatState::Track ? "track" : "context");
+        cJSON_AddNumberToObject(root, "timestamp", timestamp_ms);
+
+        cJSON *context = cJSON_AddObjectToObject(root, "context");
+        cJSON_AddStringToObject(context, "uri", track.context_uri.c_str());
+
+        cJSON_AddNumberToObject(root, "progress_ms", track.progress_ms);
+        cJSON_AddBoolToObject(root, "is_playing", state.play_state == spotify::PlayState::Playing);
+
+        cJSON *item = cJSON_AddObjectToObject(root, "item");
+        cJSON *album = cJSON_AddObjectToObject(item, "album");
+        cJSON *images = cJSON_AddArrayToObject(album, "images");
+        cJSON *image = cJSON_CreateObject();
+        cJSON_AddStringToObject(image, "url", track.album_pic_url.c_str());
+        cJSON_AddItemToArray(images, image);
+        cJSON_AddStringToObject(album, "name", track.album_name.c_str());
+
+        cJSON *artists = cJSON_AddArrayToObject(item, "artists");
+
+        for(const auto& name : track.artists) {
+            cJSON *artist = cJSON_CreateObject();
+            cJSON_AddStringToObject(artist, "name", name.c_str());
+            cJSON_AddItemToArray(artists, artist);
+        }
+
+        cJSON_AddNumberToObject(item, "duration_ms", track.duration_ms);
+        cJSON_AddStringToObject(item, "name", track.name.c_str());
+        cJSON_AddStringToObject(item, "uri", track.uri.c_str());
+
+        char *json = cJSON_PrintUnformatted(root);
+        cJSON_Delete(root);
+        return json;
+    }
+
+    static bool parse_json(const char* json, spotify::PlayerState& state) {
+        spotify::Track& track = state.track;
+        cJSON *root = cJSON_Parse(json);
+
+        if(root == nullptr) {
+            return false;
+        }
+
+        cJSON *item = cJSON_GetObjectItemCaseSensitive(root, "item");
+        cJSON *album = cJSON_GetObjectItemCaseSensitive(item, "album");
+        cJSON *image = cJSON_GetArrayItem(cJSON_GetObjectItemCaseSensitive(album, "images"), 0);
+        cJSON *context = cJSON_GetObjectItemCaseSensitive(root, "context");
+        cJSON *artist = nullptr;
+
+        track.uri = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "uri"));
+        track.name = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item, "name"));
+        track.album_name = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(album, "name"));
+        track.album_pic_url = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(image, "url"));
+        track.context_uri = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(context, "uri"));
+        track.artists.clear();
+
+        cJSON_ArrayForEach(artist, cJSON_GetObjectItemCaseSensitive(item, "artists")) {
+            track.artists.emplace_back(cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(artist, "name")));
+        }
+
+        track.duration_ms = cJSON_GetObjectItemCaseSensitive(item, "duration_ms")->valuedouble;
+        track.progress_ms = cJSON_GetObjectItemCaseSensitive(root, "progress_ms")->valuedouble;
+
+        const char* repeat = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(root, "repeat_state"));
+
+        state.play_state = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(root, "is_playing")) ? spotify::PlayState::Playing : spotify::PlayState::Paused;
+        state.shuffle_state = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(root, "shuffle_state")) ? spotify::ShuffleState::On : spotify::ShuffleState::Off;
+        state.repeat_state = std::strcmp(repeat, "track") == 0 ? spotify::RepeatState::Track :
+                             std::strcmp(repeat, "context") == 0 ? spotify::RepeatState::Context : spotify::RepeatState::Off;
+        state.volume_percent = cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(root, "device"), "volume_percent")->valuedouble;
+
+        cJSON_Delete(root);
+        return true;
+    }
+
+    void benchmark() {
+        const spotify::PlayerState state = sample_state();
+        const int64_t timestamp_ms = 1700000000000;
+
+        std::vector<uint8_t> buffer(encodedSize(state));
+        spotify::PlayerState decoded = {};
+        View view;
+        size_t checksum = 0;
+
+        int64_t start_us = esp_timer_get_time();
+
+        for(int i = 0; i < iterations; i++) {
+            checksum += encode(state, timestamp_ms, buffer.data(), buffer.size());
+        }
+
+        int64_t encode_us = esp_timer_get_time() - start_us;
+        start_us = esp_timer_get_time();
+
+        for(int i = 0; i < iterations; i++) {
+            checksum += decode(buffer.data(), buffer.size(), view);
+        }
+
+        int64_t view_us = esp_timer_get_time() - start_us;
+        start_us = esp_timer_get_time();
+
+        for(int i = 0; i < iterations; i++) {
+            checksum += decode(buffer.data(), buffer.size(), view);
+            copy(view, decoded);
+        }
+
+        int64_t copy_us = esp_timer_get_time() - start_us;
+
+        char *json = print_json(state, timestamp_ms);
+        size_t json_size = std::strlen(json);
+        start_us = esp_timer_get_time();
+
+        for(int i = 0; i < iterations; i++) {
+            char *printed = print_json(state, timestamp_ms);
+            checksum += printed[0];
+            cJSON_free(printed);
+        }
+
+        int64_t print_us = esp_timer_get_time() - start_us;
+        start_us = esp_timer_get_time();
+
+        for(int i = 0; i < iterations; i++) {
+            checksum += parse_json(json, decoded);
+        }
+
+        int64_t parse_us = esp_timer_get_time() - start_us;
+        cJSON_free(json);
+
+        ESP_LOGI(TAG, "Snapshot %u bytes, JSON %u bytes (checksum %lu)", static_cast<unsigned>(buffer.size()),
+                 static_cast<unsigned>(json_size), static_cast<uint32_t>(checksum));
+        ESP_LOGI(TAG, "Snapshot encode %.2f us, decode to view %.2f us, decode and copy %.2f us",
+                 static_cast<double>(encode_us) / iterations, static_cast<double>(view_us) / iterations,
+                 static_cast<double>(copy_us) / iterations);
+        ESP_LOGI(TAG, "JSON build and print %.2f us, parse and extract %.2f us",
+                 static_cast<double>(print_us) / iterations, static_cast<double>(parse_us) / iterations);
+    }
+
+}
+
+#endif
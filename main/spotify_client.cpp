@@ -1,10 +1,18 @@
+#define DLOG_LOCAL_LEVEL CONFIG_SPOTIFY_LOG_LEVEL
 #include "spotify_client.h"
-#include "esp_log.h"
+#include "deferred_log.h"
 #include "esp_system.h"
 #include "cJSON.h"
 #include "base64.h"
+#include "track_cache.h"
+#include "trace.h"
+#include "metrics.h"
+#include "relay_client.h"
+#include "spotify_endpoints.h"
+#include "url_builder.h"
+#include "json_item_scanner.h"
 #include <array>
-#include <stdarg.h>
+#include <string>
 
 // TO-DO:
 // 1) Add logic to handle updated access token for static objects.
@@ -17,46 +25,143 @@
 
 static const char* TAG = "SpotifyClient";
 
-static cJSON* JSON_GetItemFromPath(cJSON *root, ...) {
-    va_list args;
-    va_start(args, root);
+static std::string JSON_JoinNames(const cJSON *array) {
+    std::string names;
+    const cJSON *item = nullptr;
 
-    cJSON *current_element = root;
+    cJSON_ArrayForEach(item, array) {
+        const char *name = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item,"name"));
 
-    do {
-        if (current_element == NULL) {
-            va_end(args);
-            return NULL;
+        if(name == nullptr) {
+            continue;
         }
 
-        if (current_element->type == cJSON_Array) {
-            int index = va_arg(args, int);
-            current_element = cJSON_GetArrayItem(current_element, index);
-        } 
-        
-        else if (current_element->type == cJSON_Object) {
-            const char *key = va_arg(args, const char *);
-            current_element = cJSON_GetObjectItem(current_element, key);
-        } 
-        
-        else {
-            va_end(args);
-            return NULL;
+        if(!names.empty()) {
+            names += ", ";
+        }
+
+        names += name;
+    }
+
+    return names;
+}
+
+//Fills a search result from an entry of the tracks, albums or playlists section.
+static bool JSON_ParseSearchResult(std::string_view section, const cJSON *item, spotify::SearchResult &result) {
+    const char *name = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item,"name"));
+    const char *uri = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(item,"uri"));
+
+    if(name == nullptr || uri == nullptr) {
+        return false;
+    }
+
+    if(section == "tracks") {
+        result.type = spotify::SearchType::Track;
+        result.detail = JSON_JoinNames(cJSON_GetObjectItemCaseSensitive(item,"artists"));
+    }
+
+    else if(section == "albums") {
+        result.type = spotify::SearchType::Album;
+        result.detail = JSON_JoinNames(cJSON_GetObjectItemCaseSensitive(item,"artists"));
+    }
+
+    else if(section == "playlists") {
+        const char *owner = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(item,"owner"),"display_name"));
+        result.type = spotify::SearchType::Playlist;
+        result.detail = owner != nullptr ? owner : "";
+    }
+
+    else {
+        return false;
+    }
+
+    result.name = name;
+    result.uri = uri;
+    return true;
+}
+
+//Fills a saved item from an entry of /v1/me/tracks, /v1/me/albums or /v1/me/playlists.
+static bool JSON_ParseSavedItem(spotify::SearchType type, const cJSON *entry, spotify::SavedItem &item) {
+    const cJSON *object = entry;
+
+    //Saved tracks and albums wrap the object with the time it was saved.
+    if(type == spotify::SearchType::Track) {
+        object = cJSON_GetObjectItemCaseSensitive(entry,"track");
+    }
+
+    else if(type == spotify::SearchType::Album) {
+        object = cJSON_GetObjectItemCaseSensitive(entry,"album");
+    }
+
+    const char *name = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(object,"name"));
+    const char *id = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(object,"id"));
+    const char *added_at = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(entry,"added_at"));
+
+    //Local files have no ID.
+    if(name == nullptr || id == nullptr) {
+        return false;
+    }
+
+    item.type = type;
+    item.name = name;
+    item.id = id;
+    item.added_at = added_at != nullptr ? added_at : "";
+    item.artists.clear();
+
+    if(type == spotify::SearchType::Playlist) {
+        const char *owner = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(object,"owner"),"display_name"));
+
+        if(owner != nullptr) {
+            item.artists.emplace_back(owner);
         }
+    }
+
+    else {
+        const cJSON *artist = nullptr;
+
+        cJSON_ArrayForEach(artist, cJSON_GetObjectItemCaseSensitive(object,"artists")) {
+            const char *artist_name = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(artist,"name"));
+
+            if(artist_name != nullptr) {
+                item.artists.emplace_back(artist_name);
+            }
+        }
+    }
 
-    } while(current_element->child != NULL); 
+    return true;
+}
 
-    va_end(args);
-    return current_element;
+//Response bodies are NUL-terminated by HttpClient.
+template<typename T>
+static bool JSON_Decode(const mem::Buffer &buff, T &out) {
+    trace::Scope scope(trace::Id::JsonParse);
+    return json::decode(std::string_view(buff.data(), buff.empty() ? 0 : buff.size() - 1), out);
 }
 
 namespace spotify {
-    Client::Client() {
-        std::vector<char> buff;
+    //Spacing of intermediate requests while a slider is dragged.
+    static constexpr uint32_t control_interval_ms = 250;
+
+    Client::Client()
+        : track_cache(std::make_unique<TrackCache>([this](const std::vector<std::string>& uris, std::vector<Track>& tracks) { return getTracks(uris, tracks); })),
+          volume_percent(0),
+          progress_ms(0),
+          duration_ms(0),
+          next_poll_token(0),
+          volume_channel("Volume", [this](int value) { return sendPlayerControl(Control::Volume, value); }, control_interval_ms),
+          seek_channel("Seek", [this](int value) { return sendPlayerControl(Control::Seek, value); }, control_interval_ms) {
+        mem::Buffer buff;
         constexpr auto auth_enc = base64::encode(API_AUTH);
         constexpr std::string_view auth_part{"Basic "};
 
         mtx_token = xSemaphoreCreateMutex();
+        mtx_api = xSemaphoreCreateMutex();
+        mtx_player = xSemaphoreCreateMutex();
+        mtx_command = xSemaphoreCreateMutex();
+
+#if CONFIG_RELAY
+        relay = std::make_unique<RelayClient>(CONFIG_RELAY_URL);
+#endif
         
         //Concatenation
         constexpr auto auth = [&] {
@@ -71,18 +176,23 @@ namespace spotify {
         token_http_client.setHeader("Authorization", auth.data());
 
         bool success = token_http_client.post("https://accounts.spotify.com/api/token",API_BODY, buff);
-        
+        metrics::countTokenRefresh(success && !buff.empty());
+
         if(!success || buff.empty()) {
-            ESP_LOGE(TAG,"HTTP POST for access token failed");
+            DLOGE(TAG,"HTTP POST for access token failed");
         }
 
         else {
-            cJSON *root = cJSON_Parse(buff.data());
-            cJSON *item = cJSON_GetObjectItemCaseSensitive(root, "access_token");
-            access_token = std::string{item->valuestring};
+            api::Token token{};
 
-            ESP_LOGI(TAG,"Access Token: %s",access_token.c_str());
-            cJSON_Delete(root);
+            if(JSON_Decode(buff, token)) {
+                access_token = std::move(token.access_token);
+                DLOGI(TAG,"Access token received");
+            }
+
+            else {
+                DLOGE(TAG,"No access token in the response");
+            }
 
             xTaskCreatePinnedToCore(  
                 get_access_token_task_dummy,    // Function to be called
@@ -91,7 +201,7 @@ namespace spotify {
                 this,                           // Parameter to pass
                 3,                              // Task priority
                 nullptr,                        // Task handle
-                0);                             // Core affinity
+                CONFIG_NETWORK_TASK_CORE);      // Core affinity
         }
 
     }
@@ -100,130 +210,451 @@ namespace spotify {
 
     }
 
-    Track Client::getCurrentlyPlaying() {
-        static bool first = true;
-        static HttpClient http_client;
-        std::vector<char> buff;
-        Track track;
+    Deadline Client::pollDeadline(uint32_t timeout_ms) {
+        CancelToken& token = poll_tokens[next_poll_token.fetch_add(1, std::memory_order_relaxed) % poll_token_count];
+
+        token.reset();
+        return Deadline::in(timeout_ms, &token);
+    }
+
+    void Client::cancel_polls() {
+        for(CancelToken& token : poll_tokens) {
+            token.cancel();
+        }
+    }
+
+    Track Client::getCurrentlyPlaying(const Deadline& deadline) {
+        mem::Buffer buff;
+        Track track{};
+
+#if CONFIG_RELAY
+        RelayClient::State relay_state;
+
+        //The relay polls the API for every controller, only fall back to polling while it's unreachable.
+        if(relay->getState(relay_state)) {
+            play_state = relay_state.play_state;
+            shuffle_state = relay_state.shuffle_state;
+            repeat_state = relay_state.repeat_state;
+            volume_percent = relay_state.volume_percent;
+            progress_ms = relay_state.track.progress_ms;
+            duration_ms = relay_state.track.duration_ms;
+
+            if(!relay_state.track.uri.empty()) {
+                track_cache->insert(relay_state.track);
+            }
+
+            return relay_state.track;
+        }
+#endif
 
         xSemaphoreTake(mtx_token,portMAX_DELAY);
         std::string bearer = "Bearer " + access_token;
         xSemaphoreGive(mtx_token);
-        
-        http_client.setHeader("Authorization",bearer);
 
-        bool success = http_client.get("https://api.spotify.com/v1/me/player/currently-playing",buff);
+        //The other caller's request is bounded by its own deadline, this one waits no longer than its own.
+        if(xSemaphoreTake(mtx_player, pdMS_TO_TICKS(deadline.timeoutMs(false))) != pdTRUE) {
+            DLOGW(TAG,"Currently playing request dropped, another one is in progress");
+            return track;
+        }
+
+        player_http_client.setHeader("Authorization",bearer.c_str());
+        bool success = player_http_client.get(API_URL "/v1/me/player/currently-playing?additional_types=episode",buff,deadline);
+        xSemaphoreGive(mtx_player);
 
         if(!success) {
-            ESP_LOGE(TAG,"HTTP GET for current play failed");
+            DLOGE(TAG,"HTTP GET for current play failed");
+            return track;
+        }
+
+        api::CurrentlyPlaying playing{};
+
+        if(!JSON_Decode(buff, playing)) {
+            DLOGE(TAG,"Unexpected currently playing response");
             return track;
         }
 
+        //Episodes are shown like tracks, the show as the album and the publisher as the artist.
+        if(playing.type == "episode") {
+            track.name = std::move(playing.episode.name);
+            track.album_name = std::move(playing.episode.show_name);
+            track.album_pic_url = std::move(playing.episode.image_url);
+            track.artists.push_back(std::move(playing.episode.publisher));
+            track.duration_ms = playing.episode.duration_ms;
+            track.uri = std::move(playing.episode.uri);
+        }
+
+        //Ads and unknown items come without one, only the play state is known then.
         else {
-            ESP_LOGI(TAG, "Parsing data");
+            track = std::move(playing.track);
+        }
 
-            //Should write a JSON class that moves the vector.
-            cJSON *root = cJSON_Parse(buff.data());
+        track.progress_ms = playing.progress_ms;
+        track.context_uri = std::move(playing.context_uri);
+        progress_ms = track.progress_ms;
+        duration_ms = track.duration_ms;
+        play_state = playing.is_playing ? PlayState::Playing : PlayState::Paused;
 
-            cJSON *item = cJSON_GetObjectItemCaseSensitive(root,"item");
+        if(!track.uri.empty()) {
+            track_cache->insert(track);
+        }
 
-            cJSON *track_name_obj = cJSON_GetObjectItemCaseSensitive(item,"name");
+        return track;
+    }
 
-            cJSON *album_obj = cJSON_GetObjectItemCaseSensitive(item,"album");
+    bool Client::waitForRelayUpdate(TickType_t timeout) {
+#if CONFIG_RELAY
+        return relay->waitForUpdate(timeout);
+#else
+        vTaskDelay(timeout);
+        return false;
+#endif
+    }
 
-            cJSON *album_name_obj = cJSON_GetObjectItemCaseSensitive(album_obj,"name");
+    bool Client::getQueue(TrackPage& page) {
+        mem::Buffer buff;
 
-            cJSON *album_pic_obj = JSON_GetItemFromPath(album_obj,"images",1,"url");
+        xSemaphoreTake(mtx_token,portMAX_DELAY);
+        std::string bearer = "Bearer " + access_token;
+        xSemaphoreGive(mtx_token);
 
-            cJSON *duration_ms_obj =  cJSON_GetObjectItemCaseSensitive(item,"duration_ms");
+        xSemaphoreTake(mtx_api,portMAX_DELAY);
+        api_http_client.setHeader("Authorization",bearer.c_str());
+        bool success = api_http_client.get(API_URL "/v1/me/player/queue",buff);
+        xSemaphoreGive(mtx_api);
 
-            cJSON *progress_ms_obj = cJSON_GetObjectItemCaseSensitive(root,"progress_ms");
+        if(!success) {
+            DLOGE(TAG,"HTTP GET for queue failed");
+            return false;
+        }
 
-            cJSON *artists_obj = cJSON_GetObjectItemCaseSensitive(item,"artists"); 
+        api::Queue queue{};
 
-            cJSON *is_playing_obj = cJSON_GetObjectItemCaseSensitive(root,"is_playing");
+        if(!JSON_Decode(buff, queue)) {
+            DLOGE(TAG,"Unexpected queue response");
+            return false;
+        }
 
-            const cJSON *artist = nullptr;
+        page.items = std::move(queue.queue);
+        page.offset = 0;
+        page.total = static_cast<int>(page.items.size());
 
-            //Always an array even if there's only one object.
-            cJSON_ArrayForEach(artist, artists_obj) {
-                cJSON *artist_name_obj = cJSON_GetObjectItemCaseSensitive(artist, "name");
+        for(const auto& track : page.items) {
+            track_cache->insert(track);
+        }
 
-                track.artists.emplace_back(artist_name_obj->valuestring);
-            }
+        return true;
+    }
 
-            track.progress_ms = static_cast<int>(progress_ms_obj->valuedouble);
-            track.duration_ms = static_cast<int>(duration_ms_obj->valuedouble);
-            track.name = track_name_obj->valuestring;
-            track.album_name = album_name_obj->valuestring;
+    bool Client::getDevices(std::vector<Device>& devices) {
+        mem::Buffer buff;
 
-            if(cJSON_IsNull(album_pic_obj)) {
-                track.album_pic_url = "";
-            }
+        xSemaphoreTake(mtx_token,portMAX_DELAY);
+        std::string bearer = "Bearer " + access_token;
+        xSemaphoreGive(mtx_token);
 
-            else {
-                track.album_pic_url = album_pic_obj->valuestring;
+        xSemaphoreTake(mtx_api,portMAX_DELAY);
+        api_http_client.setHeader("Authorization",bearer.c_str());
+        bool success = api_http_client.get(API_URL "/v1/me/player/devices",buff);
+        xSemaphoreGive(mtx_api);
+
+        if(!success) {
+            DLOGE(TAG,"HTTP GET for devices failed");
+            return false;
+        }
+
+        api::Devices response{};
+
+        if(!JSON_Decode(buff, response)) {
+            DLOGE(TAG,"Unexpected devices response");
+            return false;
+        }
+
+        devices = std::move(response.devices);
+
+        return true;
+    }
+
+    bool Client::getPlaylistTracks(std::string_view playlist_id, int offset, int limit, TrackPage& page) {
+        mem::Buffer buff;
+
+        xSemaphoreTake(mtx_token,portMAX_DELAY);
+        std::string bearer = "Bearer " + access_token;
+        xSemaphoreGive(mtx_token);
+
+        //Only the URIs are requested, the metadata is resolved through the track cache.
+        std::string url = API_URL "/v1/playlists/";
+        url.append(playlist_id);
+        url += "/tracks?fields=total,items(track(uri))&offset=";
+        url += std::to_string(offset);
+        url += "&limit=";
+        url += std::to_string(limit);
+
+        xSemaphoreTake(mtx_api,portMAX_DELAY);
+        api_http_client.setHeader("Authorization",bearer.c_str());
+        bool success = api_http_client.get(url.c_str(),buff);
+        xSemaphoreGive(mtx_api);
+
+        if(!success) {
+            DLOGE(TAG,"HTTP GET for playlist tracks failed");
+            return false;
+        }
+
+        api::PlaylistPage response{};
+
+        if(!JSON_Decode(buff, response)) {
+            DLOGE(TAG,"Unexpected playlist tracks response");
+            return false;
+        }
+
+        std::vector<std::string> uris;
+
+        uris.reserve(response.items.size());
+        page.offset = offset;
+        page.total = response.total;
+
+        for(auto& item : response.items) {
+            uris.push_back(std::move(item.uri));
+        }
+
+        //Local files and unavailable tracks cannot be resolved and are shown without metadata.
+        resolveTracks(uris, page.items);
+
+        return true;
+    }
+
+    bool Client::search(std::string_view query, const SearchSink& sink, const Deadline& deadline) {
+        UrlBuilder<256> url;
+
+        url.append(API_URL "/v1/search");
+        url.query("q", query).query("type", "track,album,playlist").query("limit", search_limit);
+
+        if(!url.ok()) {
+            DLOGE(TAG,"Search URL for \"%.*s\" does not fit", static_cast<int>(query.size()), query.data());
+            return false;
+        }
+
+        //Entries are parsed as their closing brace arrives, not once the page is complete.
+        JsonItemScanner scanner([&sink](std::string_view section, std::string_view item) {
+            mem::JsonScope json_scope;
+            cJSON *root = cJSON_ParseWithLength(item.data(), item.size());
+            SearchResult result;
+
+            if(JSON_ParseSearchResult(section, root, result)) {
+                sink(std::move(result));
             }
 
-            bool is_playing = cJSON_IsTrue(is_playing_obj) == cJSON_True;
-            
-            play_state = is_playing ? PlayState::Playing : PlayState::Paused;
+            cJSON_Delete(root);
+        });
+
+        if(!set_authorization(search_http_client)) {
+            return false;
+        }
+
+        return search_http_client.stream(url.c_str(), [&scanner](const char* data, size_t size) {
+            scanner.feed(data, size);
+        }, deadline);
+    }
+
+    bool Client::getSavedItems(SearchType type, int offset, const SavedSink& sink, int& total, const Deadline& deadline) {
+        static constexpr const char* paths[] = {API_URL "/v1/me/tracks", API_URL "/v1/me/albums", API_URL "/v1/me/playlists"};
+        UrlBuilder<128> url;
+
+        url.append(paths[static_cast<size_t>(type)]);
+        url.query("offset", offset).query("limit", saved_page_limit);
+
+        //A page of 50 full tracks is about 150 KB, only one entry at a time is held.
+        JsonItemScanner scanner([type, &sink](std::string_view, std::string_view entry) {
+            mem::JsonScope json_scope;
+            cJSON *root = cJSON_ParseWithLength(entry.data(), entry.size());
+            SavedItem item;
+
+            if(JSON_ParseSavedItem(type, root, item)) {
+                sink(std::move(item));
+            }
 
             cJSON_Delete(root);
+        });
 
-            return track;
+        xSemaphoreTake(mtx_api,portMAX_DELAY);
+        bool success = set_authorization(api_http_client) && api_http_client.stream(url.c_str(), [&scanner](const char* data, size_t size) {
+            scanner.feed(data, size);
+        }, deadline);
+        xSemaphoreGive(mtx_api);
+
+        total = static_cast<int>(scanner.getTotal());
+
+        if(!success || total < 0) {
+            DLOGE(TAG,"HTTP GET for saved items failed");
+            return false;
         }
+
+        return true;
     }
 
-    bool Client::sendPlayerCommand(Command cmd) {
-        static HttpClient http_client; 
-        std::vector<char> buff;
-        bool success = false;
+    bool Client::getTracks(const std::vector<std::string>& uris, std::vector<Track>& tracks) {
+        constexpr std::string_view prefix = "spotify:track:";
+        mem::Buffer buff;
+        std::string url = API_URL "/v1/tracks?ids=";
+        bool first = true;
+
+        for(const auto& uri : uris) {
+            if(!uri.starts_with(prefix)) {
+                continue;
+            }
+
+            if(!first) {
+                url += ',';
+            }
+
+            url.append(uri, prefix.size());
+            first = false;
+        }
+
+        if(first) {
+            return true;
+        }
 
         xSemaphoreTake(mtx_token,portMAX_DELAY);
         std::string bearer = "Bearer " + access_token;
         xSemaphoreGive(mtx_token);
-        
-        http_client.setHeader("Authorization", bearer);
+
+        xSemaphoreTake(mtx_api,portMAX_DELAY);
+        api_http_client.setHeader("Authorization",bearer.c_str());
+        bool success = api_http_client.get(url.c_str(),buff);
+        xSemaphoreGive(mtx_api);
+
+        if(!success) {
+            DLOGE(TAG,"HTTP GET for tracks failed");
+            return false;
+        }
+
+        api::Tracks response{};
+
+        //Unknown IDs come back as null entries, which are dropped.
+        if(!JSON_Decode(buff, response)) {
+            DLOGE(TAG,"Unexpected tracks response");
+            return false;
+        }
+
+        tracks.insert(tracks.end(), std::make_move_iterator(response.tracks.begin()), std::make_move_iterator(response.tracks.end()));
+
+        return true;
+    }
+
+    bool Client::resolveTracks(const std::vector<std::string>& uris, std::vector<Track>& tracks) {
+        return track_cache->resolve(uris, tracks);
+    }
+
+    TrackCache& Client::getTrackCache() {
+        return *track_cache;
+    }
+
+    bool Client::sendPlayerCommand(Command cmd, const Deadline& deadline) {
+        const Endpoint& target = endpoint(cmd);
+        UrlBuilder<128> url;
+
+        url.append(API_URL).append(target.path);
+
+        if(!url.ok()) {
+            DLOGE(TAG,"URL for %s does not fit", target.path);
+            return false;
+        }
+
+        //Commands come from the UI and the control channel, the header and connection are shared.
+        if(xSemaphoreTake(mtx_command, pdMS_TO_TICKS(deadline.timeoutMs(false))) != pdTRUE) {
+            DLOGW(TAG,"Command %s dropped, another one is in progress", target.path);
+            return false;
+        }
+
+        if(!set_authorization(command_http_client)) {
+            xSemaphoreGive(mtx_command);
+            return false;
+        }
+
+        cancel_polls();
+
+        bool success = command_http_client.request(target.method, url.c_str(), "", target.expected_status, deadline);
+        xSemaphoreGive(mtx_command);
+
+        if(!success) {
+            return false;
+        }
 
         switch (cmd) {
             case Command::Play:
-                success = http_client.post("https://api.spotify.com/v1/me/player/play","",buff);
-                play_state = success ? PlayState::Playing : play_state;
-                return success;
+                play_state = PlayState::Playing;
+                break;
             case Command::Pause:
-                success = http_client.post("https://api.spotify.com/v1/me/player/pause","",buff);
-                play_state = success ? PlayState::Paused : play_state;
-                return success;
-            case Command::SkipNext:
-                success = http_client.post("https://api.spotify.com/v1/me/player/next","",buff);
-                return success;
-            case Command::SkipPrev:
-                success = http_client.post("https://api.spotify.com/v1/me/player/previous","",buff);
-                return success;
+                play_state = PlayState::Paused;
+                break;
             case Command::ShuffleOn:
-                success = http_client.put("https://api.spotify.com/v1/me/player/shuffle?state=true",buff);
-                shuffle_state = success ? ShuffleState::On : shuffle_state;
-                return success;
+                shuffle_state = ShuffleState::On;
+                break;
             case Command::ShuffleOff:
-                success = http_client.put("https://api.spotify.com/v1/me/player/shuffle?state=false",buff);
-                shuffle_state = success ? ShuffleState::Off : shuffle_state;
-                return success;
+                shuffle_state = ShuffleState::Off;
+                break;
             case Command::RepeatContext:
-                success = http_client.put("https://api.spotify.com/v1/me/player/repeat?state=context",buff);
-                repeat_state = success ? RepeatState::Context : repeat_state;
-                return success;
+                repeat_state = RepeatState::Context;
+                break;
             case Command::RepeatTrack:
-                success = http_client.put("https://api.spotify.com/v1/me/player/repeat?state=track",buff);
-                repeat_state = success ? RepeatState::Track : repeat_state;
-                return success;
+                repeat_state = RepeatState::Track;
+                break;
             case Command::RepeatOff:
-                success = http_client.put("https://api.spotify.com/v1/me/player/repeat?state=off",buff);
-                repeat_state = success ? RepeatState::Off : repeat_state;
-                return success;
+                repeat_state = RepeatState::Off;
+                break;
             default:
-                return success;
+                break;
         }
+
+        return true;
+    }
+
+    bool Client::sendPlayerControl(Control ctrl, int value, const Deadline& deadline) {
+        HttpClient& http_client = ctrl == Control::Volume ? volume_http_client : seek_http_client;
+        const Endpoint& target = endpoint(ctrl);
+        UrlBuilder<128> url;
+
+        url.append(API_URL).append(target.path);
+        url.query(target.param, value);
+
+        if(!url.ok()) {
+            DLOGE(TAG,"URL for %s does not fit", target.path);
+            return false;
+        }
+
+        if(!set_authorization(http_client)) {
+            return false;
+        }
+
+        cancel_polls();
+
+        return http_client.request(target.method, url.c_str(), "", target.expected_status, deadline);
+    }
+
+    bool Client::set_authorization(HttpClient& http_client) {
+        FixedString<512> bearer;
+
+        xSemaphoreTake(mtx_token,portMAX_DELAY);
+        bearer.append("Bearer ").append(access_token);
+        xSemaphoreGive(mtx_token);
+
+        //A truncated token is rejected anyway, the request isn't worth sending.
+        if(!bearer.ok()) {
+            DLOGE(TAG,"Access token too long for the Authorization header");
+            return false;
+        }
+
+        return http_client.setHeader("Authorization", bearer.c_str()) == ESP_OK;
+    }
+
+    void Client::setVolume(int volume_percent, bool released) {
+        this->volume_percent = volume_percent;
+        volume_channel.submit(volume_percent, released);
+    }
+
+    void Client::seek(int position_ms, bool released) {
+        progress_ms = position_ms;
+        seek_channel.submit(position_ms, released);
     }
 
     bool Client::play() {
@@ -277,36 +708,54 @@ namespace spotify {
         return shuffle_state;
     }
 
+    int Client::getVolume() {
+        return volume_percent;
+    }
+
+    int Client::getProgress() {
+        return progress_ms;
+    }
+
+    int Client::getDuration() {
+        return duration_ms;
+    }
+
+    ControlChannel::Stats Client::getControlStats(Control ctrl) {
+        return ctrl == Control::Volume ? volume_channel.getStats() : seek_channel.getStats();
+    }
+
     void Client::get_access_token_task_dummy(void* arg) {
         auto obj = static_cast<Client*>(arg);
         obj->get_access_token_task();
     }
 
     void Client::get_access_token_task() {
-        std::vector<char> buff;
+        mem::Buffer buff;
         constexpr int refresh_time_ms = 3500000;
 
         while(1) {
             vTaskDelay(pdMS_TO_TICKS(refresh_time_ms));
 
             bool success = token_http_client.post("https://accounts.spotify.com/api/token",API_BODY, buff);
+            metrics::countTokenRefresh(success && !buff.empty());
 
             if(!success || buff.empty()) {
-                ESP_LOGE(TAG,"HTTP POST for access token failed");
+                DLOGE(TAG,"HTTP POST for access token failed");
             }
 
             else {
-                cJSON *root = cJSON_Parse(buff.data());
-    
-                cJSON *item = cJSON_GetObjectItemCaseSensitive(root, "access_token");
+                api::Token token{};
+
+                if(!JSON_Decode(buff, token)) {
+                    DLOGE(TAG,"No access token in the response");
+                    continue;
+                }
 
                 xSemaphoreTake(mtx_token,portMAX_DELAY);
-                access_token = item->valuestring;
+                access_token = std::move(token.access_token);
                 xSemaphoreGive(mtx_token);
 
-                ESP_LOGI(TAG, "Grabbed Access Token");
-
-                cJSON_Delete(root);
+                DLOGI(TAG, "Grabbed Access Token");
             }
 
         }
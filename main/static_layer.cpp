@@ -0,0 +1,127 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "static_layer.h"
+#include "deferred_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+static const char* TAG = "StaticLayer";
+
+StaticLayer::StaticLayer(lv_obj_t* parent)
+    : content(parent),
+      canvas(nullptr),
+      timer(nullptr),
+      pixels(nullptr),
+      layer{},
+      dirty_area{},
+      dirty(false),
+      stats{} {
+
+    lv_display_t* disp = lv_obj_get_display(parent);
+    int32_t width = lv_display_get_horizontal_resolution(disp);
+    int32_t height = lv_display_get_vertical_resolution(disp);
+    uint32_t stride = lv_draw_buf_width_to_stride(width, LV_COLOR_FORMAT_RGB565);
+    uint32_t size = stride * height;
+
+    //Only worth it with PSRAM, a full screen would take most of the internal RAM.
+    pixels = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+
+    if(pixels == nullptr) {
+        DLOGW(TAG, "No PSRAM for a %ldx%ld layer, drawing static content directly", width, height);
+        return;
+    }
+
+    lv_draw_buf_init(&layer, width, height, LV_COLOR_FORMAT_RGB565, stride, pixels, size);
+    stats.layer_bytes = size;
+
+    content = lv_obj_create(nullptr);
+    lv_obj_add_event_cb(content, refresh_event_cb, LV_EVENT_REFRESH, this);
+
+    //RGB565 has no alpha, so LVGL starts every redraw at the layer and skips what is beneath.
+    canvas = lv_canvas_create(parent);
+    lv_canvas_set_draw_buf(canvas, &layer);
+    lv_obj_set_pos(canvas, 0, 0);
+    lv_obj_remove_flag(canvas, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_move_background(canvas);
+
+    timer = lv_timer_create(timer_cb_dummy, compose_delay_ms, this);
+    invalidate();
+}
+
+StaticLayer::~StaticLayer() {
+    if(canvas == nullptr) {
+        return;
+    }
+
+    lv_timer_delete(timer);
+    lv_obj_delete(canvas);
+    lv_obj_delete(content);
+    lv_image_cache_drop(&layer);
+    heap_caps_free(pixels);
+}
+
+lv_obj_t* StaticLayer::getContent() {
+    return content;
+}
+
+void StaticLayer::invalidate() {
+    if(canvas == nullptr) {
+        return;
+    }
+
+    lv_area_t area;
+    lv_obj_get_coords(content, &area);
+    add_dirty(area);
+}
+
+StaticLayer::Stats StaticLayer::getStats() {
+    return stats;
+}
+
+void StaticLayer::add_dirty(const lv_area_t& area) {
+    if(dirty) {
+        lv_area_join(&dirty_area, &dirty_area, &area);
+        return;
+    }
+
+    dirty_area = area;
+    dirty = true;
+
+    lv_timer_reset(timer);
+    lv_timer_resume(timer);
+}
+
+void StaticLayer::refresh_event_cb(lv_event_t* e) {
+    auto obj = static_cast<StaticLayer*>(lv_event_get_user_data(e));
+    lv_area_t area;
+
+    lv_obj_get_coords(lv_event_get_target_obj(e), &area);
+    obj->add_dirty(area);
+}
+
+void StaticLayer::timer_cb_dummy(lv_timer_t* timer) {
+    auto obj = static_cast<StaticLayer*>(lv_timer_get_user_data(timer));
+    obj->timer_cb();
+}
+
+void StaticLayer::timer_cb() {
+    lv_timer_pause(timer);
+
+    if(!dirty) {
+        return;
+    }
+
+    dirty = false;
+    int64_t start_us = esp_timer_get_time();
+
+    //The whole content is rendered, but only the changed area is redrawn and flushed.
+    if(lv_snapshot_take_to_draw_buf(content, LV_COLOR_FORMAT_RGB565, &layer) != LV_RESULT_OK) {
+        DLOGE(TAG, "Couldn't render the static content");
+        return;
+    }
+
+    lv_image_cache_drop(&layer);
+    lv_obj_invalidate_area(canvas, &dirty_area);
+
+    stats.composes++;
+    stats.last_compose_us = esp_timer_get_time() - start_us;
+}
@@ -0,0 +1,127 @@
+#include "string_pool.h"
+#include <algorithm>
+#include <cstring>
+
+StringPool::StringPool()
+    : free_head(0),
+      data_end(0),
+      live_bytes(0) {
+
+    buckets.fill(invalid_id);
+
+    for(size_t i = 0; i < max_strings; i++) {
+        entries[i] = Entry{};
+        chain[i] = i + 1 < max_strings ? static_cast<Id>(i + 1) : invalid_id;
+    }
+}
+
+uint32_t StringPool::hash(std::string_view str) {
+    //FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for(char c : str) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+
+    return hash;
+}
+
+StringPool::Id StringPool::intern(std::string_view str) {
+    if(str.empty()) {
+        return invalid_id;
+    }
+
+    uint32_t hash = StringPool::hash(str);
+    Id &head = buckets[hash % bucket_count];
+
+    for(Id id = head; id != invalid_id; id = chain[id]) {
+        const Entry &entry = entries[id];
+
+        if(entry.hash == hash && entry.length == str.size() &&
+           std::memcmp(&data[entry.offset], str.data(), str.size()) == 0) {
+            entries[id].refs++;
+            return id;
+        }
+    }
+
+    if(free_head == invalid_id || str.size() > pool_bytes - live_bytes) {
+        return invalid_id;
+    }
+
+    if(str.size() > pool_bytes - data_end) {
+        compact();
+    }
+
+    Id id = free_head;
+    free_head = chain[id];
+
+    std::memcpy(&data[data_end], str.data(), str.size());
+
+    entries[id] = Entry{
+        .hash = hash,
+        .length = static_cast<uint16_t>(str.size()),
+        .offset = static_cast<uint16_t>(data_end),
+        .refs = 1
+    };
+
+    chain[id] = head;
+    head = id;
+    data_end += str.size();
+    live_bytes += str.size();
+
+    return id;
+}
+
+void StringPool::release(Id id) {
+    if(id == invalid_id || entries[id].refs == 0 || --entries[id].refs > 0) {
+        return;
+    }
+
+    Id *link = &buckets[entries[id].hash % bucket_count];
+
+    while(*link != id) {
+        link = &chain[*link];
+    }
+
+    *link = chain[id];
+    chain[id] = free_head;
+    free_head = id;
+    live_bytes -= entries[id].length;
+}
+
+std::string_view StringPool::get(Id id) const {
+    if(id == invalid_id) {
+        return {};
+    }
+
+    return std::string_view(&data[entries[id].offset], entries[id].length);
+}
+
+size_t StringPool::getUsedBytes() const {
+    return live_bytes;
+}
+
+void StringPool::compact() {
+    std::array<Id, max_strings> order;
+    size_t count = 0;
+
+    for(size_t i = 0; i < max_strings; i++) {
+        if(entries[i].refs > 0) {
+            order[count++] = static_cast<Id>(i);
+        }
+    }
+
+    //Moving strings in offset order never overwrites a string not yet moved.
+    std::sort(order.begin(), order.begin() + count, [this](Id a, Id b) {
+        return entries[a].offset < entries[b].offset;
+    });
+
+    data_end = 0;
+
+    for(size_t i = 0; i < count; i++) {
+        Entry &entry = entries[order[i]];
+        std::memmove(&data[data_end], &data[entry.offset], entry.length);
+        entry.offset = static_cast<uint16_t>(data_end);
+        data_end += entry.length;
+    }
+}
@@ -0,0 +1,156 @@
+#include "task_stats.h"
+#include "esp_log.h"
+#include <algorithm>
+
+#if CONFIG_TASK_STATS
+
+static const char* TAG = "TaskStats";
+
+TaskStats::TaskStats(uint32_t interval_ms)
+    : interval_ms(interval_ms),
+      previous_total(0),
+      core_load{},
+      task_handle(nullptr) {
+
+    mtx = xSemaphoreCreateMutex();
+
+    //Sampling costs next to nothing, so the task may run on whichever core is free.
+    xTaskCreatePinnedToCore(sampler_task_dummy,
+                            "Task Stats",
+                            4096,
+                            this,
+                            1,
+                            &task_handle,
+                            tskNO_AFFINITY);
+}
+
+TaskStats::~TaskStats() {
+    vTaskDelete(task_handle);
+    vSemaphoreDelete(mtx);
+}
+
+std::vector<TaskStats::TaskLoad> TaskStats::getTasks() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    std::vector<TaskLoad> out = tasks;
+    xSemaphoreGive(mtx);
+
+    return out;
+}
+
+uint32_t TaskStats::getCoreLoad(int core) {
+    if(core < 0 || core >= portNUM_PROCESSORS) {
+        return 0;
+    }
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    uint32_t out = core_load[core];
+    xSemaphoreGive(mtx);
+
+    return out;
+}
+
+void TaskStats::sample() {
+    //Leave room for tasks created between the two calls.
+    std::vector<TaskStatus_t> status(uxTaskGetNumberOfTasks() + 4);
+    uint32_t total = 0;
+
+    status.resize(uxTaskGetSystemState(status.data(), status.size(), &total));
+
+    //The counters are 32 bit and wrap around, unsigned differences stay correct within a window.
+    uint32_t elapsed = total - previous_total;
+    bool first = previous.empty();
+
+    std::vector<Sample> current;
+    std::vector<TaskLoad> loads;
+    uint32_t idle[portNUM_PROCESSORS] = {};
+
+    current.reserve(status.size());
+    loads.reserve(status.size());
+
+    for(const auto& task : status) {
+        current.push_back({task.xHandle, task.ulRunTimeCounter});
+
+        //Tasks created during the window are measured from their creation.
+        uint32_t run_time = task.ulRunTimeCounter;
+        auto prev = std::find_if(previous.begin(), previous.end(), [&](const Sample& sample) {
+            return sample.handle == task.xHandle;
+        });
+
+        if(prev != previous.end()) {
+            run_time -= prev->run_time;
+        }
+
+        uint32_t permille = elapsed > 0 ? static_cast<uint64_t>(run_time) * 1000 / elapsed : 0;
+        int core = task.xCoreID < portNUM_PROCESSORS ? static_cast<int>(task.xCoreID) : no_core;
+
+        for(int i = 0; i < portNUM_PROCESSORS; i++) {
+            if(task.xHandle == xTaskGetIdleTaskHandleForCore(i)) {
+                idle[i] = std::min<uint32_t>(permille, 1000);
+            }
+        }
+
+        loads.push_back({task.pcTaskName,
+                         core,
+                         permille,
+                         static_cast<uint32_t>(task.usStackHighWaterMark)});
+    }
+
+    std::sort(loads.begin(), loads.end(), [](const TaskLoad& a, const TaskLoad& b) {
+        return a.cpu_permille > b.cpu_permille;
+    });
+
+    previous = std::move(current);
+    previous_total = total;
+
+    //The first sample has nothing to compare with.
+    if(first) {
+        return;
+    }
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    tasks = std::move(loads);
+
+    for(int i = 0; i < portNUM_PROCESSORS; i++) {
+        core_load[i] = 1000 - idle[i];
+    }
+    xSemaphoreGive(mtx);
+
+    log();
+}
+
+void TaskStats::log() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+
+    for(int i = 0; i < portNUM_PROCESSORS; i++) {
+        ESP_LOGI(TAG, "Core %d: %lu.%lu%% busy", i, core_load[i] / 10, core_load[i] % 10);
+    }
+
+    for(const auto& task : tasks) {
+        char core[4] = "-";
+
+        if(task.core != no_core) {
+            snprintf(core, sizeof(core), "%d", task.core);
+        }
+
+        ESP_LOGI(TAG, "%-16s core %s %3lu.%lu%% stack free %lu",
+                 task.name.c_str(), core, task.cpu_permille / 10, task.cpu_permille % 10, task.stack_free);
+    }
+
+    xSemaphoreGive(mtx);
+}
+
+void TaskStats::sampler_task_dummy(void *arg) {
+    auto obj = static_cast<TaskStats*>(arg);
+    obj->sampler_task();
+}
+
+void TaskStats::sampler_task() {
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while(1) {
+        sample();
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(interval_ms));
+    }
+}
+
+#endif
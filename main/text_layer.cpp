@@ -0,0 +1,179 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "text_layer.h"
+#include "deferred_log.h"
+#include <algorithm>
+
+static const char* TAG = "TextLayer";
+
+//Time the start of the text stays in view before each pass.
+static constexpr uint32_t hold_time_ms = 1500;
+
+TextLayer::TextLayer(lv_obj_t* parent, int32_t width, const lv_font_t* font, lv_color_t color, int32_t speed, uint32_t period_ms)
+    : strip(nullptr),
+      font(font),
+      width(width),
+      strip_width(0),
+      scrolling(false),
+      speed(speed),
+      period_ms(period_ms),
+      offset_milli(0),
+      hold_ms(hold_time_ms),
+      dirty(false),
+      stats{} {
+
+    mtx = xSemaphoreCreateMutex();
+
+    //A8 images are drawn in the recolor color, so the strip only holds coverage.
+    canvas = lv_canvas_create(parent);
+    lv_obj_set_size(canvas, width, font->line_height);
+    lv_image_set_inner_align(canvas, LV_IMAGE_ALIGN_TOP_LEFT);
+    lv_obj_set_style_image_recolor(canvas, color, 0);
+    lv_obj_set_style_image_recolor_opa(canvas, LV_OPA_COVER, 0);
+    lv_obj_remove_flag(canvas, LV_OBJ_FLAG_CLICKABLE);
+
+    timer = lv_timer_create(timer_cb_dummy, period_ms, this);
+}
+
+TextLayer::~TextLayer() {
+    lv_timer_delete(timer);
+    lv_obj_delete(canvas);
+
+    if(strip != nullptr) {
+        lv_image_cache_drop(strip);
+        lv_draw_buf_destroy(strip);
+    }
+
+    vSemaphoreDelete(mtx);
+}
+
+lv_obj_t* TextLayer::getObj() {
+    return canvas;
+}
+
+void TextLayer::setText(std::string_view new_text) {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+
+    if(pending != new_text) {
+        pending = new_text;
+        dirty = true;
+    }
+
+    xSemaphoreGive(mtx);
+}
+
+void TextLayer::setColor(lv_color_t color) {
+    lv_obj_set_style_image_recolor(canvas, color, 0);
+}
+
+TextLayer::Stats TextLayer::getStats() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    Stats out = stats;
+    xSemaphoreGive(mtx);
+    return out;
+}
+
+void TextLayer::render() {
+    lv_point_t size;
+    lv_text_get_size(&size, text.c_str(), font, 0, 0, LV_COORD_MAX, LV_TEXT_FLAG_NONE);
+
+    int32_t text_width = std::min<int32_t>(size.x, max_strip_width - gap);
+    int32_t height = font->line_height;
+
+    scrolling = text_width > width;
+    strip_width = std::max<int32_t>(scrolling ? text_width + gap : text_width, 1);
+
+    lv_draw_buf_t* old_strip = strip;
+    strip = lv_draw_buf_create(strip_width, height, LV_COLOR_FORMAT_A8, LV_STRIDE_AUTO);
+
+    if(strip == nullptr) {
+        DLOGE(TAG, "No memory for a %ldx%ld strip", strip_width, height);
+        strip = old_strip;
+        return;
+    }
+
+    lv_canvas_set_draw_buf(canvas, strip);
+    lv_canvas_fill_bg(canvas, lv_color_black(), LV_OPA_TRANSP);
+
+    lv_layer_t layer;
+    lv_canvas_init_layer(canvas, &layer);
+
+    lv_draw_label_dsc_t dsc;
+    lv_draw_label_dsc_init(&dsc);
+    dsc.font = font;
+    dsc.color = lv_color_white();
+    dsc.text = text.c_str();
+
+    lv_area_t area = {0, 0, text_width - 1, height - 1};
+    lv_draw_label(&layer, &dsc, &area);
+    lv_canvas_finish_layer(canvas, &layer);
+
+    //The canvas sizes itself to the strip, the window stays at the layer's width. A strip
+    //narrower than the window would be repeated across it, so only a marquee is tiled.
+    lv_image_set_inner_align(canvas, scrolling ? LV_IMAGE_ALIGN_TILE : LV_IMAGE_ALIGN_TOP_LEFT);
+    lv_obj_set_size(canvas, width, height);
+
+    if(old_strip != nullptr) {
+        lv_image_cache_drop(old_strip);
+        lv_draw_buf_destroy(old_strip);
+    }
+
+    offset_milli = 0;
+    hold_ms = hold_time_ms;
+    lv_image_set_offset_x(canvas, 0);
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    stats.renders++;
+    stats.strip_bytes = strip->data_size;
+    xSemaphoreGive(mtx);
+}
+
+void TextLayer::timer_cb_dummy(lv_timer_t* timer) {
+    auto obj = static_cast<TextLayer*>(lv_timer_get_user_data(timer));
+    obj->timer_cb();
+}
+
+void TextLayer::timer_cb() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    bool changed = dirty;
+
+    if(changed) {
+        text = pending;
+        dirty = false;
+    }
+
+    xSemaphoreGive(mtx);
+
+    if(changed) {
+        render();
+        return;
+    }
+
+    if(!scrolling) {
+        return;
+    }
+
+    if(hold_ms > 0) {
+        hold_ms -= std::min(hold_ms, period_ms);
+        return;
+    }
+
+    int32_t previous_px = offset_milli / 1000;
+    offset_milli += speed * static_cast<int32_t>(period_ms);
+
+    //A full pass brings the repetition to where the text started, which looks the same.
+    if(offset_milli >= strip_width * 1000) {
+        offset_milli = 0;
+        hold_ms = hold_time_ms;
+    }
+
+    //Only whole pixel moves invalidate the layer.
+    if(offset_milli / 1000 == previous_px) {
+        return;
+    }
+
+    lv_image_set_offset_x(canvas, -offset_milli / 1000);
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    stats.steps++;
+    xSemaphoreGive(mtx);
+}
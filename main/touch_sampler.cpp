@@ -0,0 +1,286 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#define LGFX_USE_V1
+#include "touch_sampler.h"
+#include "panel.h"
+#include "panel_flush.h"
+#include "deferred_log.h"
+#include "metrics.h"
+#include "trace.h"
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "soc/gpio_struct.h"
+#include "esp_attr.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include <algorithm>
+
+static const char* TAG = "TouchSampler";
+
+TouchSampler::TouchSampler(LGFX& tft, PanelFlush& flush, lv_indev_t* indev, int irq_pin)
+    : tft(tft),
+      flush(flush),
+      indev(indev),
+      timer(nullptr),
+      irq_pin(irq_pin),
+      pen_irq(false),
+      sleep_wakeup(false),
+      pen_listener(nullptr),
+      pen_listener_arg(nullptr),
+      pen_irq_us(0),
+      touch_start_us(0),
+      queued{},
+      last{},
+      ring(),
+      latency_total_us(0),
+      stats{} {
+
+    if(irq_pin >= 0) {
+        //The XPT2046 pulls PENIRQ low while the pen is down, and briefly during conversions.
+        gpio_config_t io_conf = {};
+        io_conf.pin_bit_mask = 1ULL << irq_pin;
+        io_conf.mode = GPIO_MODE_INPUT;
+        io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
+        io_conf.intr_type = GPIO_INTR_NEGEDGE;
+        gpio_config(&io_conf);
+
+        //Already installed is fine, the service is shared.
+        esp_err_t err = gpio_install_isr_service(0);
+
+        if(err == ESP_OK || err == ESP_ERR_INVALID_STATE) {
+            err = gpio_isr_handler_add(static_cast<gpio_num_t>(irq_pin), pen_isr_dummy, this);
+        }
+
+        if(err != ESP_OK) {
+            DLOGW(TAG, "Couldn't attach the pen IRQ on GPIO %d, polling instead", irq_pin);
+            this->irq_pin = -1;
+        }
+    }
+
+    lv_indev_set_user_data(indev, this);
+    lv_indev_set_read_cb(indev, read_cb_dummy);
+    lv_indev_set_mode(indev, LV_INDEV_MODE_EVENT);
+
+    timer = lv_timer_create(timer_cb_dummy, this->irq_pin >= 0 ? irq_period_ms : poll_period_ms, this);
+}
+
+TouchSampler::~TouchSampler() {
+    setSleepWakeup(false);
+
+    if(irq_pin >= 0) {
+        gpio_isr_handler_remove(static_cast<gpio_num_t>(irq_pin));
+    }
+
+    lv_timer_delete(timer);
+}
+
+TouchSampler::Stats TouchSampler::getStats() const {
+    Stats result = stats;
+    result.dropped = ring.getDropped();
+    result.avg_latency_us = stats.presses > 0 ? latency_total_us / stats.presses : 0;
+    return result;
+}
+
+void TouchSampler::setPenListener(PenListener listener, void* arg) {
+    pen_listener = nullptr;
+    pen_listener_arg = arg;
+    pen_listener.store(listener, std::memory_order_release);
+}
+
+bool TouchSampler::isPenDown() {
+    //The pin is read without the bus, which the last frame released when it was done.
+    if(irq_pin >= 0) {
+        return pen_maybe_down();
+    }
+
+    uint16_t x, y;
+
+    //Only guards against a reading between the areas of a frame, which the LVGL task never does.
+    flush.wait();
+    stats.readings++;
+
+    return tft.getTouch(&x, &y);
+}
+
+bool TouchSampler::hasPenIrq() const {
+    return irq_pin >= 0;
+}
+
+void TouchSampler::setSleepWakeup(bool enable) {
+    if(irq_pin < 0 || sleep_wakeup.load(std::memory_order_relaxed) == enable) {
+        return;
+    }
+
+    auto pin = static_cast<gpio_num_t>(irq_pin);
+
+    if(enable) {
+        sleep_wakeup.store(true, std::memory_order_relaxed);
+        gpio_wakeup_enable(pin, GPIO_INTR_LOW_LEVEL);
+        esp_sleep_enable_gpio_wakeup();
+    }
+
+    else {
+        gpio_wakeup_disable(pin);
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+        gpio_set_intr_type(pin, GPIO_INTR_NEGEDGE);
+        sleep_wakeup.store(false, std::memory_order_relaxed);
+    }
+}
+
+void IRAM_ATTR TouchSampler::pen_isr_dummy(void* arg) {
+    auto obj = static_cast<TouchSampler*>(arg);
+
+    //The low level that woke the chip holds while the pen is down, only its first interrupt counts.
+    if(obj->sleep_wakeup.load(std::memory_order_relaxed)) {
+        gpio_ll_set_intr_type(&GPIO, obj->irq_pin, GPIO_INTR_NEGEDGE);
+    }
+
+    //Keeps the first edge of a touch, the following ones come from the conversions.
+    if(!obj->pen_irq.load(std::memory_order_relaxed)) {
+        obj->pen_irq_us = esp_timer_get_time();
+        obj->pen_irq.store(true, std::memory_order_release);
+
+        PenListener listener = obj->pen_listener.load(std::memory_order_acquire);
+
+        if(listener != nullptr) {
+            listener(obj->pen_listener_arg);
+        }
+    }
+}
+
+void TouchSampler::read_cb_dummy(lv_indev_t* indev, lv_indev_data_t* data) {
+    auto obj = static_cast<TouchSampler*>(lv_indev_get_user_data(indev));
+    obj->read_cb(data);
+}
+
+void TouchSampler::read_cb(lv_indev_data_t* data) {
+    touch::Sample sample;
+
+    if(ring.pop(sample)) {
+        if(sample.pressed && !last.pressed && touch_start_us != 0) {
+            int64_t latency_us = esp_timer_get_time() - touch_start_us;
+
+            latency_total_us += latency_us;
+            stats.max_latency_us = std::max(stats.max_latency_us, latency_us);
+            stats.presses++;
+            metrics::observeTouchLatency(latency_us);
+            touch_start_us = 0;
+        }
+
+        last = sample;
+    }
+
+    data->state = last.pressed ? LV_INDEV_STATE_PR : LV_INDEV_STATE_REL;
+    data->point.x = last.x;
+    data->point.y = last.y;
+    data->continue_reading = !ring.empty();
+}
+
+void TouchSampler::timer_cb_dummy(lv_timer_t* timer) {
+    auto obj = static_cast<TouchSampler*>(lv_timer_get_user_data(timer));
+    obj->timer_cb();
+}
+
+void TouchSampler::timer_cb() {
+    if(!pen_maybe_down()) {
+        //LVGL only advances a thrown scroll on reads, which event mode no longer does by itself.
+        if(lv_indev_get_scroll_obj(indev) != nullptr) {
+            lv_indev_read(indev);
+        }
+
+        return;
+    }
+
+    if(!queued.pressed) {
+        stats.wakeups++;
+    }
+
+    //The interrupt doesn't write the time again until the flag is cleared after the batch.
+    int64_t irq_us = pen_irq.load(std::memory_order_acquire) ? pen_irq_us : 0;
+    touch::Sample sample;
+    bool pressed = read_batch(sample);
+    pen_irq.store(false, std::memory_order_relaxed);
+
+    if(!pressed && !queued.pressed) {
+        //An edge from a conversion, or nothing when polling.
+        return;
+    }
+
+    if(pressed && !queued.pressed) {
+        //Without the IRQ the touch is only known from the first batch that saw it.
+        touch_start_us = irq_us != 0 ? irq_us : sample.time_us;
+    }
+
+    queue(sample);
+
+    if(!pressed) {
+        lv_timer_set_period(timer, irq_pin >= 0 ? irq_period_ms : poll_period_ms);
+    }
+
+    else {
+        lv_timer_set_period(timer, pressed_period_ms);
+    }
+}
+
+bool TouchSampler::pen_maybe_down() {
+    if(irq_pin < 0 || queued.pressed) {
+        return true;
+    }
+
+    return pen_irq.load(std::memory_order_acquire) || gpio_get_level(static_cast<gpio_num_t>(irq_pin)) == 0;
+}
+
+bool TouchSampler::read_batch(touch::Sample& sample) {
+    trace::Scope scope(trace::Id::TouchRead);
+    std::array<int16_t, batch_size> xs;
+    std::array<int16_t, batch_size> ys;
+    size_t count = 0;
+
+    //Frames end with the bus released, this only guards against a batch between the areas of one.
+    flush.wait();
+    int64_t start_us = esp_timer_get_time();
+
+    for(size_t i = 0; i < batch_size; i++) {
+        uint16_t x, y;
+
+        if(tft.getTouch(&x, &y)) {
+            xs[count] = x;
+            ys[count] = y;
+            count++;
+        }
+
+        stats.readings++;
+
+        //Stops once the batch can't be pressed anymore. Without a touch in progress one miss
+        //is enough, which keeps polling without the IRQ at one reading.
+        size_t misses = i + 1 - count;
+
+        if(misses > batch_size / 2 || (misses > 0 && !queued.pressed)) {
+            break;
+        }
+    }
+
+    sample.time_us = esp_timer_get_time();
+    stats.bus_us += sample.time_us - start_us;
+    stats.batches++;
+
+    //A lifting pen gives partial batches, which only count as pressed with a majority.
+    sample.pressed = count > batch_size / 2;
+
+    if(sample.pressed) {
+        sample.x = touch::median(std::span(xs.data(), count));
+        sample.y = touch::median(std::span(ys.data(), count));
+    }
+
+    else {
+        sample.x = queued.x;
+        sample.y = queued.y;
+    }
+
+    return sample.pressed;
+}
+
+void TouchSampler::queue(const touch::Sample& sample) {
+    queued = sample;
+    ring.push(sample);
+    lv_indev_read(indev);
+}
@@ -0,0 +1,176 @@
+#include "trace.h"
+#include "base64.h"
+
+#if CONFIG_TRACE
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_cpu.h"
+#include "esp_ipc.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+namespace trace {
+
+    static constexpr uint32_t capacity = CONFIG_TRACE_BUFFER_EVENTS;
+    static_assert((capacity & (capacity - 1)) == 0, "CONFIG_TRACE_BUFFER_EVENTS must be a power of two");
+
+    //Records drained per console line, keeps the lines short enough for the monitor.
+    static constexpr uint32_t records_per_line = 48;
+
+    static constexpr uint32_t drain_interval_ms = 100;
+
+    //The name tables are repeated so a capture started late can still be decoded.
+    static constexpr uint32_t names_interval = 50;
+
+    static constexpr std::array<const char*, static_cast<size_t>(Id::Count)> id_names = {
+        "HTTP request",
+        "HTTP connected",
+        "HTTP header sent",
+        "HTTP finish",
+        "HTTP bytes",
+        "LVGL render",
+        "LVGL flush",
+        "Touch read",
+        "JSON parse"
+    };
+
+    struct Record {
+        uint32_t cycles;                ///< CPU cycle count of the recording core.
+        uint32_t task;                  ///< Handle of the running task.
+        uint8_t type;                   ///< The Type.
+        uint8_t id;                     ///< The Id.
+        uint16_t reserved;
+        int32_t value;                  ///< Counter value, or the low 32 bits of esp_timer time for Sync.
+    };
+
+    static_assert(sizeof(Record) == 16, "Record is part of the wire format");
+
+    //Only the owning core writes head, only the drain task writes tail.
+    struct Ring {
+        std::atomic<uint32_t> head;     ///< Next record to write.
+        std::atomic<uint32_t> tail;     ///< Next record to drain.
+        uint32_t dropped;               ///< Records lost because the ring was full.
+        Record records[capacity];       ///< The records.
+    };
+
+    static Ring rings[portNUM_PROCESSORS];
+
+    void record(Type type, Id id, int32_t value) {
+        //Masking interrupts keeps other tasks and ISRs of this core out, the other core has its own ring.
+        UBaseType_t irq = portSET_INTERRUPT_MASK_FROM_ISR();
+        Ring& ring = rings[xPortGetCoreID()];
+        uint32_t head = ring.head.load(std::memory_order_relaxed);
+
+        if(head - ring.tail.load(std::memory_order_acquire) < capacity) {
+            ring.records[head & (capacity - 1)] = {
+                .cycles = esp_cpu_get_cycle_count(),
+                .task = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(xTaskGetCurrentTaskHandle())),
+                .type = static_cast<uint8_t>(type),
+                .id = static_cast<uint8_t>(id),
+                .reserved = 0,
+                .value = value
+            };
+
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+        else {
+            ring.dropped++;
+        }
+
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(irq);
+    }
+
+    static void sync(void* arg) {
+        record(Type::Sync, Id::HttpRequest, static_cast<int32_t>(esp_timer_get_time()));
+    }
+
+    static void print_names() {
+        printf("@C %d\n", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+
+        for(size_t i = 0; i < id_names.size(); i++) {
+            printf("@I %u %s\n", static_cast<unsigned>(i), id_names[i]);
+        }
+
+        //Names are only read from the scheduler's task list, a recorded handle may belong to a deleted task.
+        std::vector<TaskStatus_t> status(uxTaskGetNumberOfTasks() + 4);
+        status.resize(uxTaskGetSystemState(status.data(), status.size(), nullptr));
+
+        for(const auto& task : status) {
+            printf("@N %08lx %s\n", static_cast<uint32_t>(reinterpret_cast<uintptr_t>(task.xHandle)), task.pcTaskName);
+        }
+    }
+
+    static void drain(int core, std::vector<uint32_t>& tasks, bool& unknown_task) {
+        Ring& ring = rings[core];
+        Record records[records_per_line];
+        char line[base64::encodedLength(sizeof(records))];
+
+        while(1) {
+            uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+            uint32_t count = std::min(ring.head.load(std::memory_order_acquire) - tail, records_per_line);
+
+            if(count == 0) {
+                return;
+            }
+
+            for(uint32_t i = 0; i < count; i++) {
+                records[i] = ring.records[(tail + i) & (capacity - 1)];
+
+                if(std::find(tasks.begin(), tasks.end(), records[i].task) == tasks.end()) {
+                    tasks.push_back(records[i].task);
+                    unknown_task = true;
+                }
+            }
+
+            ring.tail.store(tail + count, std::memory_order_release);
+
+            size_t len = 0;
+            base64::encode(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(records), count * sizeof(Record)), line, len);
+            printf("@T %d %lu %.*s\n", core, ring.dropped, static_cast<int>(len), line);
+        }
+    }
+
+    static void drain_task(void* arg) {
+        std::vector<uint32_t> tasks;
+        uint32_t iteration = 0;
+
+        while(1) {
+            //A sync record per drain keeps the 32 bit cycle counts from wrapping between two references.
+            for(int core = 0; core < portNUM_PROCESSORS; core++) {
+                esp_ipc_call_blocking(core, sync, nullptr);
+            }
+
+            bool unknown_task = false;
+
+            for(int core = 0; core < portNUM_PROCESSORS; core++) {
+                drain(core, tasks, unknown_task);
+            }
+
+            if(unknown_task || iteration % names_interval == 0) {
+                print_names();
+            }
+
+            iteration++;
+            vTaskDelay(pdMS_TO_TICKS(drain_interval_ms));
+        }
+    }
+
+    void init() {
+        xTaskCreatePinnedToCore(drain_task,
+                                "Trace Drain",
+                                4096,
+                                nullptr,
+                                1,
+                                nullptr,
+                                CONFIG_NETWORK_TASK_CORE);
+    }
+
+}
+
+#endif
@@ -0,0 +1,257 @@
+#include "track_cache.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include <algorithm>
+
+static const char* TAG = "TrackCache";
+
+TrackCache::TrackCache(BatchFetcher fetcher)
+    : lru_head(no_slot),
+      lru_tail(no_slot),
+      free_head(0),
+      count(0),
+      fetcher(std::move(fetcher)),
+      stats{} {
+
+    buckets.fill(no_slot);
+
+    for(size_t i = 0; i < capacity; i++) {
+        lru_next[i] = i + 1 < capacity ? static_cast<Slot>(i + 1) : no_slot;
+    }
+
+    mtx = xSemaphoreCreateMutex();
+}
+
+TrackCache::~TrackCache() {
+    vSemaphoreDelete(mtx);
+}
+
+TrackCache::Slot TrackCache::find(std::string_view uri, uint32_t hash) {
+    for(Slot slot = buckets[hash % bucket_count]; slot != no_slot; slot = bucket_next[slot]) {
+        if(uri_hashes[slot] == hash && strings.get(uris[slot]) == uri) {
+            return slot;
+        }
+    }
+
+    return no_slot;
+}
+
+void TrackCache::unlink(Slot slot) {
+    if(lru_prev[slot] != no_slot) {
+        lru_next[lru_prev[slot]] = lru_next[slot];
+    }
+
+    else {
+        lru_head = lru_next[slot];
+    }
+
+    if(lru_next[slot] != no_slot) {
+        lru_prev[lru_next[slot]] = lru_prev[slot];
+    }
+
+    else {
+        lru_tail = lru_prev[slot];
+    }
+}
+
+void TrackCache::push_front(Slot slot) {
+    lru_prev[slot] = no_slot;
+    lru_next[slot] = lru_head;
+
+    if(lru_head != no_slot) {
+        lru_prev[lru_head] = slot;
+    }
+
+    lru_head = slot;
+
+    if(lru_tail == no_slot) {
+        lru_tail = slot;
+    }
+}
+
+TrackCache::Slot TrackCache::allocate() {
+    if(free_head != no_slot) {
+        Slot slot = free_head;
+        free_head = lru_next[slot];
+        count++;
+        return slot;
+    }
+
+    //Evict the least recently used track.
+    Slot slot = lru_tail;
+    unlink(slot);
+
+    Slot *link = &buckets[uri_hashes[slot] % bucket_count];
+
+    while(*link != slot) {
+        link = &bucket_next[*link];
+    }
+
+    *link = bucket_next[slot];
+
+    strings.release(uris[slot]);
+    strings.release(names[slot]);
+    strings.release(album_names[slot]);
+    strings.release(album_pic_urls[slot]);
+    strings.release(artists[slot]);
+
+    return slot;
+}
+
+void TrackCache::read(Slot slot, spotify::Track& track) {
+    track.uri = strings.get(uris[slot]);
+    track.name = strings.get(names[slot]);
+    track.album_name = strings.get(album_names[slot]);
+    track.album_pic_url = strings.get(album_pic_urls[slot]);
+    track.duration_ms = durations_ms[slot];
+    track.artists.clear();
+
+    std::string_view joined = strings.get(artists[slot]);
+
+    while(!joined.empty()) {
+        size_t end = joined.find('\n');
+        track.artists.emplace_back(joined.substr(0, end));
+        joined = end == std::string_view::npos ? std::string_view{} : joined.substr(end + 1);
+    }
+}
+
+void TrackCache::insert(const spotify::Track& track) {
+    if(track.uri.empty()) {
+        return;
+    }
+
+    std::string joined;
+
+    for(const auto& artist : track.artists) {
+        if(!joined.empty()) {
+            joined += '\n';
+        }
+        joined += artist;
+    }
+
+    uint32_t hash = StringPool::hash(track.uri);
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+
+    Slot slot = find(track.uri, hash);
+
+    if(slot != no_slot) {
+        unlink(slot);
+        strings.release(names[slot]);
+        strings.release(album_names[slot]);
+        strings.release(album_pic_urls[slot]);
+        strings.release(artists[slot]);
+    }
+
+    else {
+        slot = allocate();
+        uri_hashes[slot] = hash;
+        uris[slot] = strings.intern(track.uri);
+        bucket_next[slot] = buckets[hash % bucket_count];
+        buckets[hash % bucket_count] = slot;
+    }
+
+    names[slot] = strings.intern(track.name);
+    album_names[slot] = strings.intern(track.album_name);
+    album_pic_urls[slot] = strings.intern(track.album_pic_url);
+    artists[slot] = strings.intern(joined);
+    durations_ms[slot] = track.duration_ms;
+    push_front(slot);
+
+    stats.entries = count;
+    stats.string_bytes = strings.getUsedBytes();
+
+    xSemaphoreGive(mtx);
+}
+
+bool TrackCache::lookup(std::string_view uri, spotify::Track& track) {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+
+    Slot slot = find(uri, StringPool::hash(uri));
+
+    if(slot != no_slot) {
+        unlink(slot);
+        push_front(slot);
+        read(slot, track);
+    }
+
+    xSemaphoreGive(mtx);
+
+    return slot != no_slot;
+}
+
+bool TrackCache::resolve(const std::vector<std::string>& uris, std::vector<spotify::Track>& tracks) {
+    std::vector<std::string> misses;
+    uint32_t hits = 0;
+    uint32_t batches = 0;
+    bool complete = true;
+
+    tracks.resize(uris.size());
+
+    for(size_t i = 0; i < uris.size(); i++) {
+        if(lookup(uris[i], tracks[i])) {
+            hits++;
+        }
+
+        else {
+            tracks[i] = spotify::Track{};
+            tracks[i].uri = uris[i];
+
+            if(std::find(misses.begin(), misses.end(), uris[i]) == misses.end()) {
+                misses.push_back(uris[i]);
+            }
+        }
+    }
+
+    std::vector<std::string> batch;
+    std::vector<spotify::Track> fetched;
+
+    for(size_t start = 0; start < misses.size(); start += max_batch) {
+        size_t end = std::min(start + max_batch, misses.size());
+
+        batch.assign(misses.begin() + start, misses.begin() + end);
+        fetched.clear();
+        batches++;
+
+        if(!fetcher(batch, fetched)) {
+            ESP_LOGE(TAG, "Batch request for %u tracks failed", static_cast<unsigned int>(batch.size()));
+            complete = false;
+            continue;
+        }
+
+        for(const auto& track : fetched) {
+            insert(track);
+
+            //A URI may appear more than once in the list.
+            for(size_t i = 0; i < uris.size(); i++) {
+                if(uris[i] == track.uri) {
+                    tracks[i] = track;
+                }
+            }
+        }
+
+        if(fetched.size() < batch.size()) {
+            complete = false;
+        }
+    }
+
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    stats.hits += hits;
+    stats.misses += uris.size() - hits;
+    stats.pages++;
+    stats.batch_requests += batches;
+    //Before the cache a page took one request with its metadata, now its URIs take one and the misses the rest.
+    stats.requests += 1 + batches;
+    stats.requests_saved = static_cast<int32_t>(stats.pages) - static_cast<int32_t>(stats.requests);
+    xSemaphoreGive(mtx);
+
+    return complete;
+}
+
+TrackCache::Stats TrackCache::getStats() {
+    xSemaphoreTake(mtx, portMAX_DELAY);
+    Stats out = stats;
+    xSemaphoreGive(mtx);
+
+    return out;
+}
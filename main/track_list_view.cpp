@@ -0,0 +1,337 @@
+#define DLOG_LOCAL_LEVEL CONFIG_UI_LOG_LEVEL
+#include "track_list_view.h"
+#include "deferred_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+static const char* TAG = "TrackListView";
+
+TrackListView::TrackListView(lv_obj_t* parent, int32_t width, int32_t height)
+    : generation(0),
+      total(-1),
+      first_index(0),
+      last_scroll_y(0),
+      direction(1),
+      scrolling(false),
+      frame_start_us(0),
+      frame_total_us(0),
+      stats{},
+      task_handle(nullptr) {
+
+    list = lv_obj_create(parent);
+    lv_obj_set_size(list, width, height);
+    lv_obj_set_style_pad_all(list, 0, LV_PART_MAIN);
+    lv_obj_set_scroll_dir(list, LV_DIR_VER);
+    lv_obj_add_event_cb(list, scroll_event_cb, LV_EVENT_ALL, this);
+
+    //Rows are positioned by hand, the spacer only sets the scrollable height.
+    spacer = lv_obj_create(list);
+    lv_obj_set_size(spacer, 1, 1);
+    lv_obj_set_style_border_width(spacer, 0, LV_PART_MAIN);
+    lv_obj_set_style_bg_opa(spacer, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_remove_flag(spacer, LV_OBJ_FLAG_CLICKABLE);
+
+    for(auto& row : rows) {
+        row.obj = lv_obj_create(list);
+        lv_obj_set_size(row.obj, LV_PCT(100), row_height);
+        lv_obj_set_style_radius(row.obj, 0, LV_PART_MAIN);
+        lv_obj_set_style_pad_all(row.obj, 2, LV_PART_MAIN);
+        lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row.obj, LV_OBJ_FLAG_EVENT_BUBBLE);
+        lv_obj_add_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+
+        row.title = lv_label_create(row.obj);
+        lv_label_set_long_mode(row.title, LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(row.title, LV_PCT(100));
+        lv_obj_align(row.title, LV_ALIGN_TOP_LEFT, 0, 0);
+
+        row.artist = lv_label_create(row.obj);
+        lv_label_set_long_mode(row.artist, LV_LABEL_LONG_CLIP);
+        lv_obj_set_width(row.artist, LV_PCT(100));
+        lv_obj_align(row.artist, LV_ALIGN_BOTTOM_LEFT, 0, 0);
+
+        row.index = -1;
+    }
+
+    for(auto& slot : pages) {
+        slot.page = -1;
+        slot.state = PageState::Empty;
+    }
+
+    lv_display_add_event_cb(lv_display_get_default(), refr_event_cb, LV_EVENT_ALL, this);
+
+    fetch_queue = xQueueCreate(page_slots, sizeof(FetchRequest));
+
+    xTaskCreatePinnedToCore(fetch_task_dummy,
+                            "List Fetch",
+                            6144,
+                            this,
+                            1,
+                            &task_handle,
+                            CONFIG_NETWORK_TASK_CORE);
+}
+
+TrackListView::~TrackListView() {
+    vTaskDelete(task_handle);
+    vQueueDelete(fetch_queue);
+    lv_display_remove_event_cb_with_user_data(lv_display_get_default(), refr_event_cb, this);
+    lv_obj_delete(list);
+}
+
+void TrackListView::setSource(PageFetcher fetcher) {
+    this->fetcher = std::move(fetcher);
+    generation++;
+
+    for(auto& slot : pages) {
+        slot.page = -1;
+        slot.state = PageState::Empty;
+        slot.data = spotify::TrackPage{};
+    }
+
+    for(auto& row : rows) {
+        row.index = -1;
+    }
+
+    stats.pages_fetched = 0;
+    first_index = 0;
+    last_scroll_y = 0;
+    direction = 1;
+    set_total(-1);
+    lv_obj_scroll_to_y(list, 0, LV_ANIM_OFF);
+
+    //The size of the list is unknown until the first page arrives.
+    request_page(0);
+    bind_rows(true);
+}
+
+lv_obj_t* TrackListView::getObj() {
+    return list;
+}
+
+TrackListView::Stats TrackListView::getStats() {
+    Stats out = stats;
+    out.min_free_heap = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+    return out;
+}
+
+void TrackListView::scroll_event_cb(lv_event_t* e) {
+    auto view = static_cast<TrackListView*>(lv_event_get_user_data(e));
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if(code == LV_EVENT_SCROLL_BEGIN) {
+        view->scrolling = true;
+        view->frame_total_us = 0;
+        view->stats.frames = 0;
+        view->stats.max_frame_us = 0;
+    }
+
+    else if(code == LV_EVENT_SCROLL) {
+        int32_t scroll_y = lv_obj_get_scroll_y(view->list);
+
+        if(scroll_y != view->last_scroll_y) {
+            view->direction = scroll_y > view->last_scroll_y ? 1 : -1;
+            view->last_scroll_y = scroll_y;
+        }
+
+        view->bind_rows(false);
+    }
+
+    else if(code == LV_EVENT_SCROLL_END) {
+        view->scrolling = false;
+        view->stats.avg_frame_us = view->stats.frames > 0 ? view->frame_total_us / view->stats.frames : 0;
+
+        Stats out = view->getStats();
+        DLOGI(TAG, "Scroll: %lu frames, avg %lld us, max %lld us, %lu pages fetched, min free heap %u",
+                 static_cast<unsigned long>(out.frames),
+                 out.avg_frame_us,
+                 out.max_frame_us,
+                 static_cast<unsigned long>(out.pages_fetched),
+                 static_cast<unsigned int>(out.min_free_heap));
+    }
+}
+
+void TrackListView::refr_event_cb(lv_event_t* e) {
+    auto view = static_cast<TrackListView*>(lv_event_get_user_data(e));
+    lv_event_code_t code = lv_event_get_code(e);
+
+    if(!view->scrolling) {
+        return;
+    }
+
+    if(code == LV_EVENT_REFR_START) {
+        view->frame_start_us = esp_timer_get_time();
+    }
+
+    else if(code == LV_EVENT_REFR_READY && view->frame_start_us != 0) {
+        int64_t frame_us = esp_timer_get_time() - view->frame_start_us;
+        view->frame_total_us += frame_us;
+        view->stats.frames++;
+        view->stats.max_frame_us = std::max(view->stats.max_frame_us, frame_us);
+        view->frame_start_us = 0;
+    }
+}
+
+void TrackListView::bind_rows(bool force) {
+    //Keep one row of margin above the viewport so the top row never pops in.
+    int first = std::max(0, static_cast<int>(last_scroll_y / row_height) - 1);
+
+    if(first == first_index && !force) {
+        return;
+    }
+
+    first_index = first;
+
+    for(int index = first; index < first + row_count; index++) {
+        Row& row = rows[index % row_count];
+
+        if(row.index != index || force) {
+            bind_row(row, index);
+        }
+    }
+
+    //Fetch ahead of the scroll direction, half a page beyond the materialized rows.
+    int ahead = direction > 0 ? first + row_count + page_size / 2 : first - page_size / 2;
+
+    request_page(first / page_size);
+    request_page((first + row_count - 1) / page_size);
+
+    if(ahead >= 0 && total >= 0 && ahead < total) {
+        request_page(ahead / page_size);
+    }
+}
+
+void TrackListView::bind_row(Row& row, int index) {
+    row.index = index;
+
+    if(total >= 0 && index >= total) {
+        lv_obj_add_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+
+    lv_obj_set_y(row.obj, index * row_height);
+    lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+
+    PageSlot* slot = find_page(index / page_size);
+    int item = index % page_size;
+
+    if(slot == nullptr || slot->state != PageState::Ready || item >= static_cast<int>(slot->data.items.size())) {
+        lv_label_set_text(row.title, "Loading...");
+        lv_label_set_text(row.artist, "");
+        return;
+    }
+
+    const spotify::Track& track = slot->data.items[item];
+    std::string artists;
+
+    for(const auto& artist : track.artists) {
+        if(!artists.empty()) {
+            artists += ", ";
+        }
+        artists += artist;
+    }
+
+    lv_label_set_text(row.title, track.name.c_str());
+    lv_label_set_text(row.artist, artists.c_str());
+}
+
+TrackListView::PageSlot* TrackListView::find_page(int page) {
+    for(auto& slot : pages) {
+        if(slot.state != PageState::Empty && slot.page == page) {
+            return &slot;
+        }
+    }
+
+    return nullptr;
+}
+
+void TrackListView::request_page(int page) {
+    if(page < 0 || find_page(page) != nullptr) {
+        return;
+    }
+
+    //Reuse an empty slot, otherwise evict the ready page furthest from the viewport.
+    int first_page = first_index / page_size;
+    PageSlot* victim = nullptr;
+
+    for(auto& slot : pages) {
+        if(slot.state == PageState::Empty) {
+            victim = &slot;
+            break;
+        }
+
+        if(slot.state == PageState::Ready &&
+           (victim == nullptr || std::abs(slot.page - first_page) > std::abs(victim->page - first_page))) {
+            victim = &slot;
+        }
+    }
+
+    //All slots are loading, the page is requested again on the next scroll.
+    if(victim == nullptr) {
+        return;
+    }
+
+    FetchRequest req = {
+        .page = page,
+        .generation = generation
+    };
+
+    if(xQueueSend(fetch_queue, &req, 0) != pdTRUE) {
+        return;
+    }
+
+    victim->page = page;
+    victim->state = PageState::Loading;
+    victim->data = spotify::TrackPage{};
+}
+
+void TrackListView::set_total(int new_total) {
+    total = new_total;
+    lv_obj_set_y(spacer, std::max(0, total * row_height - 1));
+}
+
+void TrackListView::fetch_task_dummy(void *arg) {
+    auto obj = static_cast<TrackListView*>(arg);
+    obj->fetch_task();
+}
+
+void TrackListView::fetch_task() {
+    FetchRequest req;
+    spotify::TrackPage data;
+
+    while(1) {
+        xQueueReceive(fetch_queue, &req, portMAX_DELAY);
+
+        lv_lock();
+        PageFetcher page_fetcher = req.generation == generation ? fetcher : nullptr;
+        lv_unlock();
+
+        bool success = page_fetcher && page_fetcher(req.page * page_size, page_size, data);
+
+        lv_lock();
+        PageSlot* slot = req.generation == generation ? find_page(req.page) : nullptr;
+
+        if(slot != nullptr && slot->state == PageState::Loading) {
+            if(success) {
+                slot->data = std::move(data);
+                slot->state = PageState::Ready;
+                stats.pages_fetched++;
+
+                if(slot->data.total != total) {
+                    set_total(slot->data.total);
+                }
+
+                bind_rows(true);
+            }
+
+            else {
+                slot->state = PageState::Empty;
+            }
+        }
+        lv_unlock();
+
+        data = spotify::TrackPage{};
+    }
+}
@@ -0,0 +1,212 @@
+#include "ui_bench.h"
+#include "bench.h"
+#include "static_layer.h"
+#include "text_layer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+#include <functional>
+
+#if CONFIG_BOOT_BENCHMARKS
+
+namespace ui_bench {
+
+    static const char* TAG = "UiBench";
+
+    static constexpr int32_t screen_width = 480;
+    static constexpr int32_t screen_height = 320;
+    static constexpr uint32_t tick_ms = 5;
+    static constexpr uint32_t duration_ms = 10000;
+    static constexpr uint32_t progress_period_ms = 250;
+    static constexpr int32_t cover_size = 160;
+
+    static constexpr const char* long_title = "Shine On You Crazy Diamond (Parts I-V) - 2011 Remastered Version";
+
+    struct Counters {
+        uint32_t frames;            ///< Refreshes that flushed something.
+        uint64_t bytes;             ///< Bytes flushed.
+    };
+
+    static void flush_cb(lv_display_t* disp, const lv_area_t* area, uint8_t* data) {
+        auto counters = static_cast<Counters*>(lv_display_get_user_data(disp));
+        counters->bytes += lv_area_get_size(area) * sizeof(uint16_t);
+
+        if(lv_display_flush_is_last(disp)) {
+            counters->frames++;
+        }
+
+        lv_display_flush_ready(disp);
+    }
+
+    //Builds a scene on the active screen, steps it with a simulated clock and reports the CPU time
+    //of the refreshes that flushed a frame. Teardown runs before the screen is cleaned, to delete
+    //objects owning LVGL objects.
+    static void run_scene(lv_display_t* disp, const char* name, const std::function<void(lv_obj_t*)>& build,
+                          const std::function<void()>& teardown = nullptr) {
+        auto counters = static_cast<Counters*>(lv_display_get_user_data(disp));
+        lv_obj_t* screen = lv_display_get_screen_active(disp);
+
+        build(screen);
+
+        //The first frames draw the whole screen, only the steady state is measured.
+        for(uint32_t t = 0; t < 500; t += tick_ms) {
+            lv_tick_inc(tick_ms);
+            lv_timer_handler();
+        }
+
+        *counters = {};
+        int64_t busy_us = 0;
+        bench::Case frame("ui", name, duration_ms / tick_ms);
+
+        for(uint32_t t = 0; t < duration_ms; t += tick_ms) {
+            uint32_t frames = counters->frames;
+
+            lv_tick_inc(tick_ms);
+            int64_t start_us = esp_timer_get_time();
+            frame.start();
+            lv_timer_handler();
+
+            if(counters->frames != frames) {
+                frame.stop();
+            }
+
+            else {
+                frame.cancel();
+            }
+
+            busy_us += esp_timer_get_time() - start_us;
+        }
+
+        uint32_t seconds = duration_ms / 1000;
+
+        frame.metric("frames_per_s", counters->frames / seconds);
+        frame.metric("cpu_us_per_s", busy_us / seconds);
+        frame.metric("bytes_per_s", counters->bytes / seconds);
+        frame.metric("bytes_per_frame", counters->frames > 0 ? counters->bytes / counters->frames : 0);
+        frame.report();
+
+        if(teardown) {
+            teardown();
+        }
+
+        lv_obj_clean(screen);
+    }
+
+    //Gradient background and album cover, the content a StaticLayer holds.
+    static void build_backdrop(lv_obj_t* parent, const lv_image_dsc_t* cover) {
+        lv_obj_t* backdrop = lv_obj_create(parent);
+        lv_obj_set_size(backdrop, screen_width, screen_height);
+        lv_obj_set_style_radius(backdrop, 0, 0);
+        lv_obj_set_style_border_width(backdrop, 0, 0);
+        lv_obj_set_style_bg_color(backdrop, lv_color_hex(0x303848), 0);
+        lv_obj_set_style_bg_grad_color(backdrop, lv_color_hex(0x101014), 0);
+        lv_obj_set_style_bg_grad_dir(backdrop, LV_GRAD_DIR_VER, 0);
+
+        lv_obj_t* image = lv_image_create(parent);
+        lv_image_set_src(image, cover);
+        lv_obj_set_pos(image, 10, 60);
+    }
+
+    //Progress bar over the bottom of the cover, stepped like the playback position.
+    static void build_progress(lv_obj_t* parent) {
+        lv_obj_t* bar = lv_bar_create(parent);
+        lv_obj_set_size(bar, cover_size, 6);
+        lv_obj_set_pos(bar, 10, 60 + cover_size - 6);
+        lv_bar_set_range(bar, 0, 1000);
+
+        lv_timer_t* timer = lv_timer_create([](lv_timer_t* timer) {
+            auto bar = static_cast<lv_obj_t*>(lv_timer_get_user_data(timer));
+            lv_bar_set_value(bar, (lv_bar_get_value(bar) + 1) % 1000, LV_ANIM_OFF);
+        }, progress_period_ms, bar);
+
+        lv_obj_add_event_cb(bar, [](lv_event_t* e) {
+            lv_timer_delete(static_cast<lv_timer_t*>(lv_event_get_user_data(e)));
+        }, LV_EVENT_DELETE, timer);
+    }
+
+    void run() {
+        constexpr uint32_t buffer_size = screen_width * screen_height / 10;
+        auto buffer = heap_caps_malloc(buffer_size * sizeof(uint16_t), MALLOC_CAP_DMA);
+
+        if(buffer == nullptr) {
+            ESP_LOGE(TAG, "No memory for the draw buffer");
+            return;
+        }
+
+        Counters counters = {};
+        lv_display_t* disp = lv_display_create(screen_width, screen_height);
+        lv_display_set_flush_cb(disp, flush_cb);
+        lv_display_set_buffers(disp, buffer, nullptr, buffer_size * sizeof(uint16_t), LV_DISPLAY_RENDER_MODE_PARTIAL);
+        lv_display_set_user_data(disp, &counters);
+        lv_display_set_default(disp);
+
+        run_scene(disp, "scrolling_label", [](lv_obj_t* screen) {
+            lv_obj_t* label = lv_label_create(screen);
+            lv_obj_set_width(label, 120);
+            lv_label_set_long_mode(label, LV_LABEL_LONG_SCROLL_CIRCULAR);
+            lv_label_set_text_static(label, long_title);
+        });
+
+        TextLayer* text_layer = nullptr;
+
+        run_scene(disp, "text_layer", [&text_layer](lv_obj_t* screen) {
+            text_layer = new TextLayer(screen, 120, LV_FONT_DEFAULT, lv_color_black());
+            text_layer->setText(long_title);
+        }, [&text_layer]() {
+            TextLayer::Stats stats = text_layer->getStats();
+            ESP_LOGI(TAG, "Text layer: %lu renders, %lu strip bytes", stats.renders, stats.strip_bytes);
+            delete text_layer;
+        });
+
+        //A frame per progress step, so the per frame numbers are the cost of one step.
+        auto cover_pixels = static_cast<uint16_t*>(heap_caps_malloc_prefer(cover_size * cover_size * sizeof(uint16_t), 2,
+                                                                           MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT));
+
+        if(cover_pixels == nullptr) {
+            ESP_LOGE(TAG, "No memory for the cover, skipping the progress scenes");
+        }
+
+        else {
+            for(int32_t i = 0; i < cover_size * cover_size; i++) {
+                cover_pixels[i] = static_cast<uint16_t>(i * 2654435761u >> 16);
+            }
+
+            lv_image_dsc_t cover = {};
+            cover.header.magic = LV_IMAGE_HEADER_MAGIC;
+            cover.header.cf = LV_COLOR_FORMAT_RGB565;
+            cover.header.w = cover_size;
+            cover.header.h = cover_size;
+            cover.header.stride = cover_size * sizeof(uint16_t);
+            cover.data_size = cover_size * cover_size * sizeof(uint16_t);
+            cover.data = reinterpret_cast<const uint8_t*>(cover_pixels);
+
+            run_scene(disp, "progress_over_cover", [&cover](lv_obj_t* screen) {
+                build_backdrop(screen, &cover);
+                build_progress(screen);
+            });
+
+            StaticLayer* static_layer = nullptr;
+
+            run_scene(disp, "progress_over_static_layer", [&static_layer, &cover](lv_obj_t* screen) {
+                static_layer = new StaticLayer(screen);
+                build_backdrop(static_layer->getContent(), &cover);
+                build_progress(screen);
+            }, [&static_layer]() {
+                StaticLayer::Stats stats = static_layer->getStats();
+                ESP_LOGI(TAG, "Static layer: %lu composes, %lld us last, %lu bytes", stats.composes,
+                         stats.last_compose_us, stats.layer_bytes);
+                delete static_layer;
+            });
+
+            lv_image_cache_drop(&cover);
+            heap_caps_free(cover_pixels);
+        }
+
+        lv_display_delete(disp);
+        heap_caps_free(buffer);
+    }
+
+}
+
+#endif
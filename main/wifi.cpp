@@ -134,6 +134,11 @@ void Wifi::init() {
     };
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+
+#if CONFIG_POWER_GOVERNOR
+    //The modem sleeps between the beacons, which lets the chip light sleep while associated.
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MIN_MODEM));
+#endif
 }
 
 esp_err_t Wifi::connect() {
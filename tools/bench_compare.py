@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""Collect the boot benchmark results from a console capture and compare them to a baseline.
+
+With CONFIG_BOOT_BENCHMARKS the firmware prints every benchmark case as a `@B {...}` line of
+JSON between the regular log output: median, 99th percentile and fastest time per operation
+in microseconds, heap allocations and bytes per operation, and the peak heap use. Capture the
+console, e.g. `idf.py monitor | tee boot.log`, then run
+
+    tools/bench_compare.py boot.log                 # compare to tools/bench_baseline.json
+    tools/bench_compare.py boot.log --update        # record the capture as the baseline
+
+A case regresses when its median is slower than the baseline by more than --threshold
+(10 % by default), its 99th percentile by more than twice that, when it allocates more
+often, or when its peak heap grows by more than the threshold and 1 KB. A case of the
+baseline missing from the capture fails too, as a crash or a dropped case would otherwise
+pass; new cases are listed until the baseline is updated. The exit status is 1 if any case
+regressed or is missing, so the comparison can gate a change.
+
+The committed baseline was recorded on an x86-64 workstation with tools/bench_host.cpp, which
+runs the suites that don't need the board, so only host runs compare to it:
+
+    ./bench_host | tools/bench_compare.py -
+
+Timings of other setups don't compare. For the board, record a baseline of its own on the
+reference board, with the benchmark server of CONFIG_BENCH_SERVER_URL on the same network,
+and pass it with --baseline.
+"""
+import argparse
+import json
+import os
+import re
+import sys
+
+LINE = re.compile(r"@B (\{.*\})\s*$")
+BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "bench_baseline.json")
+PEAK_SLACK = 1024
+
+
+def parse(lines):
+    results = {}
+
+    for line in lines:
+        match = LINE.search(line)
+        if not match:
+            continue
+        try:
+            result = json.loads(match.group(1))
+        except json.JSONDecodeError:
+            # A line cut short by a reset or a lost byte on the serial link.
+            continue
+        results[f"{result.pop('suite')}/{result.pop('case')}"] = result
+
+    return results
+
+
+def compare(results, baseline, threshold):
+    regressions = []
+    rows = []
+
+    for key in sorted(set(results) | set(baseline)):
+        new = results.get(key)
+        old = baseline.get(key)
+
+        if new is None:
+            regressions.append(key)
+            rows.append((key, "missing", "REGRESSED missing"))
+            continue
+        if old is None:
+            rows.append((key, f"{new['median_us']:.3f} us", "new"))
+            continue
+
+        change = new["median_us"] / old["median_us"] - 1 if old["median_us"] > 0 else 0.0
+        flags = []
+
+        if change > threshold:
+            flags.append("median")
+        if old["p99_us"] > 0 and new["p99_us"] / old["p99_us"] - 1 > 2 * threshold:
+            flags.append("p99")
+        if new.get("allocs", 0) > old.get("allocs", 0) + 0.005:
+            flags.append("allocs")
+        if new["peak_bytes"] > old["peak_bytes"] * (1 + threshold) + PEAK_SLACK:
+            flags.append("peak")
+
+        if flags:
+            regressions.append(key)
+
+        rows.append((key, f"{old['median_us']:.3f} -> {new['median_us']:.3f} us ({change:+.1%})",
+                     "REGRESSED " + ",".join(flags) if flags else ""))
+
+    width = max((len(row[0]) for row in rows), default=0)
+
+    for key, timing, status in rows:
+        print(f"{key:<{width}}  {timing:<36}  {status}".rstrip())
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="console capture, - for stdin")
+    parser.add_argument("-b", "--baseline", default=BASELINE, help="baseline file")
+    parser.add_argument("-o", "--output", help="also write the results of the capture to this file")
+    parser.add_argument("-t", "--threshold", type=float, default=0.10, help="relative slowdown tolerated")
+    parser.add_argument("--update", action="store_true", help="write the results to the baseline instead of comparing")
+    args = parser.parse_args()
+
+    lines = sys.stdin if args.capture == "-" else open(args.capture, errors="replace")
+    results = parse(lines)
+
+    if not results:
+        sys.exit("No benchmark results in the capture, is CONFIG_BOOT_BENCHMARKS enabled?")
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    if args.update:
+        with open(args.baseline, "w") as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print(f"Recorded {len(results)} cases to {args.baseline}")
+        return
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    regressions = compare(results, baseline, args.threshold)
+
+    if regressions:
+        print(f"{len(regressions)} of {len(set(results) | set(baseline))} cases regressed or are missing")
+        sys.exit(1)
+
+    print(f"No regressions in {len(results)} cases")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,263 @@
+// Host build of the boot benchmark suites that don't need the board (include/bench.h).
+//
+// Runs the base64, currently_playing, track and token cases of main/base64_bench.cpp and
+// main/api_bench.cpp with the same names, trials and batches, and prints them as the same
+// `@B {...}` lines, so tools/bench_compare.py gates a change on a workstation or in CI. The
+// runner times with the steady clock instead of CPU cycles, counts operator new for the
+// allocations and takes the peak as the most bytes live above the start of a case.
+//
+// Left out because they need the board: the http suite, mbedTLS, cJSON, the track cache
+// lookup (FreeRTOS) and setting the header on esp_http_client. The token cases guard the
+// access token with a std::mutex instead of a FreeRTOS mutex.
+//
+// tools/bench_baseline.json was recorded with this tool, so only host runs compare to it.
+//
+//     g++ -O2 -std=c++20 -Iinclude -Itools/host tools/bench_host.cpp main/json_schema.cpp -o bench_host
+//     ./bench_host [payload directory] | tools/bench_compare.py -
+#include "bench.h"
+#include "base64.h"
+#include "spotify_schema.h"
+#include "url_builder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <malloc.h>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+static bool measuring = false;
+static uint32_t hook_allocations = 0;
+static uint64_t hook_bytes = 0;
+static size_t live_bytes = 0;
+static size_t peak_live_bytes = 0;
+
+void* operator new(size_t size) {
+    void* ptr = malloc(size);
+
+    if(ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    live_bytes += malloc_usable_size(ptr);
+    peak_live_bytes = std::max(peak_live_bytes, live_bytes);
+
+    if(measuring) {
+        hook_allocations++;
+        hook_bytes += size;
+    }
+
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    if(ptr != nullptr) {
+        live_bytes -= malloc_usable_size(ptr);
+        free(ptr);
+    }
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+static uint32_t now_ns() {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+namespace bench {
+
+    //As main/bench.cpp, with nanoseconds in place of cycles and live bytes in place of free heap.
+    Case::Case(const char* suite, const char* name, uint32_t trials, uint32_t batch)
+        : suite(suite),
+          name(name),
+          batch(std::max<uint32_t>(batch, 1)),
+          start_cycles(0),
+          allocations(0),
+          allocated_bytes(0),
+          metrics{},
+          metric_count(0) {
+
+        samples.reserve(trials);
+        start_free = live_bytes;
+        peak_live_bytes = live_bytes;
+    }
+
+    Case::~Case() {
+    }
+
+    void Case::start() {
+        hook_allocations = 0;
+        hook_bytes = 0;
+        measuring = true;
+        start_cycles = now_ns();
+    }
+
+    void Case::stop() {
+        end(true);
+    }
+
+    void Case::cancel() {
+        end(false);
+    }
+
+    void Case::end(bool record) {
+        uint32_t cycles = now_ns() - start_cycles;
+        measuring = false;
+
+        if(!record || samples.size() == samples.capacity()) {
+            return;
+        }
+
+        samples.push_back(cycles);
+        allocations += hook_allocations;
+        allocated_bytes += hook_bytes;
+    }
+
+    void Case::metric(const char* key, double value) {
+        if(metric_count < metrics.size()) {
+            metrics[metric_count++] = {key, value};
+        }
+    }
+
+    Result Case::report() {
+        Result result = {};
+        float ns_per_op = 1000.0f * batch;
+        uint32_t operations = samples.size() * batch;
+
+        result.trials = samples.size();
+        result.batch = batch;
+        result.peak_bytes = peak_live_bytes - start_free;
+
+        if(!samples.empty()) {
+            std::sort(samples.begin(), samples.end());
+            result.median_us = samples[samples.size() / 2] / ns_per_op;
+            result.p99_us = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)] / ns_per_op;
+            result.min_us = samples.front() / ns_per_op;
+            result.allocations = static_cast<float>(allocations) / operations;
+            result.allocated_bytes = static_cast<float>(allocated_bytes) / operations;
+        }
+
+        printf("@B {\"suite\":\"%s\",\"case\":\"%s\",\"trials\":%lu,\"batch\":%lu,\"median_us\":%.3f,\"p99_us\":%.3f,"
+               "\"min_us\":%.3f,\"allocs\":%.2f,\"alloc_bytes\":%.1f,\"peak_bytes\":%lu",
+               suite, name, static_cast<unsigned long>(result.trials), static_cast<unsigned long>(result.batch),
+               result.median_us, result.p99_us, result.min_us, result.allocations, result.allocated_bytes,
+               static_cast<unsigned long>(result.peak_bytes));
+
+        for(size_t i = 0; i < metric_count; i++) {
+            printf(",\"%s\":%.3f", metrics[i].key, metrics[i].value);
+        }
+
+        printf("}\n");
+
+        return result;
+    }
+
+}
+
+static std::string directory = "tools/payloads";
+
+static std::string load(const char* name) {
+    std::ifstream file(directory + "/" + name + ".json", std::ios::binary);
+    std::stringstream text;
+
+    if(!file) {
+        std::fprintf(stderr, "Missing payload %s/%s.json\n", directory.c_str(), name);
+        std::exit(1);
+    }
+
+    text << file.rdbuf();
+    return text.str();
+}
+
+//main/base64_bench.cpp
+static void run_base64() {
+    constexpr size_t input_size = 3072;
+    constexpr int iterations = 200;
+    std::vector<uint8_t> input(input_size);
+    std::vector<char> encoded(base64::encodedLength(input_size) + 1);
+    std::vector<uint8_t> decoded(base64::decodedMaxLength(encoded.size()));
+    std::mt19937 rng(49);
+    size_t written = 0;
+
+    for(auto& byte : input) {
+        byte = static_cast<uint8_t>(rng());
+    }
+
+    bench::run("base64", "encode_3k", [&] {
+        base64::encode(input, encoded, written);
+    }, iterations);
+
+    size_t encoded_len = written;
+
+    bench::run("base64", "decode_3k", [&] {
+        base64::decode(std::span<const char>(encoded.data(), encoded_len), decoded, written);
+    }, iterations);
+
+    if(written != input_size || !std::equal(input.begin(), input.end(), decoded.begin())) {
+        std::fprintf(stderr, "base64 round trip FAILED\n");
+        std::exit(1);
+    }
+}
+
+//main/api_bench.cpp
+static void run_currently_playing() {
+    std::string track = load("currently_playing_track");
+    std::string episode = load("currently_playing_episode");
+
+    bench::run("currently_playing", "decode_track", [&track] {
+        spotify::api::CurrentlyPlaying playing{};
+        json::decode(track, playing);
+    });
+
+    bench::run("currently_playing", "decode_episode", [&episode] {
+        spotify::api::CurrentlyPlaying playing{};
+        json::decode(episode, playing);
+    });
+}
+
+static void run_track() {
+    std::string text = load("currently_playing_track");
+    spotify::api::CurrentlyPlaying playing{};
+
+    json::decode(text, playing);
+
+    bench::run("track", "copy", [&playing] {
+        spotify::Track track = playing.track;
+    }, bench::default_trials, 10);
+}
+
+static void run_token() {
+    std::string access_token(260, 'x');
+    std::mutex mtx_token;
+
+    bench::run("token", "bearer_string", [&] {
+        std::lock_guard<std::mutex> lock(mtx_token);
+        std::string header = "Bearer " + access_token;
+    }, bench::default_trials, 10);
+
+    bench::run("token", "bearer_fixed", [&] {
+        FixedString<512> header;
+        std::lock_guard<std::mutex> lock(mtx_token);
+        header.append("Bearer ").append(access_token);
+    }, bench::default_trials, 10);
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1) {
+        directory = argv[1];
+    }
+
+    run_base64();
+    run_currently_playing();
+    run_track();
+    run_token();
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Build the glyph file for the `glyphs` partition from TTF/OTF fonts.
+
+Every codepoint of the requested ranges is taken from the first font that has it and
+rasterized at 4 bits per pixel. Codepoints no font has are left out, so they fall back
+to the firmware's default font. The layout is documented in include/glyph_cache.h.
+
+    pip install pillow
+    tools/build_glyphs.py --size 16 --font NotoSans-Regular.ttf \\
+        --font NotoSansCJK-Regular.ttc --ranges latin,cyrillic,greek,kana,cjk,hangul glyphs.bin
+    parttool.py write_partition --partition-name=glyphs --input glyphs.bin
+"""
+import argparse
+import struct
+import sys
+
+from PIL import Image, ImageDraw, ImageFont
+
+MAGIC = b"GLPH"
+VERSION = 1
+HEADER = struct.Struct("<4sHBBHhIIIII")
+RANGE = struct.Struct("<III")
+DESCRIPTOR = struct.Struct("<IHHBBbb")
+MAX_GLYPH_BYTES = 1024
+
+# Named sets of codepoint ranges, inclusive.
+RANGES = {
+    "ascii": [(0x20, 0x7E)],
+    "latin": [(0x20, 0x7E), (0xA0, 0x24F), (0x2000, 0x206F), (0x20AC, 0x20AC)],
+    "greek": [(0x370, 0x3FF)],
+    "cyrillic": [(0x400, 0x4FF)],
+    "kana": [(0x3000, 0x30FF), (0xFF00, 0xFFEF)],
+    "cjk": [(0x4E00, 0x9FFF)],
+    "hangul": [(0x1100, 0x11FF), (0x3130, 0x318F), (0xAC00, 0xD7A3)],
+}
+
+
+def parse_ranges(spec):
+    ranges = []
+
+    for part in spec.split(","):
+        if part in RANGES:
+            ranges += RANGES[part]
+        elif "-" in part:
+            first, last = part.split("-")
+            ranges.append((int(first, 16), int(last, 16)))
+        else:
+            ranges.append((int(part, 16), int(part, 16)))
+
+    return sorted(set(cp for first, last in ranges for cp in range(first, last + 1)))
+
+
+def rasterize(font, char):
+    """Returns the advance, box, offsets and 4 bpp rows of a glyph."""
+    x0, y0, x1, y1 = font.getbbox(char, anchor="ls")
+    advance = round(font.getlength(char))
+    width, height = x1 - x0, y1 - y0
+
+    if width <= 0 or height <= 0:
+        return advance, 0, 0, 0, 0, b""
+
+    image = Image.new("L", (width, height))
+    ImageDraw.Draw(image).text((-x0, -y0), char, font=font, fill=255, anchor="ls")
+    pixels = image.tobytes()
+    rows = bytearray()
+
+    for y in range(height):
+        row = [(pixels[y * width + x] + 8) // 17 for x in range(width)] + [0]
+
+        for x in range(0, width, 2):
+            rows.append(row[x] << 4 | row[x + 1])
+
+    # LVGL's y offset is the bottom of the box above the base line.
+    return advance, width, height, x0, -y1, bytes(rows)
+
+
+def covers(font, notdef, char):
+    """Pillow draws .notdef for missing codepoints, so compare against it."""
+    if char.isspace() or not char.isprintable():
+        return char.isspace()
+
+    return rasterize(font, char) != notdef
+
+
+def build(fonts, codepoints):
+    notdefs = [rasterize(font, "\uffff") for font in fonts]
+    glyphs = {}
+
+    for cp in codepoints:
+        char = chr(cp)
+
+        for font, notdef in zip(fonts, notdefs):
+            if covers(font, notdef, char):
+                glyph = rasterize(font, char)
+
+                if glyph[1] > 255 or glyph[2] > 255 or len(glyph[5]) > MAX_GLYPH_BYTES or \
+                        not -128 <= glyph[3] < 128 or not -128 <= glyph[4] < 128:
+                    sys.exit(f"U+{cp:04X} is too large, use a smaller size")
+
+                glyphs[cp] = glyph
+                break
+
+    ascent, descent = fonts[0].getmetrics()
+    return pack(glyphs, ascent + descent, descent)
+
+
+def pack(glyphs, line_height, base_line):
+    """Lays out {codepoint: rasterize() result} as a glyph file."""
+    ranges = []
+
+    for index, cp in enumerate(sorted(glyphs)):
+        if ranges and ranges[-1][0] + ranges[-1][1] == cp:
+            ranges[-1][1] += 1
+        else:
+            ranges.append([cp, 1, index])
+
+    descriptor_offset = HEADER.size + len(ranges) * RANGE.size
+    bitmap_offset = descriptor_offset + len(glyphs) * DESCRIPTOR.size
+    descriptors = bytearray()
+    bitmaps = bytearray()
+
+    for cp in sorted(glyphs):
+        advance, width, height, ofs_x, ofs_y, rows = glyphs[cp]
+        descriptors += DESCRIPTOR.pack(bitmap_offset + len(bitmaps), len(rows), advance, width, height, ofs_x, ofs_y)
+        bitmaps += rows
+
+    size = bitmap_offset + len(bitmaps)
+    max_bitmap = max((len(glyph[5]) for glyph in glyphs.values()), default=0)
+    header = HEADER.pack(MAGIC, VERSION, 4, 0, line_height, base_line, len(ranges), len(glyphs),
+                         descriptor_offset, max_bitmap, size)
+
+    return header + b"".join(RANGE.pack(*r) for r in ranges) + descriptors + bitmaps, len(glyphs), len(ranges)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--font", action="append", required=True, help="TTF/OTF/TTC font, in order of preference")
+    parser.add_argument("--size", type=int, default=16, help="pixel size")
+    parser.add_argument("--ranges", default="latin",
+                        help="comma separated names (%s) or hex ranges like 2190-21FF" % ", ".join(RANGES))
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    fonts = [ImageFont.truetype(path, args.size) for path in args.font]
+    data, glyphs, ranges = build(fonts, parse_ranges(args.ranges))
+
+    with open(args.output, "wb") as f:
+        f.write(data)
+
+    print(f"{glyphs} glyphs in {ranges} ranges, {len(data)} bytes", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,247 @@
+// Host check that player commands don't allocate (include/spotify_endpoints.h, include/url_builder.h).
+//
+// Links main/http_client.cpp against a scripted esp_http_client that answers every request with
+// 204 No Content, and counts operator new and the mem:: allocations while every Command and
+// Control is sent the way spotify::Client::sendPlayerCommand and sendPlayerControl send them:
+// endpoint lookup, URL and Authorization header built on the stack, then HttpClient::request.
+// Also checks that the request carries the expected method, URL and header, and that a token
+// too long for the header aborts the command before anything is sent.
+//
+// Metrics are off, as by default: with CONFIG_METRICS the registry folds the URL of every
+// request into a string.
+//
+//     g++ -O2 -std=c++20 -DCONFIG_METRICS=0 -Iinclude -Itools/host tools/command_alloc_check.cpp main/http_client.cpp -o command_alloc_check
+//     ./command_alloc_check
+#include "http_client.h"
+#include "deferred_log.h"
+#include "spotify_endpoints.h"
+#include "url_builder.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#define API_URL "https://api.spotify.com"
+
+static constexpr int rounds = 1000;
+
+static size_t allocations = 0;
+static int failures = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+
+    if(void* ptr = malloc(size)) {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace mem {
+
+    void* allocate(size_t size, Region region) {
+        allocations++;
+        return malloc(size);
+    }
+
+    void deallocate(void* ptr) {
+        free(ptr);
+    }
+
+}
+
+namespace dlog {
+
+    void submit(Record& record) {
+        printf("log: %s\n", record.header.format);
+    }
+
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    return code == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//One connection of the scripted server, which keeps what the last request carried.
+struct esp_http_client {
+    esp_http_client_method_t method;
+    char url[256];
+    char authorization[1024];
+    bool open;
+    uint32_t requests;
+};
+
+//The connection HttpClient opened last, whose requests are checked.
+static esp_http_client_handle_t connection = nullptr;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t* config) {
+    connection = new esp_http_client{config->method, "", "", false, 0};
+    return connection;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) {
+    delete client;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char* url) {
+    snprintf(client->url, sizeof(client->url), "%s", url);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) {
+    client->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char* key, const char* value) {
+    if(strcmp(key, "Authorization") == 0) {
+        snprintf(client->authorization, sizeof(client->authorization), "%s", value);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_get_header(esp_http_client_handle_t client, const char* key, char** value) {
+    *value = strcmp(key, "Authorization") == 0 ? client->authorization : nullptr;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char* key) {
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms) {
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len) {
+    client->open = true;
+    client->requests++;
+    return ESP_OK;
+}
+
+int esp_http_client_write(esp_http_client_handle_t client, const char* buffer, int len) {
+    return len;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client) {
+    return 0;
+}
+
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client) {
+    return false;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client) {
+    return HttpStatus_NoContent;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char* buffer, int len) {
+    return 0;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client) {
+    return true;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client) {
+    client->open = false;
+    return ESP_OK;
+}
+
+static void check(bool condition, const std::string& what) {
+    if(!condition) {
+        printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+//What Client::set_authorization and sendPlayerCommand/sendPlayerControl do.
+static bool send(HttpClient& http_client, const spotify::Endpoint& target, int value, std::string_view token) {
+    UrlBuilder<128> url;
+
+    url.append(API_URL).append(target.path);
+
+    if(target.param != nullptr) {
+        url.query(target.param, value);
+    }
+
+    if(!url.ok()) {
+        return false;
+    }
+
+    FixedString<512> bearer;
+    bearer.append("Bearer ").append(token);
+
+    if(!bearer.ok()) {
+        return false;
+    }
+
+    if(http_client.setHeader("Authorization", bearer.c_str()) != ESP_OK) {
+        return false;
+    }
+
+    return http_client.request(target.method, url.c_str(), "", target.expected_status, Deadline::in(5000));
+}
+
+static void check_command(HttpClient& http_client, const spotify::Endpoint& target, int value, const std::string& token) {
+    std::string name = target.path;
+    std::string url = std::string(API_URL) + target.path;
+
+    if(target.param != nullptr) {
+        url += std::string("?") + target.param + "=" + std::to_string(value);
+    }
+
+    //The first request may size what the client keeps, only the ones after it count.
+    check(send(http_client, target, value, token), name + " succeeds");
+    check(connection->method == target.method && url == connection->url, name + " sent as " + url);
+    check(std::string("Bearer ") + token == connection->authorization, name + " carries the token");
+
+    size_t before = allocations;
+
+    for(int i = 0; i < rounds; i++) {
+        send(http_client, target, value, token);
+    }
+
+    size_t made = allocations - before;
+    printf("%-36s %6.2f allocations per command\n", name.c_str(), static_cast<double>(made) / rounds);
+    check(made == 0, name + " allocates");
+}
+
+int main() {
+    std::string token(300, 'A');
+    std::string oversized(600, 'B');
+    HttpClient http_client;
+
+    for(const auto& entry : spotify::command_endpoints) {
+        check_command(http_client, entry.endpoint, 0, token);
+    }
+
+    for(const auto& entry : spotify::control_endpoints) {
+        check_command(http_client, entry.endpoint, 65, token);
+    }
+
+    //A truncated header would be sent with a token the API rejects, the command is dropped instead.
+    uint32_t requests = connection->requests;
+    check(!send(http_client, spotify::endpoint(spotify::Command::Play), 0, oversized), "oversized token rejected");
+    check(connection->requests == requests, "nothing sent with an oversized token");
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Host benchmark of the schema decoders (include/json_schema.h, include/spotify_schema.h).
+//
+// Decodes the responses recorded in tools/payloads, the shapes the client receives from each
+// endpoint, with the schema the client decodes them with. Reports the time per decode and the
+// throughput, next to skipping the whole text with json::Reader, which checks the brackets
+// and strings only and bounds what a one-pass decoder can reach. Prints what was decoded from
+// every payload so a schema that stops matching the API shows up as empty fields.
+//
+//     g++ -O2 -std=c++20 -Iinclude tools/decode_bench.cpp main/json_schema.cpp -o decode_bench
+//     ./decode_bench [payload directory]
+#include "spotify_schema.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr double min_seconds = 0.2;
+
+static std::string directory = "tools/payloads";
+
+static std::string load(const char* name) {
+    std::ifstream file(directory + "/" + name + ".json", std::ios::binary);
+    std::stringstream text;
+
+    if(!file) {
+        std::fprintf(stderr, "Missing payload %s/%s.json\n", directory.c_str(), name);
+        std::exit(1);
+    }
+
+    text << file.rdbuf();
+    return text.str();
+}
+
+//Runs fn until min_seconds have passed, returns microseconds per run.
+template<typename F>
+static double measure(F&& fn) {
+    long runs = 0;
+    auto start = Clock::now();
+    double elapsed = 0;
+
+    do {
+        for(int i = 0; i < 16; i++) {
+            fn();
+        }
+
+        runs += 16;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    } while(elapsed < min_seconds);
+
+    return elapsed * 1e6 / runs;
+}
+
+template<typename T, typename D>
+static void run(const char* name, D&& describe) {
+    std::string text = load(name);
+    T out{};
+    bool ok = json::decode(text, out);
+
+    if(!ok) {
+        std::printf("%-28s decode failed\n", name);
+        return;
+    }
+
+    double decode_us = measure([&] {
+        T value{};
+        json::decode(text, value);
+    });
+
+    double skip_us = measure([&] {
+        json::Reader reader(text);
+        reader.skipValue();
+    });
+
+    std::printf("%-28s %7zu B %9.2f us %8.1f MB/s   skip %8.2f us %8.1f MB/s\n", name, text.size(),
+                decode_us, text.size() / decode_us, skip_us, text.size() / skip_us);
+    std::printf("    %s\n", describe(out).c_str());
+}
+
+static std::string describe(const spotify::Track& track) {
+    std::string artists;
+
+    for(const auto& artist : track.artists) {
+        artists += (artists.empty() ? "" : ", ") + artist;
+    }
+
+    return "\"" + track.name + "\" by " + artists + " on \"" + track.album_name + "\", " +
+           std::to_string(track.duration_ms) + " ms, " + track.uri + ", art " + track.album_pic_url;
+}
+
+static std::string describe_playing(const spotify::api::CurrentlyPlaying& playing) {
+    std::string out = playing.type + (playing.is_playing ? " playing" : " paused") + " at " +
+                      std::to_string(playing.progress_ms) + " ms in " + playing.context_uri + ": ";
+
+    if(playing.type == "episode") {
+        out += "\"" + playing.episode.name + "\" of \"" + playing.episode.show_name + "\" by " +
+               playing.episode.publisher + ", " + std::to_string(playing.episode.duration_ms) + " ms, " + playing.episode.uri;
+    }
+
+    else if(playing.type == "track") {
+        out += describe(playing.track);
+    }
+
+    else {
+        out += "no item";
+    }
+
+    return out;
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1) {
+        directory = argv[1];
+    }
+
+    run<spotify::api::CurrentlyPlaying>("currently_playing_track", describe_playing);
+    run<spotify::api::CurrentlyPlaying>("currently_playing_episode", describe_playing);
+    run<spotify::api::CurrentlyPlaying>("currently_playing_ad", describe_playing);
+
+    run<spotify::api::Queue>("queue", [](const spotify::api::Queue& queue) {
+        return std::to_string(queue.queue.size()) + " tracks, first " + describe(queue.queue.front());
+    });
+
+    run<spotify::api::PlaylistPage>("playlist_tracks", [](const spotify::api::PlaylistPage& page) {
+        size_t missing = 0;
+
+        for(const auto& item : page.items) {
+            missing += item.uri.empty();
+        }
+
+        return std::to_string(page.items.size()) + " of " + std::to_string(page.total) + " items, " +
+               std::to_string(missing) + " without a track, first " + page.items.front().uri;
+    });
+
+    run<spotify::api::Tracks>("tracks", [](const spotify::api::Tracks& tracks) {
+        return std::to_string(tracks.tracks.size()) + " tracks, last " + describe(tracks.tracks.back());
+    });
+
+    run<spotify::api::Devices>("devices", [](const spotify::api::Devices& devices) {
+        std::string out;
+
+        for(const auto& device : devices.devices) {
+            out += device.name + " (" + device.type + (device.is_active ? ", active, " : ", ") +
+                   std::to_string(device.volume_percent) + "%) ";
+        }
+
+        return out;
+    });
+
+    run<spotify::api::Token>("token", [](const spotify::api::Token& token) {
+        return std::to_string(token.access_token.size()) + " characters";
+    });
+
+    return 0;
+}
@@ -0,0 +1,378 @@
+// Host benchmark and check of the glyph cache (include/glyph_cache.h).
+//
+// Reads a glyph file built by tools/build_glyphs.py, or builds a synthetic one covering Latin,
+// Greek, Cyrillic, kana, CJK and Hangul with random bitmaps of the sizes a 16 px font has. The
+// file is read with pread, as the device reads the partition. Reports per title the time to
+// draw it with a cold cache, the time per glyph once cached and the glyphs read, then the hit
+// rate of cycling through the titles the way the now playing screen does.
+//
+// Also checks the cache: every glyph of a long run of random lookups, most of them evicting,
+// is compared with a reference parse of the file, a reader that fails at random must only fail
+// lookups, and corrupted headers must be rejected or open to a file whose lookups stay inside
+// it. Build with the sanitizers to catch overruns:
+//
+//     g++ -O2 -std=c++20 -Iinclude tools/glyph_cache_bench.cpp main/glyph_cache.cpp -o glyph_cache_bench
+//     ./glyph_cache_bench [glyphs.bin]
+#include "glyph_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+struct Title {
+    const char* script;
+    const char* text;
+};
+
+static const Title titles[] = {
+    {"Latin", "Bohemian Rhapsody - Remastered 2011"},
+    {"Latin", "Je ne regrette rien, Édith Piaf"},
+    {"Cyrillic", "Кино - Группа крови"},
+    {"Greek", "Μίκης Θεοδωράκης - Ζορμπάς"},
+    {"Japanese", "宇多田ヒカル - 花束を君に"},
+    {"Chinese", "周杰倫 - 晴天 (葉惠美)"},
+    {"Hangul", "아이유 - 밤편지 (Through the Night)"},
+};
+
+static constexpr int cycles = 4;
+static constexpr int churn_lookups = 300000;
+static constexpr int corrupt_headers = 20000;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if(!condition) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void put(std::vector<uint8_t>& out, size_t pos, uint32_t value, size_t bytes) {
+    for(size_t i = 0; i < bytes; i++) {
+        out[pos + i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint32_t get(const uint8_t* data, size_t bytes) {
+    uint32_t value = 0;
+
+    for(size_t i = 0; i < bytes; i++) {
+        value |= static_cast<uint32_t>(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+//The layout of glyph_cache.h, with boxes the size of a 16 px font: narrow for alphabets, square for CJK.
+static std::vector<uint8_t> synthesize() {
+    struct Block {
+        uint32_t first;
+        uint32_t last;
+        uint8_t box_w;
+    };
+
+    static const Block blocks[] = {
+        {0x20, 0x24F, 8}, {0x370, 0x3FF, 9}, {0x400, 0x4FF, 9}, {0x3000, 0x30FF, 15},
+        {0x4E00, 0x9FFF, 15}, {0xAC00, 0xD7A3, 15}, {0xFF00, 0xFFEF, 15},
+    };
+
+    constexpr uint8_t box_h = 16;
+    std::mt19937 rng(39);
+    uint32_t glyph_count = 0;
+
+    for(const Block& block : blocks) {
+        glyph_count += block.last - block.first + 1;
+    }
+
+    size_t range_count = std::size(blocks);
+    uint32_t descriptor_offset = GlyphCache::header_size + range_count * GlyphCache::range_size;
+    uint32_t bitmap_offset = descriptor_offset + glyph_count * GlyphCache::descriptor_size;
+    std::vector<uint8_t> file(bitmap_offset);
+    uint32_t glyph = 0;
+    uint32_t max_bitmap = 0;
+
+    for(size_t i = 0; i < range_count; i++) {
+        const Block& block = blocks[i];
+        size_t range = GlyphCache::header_size + i * GlyphCache::range_size;
+
+        put(file, range, block.first, 4);
+        put(file, range + 4, block.last - block.first + 1, 4);
+        put(file, range + 8, glyph, 4);
+
+        for(uint32_t cp = block.first; cp <= block.last; cp++, glyph++) {
+            uint8_t box_w = cp == 0x20 ? 0 : block.box_w;
+            uint32_t size = (box_w + 1) / 2 * (box_w == 0 ? 0 : box_h);
+            size_t descriptor = descriptor_offset + glyph * GlyphCache::descriptor_size;
+
+            put(file, descriptor, file.size(), 4);
+            put(file, descriptor + 4, size, 2);
+            put(file, descriptor + 6, box_w + 1, 2);
+            file[descriptor + 8] = box_w;
+            file[descriptor + 9] = box_w == 0 ? 0 : box_h;
+            file[descriptor + 10] = 0;
+            file[descriptor + 11] = static_cast<uint8_t>(-3);
+
+            for(uint32_t b = 0; b < size; b++) {
+                file.push_back(static_cast<uint8_t>(rng()));
+            }
+
+            max_bitmap = std::max(max_bitmap, size);
+        }
+    }
+
+    std::memcpy(file.data(), "GLPH", 4);
+    put(file, 4, GlyphCache::version, 2);
+    file[6] = 4;
+    put(file, 8, 19, 2);
+    put(file, 10, 4, 2);
+    put(file, 12, range_count, 4);
+    put(file, 16, glyph_count, 4);
+    put(file, 20, descriptor_offset, 4);
+    put(file, 24, max_bitmap, 4);
+    put(file, 28, file.size(), 4);
+
+    return file;
+}
+
+static std::vector<uint32_t> codepoints(const char* text) {
+    std::vector<uint32_t> out;
+    auto s = reinterpret_cast<const uint8_t*>(text);
+
+    while(*s != 0) {
+        int extra = *s >= 0xF0 ? 3 : *s >= 0xE0 ? 2 : *s >= 0xC0 ? 1 : 0;
+        uint32_t cp = *s++ & (0x7F >> extra);
+
+        for(int i = 0; i < extra && *s != 0; i++) {
+            cp = cp << 6 | (*s++ & 0x3F);
+        }
+
+        out.push_back(cp);
+    }
+
+    return out;
+}
+
+static double now_us() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Compares a glyph with the file itself.
+static bool matches(const std::vector<uint8_t>& file, uint32_t codepoint, const GlyphCache::Glyph& glyph) {
+    uint32_t range_count = get(&file[12], 4);
+    uint32_t descriptor_offset = get(&file[20], 4);
+
+    for(uint32_t i = 0; i < range_count; i++) {
+        const uint8_t* range = &file[GlyphCache::header_size + i * GlyphCache::range_size];
+        uint32_t first = get(range, 4);
+
+        if(codepoint < first || codepoint - first >= get(range + 4, 4)) {
+            continue;
+        }
+
+        const uint8_t* descriptor = &file[descriptor_offset + (get(range + 8, 4) + codepoint - first) * GlyphCache::descriptor_size];
+        uint32_t size = get(descriptor + 4, 2);
+
+        return glyph.adv_w == get(descriptor + 6, 2) && glyph.box_w == descriptor[8] && glyph.box_h == descriptor[9] &&
+               glyph.ofs_x == static_cast<int8_t>(descriptor[10]) && glyph.ofs_y == static_cast<int8_t>(descriptor[11]) &&
+               (size == 0 || std::memcmp(glyph.bitmap, &file[get(descriptor, 4)], size) == 0);
+    }
+
+    return false;
+}
+
+static void bench(GlyphCache& cache) {
+    printf("%-9s %13s %9s %12s\n", "script", "first render", "cached", "glyphs read");
+
+    for(const Title& title : titles) {
+        std::vector<uint32_t> text = codepoints(title.text);
+        GlyphCache::Glyph glyph;
+        constexpr int repeats = 1000;
+
+        cache.clear();
+        uint32_t misses = cache.getStats().misses;
+
+        double start = now_us();
+
+        for(uint32_t cp : text) {
+            cache.lookup(cp, glyph);
+        }
+
+        double first_us = now_us() - start;
+        misses = cache.getStats().misses - misses;
+
+        start = now_us();
+
+        for(int i = 0; i < repeats; i++) {
+            for(uint32_t cp : text) {
+                cache.lookup(cp, glyph);
+            }
+        }
+
+        double cached_us = (now_us() - start) / repeats / text.size();
+
+        printf("%-9s %10.1f us %6.3f us %12u\n", title.script, first_us, cached_us, misses);
+    }
+
+    cache.clear();
+    GlyphCache::Stats before = cache.getStats();
+
+    for(int cycle = 0; cycle < cycles; cycle++) {
+        for(const Title& title : titles) {
+            GlyphCache::Glyph glyph;
+
+            for(uint32_t cp : codepoints(title.text)) {
+                cache.lookup(cp, glyph);
+            }
+        }
+    }
+
+    GlyphCache::Stats after = cache.getStats();
+    uint32_t hits = after.hits - before.hits;
+    uint32_t misses = after.misses - before.misses;
+
+    printf("%zu titles %d times: %.1f%% hits, %u evictions, %u bytes read\n", std::size(titles), cycles,
+           100.0 * hits / (hits + misses), after.evictions - before.evictions, after.bytes_read - before.bytes_read);
+}
+
+static void churn(GlyphCache& cache, const std::vector<uint8_t>& file) {
+    std::mt19937 rng(7);
+    uint32_t checked = 0;
+
+    //Mostly CJK, which doesn't fit the slots, with a hot set of Latin in between.
+    for(int i = 0; i < churn_lookups; i++) {
+        uint32_t cp = rng() % 4 == 0 ? 0x41 + rng() % 26 : 0x4E00 + rng() % 0x5200;
+        GlyphCache::Glyph glyph;
+
+        if(cache.lookup(cp, glyph)) {
+            check(matches(file, cp, glyph), "cached glyph equals the file");
+            checked++;
+        }
+    }
+
+    check(checked > 0, "churn found glyphs");
+    printf("churn: %u glyphs checked, %u evictions\n", checked, cache.getStats().evictions);
+}
+
+static void failing_reader(const std::vector<uint8_t>& file) {
+    std::mt19937 rng(11);
+    bool failing = false;
+    GlyphCache cache;
+
+    cache.open([&](uint32_t offset, void* dst, size_t len) {
+        if((failing && rng() % 3 == 0) || offset > file.size() || len > file.size() - offset) {
+            return false;
+        }
+
+        std::memcpy(dst, &file[offset], len);
+        return true;
+    });
+
+    failing = true;
+
+    for(int i = 0; i < churn_lookups / 10; i++) {
+        uint32_t cp = 0x4E00 + rng() % 0x300;
+        GlyphCache::Glyph glyph;
+
+        if(cache.lookup(cp, glyph)) {
+            check(matches(file, cp, glyph), "glyph read past a failed read equals the file");
+        }
+    }
+}
+
+static void corrupt(const std::vector<uint8_t>& file) {
+    std::mt19937 rng(13);
+    uint32_t opened = 0;
+
+    for(int i = 0; i < corrupt_headers; i++) {
+        //Only the header and the range table are corrupted, the bytes after them are read as they are.
+        std::vector<uint8_t> copy(file.begin(), file.begin() + std::min<size_t>(file.size(), 1 << 16));
+        size_t table_end = GlyphCache::header_size + get(&file[12], 4) * GlyphCache::range_size;
+
+        for(int flip = 0; flip < 1 + static_cast<int>(rng() % 4); flip++) {
+            copy[rng() % table_end] = static_cast<uint8_t>(rng());
+        }
+
+        GlyphCache cache;
+        bool open = cache.open([&copy](uint32_t offset, void* dst, size_t len) {
+            if(offset > copy.size() || len > copy.size() - offset) {
+                return false;
+            }
+
+            std::memcpy(dst, &copy[offset], len);
+            return true;
+        });
+
+        if(!open) {
+            continue;
+        }
+
+        opened++;
+
+        for(int j = 0; j < 64; j++) {
+            GlyphCache::Glyph glyph;
+            cache.lookup(rng() % 0x10000, glyph);
+        }
+    }
+
+    printf("corrupted headers: %d, %u still opened\n", corrupt_headers, opened);
+}
+
+int main(int argc, char** argv) {
+    std::vector<uint8_t> file;
+    std::string path;
+
+    if(argc > 1) {
+        path = argv[1];
+        FILE* in = fopen(argv[1], "rb");
+
+        if(in == nullptr) {
+            perror(argv[1]);
+            return 1;
+        }
+
+        int c;
+
+        while((c = fgetc(in)) != EOF) {
+            file.push_back(static_cast<uint8_t>(c));
+        }
+
+        fclose(in);
+    }
+
+    else {
+        file = synthesize();
+        path = "/tmp/glyph_cache_bench.bin";
+        FILE* out = fopen(path.c_str(), "wb");
+        fwrite(file.data(), 1, file.size(), out);
+        fclose(out);
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    GlyphCache cache;
+
+    bool opened = cache.open([fd](uint32_t offset, void* dst, size_t len) {
+        return pread(fd, dst, len, offset) == static_cast<ssize_t>(len);
+    });
+
+    if(!opened) {
+        printf("%s is not a glyph file\n", path.c_str());
+        return 1;
+    }
+
+    printf("%s: %zu bytes, %u bytes per slot, %u KB of slots\n", path.c_str(), file.size(), cache.getSlotBytes(),
+           static_cast<unsigned>(cache.getSlotBytes() * GlyphCache::slot_count / 1024));
+
+    bench(cache);
+    churn(cache, file);
+    failing_reader(file);
+    corrupt(file);
+    close(fd);
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
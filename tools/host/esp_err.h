@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdlib>
+
+//The esp_err_t subset the host tools use, with the values of ESP-IDF.
+typedef int esp_err_t;
+
+#define ESP_OK          0
+#define ESP_FAIL        -1
+#define ESP_ERR_TIMEOUT 0x107
+
+#define ESP_ERROR_CHECK(x) do {     \
+        if((x) != ESP_OK) {         \
+            abort();                \
+        }                           \
+    } while(0)
+
+const char* esp_err_to_name(esp_err_t code);
@@ -0,0 +1,5 @@
+#pragma once
+#include <cstdint>
+
+//Microseconds since start, defined by the host tool.
+int64_t esp_timer_get_time();
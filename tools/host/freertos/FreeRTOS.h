@@ -0,0 +1,8 @@
+#pragma once
+
+//Stands in for the FreeRTOS header in the host tools. The headers they include only need the
+//types of members the tools never use.
+typedef struct {
+    volatile unsigned int owner;
+    unsigned int count;
+} portMUX_TYPE;
@@ -0,0 +1,4 @@
+#pragma once
+
+//Stands in for the FreeRTOS task header in the host tools, see FreeRTOS.h.
+#include "freertos/FreeRTOS.h"
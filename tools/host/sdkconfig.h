@@ -0,0 +1,12 @@
+#pragma once
+
+//Stands in for the sdkconfig.h ESP-IDF generates, so the parts of the firmware that only use
+//the standard library build into the host tools. Pass -Itools/host after -Iinclude, and -D
+//to override a value.
+#ifndef CONFIG_METRICS
+#define CONFIG_METRICS 1
+#endif
+
+#ifndef CONFIG_HTTP_LOG_LEVEL
+#define CONFIG_HTTP_LOG_LEVEL 2
+#endif
@@ -0,0 +1,266 @@
+// Host check of the streaming list scanner (include/json_item_scanner.h).
+//
+// Feeds the recorded playlist page of tools/payloads and a search response written to be hard
+// on the scanner, with escaped quotes and backslashes, brackets and "items" keys inside
+// strings, nested arrays and objects inside entries, and a "total" in a section as well as at
+// the top level. Each is fed whole, a byte at a time and split in two at every position. The
+// entries, their sections, the count and the total must equal those found by a recursive parse
+// of the complete text.
+//
+//     g++ -O2 -std=c++20 -Iinclude tools/json_item_scanner_check.cpp main/json_item_scanner.cpp -o json_item_scanner_check
+//     ./json_item_scanner_check [payload directory]
+#include "json_item_scanner.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using Entries = std::vector<std::pair<std::string, std::string>>;
+
+struct Expected {
+    Entries entries;
+    int64_t total;
+};
+
+static const char* search = R"({
+  "tracks": {
+    "href": "https://api.spotify.com/v1/search?q=a%22b",
+    "items": [
+      {"name": "Say \"items\": [ {", "artists": [{"name": "A\\"}, {"name": "}]"}], "markets": [["x", "y"], []]},
+      {"name": "plain", "album": {"images": [{"url": "u", "size": [640, 640]}]}, "items": [{"nested": true}]},
+      { }
+    ],
+    "total": 991
+  },
+  "albums": {"items": [], "total": 0},
+  "artists": {
+    "items": [
+      {"name": "\\\"", "genres": ["{", "[", "\"items\""]}
+    ],
+    "next": null
+  },
+  "total": 42
+})";
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if(!condition) {
+        printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+//A recursive parse of the complete text, which records what the scanner must hand out.
+class Reference {
+public:
+    explicit Reference(const std::string& text) : text(text), pos(0) {}
+
+    Expected parse() {
+        Expected expected = {{}, -1};
+        skip_space();
+        expect('{');
+
+        while(!next_is('}')) {
+            std::string key = read_string();
+            expect(':');
+            skip_space();
+
+            if(key == "items" && text[pos] == '[') {
+                read_items("", expected.entries);
+            }
+
+            else if(key == "total" && text[pos] != '"' && text[pos] != '{' && text[pos] != '[') {
+                size_t start = pos;
+                skip_value();
+                expected.total = std::stoll(text.substr(start, pos - start));
+            }
+
+            else if(text[pos] == '{') {
+                read_section(key, expected.entries);
+            }
+
+            else {
+                skip_value();
+            }
+
+            next_is(',');
+        }
+
+        return expected;
+    }
+
+private:
+    void read_section(const std::string& section, Entries& entries) {
+        expect('{');
+
+        while(!next_is('}')) {
+            std::string key = read_string();
+            expect(':');
+            skip_space();
+
+            if(key == "items" && text[pos] == '[') {
+                read_items(section, entries);
+            }
+
+            else {
+                skip_value();
+            }
+
+            next_is(',');
+        }
+    }
+
+    void read_items(const std::string& section, Entries& entries) {
+        expect('[');
+
+        while(!next_is(']')) {
+            skip_space();
+            size_t start = pos;
+            bool object = text[pos] == '{';
+            skip_value();
+
+            if(object) {
+                entries.emplace_back(section, text.substr(start, pos - start));
+            }
+
+            next_is(',');
+        }
+    }
+
+    void skip_value() {
+        skip_space();
+
+        if(text[pos] == '"') {
+            read_string();
+        }
+
+        else if(text[pos] == '{' || text[pos] == '[') {
+            char close = text[pos] == '{' ? '}' : ']';
+            pos++;
+
+            while(!next_is(close)) {
+                skip_value();
+                next_is(',') || next_is(':');
+            }
+        }
+
+        else {
+            while(pos < text.size() && std::string_view(",:}] \n\r\t").find(text[pos]) == std::string_view::npos) {
+                pos++;
+            }
+        }
+    }
+
+    std::string read_string() {
+        skip_space();
+        expect('"');
+        std::string out;
+
+        while(pos < text.size() && text[pos] != '"') {
+            if(text[pos] == '\\') {
+                pos++;
+            }
+
+            out.push_back(text[pos++]);
+        }
+
+        pos++;
+        return out;
+    }
+
+    bool next_is(char c) {
+        skip_space();
+
+        if(pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+
+        return false;
+    }
+
+    void expect(char c) {
+        if(!next_is(c)) {
+            printf("Reference parse expected '%c' at %zu\n", c, pos);
+            exit(1);
+        }
+    }
+
+    void skip_space() {
+        while(pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t')) {
+            pos++;
+        }
+    }
+
+    const std::string& text;
+    size_t pos;
+};
+
+static std::string load(const std::string& directory, const char* name) {
+    std::ifstream file(directory + "/" + name + ".json", std::ios::binary);
+    std::stringstream text;
+
+    if(!file) {
+        fprintf(stderr, "Missing payload %s/%s.json\n", directory.c_str(), name);
+        exit(1);
+    }
+
+    text << file.rdbuf();
+    return text.str();
+}
+
+//Feeds the text in the pieces given by the split points and compares with the reference.
+static bool scan(const std::string& text, const std::vector<size_t>& splits, const Expected& expected) {
+    Entries entries;
+    JsonItemScanner scanner([&entries](std::string_view section, std::string_view item) {
+        entries.emplace_back(section, item);
+    });
+    size_t start = 0;
+
+    for(size_t split : splits) {
+        scanner.feed(text.data() + start, split - start);
+        start = split;
+    }
+
+    scanner.feed(text.data() + start, text.size() - start);
+
+    return entries == expected.entries && scanner.getItemCount() == expected.entries.size() && scanner.getTotal() == expected.total;
+}
+
+static void run(const char* name, const std::string& text) {
+    Expected expected = Reference(text).parse();
+    std::vector<size_t> bytes;
+
+    for(size_t i = 1; i < text.size(); i++) {
+        bytes.push_back(i);
+    }
+
+    check(!expected.entries.empty(), std::string(name) + " has entries");
+    check(scan(text, {}, expected), std::string(name) + " fed whole");
+    check(scan(text, bytes, expected), std::string(name) + " fed a byte at a time");
+
+    for(size_t split = 1; split < text.size(); split++) {
+        if(!scan(text, {split}, expected)) {
+            check(false, std::string(name) + " split at " + std::to_string(split));
+            break;
+        }
+    }
+
+    printf("%-16s %6zu bytes, %3zu entries, total %lld, %zu split points\n", name, text.size(), expected.entries.size(),
+           static_cast<long long>(expected.total), text.size() - 1);
+}
+
+int main(int argc, char** argv) {
+    std::string directory = argc > 1 ? argv[1] : "tools/payloads";
+
+    run("playlist_tracks", load(directory, "playlist_tracks"));
+    run("search", search);
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,307 @@
+// Host benchmark of the library index (include/library_index.h).
+//
+// Builds the index of a synthetic library the way LibrarySync does: tracks with one to three
+// artists drawn from a few thousand, a tenth as many albums and a few hundred playlists, with
+// some accented and CJK names. Reports the file size, the build time, the time to merge an
+// incremental sync into the index, and the latency of prefix searches typed from the names
+// next to a scan of every item. Every search is checked against the scan.
+//
+//     g++ -O2 -std=c++20 -Iinclude tools/library_bench.cpp main/library_index.cpp -o library_bench
+//     ./library_bench [tracks...]
+#include "library_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Entry {
+    LibraryIndex::Kind kind;
+    std::string name;
+    std::vector<std::string> artists;
+    std::string id;
+};
+
+static constexpr size_t max_results = 15;
+static constexpr int queries = 5000;
+static constexpr int scan_queries = 200;
+
+static const char* syllables[] = {"ka", "lo", "mi", "ra", "su", "ne", "to", "vi", "an", "el", "or", "ty", "be", "da",
+                                  "fre", "gho", "la", "ver", "ston", "mo", "ri", "night", "sun", "blue", "star", "in"};
+static const char* accented[] = {"é", "á", "ö", "ñ", "ç", "ü"};
+static const char* cjk[] = {"夜", "空", "花", "雨", "心", "東", "京", "愛"};
+
+static std::string word(std::mt19937& rng) {
+    std::string out;
+    int count = 1 + rng() % 3;
+
+    for(int i = 0; i < count; i++) {
+        out += syllables[rng() % (sizeof(syllables) / sizeof(syllables[0]))];
+    }
+
+    //Some names are accented.
+    if(rng() % 20 == 0) {
+        out.insert(rng() % out.size(), accented[rng() % 6]);
+    }
+
+    out[0] = static_cast<char>(out[0] - 'a' + 'A');
+    return out;
+}
+
+static std::string name(std::mt19937& rng, int words) {
+    std::string out;
+
+    if(rng() % 30 == 0) {
+        for(int i = 0; i < 2 + static_cast<int>(rng() % 4); i++) {
+            out += cjk[rng() % 8];
+        }
+
+        return out;
+    }
+
+    for(int i = 0; i < words; i++) {
+        out += i > 0 ? (rng() % 10 == 0 ? " - " : " ") : "";
+        out += word(rng);
+    }
+
+    return out;
+}
+
+static std::string spotify_id(std::mt19937& rng) {
+    static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+    std::string out(22, '0');
+
+    for(char& c : out) {
+        c = digits[rng() % 62];
+    }
+
+    return out;
+}
+
+static std::vector<Entry> synthetic(size_t tracks, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> artists(std::max<size_t>(tracks / 8, 50));
+    std::vector<Entry> entries;
+
+    for(auto& artist : artists) {
+        artist = name(rng, 1 + rng() % 2);
+    }
+
+    //A few artists account for most of the tracks.
+    auto pick = [&] {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        return artists[static_cast<size_t>(u * u * u * artists.size())];
+    };
+
+    for(size_t i = 0; i < tracks; i++) {
+        Entry& entry = entries.emplace_back(Entry{LibraryIndex::Kind::Track, name(rng, 1 + rng() % 4), {}, spotify_id(rng)});
+
+        for(int j = rng() % 6 == 0 ? 1 + rng() % 2 : 0; j >= 0; j--) {
+            entry.artists.push_back(pick());
+        }
+    }
+
+    for(size_t i = 0; i < tracks / 10; i++) {
+        entries.push_back(Entry{LibraryIndex::Kind::Album, name(rng, 1 + rng() % 3), {pick()}, spotify_id(rng)});
+    }
+
+    for(size_t i = 0; i < 300; i++) {
+        entries.push_back(Entry{LibraryIndex::Kind::Playlist, name(rng, 1 + rng() % 3), {"user " + std::to_string(i % 7)}, spotify_id(rng)});
+    }
+
+    return entries;
+}
+
+static void add(LibraryIndexBuilder& builder, const Entry& entry) {
+    std::vector<std::string_view> artists(entry.artists.begin(), entry.artists.end());
+    builder.add(entry.kind, entry.name, artists, entry.id);
+}
+
+static std::string normalized(std::string_view text) {
+    char buffer[256];
+    return std::string(buffer, LibraryIndex::normalize(text, buffer, sizeof(buffer)));
+}
+
+//What the index should find: items whose name or one of whose artists starts with the query.
+static bool matches(const Entry& entry, std::string_view prefix) {
+    if(normalized(entry.name).substr(0, LibraryIndex::max_key).starts_with(prefix)) {
+        return true;
+    }
+
+    for(const auto& artist : entry.artists) {
+        if(normalized(artist).substr(0, LibraryIndex::max_key).starts_with(prefix)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool run(size_t tracks) {
+    std::vector<Entry> entries = synthetic(tracks, 1);
+    std::vector<Entry> fresh = synthetic(100, 2);
+    std::vector<uint8_t> file;
+    std::vector<uint8_t> merged;
+
+    //The sync adds the pages as they arrive, newest first.
+    auto start = std::chrono::steady_clock::now();
+    LibraryIndexBuilder builder;
+
+    for(const auto& entry : entries) {
+        add(builder, entry);
+    }
+
+    builder.build(file);
+    double build_ms = elapsed_us(start) / 1000;
+
+    LibraryIndex index;
+    start = std::chrono::steady_clock::now();
+
+    if(!index.open(file.data(), file.size())) {
+        printf("%zu tracks: index does not open\n", tracks);
+        return false;
+    }
+
+    double open_ms = elapsed_us(start) / 1000;
+
+    //An incremental sync: the new items, then those of the current index.
+    start = std::chrono::steady_clock::now();
+    LibraryIndexBuilder incremental;
+
+    for(const auto& entry : fresh) {
+        add(incremental, entry);
+    }
+
+    for(auto kind : {LibraryIndex::Kind::Track, LibraryIndex::Kind::Album, LibraryIndex::Kind::Playlist}) {
+        incremental.merge(index, kind);
+    }
+
+    incremental.build(merged);
+    double merge_ms = elapsed_us(start) / 1000;
+
+    LibraryIndex merged_index;
+    bool correct = merged_index.open(merged.data(), merged.size()) &&
+                   merged_index.getItemCount() == entries.size() + fresh.size();
+
+    //Queries typed from names: the first 1 to 8 characters of an item or artist.
+    std::mt19937 rng(3);
+    std::vector<std::string> typed;
+
+    for(int i = 0; i < queries; i++) {
+        const Entry& entry = entries[rng() % entries.size()];
+        const std::string& text = rng() % 3 == 0 ? entry.artists[0] : entry.name;
+        size_t length = std::min<size_t>(text.size(), 1 + rng() % 8);
+
+        while(length < text.size() && (static_cast<uint8_t>(text[length]) & 0xC0) == 0x80) {
+            length++;
+        }
+
+        typed.push_back(text.substr(0, length));
+    }
+
+    //Item ids are positions in name order, the entries are found by their Spotify ID.
+    std::unordered_map<std::string_view, const Entry*> by_id;
+
+    for(const auto& entry : entries) {
+        by_id[entry.id] = &entry;
+    }
+
+    std::vector<double> latencies;
+    std::vector<uint32_t> found(max_results);
+    LibraryIndex::Item item;
+    std::string detail;
+    size_t results = 0;
+
+    for(const auto& query : typed) {
+        start = std::chrono::steady_clock::now();
+        size_t count = index.search(query, found.data(), found.size());
+
+        //The results are shown, so their records are read as well.
+        for(size_t i = 0; i < count; i++) {
+            index.getItem(found[i], item);
+            index.getDetail(item, detail);
+        }
+
+        latencies.push_back(elapsed_us(start));
+        results += count;
+
+        std::string prefix = normalized(query).substr(0, LibraryIndex::max_key);
+
+        for(size_t i = 0; i < count; i++) {
+            index.getItem(found[i], item);
+            auto entry = by_id.find(item.id);
+            correct = correct && entry != by_id.end() && entry->second->name == item.name && matches(*entry->second, prefix);
+        }
+
+        //Fewer than asked for: every match was found.
+        if(count < max_results) {
+            size_t expected = std::count_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+                return matches(entry, prefix);
+            });
+
+            correct = correct && count == expected;
+        }
+    }
+
+    //Without the index, every name is normalized and compared.
+    start = std::chrono::steady_clock::now();
+    size_t scanned = 0;
+
+    for(int i = 0; i < scan_queries; i++) {
+        std::string prefix = normalized(typed[i]);
+        size_t count = 0;
+
+        for(size_t j = 0; j < entries.size() && count < max_results; j++) {
+            count += matches(entries[j], prefix);
+        }
+
+        scanned += count;
+    }
+
+    double scan_us = elapsed_us(start) / scan_queries;
+
+    std::sort(latencies.begin(), latencies.end());
+    double total_us = 0;
+
+    for(double latency : latencies) {
+        total_us += latency;
+    }
+
+    printf("%7zu %8u %7u %7.2f MB %5.1f B %8.1f ms %6.1f ms %7.1f ms %7.2f us %7.2f us %7.2f us %9.1f us %5.1f %s\n",
+           tracks, index.getItemCount(), index.getArtistCount(), file.size() / 1e6,
+           static_cast<double>(file.size()) / index.getItemCount(), build_ms, open_ms, merge_ms,
+           total_us / latencies.size(), latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+           scan_us, static_cast<double>(results) / typed.size(), correct && scanned > 0 ? "ok" : "MISMATCH");
+
+    return correct;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+
+    for(int i = 1; i < argc; i++) {
+        sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+
+    if(sizes.empty()) {
+        sizes = {1000, 10000, 30000, 60000};
+    }
+
+    printf("%7s %8s %7s %10s %7s %11s %9s %10s %10s %10s %10s %12s %5s\n", "tracks", "items", "artists",
+           "size", "/item", "build", "open", "merge", "search", "p50", "p99", "scan", "found");
+
+    bool correct = true;
+
+    for(size_t tracks : sizes) {
+        correct = run(tracks) && correct;
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Compare the HTTP request latency of two trace captures, e.g. with verbose logging on and off.
+
+Build with CONFIG_TRACE, capture the console once with the HTTP log level at 4 (debug) and
+once at 2 (warning), running the same actions, then pass both captures:
+
+    tools/log_latency.py verbose.log quiet.log
+
+The spans are the "HTTP request" events of the trace, see tools/trace_export.py.
+"""
+import argparse
+import statistics
+import sys
+
+from trace_export import BEGIN, END, SYNC, parse, timestamps
+
+SPAN = "HTTP request"
+
+
+def durations(capture, name):
+    """Returns the durations in microseconds of the spans called name."""
+    with open(capture, errors="replace") as lines:
+        mhz, ids, _tasks, records, dropped = parse(lines)
+
+    ids = {index for index, event in ids.items() if event == name}
+    result = []
+
+    for core, core_records in sorted(records.items()):
+        times = timestamps(core_records, mhz)
+        if times is None:
+            print(f"{capture}: core {core} has no sync records, skipped", file=sys.stderr)
+            continue
+
+        # Spans nest per task, a request never moves to the other core while it runs.
+        open_spans = {}
+        for ts, (_cycles, task, kind, event_id, _reserved, _value) in zip(times, core_records):
+            if kind == SYNC or event_id not in ids:
+                continue
+            if kind == BEGIN:
+                open_spans.setdefault(task, []).append(ts)
+            elif kind == END and open_spans.get(task):
+                result.append(ts - open_spans[task].pop())
+
+    if any(dropped.values()):
+        print(f"{capture}: events were dropped on the device, spans may be missing", file=sys.stderr)
+
+    return result
+
+
+def summary(values):
+    values = sorted(values)
+    p95 = values[min(len(values) - 1, int(len(values) * 0.95))]
+    return {"count": len(values), "mean": statistics.fmean(values), "median": statistics.median(values), "p95": p95}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("verbose", help="console capture with verbose logging")
+    parser.add_argument("quiet", help="console capture with logging reduced")
+    parser.add_argument("--span", default=SPAN, help=f"trace event to compare (default: {SPAN})")
+    args = parser.parse_args()
+
+    results = {}
+    for label, capture in (("verbose", args.verbose), ("quiet", args.quiet)):
+        spans = durations(capture, args.span)
+        if not spans:
+            print(f"{capture}: no \"{args.span}\" spans", file=sys.stderr)
+            return 1
+        results[label] = summary(spans)
+
+    print(f"{'':8} {'count':>6} {'mean ms':>9} {'median ms':>10} {'p95 ms':>8}")
+    for label, result in results.items():
+        print(f"{label:8} {result['count']:6} {result['mean'] / 1000:9.2f} {result['median'] / 1000:10.2f} "
+              f"{result['p95'] / 1000:8.2f}")
+
+    verbose, quiet = results["verbose"], results["quiet"]
+    print(f"logging costs {(verbose['median'] - quiet['median']) / 1000:.2f} ms per request at the median, "
+          f"{(verbose['p95'] - quiet['p95']) / 1000:.2f} ms at p95")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,327 @@
+// Host exporter and scrape test of the metrics registry (include/metrics.h).
+//
+// Feeds the registry the observations the firmware makes: requests to endpoints whose paths
+// carry IDs, failures, token refreshes, polls, frames, touches and power state changes. Then
+// scrapes it and checks the exposition against the Prometheus text format: metric and label
+// names, HELP and TYPE once per family and before its samples, no duplicate series, and
+// histograms whose buckets are cumulative up to +Inf, which equals their count. It also checks
+// the values: IDs folded out of paths, endpoints past the limit counted as "other", non-2xx
+// and failed requests counted as errors, and exactly one power state current.
+//
+// With --serve it keeps observing synthetic requests and serves /metrics on the port, so a
+// real Prometheus or promtool can scrape the same renderer the device uses.
+//
+//     g++ -O2 -std=c++20 -Iinclude -Itools/host tools/metrics_host.cpp main/metrics.cpp -o metrics_host
+//     ./metrics_host [--serve port]
+#include "metrics.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <regex>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+struct Sample {
+    std::string name;
+    std::string labels;     ///< The labels without le, the series of a histogram share them.
+    std::string le;         ///< The bucket bound, empty if the sample isn't a bucket.
+    double value;
+};
+
+static const std::regex sample_line(R"(([a-zA-Z_:][a-zA-Z0-9_:]*)(?:\{(.*)\})? (\S+))");
+static const std::regex label_pair(R"(([a-zA-Z_][a-zA-Z0-9_]*)="((?:[^"\\]|\\.)*)\"(,|$))");
+static const std::regex header_line(R"(# (HELP|TYPE) ([a-zA-Z_:][a-zA-Z0-9_:]*) (.+))");
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what) {
+    if(!condition) {
+        printf("FAIL %s\n", what.c_str());
+        failures++;
+    }
+}
+
+static void observe(std::mt19937& rng) {
+    static const char* playlists[] = {"37i9dQZF1DXcBWIGoYBM5M", "0vvXsWCC9xrXsKd4FyS8kM", "3cEYpjA9oz9GiPac4AsH4n"};
+    std::exponential_distribution<double> latency(1 / 150000.0);
+
+    metrics::observeRequest("GET", "https://api.spotify.com/v1/me/player/currently-playing?additional_types=episode",
+                            200, static_cast<int64_t>(latency(rng)));
+    metrics::observeRequest("GET", std::string("https://api.spotify.com/v1/playlists/") + playlists[rng() % 3] + "/tracks?offset=0&limit=50",
+                            rng() % 10 == 0 ? 429 : 200, static_cast<int64_t>(latency(rng)));
+    metrics::observeRequest("PUT", "https://api.spotify.com/v1/me/player/pause", rng() % 20 == 0 ? -1 : 204,
+                            static_cast<int64_t>(latency(rng)));
+    metrics::observePollInterval(950000 + rng() % 100000);
+    metrics::observeFrame(2000 + rng() % 20000);
+    metrics::observeFlush(1000 + rng() % 5000, 480 * 32);
+    metrics::observeTouchLatency(5000 + rng() % 30000);
+}
+
+static bool parse_labels(const std::string& text, std::string& labels, std::string& le) {
+    auto it = std::sregex_iterator(text.begin(), text.end(), label_pair);
+    size_t consumed = 0;
+
+    for(; it != std::sregex_iterator(); ++it) {
+        if(static_cast<size_t>(it->position()) != consumed) {
+            return false;
+        }
+
+        consumed += it->length();
+
+        if((*it)[1] == "le") {
+            le = (*it)[2];
+        }
+
+        //Every pair ends in a comma here, so the last one compares equal to the others.
+        else {
+            labels += (*it)[1].str() + "=\"" + (*it)[2].str() + "\",";
+        }
+    }
+
+    return consumed == text.size();
+}
+
+static std::string family_of(const std::string& name, const std::map<std::string, std::string>& types) {
+    for(const char* suffix : {"_bucket", "_sum", "_count"}) {
+        size_t len = strlen(suffix);
+
+        if(name.size() > len && name.compare(name.size() - len, len, suffix) == 0) {
+            std::string base = name.substr(0, name.size() - len);
+            auto type = types.find(base);
+
+            if(type != types.end() && type->second == "histogram") {
+                return base;
+            }
+        }
+    }
+
+    return name;
+}
+
+static std::vector<Sample> scrape_and_check(const std::string& exposition) {
+    std::map<std::string, std::string> types;
+    std::set<std::string> helps;
+    std::set<std::string> series;
+    std::vector<Sample> samples;
+    size_t start = 0;
+
+    check(!exposition.empty() && exposition.back() == '\n', "exposition ends with a newline");
+
+    while(start < exposition.size()) {
+        size_t end = exposition.find('\n', start);
+        std::string line = exposition.substr(start, end - start);
+        start = end == std::string::npos ? exposition.size() : end + 1;
+        std::smatch match;
+
+        if(line.empty()) {
+            continue;
+        }
+
+        if(line[0] == '#') {
+            if(!std::regex_match(line, match, header_line)) {
+                check(false, "malformed comment: " + line);
+                continue;
+            }
+
+            if(match[1] == "HELP") {
+                check(helps.insert(match[2]).second, "HELP once for " + match[2].str());
+            }
+
+            else {
+                static const std::set<std::string> known = {"counter", "gauge", "histogram", "summary", "untyped"};
+                check(known.count(match[3]) == 1, "known type for " + match[2].str());
+                check(types.emplace(match[2], match[3]).second, "TYPE once for " + match[2].str());
+            }
+
+            continue;
+        }
+
+        if(!std::regex_match(line, match, sample_line)) {
+            check(false, "malformed sample: " + line);
+            continue;
+        }
+
+        Sample sample{match[1], "", "", 0};
+        check(parse_labels(match[2], sample.labels, sample.le), "well-formed labels: " + line);
+
+        char* value_end = nullptr;
+        sample.value = strtod(match[3].str().c_str(), &value_end);
+        check(*value_end == '\0', "numeric value: " + line);
+
+        std::string family = family_of(sample.name, types);
+        check(types.count(family) == 1, "TYPE before the samples of " + family);
+        check(series.insert(sample.name + "{" + sample.labels + "le=" + sample.le + "}").second, "unique series: " + line);
+
+        samples.push_back(sample);
+    }
+
+    //Histograms: per series the buckets rise with their bounds and end in +Inf, which equals the count.
+    for(const auto& [family, type] : types) {
+        if(type != "histogram") {
+            continue;
+        }
+
+        std::map<std::string, std::vector<const Sample*>> buckets;
+        std::map<std::string, double> counts;
+
+        for(const auto& sample : samples) {
+            if(sample.name == family + "_bucket") {
+                buckets[sample.labels].push_back(&sample);
+            }
+
+            else if(sample.name == family + "_count") {
+                counts[sample.labels] = sample.value;
+            }
+        }
+
+        for(const auto& [labels, series_buckets] : buckets) {
+            std::string where = family + "{" + labels + "}";
+            double last_le = -1;
+            double last_value = 0;
+
+            for(const Sample* bucket : series_buckets) {
+                double le = bucket->le == "+Inf" ? INFINITY : strtod(bucket->le.c_str(), nullptr);
+                check(le > last_le, "bounds rise in " + where);
+                check(bucket->value >= last_value, "cumulative buckets in " + where);
+                last_le = le;
+                last_value = bucket->value;
+            }
+
+            check(series_buckets.back()->le == "+Inf", "+Inf bucket last in " + where);
+            check(counts.count(labels) == 1 && counts[labels] == last_value, "+Inf equals the count in " + where);
+        }
+    }
+
+    return samples;
+}
+
+static double value_of(const std::vector<Sample>& samples, const std::string& name, const std::string& labels) {
+    for(const auto& sample : samples) {
+        if(sample.name == name && sample.labels == labels && sample.le.empty()) {
+            return sample.value;
+        }
+    }
+
+    return -1;
+}
+
+static int run_checks() {
+    std::mt19937 rng(7);
+
+    metrics::observePowerState("active");
+
+    for(int i = 0; i < 200; i++) {
+        observe(rng);
+    }
+
+    metrics::observeRequest("POST", "https://accounts.spotify.com/api/token", 200, 120000);
+    metrics::countTokenRefresh(true);
+    metrics::countTokenRefresh(false);
+    metrics::observePowerState("dim");
+    metrics::observePowerState("blank");
+    metrics::observeWakeLatency(80000);
+    metrics::observePowerState("active");
+
+    //More endpoints than the registry keeps, the rest go to "other".
+    for(int i = 0; i < 40; i++) {
+        metrics::observeRequest("GET", "https://api.spotify.com/v1/endpoint" + std::to_string(i), 200, 1000);
+    }
+
+    std::string exposition;
+    auto start = std::chrono::steady_clock::now();
+    metrics::render(exposition);
+    metrics::renderGauge(exposition, "spotify_heap_free_bytes", "Free heap.", "region=\"internal\"", 123456);
+    auto render_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<Sample> samples = scrape_and_check(exposition);
+
+    std::string playlist = "method=\"GET\",endpoint=\"/v1/playlists/{id}/tracks\",";
+    std::string pause = "method=\"PUT\",endpoint=\"/v1/me/player/pause\",";
+
+    check(value_of(samples, "spotify_http_request_duration_seconds_count", playlist) == 200, "playlist IDs folded into one endpoint");
+    check(value_of(samples, "spotify_http_request_errors_total", playlist) > 0, "429 counted as an error");
+    check(value_of(samples, "spotify_http_request_errors_total", pause) > 0, "failed requests counted as errors");
+    check(value_of(samples, "spotify_http_request_errors_total", pause) < 200, "204 not counted as an error");
+    check(value_of(samples, "spotify_http_request_duration_seconds_count", "method=\"GET\",endpoint=\"other\",") > 0,
+          "endpoints past the limit counted as other");
+    check(value_of(samples, "spotify_token_refreshes_total", "result=\"success\",") == 1, "successful refresh counted");
+    check(value_of(samples, "spotify_token_refreshes_total", "result=\"failure\",") == 1, "failed refresh counted");
+    check(value_of(samples, "spotify_power_state_entries_total", "state=\"active\",") == 2, "power state entries");
+    check(value_of(samples, "spotify_power_state", "state=\"active\",") == 1 && value_of(samples, "spotify_power_state", "state=\"blank\",") == 0,
+          "one power state current");
+    check(value_of(samples, "spotify_heap_free_bytes", "region=\"internal\",") == 123456, "gauge rendered");
+
+    printf("%zu samples, %zu bytes rendered in %.0f us, %d failures\n", samples.size(), exposition.size(), render_us, failures);
+
+    return failures == 0 ? 0 : 1;
+}
+
+static int serve(int port) {
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if(bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 4) != 0) {
+        perror("listen");
+        return 1;
+    }
+
+    std::thread([] {
+        std::mt19937 rng(1);
+        metrics::observePowerState("active");
+
+        while(true) {
+            observe(rng);
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }).detach();
+
+    printf("Serving http://localhost:%d/metrics\n", port);
+
+    while(true) {
+        int client = accept(server, nullptr, nullptr);
+
+        if(client < 0) {
+            continue;
+        }
+
+        char request[1024];
+        ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+        request[received > 0 ? received : 0] = '\0';
+
+        std::string body;
+        std::string status = "404 Not Found";
+
+        if(strncmp(request, "GET /metrics ", 13) == 0) {
+            metrics::render(body);
+            status = "200 OK";
+        }
+
+        std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        send(client, response.data(), response.size(), 0);
+        close(client);
+    }
+}
+
+int main(int argc, char** argv) {
+    if(argc == 3 && strcmp(argv[1], "--serve") == 0) {
+        return serve(atoi(argv[2]));
+    }
+
+    return run_checks();
+}
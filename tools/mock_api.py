@@ -0,0 +1,278 @@
+#!/usr/bin/env python3
+"""Local mock of the Spotify Web API endpoints used by the controller.
+
+Serves a synthetic playlist (10 000 tracks by default) with limit/offset paging,
+batched track lookups, a short queue, a list of devices and a currently playing track whose
+context is that playlist.
+Player commands (next, previous, play, pause, seek, volume, shuffle, repeat) change the
+simulated player and are answered with 204. /v1/search matches tracks, albums and playlists
+by substring; --search-delay-ms and --search-item-ms make it answer like a real backend over a
+slow link, so results arriving one by one can be observed. The first --saved tracks of the
+playlist, every twelfth album and the 50 playlists are the saved library (/v1/me/tracks,
+/v1/me/albums, /v1/me/playlists), track and album n saved n hours after 2024-01-01, so
+restarting with a larger --saved adds newly saved items for the library sync to pick up.
+
+Set `API URL` in the Spotify Configuration menu to http://<host>:<port> to use it.
+"""
+import argparse
+import json
+import re
+import threading
+import time
+from datetime import datetime, timedelta
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+PLAYLIST_ID = "mock"
+
+
+def make_track(index):
+    return {
+        "name": f"Track {index:05d}",
+        "id": f"mock{index:018d}",
+        "uri": f"spotify:track:mock{index:018d}",
+        "duration_ms": 180000 + (index % 120) * 1000,
+        "album": {"name": f"Album {index // 12:04d}", "images": []},
+        "artists": [{"name": f"Artist {index % 97:02d}"}],
+    }
+
+
+def make_album(index):
+    return {
+        "name": f"Album {index:04d}",
+        "id": f"mock{index:018d}",
+        "uri": f"spotify:album:mock{index:018d}",
+        "artists": [{"name": f"Artist {index * 12 % 97:02d}"}],
+        "images": [],
+    }
+
+
+def make_playlist(index):
+    if index == 0:
+        return {"name": "Mock playlist", "id": PLAYLIST_ID, "uri": f"spotify:playlist:{PLAYLIST_ID}",
+                "owner": {"display_name": "mock"}}
+    return {"name": f"Mix {index:02d}", "id": f"mix{index:02d}", "uri": f"spotify:playlist:mix{index:02d}",
+            "owner": {"display_name": "mock"}}
+
+
+def saved(kind, count, offset, limit):
+    """Page of /v1/me/tracks or /v1/me/albums: item n was saved n hours after 2024-01-01, newest first."""
+    make = make_track if kind == "track" else make_album
+    first = count - 1 - offset
+    items = [{"added_at": (datetime(2024, 1, 1) + timedelta(hours=n)).strftime("%Y-%m-%dT%H:%M:%SZ"), kind: make(n)}
+             for n in range(first, max(first - limit, -1), -1)]
+    return {"href": f"/v1/me/{kind}s", "total": count, "offset": offset, "limit": limit, "items": items}
+
+
+def search(query, types, limit, offset, total):
+    """Search response with one section per requested type, like /v1/search."""
+    q = query.lower()
+
+    def section(kind, count, make, text):
+        matches = [i for i in range(count) if q in text(i)]
+        return {"href": f"/v1/search?q={query}&type={kind}", "limit": limit, "offset": offset,
+                "total": len(matches), "next": None, "previous": None,
+                "items": [make(i) for i in matches[offset:offset + limit]]}
+
+    body = {}
+    if "track" in types:
+        body["tracks"] = section("track", total, make_track,
+                                 lambda i: f"track {i:05d} artist {i % 97:02d} album {i // 12:04d}")
+    if "album" in types:
+        body["albums"] = section("album", total // 12 + 1, make_album,
+                                 lambda i: f"album {i:04d} artist {i * 12 % 97:02d}")
+    if "playlist" in types:
+        body["playlists"] = section("playlist", 50, make_playlist,
+                                    lambda i: make_playlist(i)["name"].lower())
+    return body
+
+
+class Player:
+    """Simulated player, shared by all request handlers."""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.index = 0
+        self.playing = True
+        self.position_ms = 1000
+        self.position_time = time.monotonic()
+        self.shuffle = False
+        self.repeat = "off"
+        self.volume = 50
+
+    def progress_ms(self):
+        if not self.playing:
+            return self.position_ms
+        return self.position_ms + int((time.monotonic() - self.position_time) * 1000)
+
+    def seek(self, position_ms):
+        self.position_ms = position_ms
+        self.position_time = time.monotonic()
+
+    def state(self):
+        with self.lock:
+            return {"device": {"volume_percent": self.volume},
+                    "shuffle_state": self.shuffle,
+                    "repeat_state": self.repeat,
+                    "progress_ms": self.progress_ms(),
+                    "is_playing": self.playing,
+                    "currently_playing_type": "track",
+                    "context": {"uri": f"spotify:playlist:{PLAYLIST_ID}"},
+                    "item": make_track(self.index)}
+
+    def command(self, path, query, total):
+        with self.lock:
+            if path == "/v1/me/player/next":
+                self.index = (self.index + 1) % total
+                self.seek(0)
+            elif path == "/v1/me/player/previous":
+                self.index = (self.index - 1) % total
+                self.seek(0)
+            elif path == "/v1/me/player/play":
+                self.seek(self.progress_ms())
+                self.playing = True
+            elif path == "/v1/me/player/pause":
+                self.seek(self.progress_ms())
+                self.playing = False
+            elif path == "/v1/me/player/seek":
+                self.seek(int(query.get("position_ms", ["0"])[0]))
+            elif path == "/v1/me/player/volume":
+                self.volume = int(query.get("volume_percent", ["0"])[0])
+            elif path == "/v1/me/player/shuffle":
+                self.shuffle = query.get("state", ["false"])[0] == "true"
+            elif path == "/v1/me/player/repeat":
+                self.repeat = query.get("state", ["off"])[0]
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    total = 10000
+    saved = 2000
+    player = Player()
+    requests = 0
+    searches = 0
+    searches_aborted = 0
+    search_delay = 0.0
+    search_item_delay = 0.0
+
+    def send_json(self, obj, status=200, pieces=1, piece_delay=0.0):
+        body = json.dumps(obj, separators=(",", ":")).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        # The body is paced in equal pieces to model a slow link.
+        step = -(-len(body) // pieces)
+        for start in range(0, len(body), step):
+            if start:
+                time.sleep(piece_delay)
+            self.wfile.write(body[start:start + step])
+            self.wfile.flush()
+
+    def send_empty(self, status=204):
+        self.send_response(status)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, format, *args):
+        if self.server.verbose:
+            super().log_message(format, *args)
+
+    def do_GET(self):
+        Handler.requests += 1
+        url = urlparse(self.path)
+        query = parse_qs(url.query)
+
+        match = re.fullmatch(r"/v1/playlists/([^/]+)/tracks", url.path)
+        if match:
+            offset = int(query.get("offset", ["0"])[0])
+            limit = min(int(query.get("limit", ["100"])[0]), 100)
+            end = min(offset + limit, self.total)
+            items = [{"track": make_track(i)} for i in range(offset, end)]
+            self.send_json({"total": self.total, "offset": offset, "limit": limit, "items": items})
+        elif url.path == "/v1/tracks":
+            ids = query.get("ids", [""])[0].split(",")[:50]
+            self.send_json({"tracks": [make_track(int(i[4:])) if i.startswith("mock") else None
+                                       for i in ids]})
+        elif url.path in ("/v1/me/tracks", "/v1/me/albums"):
+            offset = int(query.get("offset", ["0"])[0])
+            limit = min(int(query.get("limit", ["20"])[0]), 50)
+            if url.path == "/v1/me/tracks":
+                self.send_json(saved("track", min(self.saved, self.total), offset, limit))
+            else:
+                self.send_json(saved("album", min(self.saved, self.total) // 12, offset, limit))
+        elif url.path == "/v1/me/playlists":
+            offset = int(query.get("offset", ["0"])[0])
+            limit = min(int(query.get("limit", ["20"])[0]), 50)
+            self.send_json({"href": "/v1/me/playlists", "total": 50, "offset": offset, "limit": limit,
+                            "items": [make_playlist(i) for i in range(offset, min(offset + limit, 50))]})
+        elif url.path == "/v1/me/player/queue":
+            index = self.player.index
+            self.send_json({"currently_playing": make_track(index),
+                            "queue": [make_track((index + i) % self.total) for i in range(1, 21)]})
+        elif url.path == "/v1/me/player/currently-playing":
+            state = self.player.state()
+            self.send_json({key: state[key] for key in ("progress_ms", "is_playing", "currently_playing_type",
+                                                        "context", "item")})
+        elif url.path == "/v1/me/player/devices":
+            self.send_json({"devices": [
+                {"id": "mock-speaker", "is_active": True, "is_private_session": False, "is_restricted": False,
+                 "name": "Mock speaker", "type": "Speaker", "volume_percent": self.player.volume,
+                 "supports_volume": True},
+                {"id": "mock-phone", "is_active": False, "is_private_session": False, "is_restricted": False,
+                 "name": "Mock phone", "type": "Smartphone", "volume_percent": 100, "supports_volume": True},
+            ]})
+        elif url.path == "/v1/me/player":
+            self.send_json(self.player.state())
+        elif url.path == "/v1/search":
+            Handler.searches += 1
+            limit = min(int(query.get("limit", ["20"])[0]), 50)
+            offset = int(query.get("offset", ["0"])[0])
+            body = search(query.get("q", [""])[0], query.get("type", ["track"])[0].split(","),
+                          limit, offset, self.total)
+            time.sleep(self.search_delay)
+            items = sum(len(section["items"]) for section in body.values())
+            try:
+                self.send_json(body, pieces=max(items, 1), piece_delay=self.search_item_delay)
+            except (BrokenPipeError, ConnectionResetError):
+                # The client gave up on the search, e.g. because the query changed.
+                Handler.searches_aborted += 1
+                self.close_connection = True
+        else:
+            self.send_json({"error": {"status": 404, "message": "Not found"}}, 404)
+
+    def do_PUT(self):
+        self.do_POST()
+
+    def do_POST(self):
+        Handler.requests += 1
+        length = int(self.headers.get("Content-Length", 0))
+        self.rfile.read(length)
+        url = urlparse(self.path)
+        self.player.command(url.path, parse_qs(url.query), self.total)
+        self.send_empty()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--tracks", type=int, default=10000, help="number of tracks in the playlist")
+    parser.add_argument("--saved", type=int, default=2000, help="number of saved tracks")
+    parser.add_argument("--quiet", action="store_true", help="don't log every request")
+    parser.add_argument("--search-delay-ms", type=float, default=0, help="time before a search is answered")
+    parser.add_argument("--search-item-ms", type=float, default=0, help="time between the results of a search")
+    args = parser.parse_args()
+
+    Handler.total = args.tracks
+    Handler.saved = args.saved
+    Handler.search_delay = args.search_delay_ms / 1000
+    Handler.search_item_delay = args.search_item_ms / 1000
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.verbose = not args.quiet
+    print(f"Serving mock API on http://{args.host}:{args.port}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,185 @@
+// Host benchmark of the album art palette extraction (include/palette.h).
+//
+// Feeds 160x160 RGB565 images to PaletteExtractor the way AlbumArt does, every other pixel of
+// every other row, and reports the time per image next to a full-resolution 64K-bin histogram.
+// Without arguments it uses synthetic covers; binary PPM files (P6) can be given instead, e.g.
+// covers converted with `convert cover.jpg -resize 160x160 cover.ppm`.
+//
+//     g++ -O2 -std=c++20 -Iinclude tools/palette_bench.cpp main/palette.cpp -o palette_bench
+//     ./palette_bench [cover.ppm...]
+#include "palette.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Image {
+    std::string name;
+    int width;
+    int height;
+    std::vector<uint16_t> pixels;
+};
+
+static constexpr int size = 160;
+static constexpr int step = 2;
+static constexpr int rounds = 200;
+
+static uint16_t rgb565(int r, int g, int b) {
+    r = std::clamp(r, 0, 255);
+    g = std::clamp(g, 0, 255);
+    b = std::clamp(b, 0, 255);
+    return (r & 0xF8) << 8 | (g & 0xFC) << 3 | b >> 3;
+}
+
+static Image synthetic(const std::string& name, int kind) {
+    Image image{name, size, size, std::vector<uint16_t>(size * size)};
+    std::mt19937 rng(kind);
+    std::normal_distribution<float> noise(0, 12);
+
+    for(int y = 0; y < size; y++) {
+        for(int x = 0; x < size; x++) {
+            int r, g, b;
+
+            if(kind == 0) {
+                //Flat background with a centered disc, like a logo cover.
+                bool disc = (x - 80) * (x - 80) + (y - 80) * (y - 80) < 45 * 45;
+                r = disc ? 230 : 20, g = disc ? 60 : 30, b = disc ? 40 : 70;
+            }
+
+            else if(kind == 1) {
+                //Diagonal gradient, every pixel different.
+                r = x * 255 / size, g = y * 255 / size, b = 255 - (x + y) * 255 / (2 * size);
+            }
+
+            else if(kind == 2) {
+                //Photo-like: two noisy regions and a bright band.
+                bool sky = y < 70;
+                bool band = y > 100 && y < 115;
+                r = band ? 250 : sky ? 120 : 60;
+                g = band ? 200 : sky ? 170 : 90;
+                b = band ? 60 : sky ? 220 : 40;
+                r += noise(rng), g += noise(rng), b += noise(rng);
+            }
+
+            else {
+                //Uniform noise, the worst case for the tree.
+                r = rng() & 0xFF, g = rng() & 0xFF, b = rng() & 0xFF;
+            }
+
+            image.pixels[y * size + x] = rgb565(r, g, b);
+        }
+    }
+
+    return image;
+}
+
+static bool read_ppm(const std::string& path, Image& image) {
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int max_value;
+
+    if(!(file >> magic >> image.width >> image.height >> max_value) || magic != "P6" || max_value != 255) {
+        return false;
+    }
+
+    file.get();
+    std::vector<uint8_t> rgb(image.width * image.height * 3);
+
+    if(!file.read(reinterpret_cast<char*>(rgb.data()), rgb.size())) {
+        return false;
+    }
+
+    image.name = path;
+    image.pixels.resize(image.width * image.height);
+
+    for(size_t i = 0; i < image.pixels.size(); i++) {
+        image.pixels[i] = rgb565(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+    }
+
+    return true;
+}
+
+template<typename F>
+static double time_us(F f) {
+    auto start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < rounds; i++) {
+        f();
+    }
+
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    std::vector<Image> images;
+
+    for(int i = 1; i < argc; i++) {
+        Image image;
+
+        if(!read_ppm(argv[i], image)) {
+            fprintf(stderr, "%s: not a binary PPM\n", argv[i]);
+            return 1;
+        }
+
+        images.push_back(std::move(image));
+    }
+
+    if(images.empty()) {
+        images = {synthetic("logo", 0), synthetic("gradient", 1), synthetic("photo", 2), synthetic("noise", 3)};
+    }
+
+    static PaletteExtractor extractor;
+    static std::vector<uint32_t> histogram(65536);
+    volatile uint32_t sink = 0;
+
+    printf("%-12s %10s %10s %10s %10s  %-8s %-8s %-8s %s\n", "image", "sampled", "every px", "histogram",
+           "reductions", "bg", "text", "accent", "dominant");
+
+    for(const Image& image : images) {
+        Palette palette = {};
+
+        double sampled_us = time_us([&] {
+            extractor.reset();
+
+            for(int y = 0; y < image.height; y += step) {
+                extractor.addRow(&image.pixels[y * image.width], image.width, step);
+            }
+
+            palette = extractor.finish();
+        });
+
+        uint32_t reductions = extractor.getStats().reductions;
+
+        double full_us = time_us([&] {
+            extractor.reset();
+            extractor.addRow(image.pixels.data(), image.pixels.size());
+            sink = sink + extractor.finish().background;
+        });
+
+        double histogram_us = time_us([&] {
+            std::fill(histogram.begin(), histogram.end(), 0);
+
+            for(uint16_t pixel : image.pixels) {
+                histogram[pixel]++;
+            }
+
+            sink = sink + (std::max_element(histogram.begin(), histogram.end()) - histogram.begin());
+        });
+
+        printf("%-12s %7.1f us %7.1f us %7.1f us %10u  %06x   %06x   %06x  ", image.name.c_str(), sampled_us, full_us,
+               histogram_us, reductions, palette.background, palette.text, palette.accent);
+
+        for(size_t i = 0; i < palette.dominant_count; i++) {
+            printf(" %06x", palette.dominant[i]);
+        }
+
+        printf("  (contrast %.1f, %.1f, %.1f)\n", PaletteExtractor::contrast(palette.background, palette.text),
+               PaletteExtractor::contrast(palette.background, palette.secondary),
+               PaletteExtractor::contrast(palette.background, palette.accent));
+    }
+
+    return 0;
+}
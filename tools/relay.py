@@ -0,0 +1,373 @@
+#!/usr/bin/env python3
+"""LAN relay pushing the Spotify player state to the controllers over WebSockets.
+
+The relay polls GET /v1/me/player once per interval for all controllers and sends each
+of them a binary snapshot on connect and a delta whenever something changes. Enable
+`Receive player updates from a LAN relay` in the Spotify Configuration menu and set
+`Relay URL` to ws://<host>:<port>/ to use it.
+
+Message format (little-endian), see include/relay_client.h:
+
+    u8 version | u8 type (0 snapshot, 1 delta) | u32 sequence | u16 field mask | fields
+
+Without credentials the relay sends no Authorization header, which suits tools/mock_api.py.
+Credentials are read from --client-id/--client-secret/--refresh-token or the
+SPOTIFY_CLIENT_ID, SPOTIFY_CLIENT_SECRET and SPOTIFY_REFRESH_TOKEN environment variables.
+"""
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import os
+import struct
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+VERSION = 1
+SNAPSHOT, DELTA = 0, 1
+
+# Field order defines the bit positions and the order in the message.
+FIELDS = ["uri", "name", "album_name", "album_pic_url", "artists", "context_uri",
+          "duration_ms", "progress_ms", "playing", "shuffle", "repeat", "volume"]
+BIT = {name: 1 << index for index, name in enumerate(FIELDS)}
+REPEAT = {"off": 0, "track": 1, "context": 2}
+
+# A reported progress further than this from the extrapolated one is a seek.
+PROGRESS_TOLERANCE_MS = 1500
+
+WS_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+
+def _str8(value):
+    data = value.encode()[:255]
+    return struct.pack("<B", len(data)) + data
+
+
+def _str16(value):
+    data = value.encode()[:65535]
+    return struct.pack("<H", len(data)) + data
+
+
+def encode(kind, sequence, state, fields):
+    """Encodes the given fields of a state."""
+    mask = 0
+    body = b""
+    for name in FIELDS:
+        if name not in fields:
+            continue
+        mask |= BIT[name]
+        value = state[name]
+        if name == "album_pic_url":
+            body += _str16(value)
+        elif name == "artists":
+            body += struct.pack("<B", min(len(value), 255)) + b"".join(_str8(a) for a in value[:255])
+        elif name in ("duration_ms", "progress_ms"):
+            body += struct.pack("<I", max(0, value))
+        elif name in ("playing", "shuffle", "repeat", "volume"):
+            body += struct.pack("<B", value)
+        else:
+            body += _str8(value)
+    return struct.pack("<BBIH", VERSION, kind, sequence, mask) + body
+
+
+def decode(message, state=None):
+    """Applies a message to a state dict, the reference for the firmware's decoder."""
+    version, kind, sequence, mask = struct.unpack_from("<BBIH", message)
+    if version != VERSION:
+        raise ValueError(f"unsupported version {version}")
+    state = {} if kind == SNAPSHOT or state is None else dict(state)
+    pos = 8
+
+    def read(fmt):
+        nonlocal pos
+        value, = struct.unpack_from(fmt, message, pos)
+        pos += struct.calcsize(fmt)
+        return value
+
+    def string(fmt):
+        nonlocal pos
+        length = read(fmt)
+        value = message[pos:pos + length].decode()
+        pos += length
+        return value
+
+    for name in FIELDS:
+        if not mask & BIT[name]:
+            continue
+        if name == "album_pic_url":
+            state[name] = string("<H")
+        elif name == "artists":
+            state[name] = [string("<B") for _ in range(read("<B"))]
+        elif name in ("duration_ms", "progress_ms"):
+            state[name] = read("<I")
+        elif name in ("playing", "shuffle", "repeat", "volume"):
+            state[name] = read("<B")
+        else:
+            state[name] = string("<B")
+    return kind, sequence, state
+
+
+def state_from_player(player):
+    """Maps a /v1/me/player response to the relayed fields."""
+    item = player.get("item") or {}
+    album = item.get("album") or {}
+    images = album.get("images") or []
+    context = player.get("context") or {}
+    device = player.get("device") or {}
+    return {
+        "uri": item.get("uri") or "",
+        "name": item.get("name") or "",
+        "album_name": album.get("name") or "",
+        "album_pic_url": images[1]["url"] if len(images) > 1 else "",
+        "artists": [a.get("name") or "" for a in item.get("artists") or []],
+        "context_uri": context.get("uri") or "",
+        "duration_ms": int(item.get("duration_ms") or 0),
+        "progress_ms": int(player.get("progress_ms") or 0),
+        "playing": 1 if player.get("is_playing") else 0,
+        "shuffle": 1 if player.get("shuffle_state") else 0,
+        "repeat": REPEAT.get(player.get("repeat_state"), 0),
+        "volume": int(device.get("volume_percent") or 0),
+    }
+
+
+def changed_fields(old, new, elapsed_ms):
+    """Fields of new that differ from old. Progress only counts when it jumps."""
+    if old is None:
+        return set(FIELDS)
+    fields = {name for name in FIELDS if name != "progress_ms" and old[name] != new[name]}
+    expected = old["progress_ms"] + (elapsed_ms if old["playing"] else 0)
+    if "uri" in fields or "playing" in fields or abs(new["progress_ms"] - expected) > PROGRESS_TOLERANCE_MS:
+        fields.add("progress_ms")
+    return fields
+
+
+class WebSocket:
+    """Just enough of RFC 6455 for binary pushes and short text requests."""
+
+    def __init__(self, reader, writer, mask):
+        self.reader = reader
+        self.writer = writer
+        self.mask = mask
+
+    async def send(self, data, opcode=0x2):
+        header = bytes([0x80 | opcode])
+        length = len(data)
+        mask_bit = 0x80 if self.mask else 0
+        if length < 126:
+            header += bytes([mask_bit | length])
+        elif length < 65536:
+            header += bytes([mask_bit | 126]) + struct.pack(">H", length)
+        else:
+            header += bytes([mask_bit | 127]) + struct.pack(">Q", length)
+        if self.mask:
+            key = os.urandom(4)
+            data = bytes(b ^ key[i % 4] for i, b in enumerate(data))
+            header += key
+        self.writer.write(header + data)
+        await self.writer.drain()
+
+    async def recv(self):
+        """Returns (opcode, payload) of the next complete message, answering pings on the way."""
+        message = b""
+        opcode = None
+        while True:
+            first, second = await self.reader.readexactly(2)
+            length = second & 0x7F
+            if length == 126:
+                length, = struct.unpack(">H", await self.reader.readexactly(2))
+            elif length == 127:
+                length, = struct.unpack(">Q", await self.reader.readexactly(8))
+            key = await self.reader.readexactly(4) if second & 0x80 else None
+            payload = await self.reader.readexactly(length)
+            if key:
+                payload = bytes(b ^ key[i % 4] for i, b in enumerate(payload))
+            frame_opcode = first & 0x0F
+            if frame_opcode == 0x9:
+                await self.send(payload, 0xA)
+                continue
+            if frame_opcode == 0xA:
+                continue
+            if frame_opcode != 0x0:
+                opcode = frame_opcode
+            message += payload
+            if first & 0x80:
+                return opcode, message
+
+    def close(self):
+        self.writer.close()
+
+
+async def accept(reader, writer):
+    """Completes the server side of the opening handshake."""
+    headers = {}
+    request = (await reader.readuntil(b"\r\n\r\n")).decode(errors="replace").split("\r\n")
+    for line in request[1:]:
+        if ":" in line:
+            key, value = line.split(":", 1)
+            headers[key.strip().lower()] = value.strip()
+    accept_key = base64.b64encode(hashlib.sha1((headers["sec-websocket-key"] + WS_GUID).encode()).digest()).decode()
+    writer.write(("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                  f"Sec-WebSocket-Accept: {accept_key}\r\n\r\n").encode())
+    await writer.drain()
+    return WebSocket(reader, writer, mask=False)
+
+
+async def connect(host, port, path="/"):
+    """Opens a client WebSocket, used by the test harness."""
+    reader, writer = await asyncio.open_connection(host, port)
+    key = base64.b64encode(os.urandom(16)).decode()
+    writer.write((f"GET {path} HTTP/1.1\r\nHost: {host}:{port}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                  f"Sec-WebSocket-Key: {key}\r\nSec-WebSocket-Version: 13\r\n\r\n").encode())
+    await writer.drain()
+    response = await reader.readuntil(b"\r\n\r\n")
+    if b" 101 " not in response.split(b"\r\n", 1)[0]:
+        raise ConnectionError(response.decode(errors="replace"))
+    return WebSocket(reader, writer, mask=True)
+
+
+class Relay:
+    def __init__(self, api_url, interval, client_id="", client_secret="", refresh_token=""):
+        self.api_url = api_url.rstrip("/")
+        self.interval = interval
+        self.credentials = (client_id, client_secret, refresh_token)
+        self.token = None
+        self.token_expiry = 0
+        self.clients = set()
+        self.state = None
+        self.state_time = 0
+        self.sequence = 0
+        self.upstream_requests = 0
+        self.messages_sent = 0
+        self.bytes_sent = 0
+        self.sent_times = {}
+
+    def _access_token(self):
+        client_id, client_secret, refresh_token = self.credentials
+        if not refresh_token:
+            return None
+        if self.token and time.time() < self.token_expiry - 60:
+            return self.token
+        auth = base64.b64encode(f"{client_id}:{client_secret}".encode()).decode()
+        body = urllib.parse.urlencode({"grant_type": "refresh_token", "refresh_token": refresh_token}).encode()
+        request = urllib.request.Request("https://accounts.spotify.com/api/token", body,
+                                         {"Authorization": f"Basic {auth}",
+                                          "Content-Type": "application/x-www-form-urlencoded"})
+        with urllib.request.urlopen(request, timeout=10) as response:
+            token = json.load(response)
+        self.token = token["access_token"]
+        self.token_expiry = time.time() + token.get("expires_in", 3600)
+        return self.token
+
+    def _fetch(self):
+        headers = {}
+        token = self._access_token()
+        if token:
+            headers["Authorization"] = f"Bearer {token}"
+        self.upstream_requests += 1
+        request = urllib.request.Request(self.api_url + "/v1/me/player", headers=headers)
+        with urllib.request.urlopen(request, timeout=10) as response:
+            if response.status == 204:
+                return None
+            return json.load(response)
+
+    async def _send(self, ws, message):
+        try:
+            await ws.send(message)
+            self.messages_sent += 1
+            self.bytes_sent += len(message)
+        except (ConnectionError, OSError):
+            self.clients.discard(ws)
+
+    async def poll(self):
+        loop = asyncio.get_running_loop()
+        while True:
+            started = time.monotonic()
+            try:
+                player = await loop.run_in_executor(None, self._fetch)
+            except (urllib.error.URLError, OSError, ValueError) as err:
+                print(f"poll failed: {err}")
+                player = None
+
+            if player is not None:
+                state = state_from_player(player)
+                now = time.monotonic()
+                fields = changed_fields(self.state, state, (now - self.state_time) * 1000)
+                if self.state is None or "progress_ms" in fields:
+                    self.state_time = now
+                else:
+                    # Keep the reference progress, controllers extrapolate from the last one sent.
+                    state["progress_ms"] = self.state["progress_ms"]
+                self.state = state
+                if fields:
+                    self.sequence += 1
+                    self.sent_times[self.sequence] = time.monotonic()
+                    message = encode(DELTA, self.sequence, state, fields)
+                    await asyncio.gather(*(self._send(ws, message) for ws in list(self.clients)))
+
+            await asyncio.sleep(max(0, self.interval - (time.monotonic() - started)))
+
+    def snapshot(self):
+        state = dict(self.state)
+        if state["playing"]:
+            state["progress_ms"] += int((time.monotonic() - self.state_time) * 1000)
+        return encode(SNAPSHOT, self.sequence, state, set(FIELDS))
+
+    async def handle(self, reader, writer):
+        try:
+            ws = await accept(reader, writer)
+        except (asyncio.IncompleteReadError, KeyError, ConnectionError):
+            writer.close()
+            return
+        self.clients.add(ws)
+        try:
+            if self.state is not None:
+                await self._send(ws, self.snapshot())
+            while True:
+                opcode, payload = await ws.recv()
+                if opcode == 0x8:
+                    break
+                if opcode == 0x1 and payload == b"snapshot" and self.state is not None:
+                    await self._send(ws, self.snapshot())
+        except (asyncio.IncompleteReadError, ConnectionError, OSError):
+            pass
+        finally:
+            self.clients.discard(ws)
+            ws.close()
+
+    async def serve(self, host, port):
+        server = await asyncio.start_server(self.handle, host, port)
+        asyncio.create_task(self.poll())
+        return server
+
+
+async def run(args):
+    relay = Relay(args.api, args.interval,
+                  args.client_id or os.environ.get("SPOTIFY_CLIENT_ID", ""),
+                  args.client_secret or os.environ.get("SPOTIFY_CLIENT_SECRET", ""),
+                  args.refresh_token or os.environ.get("SPOTIFY_REFRESH_TOKEN", ""))
+    server = await relay.serve(args.host, args.port)
+    print(f"Relaying {args.api} on ws://{args.host}:{args.port}/ every {args.interval} s")
+    async with server:
+        while True:
+            await asyncio.sleep(60)
+            print(f"{len(relay.clients)} controllers, {relay.upstream_requests} upstream requests, "
+                  f"{relay.messages_sent} messages ({relay.bytes_sent} bytes) sent")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--api", default="https://api.spotify.com", help="API base URL, e.g. of tools/mock_api.py")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8765)
+    parser.add_argument("--interval", type=float, default=1.0, help="upstream poll interval in seconds")
+    parser.add_argument("--client-id", default="")
+    parser.add_argument("--client-secret", default="")
+    parser.add_argument("--refresh-token", default="")
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Measures the relay's fan-out latency and upstream request reduction locally.
+
+Starts tools/mock_api.py and tools/relay.py in process, connects N simulated controllers
+and skips tracks on the mock player. For every skip it reports how long each controller
+took to see the new track, both from the skip and from the relay's broadcast, and at the
+end compares the relay's upstream requests with N controllers polling on their own.
+"""
+import argparse
+import asyncio
+import statistics
+import threading
+import time
+import urllib.request
+from http.server import ThreadingHTTPServer
+
+import mock_api
+import relay
+
+
+class Controller:
+    def __init__(self, index):
+        self.index = index
+        self.state = None
+        self.sequence = None
+        self.seen = {}
+        self.gaps = 0
+        self.ws = None
+
+    async def run(self, port):
+        self.ws = ws = await relay.connect("127.0.0.1", port)
+        while True:
+            opcode, message = await ws.recv()
+            if opcode != 0x2:
+                continue
+            kind, sequence, state = relay.decode(message, self.state)
+            if kind == relay.DELTA and self.sequence is not None and sequence != self.sequence + 1:
+                self.gaps += 1
+                await ws.send(b"snapshot", 0x1)
+                continue
+            self.state, self.sequence = state, sequence
+            self.seen.setdefault(state.get("uri"), (time.monotonic(), sequence))
+
+
+def percentile(values, fraction):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def summary(label, values_ms):
+    return (f"{label}: min {min(values_ms):.1f} ms, median {statistics.median(values_ms):.1f} ms, "
+            f"p95 {percentile(values_ms, 0.95):.1f} ms, max {max(values_ms):.1f} ms")
+
+
+async def run(args):
+    server = ThreadingHTTPServer(("127.0.0.1", 0), mock_api.Handler)
+    server.verbose = False
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    api = f"http://127.0.0.1:{server.server_address[1]}"
+
+    relay_server = relay.Relay(api, args.interval)
+    ws_server = await relay_server.serve("127.0.0.1", 0)
+    port = ws_server.sockets[0].getsockname()[1]
+
+    controllers = [Controller(i) for i in range(args.controllers)]
+    tasks = [asyncio.create_task(c.run(port)) for c in controllers]
+    await asyncio.sleep(args.interval * 2)
+
+    started = time.monotonic()
+    from_change = []
+    from_broadcast = []
+    missed = 0
+
+    for _ in range(args.skips):
+        request = urllib.request.Request(api + "/v1/me/player/next", method="POST")
+        skipped = time.monotonic()
+        urllib.request.urlopen(request).close()
+        uri = mock_api.make_track(mock_api.Handler.player.index)["uri"]
+
+        deadline = skipped + args.interval * 2 + 1
+        while time.monotonic() < deadline and not all(uri in c.seen for c in controllers):
+            await asyncio.sleep(0.005)
+
+        for controller in controllers:
+            if uri not in controller.seen:
+                missed += 1
+                continue
+            seen, sequence = controller.seen[uri]
+            from_change.append((seen - skipped) * 1000)
+            from_broadcast.append((seen - relay_server.sent_times[sequence]) * 1000)
+
+        await asyncio.sleep(args.gap)
+
+    elapsed = time.monotonic() - started
+    polling_requests = args.controllers * elapsed / args.poll_interval
+
+    print(f"{args.controllers} controllers, {args.skips} track changes, relay polling every {args.interval} s")
+    if from_change:
+        print(summary("skip to controller", from_change))
+        print(summary("broadcast to controller", from_broadcast))
+    print(f"missed updates: {missed}, sequence gaps: {sum(c.gaps for c in controllers)}")
+    print(f"upstream requests: relay {relay_server.upstream_requests}, "
+          f"{args.controllers} controllers polling every {args.poll_interval} s ~{polling_requests:.0f}")
+    print(f"relay sent {relay_server.messages_sent} messages, {relay_server.bytes_sent} bytes")
+
+    for task in tasks:
+        task.cancel()
+    for controller in controllers:
+        controller.ws.close()
+    # Lets the relay's handlers see the connections close.
+    await asyncio.sleep(0.2)
+    ws_server.close()
+    server.shutdown()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("-n", "--controllers", type=int, default=50)
+    parser.add_argument("--skips", type=int, default=10, help="number of track changes")
+    parser.add_argument("--gap", type=float, default=1.0, help="seconds between track changes")
+    parser.add_argument("--interval", type=float, default=0.5, help="relay poll interval in seconds")
+    parser.add_argument("--poll-interval", type=float, default=1.0, help="per-controller poll interval to compare with")
+    asyncio.run(run(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""Measures as-you-type search against tools/mock_api.py.
+
+Starts the mock API in process and replays the same typing sessions (words typed one
+character at a time, sometimes corrected with backspace, then read for a while) with two
+search policies:
+
+    naive     a request per keystroke, sent one after the other over the single connection
+              of an HttpClient, results shown once the whole page has arrived
+    device    SearchView: a request once the query has not changed for --debounce-ms, the
+              request in flight closed when the query changes, results shown as each entry
+              is parsed, and the last 8 queries cached so going back to them needs no request
+
+For each policy it reports the latency from the last keystroke of a session to its first
+and to all of its results, the requests sent per session and how many were abandoned.
+
+    tools/search_sim.py --sessions 12 --search-delay-ms 150 --search-item-ms 40
+"""
+import argparse
+import math
+import random
+import select
+import socket
+import statistics
+import threading
+import time
+from collections import OrderedDict
+from http.server import ThreadingHTTPServer
+from urllib.parse import quote
+
+import mock_api
+
+WORDS = ["track 004", "track 0123", "artist 42", "artist 7", "album 0031", "album 01", "mix 1", "mix 27"]
+CACHE_ENTRIES = 8
+
+
+class ItemScanner:
+    """Port of JsonItemScanner: counts the entries of items arrays as their closing brace arrives."""
+
+    def __init__(self):
+        self.depth = 0
+        self.in_string = False
+        self.escaped = False
+        self.item_depth = 0
+        self.items_depth = 0
+        self.string = ""
+        self.keys = {}
+        self.items = 0
+
+    def feed(self, data):
+        found = 0
+        for c in data.decode("utf-8", "replace"):
+            if self.in_string:
+                if self.escaped:
+                    self.escaped = False
+                elif c == "\\":
+                    self.escaped = True
+                elif c == '"':
+                    self.in_string = False
+                elif not self.item_depth:
+                    self.string += c
+            elif c == '"':
+                self.in_string = True
+                if not self.item_depth:
+                    self.string = ""
+            elif c == ":" and not self.item_depth:
+                self.keys[self.depth] = self.string
+            elif c in "{[":
+                self.depth += 1
+                if not self.item_depth and c == "{" and self.items_depth and self.depth == self.items_depth + 1:
+                    self.item_depth = self.depth
+                elif not self.item_depth and c == "[" and self.depth in (2, 3) and self.keys.get(self.depth - 1) == "items":
+                    self.items_depth = self.depth
+            elif c in "}]":
+                if self.item_depth and self.depth == self.item_depth:
+                    self.item_depth = 0
+                    self.items += 1
+                    found += 1
+                elif not self.item_depth:
+                    if self.depth == self.items_depth:
+                        self.items_depth = 0
+                    self.keys.pop(self.depth, None)
+                self.depth -= 1
+        return found
+
+
+class Request:
+    """A search over its own keep-alive-less connection, read without blocking."""
+
+    def __init__(self, port, query):
+        self.query = query
+        self.sock = socket.create_connection(("127.0.0.1", port))
+        self.sock.setblocking(False)
+        path = f"/v1/search?q={quote(query)}&type=track%2Calbum%2Cplaylist&limit=5"
+        self.sock.sendall(f"GET {path} HTTP/1.1\r\nHost: mock\r\nConnection: close\r\n\r\n".encode())
+        self.head = b""
+        self.length = None
+        self.received = 0
+        self.scanner = ItemScanner()
+        self.done = False
+
+    def read(self):
+        """Returns the number of entries completed by the data available."""
+        try:
+            data = self.sock.recv(4096)
+        except BlockingIOError:
+            return 0
+        if not data:
+            self.done = True
+            return 0
+        if self.length is None:
+            self.head += data
+            if b"\r\n\r\n" not in self.head:
+                return 0
+            head, data = self.head.split(b"\r\n\r\n", 1)
+            for line in head.split(b"\r\n"):
+                if line.lower().startswith(b"content-length:"):
+                    self.length = int(line.split(b":")[1])
+        self.received += len(data)
+        if self.length is not None and self.received >= self.length:
+            self.done = True
+        return self.scanner.feed(data)
+
+    def close(self):
+        self.sock.close()
+
+
+def make_sessions(count, seed):
+    """Each session is its keystrokes as (seconds since start, text), ending with the query cleared."""
+    rng = random.Random(seed)
+    sessions, t = [], 0.5
+    for _ in range(count):
+        word = rng.choice(WORDS)
+        keys = []
+        for i in range(1, len(word) + 1):
+            t += max(0.06, rng.gauss(0.18, 0.06))
+            keys.append((t, word[:i]))
+        # Sometimes the last characters are taken back after a look at the results.
+        if rng.random() < 0.4:
+            t += rng.uniform(0.8, 1.5)
+            for i in range(1, rng.randint(1, 3) + 1):
+                t += max(0.08, rng.gauss(0.2, 0.05))
+                keys.append((t, word[:-i]))
+        t += rng.uniform(1.5, 2.5)
+        keys.append((t, ""))
+        sessions.append(keys)
+    return sessions
+
+
+class Policy:
+    """Replays keystrokes in real time and records when results of the current query are shown."""
+
+    def __init__(self, name, port, debounce):
+        self.name = name
+        self.port = port
+        self.debounce = debounce
+        self.requests = 0
+        self.abandoned = 0
+        self.query = ""
+        self.changed = 0.0
+        self.answered = True
+        self.queued = []
+        self.active = None
+        self.cache = OrderedDict()
+        self.shown = []
+
+    def show(self, now, complete):
+        self.shown.append((self.query, now, complete))
+
+    def key(self, now, text):
+        if text == self.query:
+            return
+        self.query, self.changed = text, now
+        if self.name == "naive":
+            if text:
+                self.queued.append(text)
+            return
+        if self.active is not None:
+            self.active.close()
+            self.active = None
+            self.abandoned += 1
+        self.answered = True
+        if not text:
+            return
+        if text in self.cache:
+            self.cache.move_to_end(text)
+            self.show(now, True)
+            return
+        self.answered = False
+
+    def poll(self, now):
+        """Starts the next request if due, returns how long it can wait at most."""
+        if self.active is not None:
+            return 0.5
+        if self.name == "naive" and self.queued:
+            self.active = Request(self.port, self.queued.pop(0))
+            self.requests += 1
+        elif self.name == "device" and not self.answered:
+            wait = self.changed + self.debounce - now
+            if wait > 0:
+                return wait
+            self.active = Request(self.port, self.query)
+            self.requests += 1
+        return 0.5
+
+    def receive(self, now):
+        request = self.active
+        items = request.read()
+        current = request.query == self.query
+        # The naive client parses the page once it is complete.
+        if self.name == "device" and items and current:
+            self.show(now, False)
+        if not request.done:
+            return
+        request.close()
+        self.active = None
+        if self.name == "device":
+            self.cache[request.query] = True
+            while len(self.cache) > CACHE_ENTRIES:
+                self.cache.popitem(last=False)
+        if current:
+            self.answered = True
+            self.show(now, True)
+
+    def run(self, keys):
+        start = time.monotonic()
+        index = 0
+        while index < len(keys) or self.active is not None or self.queued:
+            now = time.monotonic() - start
+            while index < len(keys) and keys[index][0] <= now:
+                self.key(now, keys[index][1])
+                index += 1
+            wait = self.poll(now)
+            if index < len(keys):
+                wait = min(wait, keys[index][0] - now)
+            if self.active is not None:
+                select.select([self.active.sock], [], [], max(wait, 0))
+                self.receive(time.monotonic() - start)
+            else:
+                time.sleep(max(wait, 0))
+
+
+def latencies(session, shown):
+    """Last keystroke to the first and to all results of the session's query, None if never shown."""
+    last, settled = session[-2]
+    cleared = session[-1][0]
+    first = next((t for query, t, _ in shown if query == settled and last <= t < cleared), None)
+    full = next((t for query, t, complete in shown if complete and query == settled and last <= t < cleared), None)
+    return (None if first is None else first - last), (None if full is None else full - last)
+
+
+def summary(values):
+    values = sorted(v for v in values if v is not None)
+    if not values:
+        return f"{'-':>9} {'-':>7}"
+    return f"{statistics.mean(values) * 1000:6.0f} ms {values[min(len(values) - 1, math.ceil(0.95 * len(values)) - 1)] * 1000:4.0f} ms"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--sessions", type=int, default=10)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--debounce-ms", type=float, default=300, help="CONFIG_UI_SEARCH_DEBOUNCE_MS")
+    parser.add_argument("--search-delay-ms", type=float, default=150, help="time before the mock answers")
+    parser.add_argument("--search-item-ms", type=float, default=40, help="time between results")
+    args = parser.parse_args()
+
+    mock_api.Handler.search_delay = args.search_delay_ms / 1000
+    mock_api.Handler.search_item_delay = args.search_item_ms / 1000
+    server = ThreadingHTTPServer(("127.0.0.1", 0), mock_api.Handler)
+    server.verbose = False
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    sessions = make_sessions(args.sessions, args.seed)
+    keys = [key for session in sessions for key in session]
+    print(f"{len(sessions)} sessions, {len(keys) - len(sessions)} keystrokes, mock answers after "
+          f"{args.search_delay_ms:.0f} ms and {args.search_item_ms:.0f} ms per result\n")
+    print(f"{'policy':<8} {'first result':>17} {'all results':>17} {'requests':>9} {'/session':>9} "
+          f"{'abandoned':>9} {'missed':>7}")
+
+    for name in ("naive", "device"):
+        policy = Policy(name, server.server_address[1], args.debounce_ms / 1000)
+        policy.run(keys)
+        results = [latencies(session, policy.shown) for session in sessions]
+        firsts = [first for first, _ in results]
+        alls = [full for _, full in results]
+        missed = sum(full is None for full in alls)
+        print(f"{name:<8} {summary(firsts)} {summary(alls)} {policy.requests:9d} "
+              f"{policy.requests / len(sessions):9.1f} {policy.abandoned:9d} {missed:7d}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,193 @@
+// Host test of the player snapshot format (include/player_snapshot.h).
+//
+// Checks that random player states survive an encode and decode, including empty, over-long
+// and non-ASCII strings and more artists than are encoded, that encode refuses every buffer
+// shorter than the snapshot, that every truncated snapshot is rejected, and that a snapshot
+// of a later version with appended fields still decodes. Then corrupts snapshots at random and
+// checks that decode either rejects them or returns views inside the input. Build it with the
+// sanitizers so an overrun fails the run:
+//
+//     g++ -O1 -g -std=c++20 -fsanitize=address,undefined -Iinclude -Itools/host tools/snapshot_test.cpp main/player_snapshot.cpp -o snapshot_test
+//     ./snapshot_test [corruptions]
+#include "player_snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr int states = 2000;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what, int iteration) {
+    if(!condition) {
+        printf("FAIL %s (iteration %d)\n", what, iteration);
+        failures++;
+    }
+}
+
+static std::string random_string(std::mt19937& rng) {
+    static const char* pieces[] = {"a", "Z", "9", " ", "é", "夜", "🎵", "\"", "\\", "\0"};
+    size_t length;
+
+    switch(rng() % 8) {
+    case 0:
+        return "";
+    case 1:
+        length = snapshot::max_string + rng() % 200;
+        break;
+    default:
+        length = rng() % 60;
+        break;
+    }
+
+    std::string out;
+
+    while(out.size() < length) {
+        const char* piece = pieces[rng() % 10];
+        out.append(piece, std::max<size_t>(1, std::char_traits<char>::length(piece)));
+    }
+
+    return out;
+}
+
+static spotify::PlayerState random_state(std::mt19937& rng) {
+    spotify::PlayerState state = {};
+    spotify::Track& track = state.track;
+
+    track.uri = random_string(rng);
+    track.name = random_string(rng);
+    track.album_name = random_string(rng);
+    track.album_pic_url = random_string(rng);
+    track.context_uri = random_string(rng);
+    track.artists.resize(rng() % (snapshot::max_artists + 4));
+
+    for(auto& artist : track.artists) {
+        artist = random_string(rng);
+    }
+
+    track.duration_ms = rng() % 3600000;
+    track.progress_ms = rng() % 3600000;
+
+    state.play_state = rng() % 2 ? spotify::PlayState::Playing : spotify::PlayState::Paused;
+    state.shuffle_state = rng() % 2 ? spotify::ShuffleState::On : spotify::ShuffleState::Off;
+    state.repeat_state = static_cast<spotify::RepeatState>(rng() % 3);
+    state.volume_percent = rng() % 101;
+
+    return state;
+}
+
+static bool same_string(std::string_view decoded, const std::string& original) {
+    return decoded == std::string_view(original).substr(0, snapshot::max_string);
+}
+
+static bool inside(std::string_view view, const std::vector<uint8_t>& data, size_t len) {
+    auto begin = reinterpret_cast<const char*>(data.data());
+    return view.empty() || (view.data() >= begin && view.data() + view.size() <= begin + len);
+}
+
+static void round_trip(std::mt19937& rng, int iteration) {
+    spotify::PlayerState state = random_state(rng);
+    int64_t timestamp_ms = static_cast<int64_t>(rng()) << 20;
+    size_t size = snapshot::encodedSize(state);
+
+    //Exactly sized, so ASan catches a write or read past the snapshot.
+    std::vector<uint8_t> data(size);
+    check(snapshot::encode(state, timestamp_ms, data.data(), size) == size, "encode writes encodedSize bytes", iteration);
+
+    for(size_t capacity = 0; capacity < size; capacity += 1 + capacity / 8) {
+        std::vector<uint8_t> small(capacity);
+        check(snapshot::encode(state, timestamp_ms, small.data(), capacity) == 0, "encode refuses a short buffer", iteration);
+    }
+
+    snapshot::View view = {};
+    check(snapshot::decode(data.data(), size, view) == size, "decode returns the size", iteration);
+
+    const spotify::Track& track = state.track;
+    size_t artists = std::min(track.artists.size(), snapshot::max_artists);
+    bool same = view.version == snapshot::version && same_string(view.uri, track.uri) && same_string(view.name, track.name) &&
+                same_string(view.album_name, track.album_name) && same_string(view.album_pic_url, track.album_pic_url) &&
+                same_string(view.context_uri, track.context_uri) && view.artist_count == artists &&
+                view.duration_ms == static_cast<uint32_t>(track.duration_ms) && view.progress_ms == static_cast<uint32_t>(track.progress_ms) &&
+                view.timestamp_ms == timestamp_ms && view.play_state == state.play_state && view.shuffle_state == state.shuffle_state &&
+                view.repeat_state == state.repeat_state && view.volume_percent == state.volume_percent;
+
+    for(size_t i = 0; i < artists && same; i++) {
+        same = same_string(view.artists[i], track.artists[i]);
+    }
+
+    check(same, "decoded fields equal the state", iteration);
+
+    spotify::PlayerState copied = {};
+    snapshot::copy(view, copied);
+    check(snapshot::encodedSize(copied) == size, "copy keeps every field", iteration);
+
+    //Every prefix lacks something, the exact buffer makes any overread visible.
+    for(size_t len = 0; len < size; len++) {
+        std::vector<uint8_t> prefix(data.begin(), data.begin() + len);
+        check(snapshot::decode(prefix.data(), len, view) == 0, "truncated snapshot rejected", iteration);
+    }
+
+    //A later version appends fields and raises the length, this one skips them.
+    std::vector<uint8_t> newer = data;
+    size_t appended = 1 + rng() % 64;
+    newer.resize(size + appended, 0xA5);
+    newer[2] = snapshot::version + 1;
+    newer[4] = static_cast<uint8_t>(size + appended);
+    newer[5] = static_cast<uint8_t>((size + appended) >> 8);
+    check(snapshot::decode(newer.data(), newer.size(), view) == size + appended, "newer version decodes", iteration);
+    check(same_string(view.name, track.name), "newer version keeps the known fields", iteration);
+}
+
+static void corrupt(std::mt19937& rng, int corruptions) {
+    for(int i = 0; i < corruptions; i++) {
+        spotify::PlayerState state = random_state(rng);
+        std::vector<uint8_t> data(snapshot::encodedSize(state));
+        snapshot::encode(state, 0, data.data(), data.size());
+
+        int flips = 1 + rng() % 8;
+
+        for(int flip = 0; flip < flips; flip++) {
+            //The header decides most of the parsing, so it gets half of the corruptions.
+            size_t pos = rng() % 2 ? rng() % snapshot::header_size : rng() % data.size();
+            data[pos] = static_cast<uint8_t>(rng());
+        }
+
+        size_t len = rng() % 4 == 0 ? rng() % (data.size() + 1) : data.size();
+        data.resize(len);
+
+        snapshot::View view = {};
+        size_t size = snapshot::decode(data.data(), len, view);
+
+        if(size == 0) {
+            continue;
+        }
+
+        bool valid = size <= len && view.artist_count <= snapshot::max_artists && inside(view.uri, data, size) &&
+                     inside(view.name, data, size) && inside(view.album_name, data, size) &&
+                     inside(view.album_pic_url, data, size) && inside(view.context_uri, data, size);
+
+        for(size_t artist = 0; artist < view.artist_count && valid; artist++) {
+            valid = inside(view.artists[artist], data, size);
+        }
+
+        check(valid, "accepted corruption stays inside the snapshot", i);
+    }
+}
+
+int main(int argc, char** argv) {
+    int corruptions = argc > 1 ? atoi(argv[1]) : 200000;
+    std::mt19937 rng(35);
+
+    for(int i = 0; i < states; i++) {
+        round_trip(rng, i);
+    }
+
+    corrupt(rng, corruptions);
+
+    printf("%d round trips, %d corruptions, %d failures\n", states, corruptions, failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Models the SPI bus shared by the ILI9488 panel and the XPT2046 touch controller.
+
+Simulates the LVGL task rendering and flushing frames while a pen taps and drags, for three
+ways of reading the touch controller:
+
+    poll   the previous touch_driver_read: every input read (33 ms) waits for the panel
+           transfers and reads the controller once, whether the pen is down or not
+    gaps   TouchSampler without the pen IRQ: polled every 30 ms between frames with a single
+           reading while released, batches every 20 ms while pressed
+    irq    TouchSampler with the pen IRQ checked every 10 ms: the bus is only used while the
+           pen is down
+
+For a few screen loads it reports the display throughput and the latency from the pen
+touching the panel to LVGL reading it as pressed. The defaults follow main/panel_flush.cpp
+(RGB666 over 40 MHz, 2048 pixel DMA chunks, 1/10 screen buffers); --touch-us should match
+the TouchRead spans of a trace taken on the device.
+
+    tools/touch_bus_sim.py --seconds 120
+"""
+import argparse
+import random
+import statistics
+
+WIDTH, HEIGHT = 480, 320
+BUFFER_PIXELS = WIDTH * HEIGHT // 10
+CHUNK_PIXELS = 2048
+REFRESH_MS = 33
+INDEV_MS = 33
+
+# TouchSampler's constants.
+IRQ_MS = 10
+PRESSED_MS = 20
+POLL_MS = 30
+BATCH = 3
+
+# Pixels redrawn per frame.
+LOADS = {
+    "progress": 2 * 1200,
+    "marquee": WIDTH * 90,
+    "scroll": WIDTH * HEIGHT,
+}
+
+
+class Model:
+    def __init__(self, args, policy, frame_pixels, touches):
+        self.args = args
+        self.policy = policy
+        self.frame_pixels = frame_pixels
+        self.touches = touches
+        self.now = 0.0
+        self.bus_free = 0.0
+        self.pixels = 0
+        self.frames = 0
+        self.touch_bus_us = 0.0
+        self.readings = 0
+        self.latencies = []
+        self.queued_pressed = False
+        self.reported = set()
+
+    def transfer_us(self, pixels):
+        return pixels * 3 * 8 / self.args.spi_mhz
+
+    def pen(self, t):
+        """Index of the touch in progress at t, or None."""
+        for i, (down, up) in enumerate(self.touches):
+            if down <= t < up:
+                return i
+            if down > t:
+                break
+        return None
+
+    def pen_irq(self, t):
+        """True if the pen came down since the last batch or is still down."""
+        return self.pen(t) is not None or any(self.last_batch < down <= t for down, _ in self.touches)
+
+    def refresh(self):
+        for offset in range(0, self.frame_pixels, BUFFER_PIXELS):
+            pixels = min(BUFFER_PIXELS, self.frame_pixels - offset)
+            self.now += pixels * self.args.render_ns / 1000
+            # The flush waits for the previous transfer, then returns once the last chunk is queued.
+            start = max(self.now, self.bus_free)
+            transfer = self.transfer_us(pixels)
+            self.bus_free = start + transfer
+            self.now = max(self.now, start + transfer - self.transfer_us(min(pixels, CHUNK_PIXELS)))
+            self.pixels += pixels
+        self.frames += 1
+
+    def read(self):
+        """One reading of the controller, after the panel transfers are done."""
+        self.now = max(self.now, self.bus_free) + self.args.touch_us
+        self.bus_free = self.now
+        self.touch_bus_us += self.args.touch_us
+        self.readings += 1
+        return self.pen(self.now)
+
+    def report(self, touch):
+        if touch is not None and touch not in self.reported:
+            self.reported.add(touch)
+            self.latencies.append(self.now - self.touches[touch][0])
+
+    def batch(self):
+        hits, misses, touch = 0, 0, None
+        for _ in range(BATCH):
+            t = self.read()
+            if t is not None:
+                hits, touch = hits + 1, t
+            else:
+                misses += 1
+            if misses > BATCH // 2 or (misses and not self.queued_pressed):
+                break
+        pressed = hits > BATCH // 2
+        self.queued_pressed = pressed
+        return touch if pressed else None
+
+    def sample(self):
+        """Runs the touch timer, returns its next period."""
+        if self.policy == "poll":
+            self.report(self.read())
+            return INDEV_MS
+
+        if self.policy == "irq" and not self.queued_pressed and not self.pen_irq(self.now):
+            self.now += 2
+            return IRQ_MS
+
+        self.last_batch = self.now
+        self.report(self.batch())
+        if self.queued_pressed:
+            return PRESSED_MS
+        return IRQ_MS if self.policy == "irq" else POLL_MS
+
+    def run(self, seconds):
+        end = seconds * 1e6
+        next_refresh = 0.0
+        next_touch = 0.0
+        self.last_batch = -1.0
+
+        while self.now < end:
+            self.now = max(self.now, min(next_refresh, next_touch))
+
+            # Timers run in creation order, the display's refresh timer first.
+            if next_refresh <= self.now:
+                start = self.now
+                self.refresh()
+                next_refresh = start + REFRESH_MS * 1000
+
+            if next_touch <= self.now:
+                start = self.now
+                next_touch = start + self.sample() * 1000
+
+        return {
+            "fps": self.frames / seconds,
+            "mpx": self.pixels / seconds / 1e6,
+            "touch_ms": self.touch_bus_us / seconds / 1000,
+            "readings": self.readings / seconds,
+            "latency": self.latencies,
+            "missed": len(self.touches) - len(self.latencies),
+        }
+
+
+def make_touches(seconds, seed):
+    """Taps of 80-200 ms and drags of 0.4-1.2 s, about one every 1.5 s."""
+    rng = random.Random(seed)
+    touches, t = [], 0.5e6
+    while t < seconds * 1e6:
+        hold = rng.uniform(80e3, 200e3) if rng.random() < 0.7 else rng.uniform(400e3, 1200e3)
+        touches.append((t, t + hold))
+        t += hold + rng.expovariate(1 / 1.5e6)
+    return touches
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100 * len(values)))] if values else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--seconds", type=float, default=60)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--spi-mhz", type=float, default=40, help="panel SPI clock")
+    parser.add_argument("--touch-us", type=float, default=300, help="bus time of one controller reading")
+    parser.add_argument("--render-ns", type=float, default=60, help="LVGL render time per pixel")
+    args = parser.parse_args()
+
+    touches = make_touches(args.seconds, args.seed)
+    print(f"{len(touches)} touches in {args.seconds:.0f} s, {args.touch_us:.0f} us per reading\n")
+    print(f"{'load':<9} {'policy':<6} {'fps':>6} {'Mpx/s':>6} {'touch bus':>10} {'readings':>9} "
+          f"{'latency avg':>12} {'p95':>6} {'max':>6} {'missed':>6}")
+
+    for load, frame_pixels in LOADS.items():
+        for policy in ("poll", "gaps", "irq"):
+            r = Model(args, policy, frame_pixels, touches).run(args.seconds)
+            latency = [v / 1000 for v in r["latency"]]
+            print(f"{load:<9} {policy:<6} {r['fps']:6.1f} {r['mpx']:6.2f} {r['touch_ms']:7.1f} ms/s "
+                  f"{r['readings']:7.1f}/s {statistics.mean(latency):9.1f} ms {percentile(latency, 95):6.1f} "
+                  f"{max(latency):6.1f} {r['missed']:6d}")
+
+
+if __name__ == "__main__":
+    main()
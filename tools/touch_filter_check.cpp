@@ -0,0 +1,196 @@
+// Host check of the touch filter (include/touch_filter.h).
+//
+// Runs the median of touch::median over batches of readings the way TouchSampler does, three
+// per sample, and reports how far the raw readings and the filtered samples land from the pen.
+// Without a capture the readings are a synthetic drag with the noise of a resistive panel and
+// a wild reading in some batches, as when the pen lands or lifts; a filtered sample must stay
+// close to the pen whenever its batch has at most one. A capture holds one reading per line,
+// "x y", in batches of three, optionally with the pen position as "x y pen_x pen_y".
+//
+// Also checks median against sorting for every batch size up to 9, and touch::Ring against a
+// queue that keeps the newest entries, through random pushes and pops that overflow it.
+//
+//     g++ -O2 -std=c++20 -Iinclude tools/touch_filter_check.cpp -o touch_filter_check
+//     ./touch_filter_check [capture]
+#include "touch_filter.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <vector>
+
+static constexpr size_t batch_size = 3;
+static constexpr size_t ring_size = 8;
+static constexpr int max_error_px = 8;
+
+struct Reading {
+    int16_t x;
+    int16_t y;
+    int16_t pen_x;      ///< Where the pen was, -1 if the capture doesn't say.
+    int16_t pen_y;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if(!condition) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+//A drag across the panel, with about 2 px of noise and every tenth reading far off.
+static std::vector<Reading> synthesize() {
+    std::mt19937 rng(42);
+    std::normal_distribution<double> noise(0, 2);
+    std::vector<Reading> readings;
+
+    for(int step = 0; step < 200; step++) {
+        auto pen_x = static_cast<int16_t>(40 + step * 2);
+        auto pen_y = static_cast<int16_t>(160 + 100 * std::sin(step / 30.0));
+
+        for(size_t i = 0; i < batch_size; i++) {
+            Reading reading = {static_cast<int16_t>(pen_x + noise(rng)), static_cast<int16_t>(pen_y + noise(rng)), pen_x, pen_y};
+
+            if(rng() % 10 == 0) {
+                reading.x = static_cast<int16_t>(rng() % 480);
+                reading.y = static_cast<int16_t>(rng() % 320);
+            }
+
+            readings.push_back(reading);
+        }
+    }
+
+    return readings;
+}
+
+static std::vector<Reading> load(const char* path) {
+    std::vector<Reading> readings;
+    FILE* in = fopen(path, "r");
+    char line[128];
+
+    if(in == nullptr) {
+        perror(path);
+        exit(1);
+    }
+
+    while(fgets(line, sizeof(line), in) != nullptr) {
+        int x, y, pen_x = -1, pen_y = -1;
+
+        if(sscanf(line, "%d %d %d %d", &x, &y, &pen_x, &pen_y) >= 2) {
+            readings.push_back({static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<int16_t>(pen_x), static_cast<int16_t>(pen_y)});
+        }
+    }
+
+    fclose(in);
+    return readings;
+}
+
+static int distance(int x, int y, const Reading& reading) {
+    return static_cast<int>(std::lround(std::hypot(x - reading.pen_x, y - reading.pen_y)));
+}
+
+static void filter(const std::vector<Reading>& readings) {
+    int raw_max = 0;
+    int filtered_max = 0;
+    size_t samples = 0;
+    bool known = true;
+
+    for(size_t start = 0; start + batch_size <= readings.size(); start += batch_size) {
+        std::array<int16_t, batch_size> xs;
+        std::array<int16_t, batch_size> ys;
+        int wild = 0;
+
+        for(size_t i = 0; i < batch_size; i++) {
+            const Reading& reading = readings[start + i];
+            xs[i] = reading.x;
+            ys[i] = reading.y;
+            known = known && reading.pen_x >= 0;
+
+            if(known) {
+                int error = distance(reading.x, reading.y, reading);
+                raw_max = std::max(raw_max, error);
+                wild += error > max_error_px;
+            }
+        }
+
+        touch::Sample sample = {touch::median(xs), touch::median(ys), true, 0};
+        samples++;
+
+        if(known && wild <= 1) {
+            int error = distance(sample.x, sample.y, readings[start]);
+            filtered_max = std::max(filtered_max, error);
+            check(error <= max_error_px, "sample of a batch with one wild reading near the pen");
+        }
+    }
+
+    if(known) {
+        printf("%zu samples, farthest raw reading %d px from the pen, farthest filtered sample %d px\n",
+               samples, raw_max, filtered_max);
+    }
+
+    else {
+        printf("%zu samples, the capture has no pen positions to compare with\n", samples);
+    }
+}
+
+static void medians() {
+    std::mt19937 rng(3);
+
+    for(int round = 0; round < 100000; round++) {
+        std::vector<int16_t> values(1 + rng() % 9);
+
+        for(auto& value : values) {
+            value = static_cast<int16_t>(rng() % 64);
+        }
+
+        std::vector<int16_t> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        check(touch::median(values) == sorted[sorted.size() / 2], "median equals the sorted middle");
+    }
+}
+
+static void ring() {
+    std::mt19937 rng(5);
+    touch::Ring<ring_size> ring;
+    std::deque<int16_t> model;
+    uint32_t dropped = 0;
+
+    for(int16_t i = 0; i < 30000; i++) {
+        if(rng() % 3 != 0) {
+            ring.push({i, 0, true, 0});
+            model.push_back(i);
+
+            if(model.size() > ring_size) {
+                model.pop_front();
+                dropped++;
+            }
+        }
+
+        else {
+            touch::Sample sample;
+            bool popped = ring.pop(sample);
+            check(popped == !model.empty(), "pop succeeds unless empty");
+
+            if(popped) {
+                check(sample.x == model.front(), "pop returns the oldest kept sample");
+                model.pop_front();
+            }
+        }
+
+        check(ring.empty() == model.empty(), "empty matches");
+    }
+
+    check(ring.getDropped() == dropped, "overwritten samples counted");
+    printf("ring: %u of the samples overwritten\n", ring.getDropped());
+}
+
+int main(int argc, char** argv) {
+    filter(argc > 1 ? load(argv[1]) : synthesize());
+    medians();
+    ring();
+
+    printf("%d failures\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Convert a console capture with CONFIG_TRACE enabled to Chrome trace JSON.
+
+The firmware prints the trace rings as `@T <core> <dropped> <base64 records>` lines
+between the regular log output, together with the CPU frequency (`@C`), event names
+(`@I`) and task names (`@N`). Capture the console, e.g. `idf.py monitor | tee trace.log`,
+then open the output in chrome://tracing or https://ui.perfetto.dev.
+"""
+import argparse
+import base64
+import json
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IIBBHi")
+BEGIN, END, INSTANT, COUNTER, SYNC = range(5)
+LINE = re.compile(r"@([TCIN]) (.*?)\s*$")
+
+
+def parse(lines):
+    mhz = 240
+    ids = {}
+    tasks = {}
+    records = {}
+    dropped = {}
+
+    for line in lines:
+        match = LINE.search(line)
+        if not match:
+            continue
+        kind, rest = match.groups()
+        try:
+            if kind == "C":
+                mhz = int(rest)
+            elif kind == "I":
+                index, name = rest.split(" ", 1)
+                ids[int(index)] = name
+            elif kind == "N":
+                handle, name = rest.split(" ", 1)
+                tasks[int(handle, 16)] = name
+            else:
+                core, lost, data = rest.split(" ", 2)
+                raw = base64.b64decode(data)
+                core = int(core)
+                dropped[core] = int(lost)
+                records.setdefault(core, []).extend(RECORD.iter_unpack(raw[:len(raw) - len(raw) % RECORD.size]))
+        except ValueError:
+            # Lines cut by other console output are skipped.
+            continue
+
+    return mhz, ids, tasks, records, dropped
+
+
+def timestamps(core_records, mhz):
+    """Maps the 32 bit cycle counts of one core to microseconds using the sync records."""
+    syncs = []
+    wraps = 0
+    last_us = None
+
+    for index, (cycles, _task, kind, _id, _reserved, value) in enumerate(core_records):
+        if kind != SYNC:
+            continue
+        us = value & 0xFFFFFFFF
+        if last_us is not None and us + wraps * 2**32 < last_us - 2**31:
+            wraps += 1
+        last_us = us + wraps * 2**32
+        syncs.append((index, cycles, last_us))
+
+    if not syncs:
+        return None
+
+    result = []
+    position = 0
+
+    for index, (cycles, *_rest) in enumerate(core_records):
+        while position + 1 < len(syncs) and syncs[position + 1][0] <= index:
+            position += 1
+        ref_index, ref_cycles, ref_us = syncs[position]
+
+        # Between two syncs the rate is measured, which also covers frequency changes.
+        rate = mhz
+        if ref_index <= index and position + 1 < len(syncs):
+            next_cycles, next_us = syncs[position + 1][1:]
+            if next_us > ref_us:
+                rate = ((next_cycles - ref_cycles) & 0xFFFFFFFF) / (next_us - ref_us)
+
+        delta = (cycles - ref_cycles) & 0xFFFFFFFF
+        if delta >= 2**31:
+            delta -= 2**32
+        result.append(ref_us + delta / rate)
+
+    return result
+
+
+def export(mhz, ids, tasks, records, dropped):
+    events = [{"ph": "M", "pid": 0, "name": "process_name", "args": {"name": "ESP32-S3"}}]
+    seen = set()
+    start = None
+
+    converted = []
+    for core, core_records in sorted(records.items()):
+        times = timestamps(core_records, mhz)
+        if times is None:
+            print(f"core {core}: no sync records, skipped", file=sys.stderr)
+            continue
+        converted.extend((ts, core, record) for ts, record in zip(times, core_records))
+
+    converted.sort(key=lambda item: item[0])
+
+    for ts, core, (_cycles, task, kind, event_id, _reserved, value) in converted:
+        if kind == SYNC:
+            continue
+        if start is None:
+            start = ts
+
+        name = ids.get(event_id, f"event {event_id}")
+        event = {"name": name, "pid": 0, "tid": task, "ts": round(ts - start, 3), "args": {"core": core}}
+
+        if kind == BEGIN:
+            event["ph"] = "B"
+        elif kind == END:
+            event["ph"] = "E"
+        elif kind == INSTANT:
+            event["ph"] = "i"
+            event["s"] = "t"
+        else:
+            event["ph"] = "C"
+            event["args"] = {name: value}
+
+        events.append(event)
+
+        if task not in seen:
+            seen.add(task)
+            events.append({"ph": "M", "pid": 0, "tid": task, "name": "thread_name",
+                           "args": {"name": tasks.get(task, f"task {task:08x}")}})
+
+    for core, lost in sorted(dropped.items()):
+        if lost:
+            print(f"core {core}: {lost} events dropped on the device", file=sys.stderr)
+
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="console capture, - for stdin")
+    parser.add_argument("-o", "--output", default="trace.json", help="output file")
+    args = parser.parse_args()
+
+    if args.capture == "-":
+        trace = export(*parse(sys.stdin))
+    else:
+        with open(args.capture, errors="replace") as capture:
+            trace = export(*parse(capture))
+
+    with open(args.output, "w") as output:
+        json.dump(trace, output)
+
+    print(f"{len(trace['traceEvents'])} events written to {args.output}")
+
+
+if __name__ == "__main__":
+    main()